@@ -3,6 +3,7 @@
 #include "bggen.h"
 #include "color.h"
 #include "palette.h"
+#include "parallel.h"
 
 //cosine table: [frequency][t]
 static const float sCosTable[8][8] = {
@@ -39,85 +40,135 @@ static const float sWeightChroma[64] = {
 	0.1212f, 0.1212f, 0.1212f, 0.1212f, 0.1212f, 0.1212f, 0.1212f, 0.1212f
 };
 
-static void BgiComputeDctBlock(float *in, float *out) {
-	for (int ky = 0; ky < 8; ky++) {
+//DCT terms used for tile signatures. Terms odd in X or Y change sign when the tile is flipped.
+static const unsigned char sSignatureTermsLuma[] = { 0, 1, 8, 9, 2, 16, 18 };
+static const unsigned char sSignatureTermsChroma[] = { 0, 1, 8 };
+
+static void BgiComputeDctBlocks(float (*in)[4], BgDctBlock *out) {
+	//separable DCT of the four channels at once: first rows, then columns. Each pass scales by 1/4 and
+	//halves the first frequency, giving the same result as the direct 2D sum.
+	float rows[64][4];
+	for (int y = 0; y < 8; y++) {
 		for (int kx = 0; kx < 8; kx++) {
+			float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			for (int x = 0; x < 8; x++) {
+				float c = sCosTable[kx][x];
+				for (int ch = 0; ch < 4; ch++) sum[ch] += in[y * 8 + x][ch] * c;
+			}
 
-			double sum = 0.0;
-			for (int y = 0; y < 8; y++) {
-				double cosY = sCosTable[ky][y];
-				for (int x = 0; x < 8; x++) {
-					double cosX = sCosTable[kx][x];
+			float scale = kx == 0 ? 0.125f : 0.25f;
+			for (int ch = 0; ch < 4; ch++) rows[y * 8 + kx][ch] = sum[ch] * scale;
+		}
+	}
 
-					sum += in[y * 8 + x] * cosX * cosY;
-				}
+	float *blocks[] = { out->blockY, out->blockI, out->blockQ, out->blockA };
+	for (int ky = 0; ky < 8; ky++) {
+		for (int kx = 0; kx < 8; kx++) {
+			float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			for (int y = 0; y < 8; y++) {
+				float c = sCosTable[ky][y];
+				for (int ch = 0; ch < 4; ch++) sum[ch] += rows[y * 8 + kx][ch] * c;
 			}
 
-			//if first row/column, halve.
-			if (kx == 0) sum *= 0.5;
-			if (ky == 0) sum *= 0.5;
-			out[ky * 8 + kx] = (float) (sum * 0.0625);
+			float scale = ky == 0 ? 0.125f : 0.25f;
+			for (int ch = 0; ch < 4; ch++) blocks[ch][ky * 8 + kx] = sum[ch] * scale;
 		}
 	}
 }
 
-static void BgiComputeDct(RxReduction *reduction, BgTile *tile) {
-	//compute DCT block for Y, I, Q
-	float blockY[64], blockI[64], blockQ[64], blockA[64];
+static void BgiComputeDct(RxReduction *reduction, const BgTile *tile, BgDctBlock *dct);
+
+static void BgiComputeSignature(RxReduction *reduction, BgTile *tile) {
+	BgDctBlock dct;
+	BgiComputeDct(reduction, tile, &dct);
+
+	//scale DCT terms so that signature distance approximates pixel difference. Terms odd in X or Y
+	//are taken by magnitude so the signature is the same for all flips of a tile.
+	const float *blocks[] = { dct.blockY, dct.blockI, dct.blockQ, dct.blockA };
+	double weights[] = { reduction->yWeight, reduction->iWeight, reduction->qWeight, 40.0 };
+
+	int n = 0;
+	for (int i = 0; i < 4; i++) {
+		const unsigned char *terms = i == 0 ? sSignatureTermsLuma : sSignatureTermsChroma;
+		int nTerms = i == 0 ? sizeof(sSignatureTermsLuma) : sizeof(sSignatureTermsChroma);
+
+		for (int j = 0; j < nTerms; j++) {
+			int kx = terms[j] % 8, ky = terms[j] / 8;
+			double scale = 4.0 * weights[i];
+			if (kx == 0) scale *= 1.41421356;
+			if (ky == 0) scale *= 1.41421356;
+
+			double c = blocks[i][terms[j]] * scale;
+			if ((kx & 1) || (ky & 1)) c = fabs(c);
+			tile->signature[n++] = (float) c;
+		}
+	}
+}
+
+static void BgiComputeDct(RxReduction *reduction, const BgTile *tile, BgDctBlock *dct) {
+	//compute DCT block for Y, I, Q, A
+	float block[64][4];
 
 	for (int i = 0; i < 64; i++) {
 		double y = reduction->lumaTable[tile->pxYiq[i].y];
 		if (tile->pxYiq[i].a < 128) {
 			//A < 128: turn black transparent
 			y = 0.0;
-			blockA[i] = 0;
+			block[i][3] = 0;
 		} else {
 			//else turn full opaque
-			blockA[i] = 255;
+			block[i][3] = 255;
 		}
 
 		if (y > 0.0) {
-			blockY[i] = (float) y;
-			blockI[i] = (float) tile->pxYiq[i].i;
-			blockQ[i] = (float) tile->pxYiq[i].q;
+			block[i][0] = (float) y;
+			block[i][1] = (float) tile->pxYiq[i].i;
+			block[i][2] = (float) tile->pxYiq[i].q;
 		} else {
-			blockY[i] = 0.0f;
-			blockI[i] = 0.0f;
-			blockQ[i] = 0.0f;
+			block[i][0] = 0.0f;
+			block[i][1] = 0.0f;
+			block[i][2] = 0.0f;
 		}
 	}
 
 	//compute output blocks
-	BgiComputeDctBlock(blockY, tile->dct.blockY);
-	BgiComputeDctBlock(blockI, tile->dct.blockI);
-	BgiComputeDctBlock(blockQ, tile->dct.blockQ);
-	BgiComputeDctBlock(blockA, tile->dct.blockA);
+	BgiComputeDctBlocks(block, dct);
 }
 
-static double BgiCompareTilesDct(RxReduction *reduction, BgTile *tile1, BgTile *tile2, unsigned char mode) {
-	//sum of square
-	double error = 0.0;
-
-	for (int i = 0; i < 64; i++) {
-		double block2Y = tile2->dct.blockY[i];
-		double block2I = tile2->dct.blockI[i];
-		double block2Q = tile2->dct.blockQ[i];
-		double block2A = tile2->dct.blockA[i];
+static double BgiSignatureDistance(const BgTile *tile1, const BgTile *tile2, double maxDistance) {
+	//squared distance of signatures, approximately a lower bound of the pixel difference under any flip.
+	//Stops summing once maxDistance is reached.
+	double dist = 0.0;
+	for (int i = 0; i < BG_SIGNATURE_SIZE && dist < maxDistance; i++) {
+		double d = tile1->signature[i] - tile2->signature[i];
+		dist += d * d;
+	}
+	return dist;
+}
 
-		//flip X: negate every odd column
-		if ((mode & TILE_FLIPX) && (i % 2 == 1)) {
-			block2Y = -block2Y, block2I = -block2I, block2Q = -block2Q, block2A = -block2A;
-		}
+static double BgiCompareTilesDct(RxReduction *reduction, BgTile *tile1, BgTile *tile2, unsigned char mode, double maxError) {
+	BgDctBlock dct1, dct2;
+	BgiComputeDct(reduction, tile1, &dct1);
+	BgiComputeDct(reduction, tile2, &dct2);
 
-		//flip Y: negate every odd row
-		if ((mode & TILE_FLIPY) && ((i / 8) % 2 == 1)) {
+	//sum of square, stopping once maxError is reached
+	double error = 0.0;
+	for (int i = 0; i < 64 && error < maxError; i++) {
+		double block2Y = dct2.blockY[i];
+		double block2I = dct2.blockI[i];
+		double block2Q = dct2.blockQ[i];
+		double block2A = dct2.blockA[i];
+
+		//flip X: negate every odd column. flip Y: negate every odd row
+		int negate = ((mode & TILE_FLIPX) && (i % 2 == 1)) ^ ((mode & TILE_FLIPY) && ((i / 8) % 2 == 1));
+		if (negate) {
 			block2Y = -block2Y, block2I = -block2I, block2Q = -block2Q, block2A = -block2A;
 		}
 
-		double dy = sqrt(sWeightLuma[i])   * reduction->yWeight * (tile1->dct.blockY[i] - block2Y);
-		double di = sqrt(sWeightChroma[i]) * reduction->iWeight * (tile1->dct.blockI[i] - block2I);
-		double dq = sqrt(sWeightChroma[i]) * reduction->qWeight * (tile1->dct.blockQ[i] - block2Q);
-		double da = 40.0                                        * (tile1->dct.blockA[i] - block2A);
+		double dy = sqrt(sWeightLuma[i])   * reduction->yWeight * (dct1.blockY[i] - block2Y);
+		double di = sqrt(sWeightChroma[i]) * reduction->iWeight * (dct1.blockI[i] - block2I);
+		double dq = sqrt(sWeightChroma[i]) * reduction->qWeight * (dct1.blockQ[i] - block2Q);
+		double da = 40.0                                        * (dct1.blockA[i] - block2A);
 
 		//weighted error
 		error += dy * dy + di * di + dq * dq + da * da;
@@ -127,22 +178,22 @@ static double BgiCompareTilesDct(RxReduction *reduction, BgTile *tile1, BgTile *
 }
 
 
-static float BgiTileDifferenceFlip(RxReduction *reduction, BgTile *t1, BgTile *t2, unsigned char mode) {
+static float BgiTileDifferenceFlip(RxReduction *reduction, BgTile *t1, BgTile *t2, unsigned char mode, double maxError) {
+	//returns once the error reaches maxError, the result is then only a lower bound.
 	if (1) {
 		double err = 0.0;
-		COLOR32 *px1 = t1->px;
 		double yw2 = reduction->yWeight * reduction->yWeight;
 		double iw2 = reduction->iWeight * reduction->iWeight;
 		double qw2 = reduction->qWeight * reduction->qWeight;
 
-		for (int y = 0; y < 8; y++) {
+		for (int y = 0; y < 8 && err < maxError; y++) {
 			for (int x = 0; x < 8; x++) {
 
 				int x2 = (mode & TILE_FLIPX) ? (7 - x) : x;
 				int y2 = (mode & TILE_FLIPY) ? (7 - y) : y;
 
-				RxYiqColor *yiq1 = &t1->pxYiq[x + y * 8];
-				RxYiqColor *yiq2 = &t2->pxYiq[x2 + y2 * 8];
+				BgYiqColor *yiq1 = &t1->pxYiq[x + y * 8];
+				BgYiqColor *yiq2 = &t2->pxYiq[x2 + y2 * 8];
 				double dy = reduction->lumaTable[yiq1->y] - reduction->lumaTable[yiq2->y];
 				double di = yiq1->i - yiq2->i;
 				double dq = yiq1->q - yiq2->q;
@@ -153,50 +204,24 @@ static float BgiTileDifferenceFlip(RxReduction *reduction, BgTile *t1, BgTile *t
 
 		return (float) err;
 	} else {
-		return (float) BgiCompareTilesDct(reduction, t1, t2, mode);
+		return (float) BgiCompareTilesDct(reduction, t1, t2, mode, maxError);
 	}
 }
 
 static float BgiTileDifference(RxReduction *reduction, BgTile *t1, BgTile *t2, unsigned char *flipMode) {
-	float err = BgiTileDifferenceFlip(reduction, t1, t2, 0);
-	if (err == 0) {
-		*flipMode = 0;
-		return err;
-	}
-	float err2 = BgiTileDifferenceFlip(reduction, t1, t2, TILE_FLIPX);
-	if (err2 == 0) {
-		*flipMode = TILE_FLIPX;
-		return err2;
-	}
-	float err3 = BgiTileDifferenceFlip(reduction, t1, t2, TILE_FLIPY);
-	if (err3 == 0) {
-		*flipMode = TILE_FLIPY;
-		return err3;
-	}
-	float err4 = BgiTileDifferenceFlip(reduction, t1, t2, TILE_FLIPXY);
-	if (err4 == 0) {
-		*flipMode = TILE_FLIPXY;
-		return err4;
-	}
-
-	if (err <= err2 && err <= err3 && err <= err4) {
-		*flipMode = 0;
-		return err;
-	}
-	if (err2 <= err && err2 <= err3 && err2 <= err4) {
-		*flipMode = TILE_FLIPX;
-		return err2;
-	}
-	if (err3 <= err && err3 <= err2 && err3 <= err4) {
-		*flipMode = TILE_FLIPY;
-		return err3;
-	}
-	if (err4 <= err && err4 <= err2 && err4 <= err3) {
-		*flipMode = TILE_FLIPXY;
-		return err4;
+	//try each flip, the first with the least error wins. Later flips stop early once they can't win.
+	static const unsigned char modes[] = { TILE_FLIPNONE, TILE_FLIPX, TILE_FLIPY, TILE_FLIPXY };
+
+	float best = BgiTileDifferenceFlip(reduction, t1, t2, modes[0], 1e32);
+	*flipMode = modes[0];
+	for (int i = 1; i < 4 && best > 0; i++) {
+		float err = BgiTileDifferenceFlip(reduction, t1, t2, modes[i], best);
+		if (err < best) {
+			best = err;
+			*flipMode = modes[i];
+		}
 	}
-	*flipMode = 0;
-	return err;
+	return best;
 }
 
 static void BgiAddTileToTotal(RxReduction *reduction, int *pxBlock, BgTile *tile) {
@@ -218,366 +243,604 @@ static void BgiAddTileToTotal(RxReduction *reduction, int *pxBlock, BgTile *tile
 	}
 }
 
-typedef struct BgTileDiff_ {
+#define BG_CANDIDATE_COUNT  16      //number of merge candidates searched per tile
+#define BG_CANDIDATE_SCAN   256     //maximum number of tiles scanned each way for candidates
+#define BG_BAND_TILES       1024    //tiles processed at once by BgGenerate without character compression
+
+typedef struct BgTileMerge_ {
 	int tile1;
 	int tile2;
-	double diff;		//post-biased
-} BgTileDiff;
-
-typedef struct BgTileDiffList_ {
-	BgTileDiff *diffBuff;
-	int diffBuffSize;
-	int diffBuffLength;
-	double minDiff;
-	double maxDiff;
-} BgTileDiffList;
-
-static void BgiTdlInit(BgTileDiffList *list, int nEntries) {
-	list->diffBuffSize = nEntries;
-	list->diffBuffLength = 0;
-	list->minDiff = 1e32;
-	list->maxDiff = 0;
-	list->diffBuff = (BgTileDiff *) calloc(list->diffBuffSize, sizeof(BgTileDiff));
+	int flip;           //how tile2 must be flipped to match tile1
+	int nRepresents;    //combined represent count the cost was computed with
+	double diff;
+	double cost;        //post-biased
+} BgTileMerge;
+
+typedef struct BgMergeQueue_ {
+	BgTileMerge *entries;
+	int length;
+	int capacity;
+} BgMergeQueue;
+
+typedef struct BgSignatureKey_ {
+	float key;
+	int tile;
+} BgSignatureKey;
+
+static void BgiMqInit(BgMergeQueue *queue, int capacity) {
+	if (capacity < 16) capacity = 16;
+	queue->length = 0;
+	queue->capacity = capacity;
+	queue->entries = (BgTileMerge *) calloc(capacity, sizeof(BgTileMerge));
 }
 
-static void BgiTdlFree(BgTileDiffList *list) {
-	free(list->diffBuff);
-	list->diffBuff = NULL;
-	list->diffBuffLength = 0;
-	list->diffBuffSize = 0;
+static void BgiMqFree(BgMergeQueue *queue) {
+	free(queue->entries);
+	queue->entries = NULL;
+	queue->length = 0;
+	queue->capacity = 0;
 }
 
-static void BgiTdlAdd(BgTileDiffList *list, int tile1, int tile2, double diff) {
-	if (list->diffBuffLength == list->diffBuffSize && diff >= list->maxDiff) return;
+static int BgiMqLess(const BgTileMerge *m1, const BgTileMerge *m2) {
+	//order by cost, break ties by tile index so the result does not depend on queue order
+	if (m1->cost != m2->cost) return m1->cost < m2->cost;
+	if (m1->tile1 != m2->tile1) return m1->tile1 < m2->tile1;
+	return m1->tile2 < m2->tile2;
+}
 
-	//find an insertion point
-	//TODO: binary search
-	int destIndex = list->diffBuffLength;
-	if (diff < list->minDiff) {
-		destIndex = 0;
-	} else {
-		for (int i = 0; i < list->diffBuffLength; i++) {
-			if (diff < list->diffBuff[i].diff) {
-				destIndex = i;
-				break;
-			}
-		}
+static void BgiMqPush(BgMergeQueue *queue, const BgTileMerge *merge) {
+	if (queue->length == queue->capacity) {
+		queue->capacity *= 2;
+		queue->entries = (BgTileMerge *) realloc(queue->entries, queue->capacity * sizeof(BgTileMerge));
 	}
 
-	//insert
-	int nEntriesToMove = list->diffBuffLength - destIndex;
-	int added = 1; //was a new entry created?
-	if (destIndex + 1 + nEntriesToMove > list->diffBuffSize) {
-		nEntriesToMove = list->diffBuffSize - destIndex - 1;
-		added = 0;
-	}
-	memmove(list->diffBuff + destIndex + 1, list->diffBuff + destIndex, nEntriesToMove * sizeof(BgTileDiff));
-	list->diffBuff[destIndex].tile1 = tile1;
-	list->diffBuff[destIndex].tile2 = tile2;
-	list->diffBuff[destIndex].diff = diff;
-	if (added) {
-		list->diffBuffLength++;
+	//sift up
+	BgTileMerge *entries = queue->entries;
+	int i = queue->length++;
+	while (i > 0) {
+		int parent = (i - 1) / 2;
+		if (!BgiMqLess(merge, &entries[parent])) break;
+		entries[i] = entries[parent];
+		i = parent;
 	}
-	list->minDiff = list->diffBuff[0].diff;
-	list->maxDiff = list->diffBuff[list->diffBuffLength - 1].diff;
+	entries[i] = *merge;
 }
 
-static void BgiTdlRemoveAll(BgTileDiffList *list, int tile1, int tile2) {
-	//remove all diffs involving tile1 and tile2
-	for (int i = 0; i < list->diffBuffLength; i++) {
-		BgTileDiff *td = list->diffBuff + i;
-		if (td->tile1 == tile1 || td->tile2 == tile1 || td->tile1 == tile2 || td->tile2 == tile2) {
-			memmove(td, td + 1, (list->diffBuffLength - i - 1) * sizeof(BgTileDiff));
-			list->diffBuffLength--;
-			i--;
-		}
-	}
-	if (list->diffBuffLength > 0) {
-		list->minDiff = list->diffBuff[0].diff;
-		list->maxDiff = list->diffBuff[list->diffBuffLength - 1].diff;
+static int BgiMqPop(BgMergeQueue *queue, BgTileMerge *out) {
+	if (queue->length == 0) return 0;
+
+	BgTileMerge *entries = queue->entries;
+	*out = entries[0];
+	BgTileMerge last = entries[--queue->length];
+
+	//sift down
+	int i = 0;
+	while (1) {
+		int child = i * 2 + 1;
+		if (child >= queue->length) break;
+		if (child + 1 < queue->length && BgiMqLess(&entries[child + 1], &entries[child])) child++;
+		if (!BgiMqLess(&entries[child], &last)) break;
+		entries[i] = entries[child];
+		i = child;
 	}
+	if (queue->length > 0) entries[i] = last;
+	return 1;
 }
 
-static void BgiTdlPop(BgTileDiffList *list, BgTileDiff *out) {
-	if (list->diffBuffLength > 0) {
-		memcpy(out, list->diffBuff, sizeof(BgTileDiff));
-		memmove(list->diffBuff, list->diffBuff + 1, (list->diffBuffLength - 1) * sizeof(BgTileDiff));
-		list->diffBuffLength--;
-		if (list->diffBuffLength > 0) {
-			list->minDiff = list->diffBuff[0].diff;
-		}
-	}
-}
+static void BgiComputeMergeCost(BgTile *tiles, BgTileMerge *merge) {
+	merge->nRepresents = tiles[merge->tile1].nRepresents + tiles[merge->tile2].nRepresents;
 
-static void BgiTdlReset(BgTileDiffList *list) {
-	list->diffBuffLength = 0;
-	list->maxDiff = 0;
-	list->minDiff = 1e32;
+	double bias = merge->nRepresents;
+	merge->cost = merge->diff * bias * bias;
 }
 
-int BgPerformCharacterCompression(BgTile *tiles, int nTiles, int nBits, int nMaxChars, COLOR32 *palette, int paletteSize, int nPalettes,
-	int paletteBase, int paletteOffset, int balance, int colorBalance, int *progress) {
-	int nChars = nTiles;
-	float *diffBuff = (float *) calloc(nTiles * nTiles, sizeof(float));
-	unsigned char *flips = (unsigned char *) calloc(nTiles * nTiles, 1); //how must each tile be manipulated to best match its partner
-
-	RxReduction *reduction = (RxReduction *) calloc(1, sizeof(RxReduction));
-	RxInit(reduction, balance, colorBalance, 15, 0, 255);
-	for (int i = 0; i < nTiles; i++) {
-		BgTile *t1 = tiles + i;
-		for (int j = 0; j < i; j++) {
-			BgTile *t2 = tiles + j;
+static void BgiMergeTiles(BgTile *tiles, int *next, int tile1, int tile2, int flip) {
+	//all tile2 tiles become tile1 tiles. next links the tiles sharing a master tile.
+	int last = tile2;
+	for (int i = tile2; i != -1; i = next[i]) {
+		tiles[i].masterTile = tile1;
+		tiles[i].flipMode ^= flip;
+		tiles[i].nRepresents = 0;
+		tiles[tile1].nRepresents++;
+		last = i;
+	}
+	next[last] = next[tile1];
+	next[tile1] = tile2;
+}
 
-			diffBuff[i + j * nTiles] = BgiTileDifference(reduction, t1, t2, &flips[i + j * nTiles]);
-			diffBuff[j + i * nTiles] = diffBuff[i + j * nTiles];
-			flips[j + i * nTiles] = flips[i + j * nTiles];
-		}
-		*progress = (i * i) / nTiles * 500 / nTiles;
+static uint32_t BgiHashTile(const BgYiqColor *px) {
+	//FNV-1a
+	uint32_t hash = 0x811C9DC5;
+	const int16_t *words = (const int16_t *) px;
+	for (int i = 0; i < 64 * 4; i++) {
+		hash ^= (uint32_t) words[i];
+		hash *= 0x01000193;
 	}
+	return hash;
+}
 
-	//first, combine tiles with a difference of 0.
+static int BgiMergeIdenticalTiles(BgTile *tiles, int nTiles, int *next) {
+	//hash table of master tiles by their unflipped colors
+	int tableSize = 16;
+	while (tableSize < nTiles * 2) tableSize <<= 1;
+	int *table = (int *) malloc(tableSize * sizeof(int));
+	memset(table, 0xFF, tableSize * sizeof(int));
 
+	int nChars = nTiles;
 	for (int i = 0; i < nTiles; i++) {
-		BgTile *t1 = tiles + i;
-		if (t1->masterTile != i) continue;
-
-		for (int j = 0; j < i; j++) {
-			BgTile *t2 = tiles + j;
-			if (t2->masterTile != j) continue;
-
-			if (diffBuff[i + j * nTiles] == 0) {
-				//merge all tiles with master index i to j
-				for (int k = 0; k < nTiles; k++) {
-					if (tiles[k].masterTile == i) {
-						tiles[k].masterTile = j;
-						tiles[k].flipMode ^= flips[i + j * nTiles];
-						tiles[k].nRepresents = 0;
-						tiles[j].nRepresents++;
-					}
-				}
+		int insertSlot = -1;
+
+		for (int flip = TILE_FLIPNONE; flip <= TILE_FLIPXY; flip++) {
+			//a master tile matching this tile flipped is a master tile this tile can use
+			BgYiqColor flipped[64];
+			for (int j = 0; j < 64; j++) {
+				int x = (j % 8) ^ ((flip & TILE_FLIPX) ? 7 : 0);
+				int y = (j / 8) ^ ((flip & TILE_FLIPY) ? 7 : 0);
+				flipped[j] = tiles[i].pxYiq[x + y * 8];
+			}
+
+			int slot = BgiHashTile(flipped) & (tableSize - 1);
+			while (table[slot] != -1 && memcmp(tiles[table[slot]].pxYiq, flipped, sizeof(flipped)) != 0) {
+				slot = (slot + 1) & (tableSize - 1);
+			}
+			if (table[slot] != -1) {
+				BgiMergeTiles(tiles, next, table[slot], i, flip);
 				nChars--;
-				if (nTiles > nMaxChars) *progress = 500 + (int) (500 * sqrt((float) (nTiles - nChars) / (nTiles - nMaxChars)));
+				insertSlot = -1;
+				break;
 			}
+			if (flip == TILE_FLIPNONE) insertSlot = slot;
 		}
+
+		if (insertSlot != -1) table[insertSlot] = i;
 	}
 
-	//still too many? 
-	if (nChars > nMaxChars) {
-		//damn
+	free(table);
+	return nChars;
+}
 
-		//create a rolling buffer of similar tiles. 
-		//when tiles are combined, combinations that involve affected tiles in the array are removed.
-		//fill it to capacity initially, then keep using it until it's empty, then fill again.
-		BgTileDiffList tdl;
-		BgiTdlInit(&tdl, 64);
+static int BgiSignatureKeyComparator(const void *p1, const void *p2) {
+	const BgSignatureKey *k1 = (const BgSignatureKey *) p1;
+	const BgSignatureKey *k2 = (const BgSignatureKey *) p2;
+	if (k1->key < k2->key) return -1;
+	if (k1->key > k2->key) return 1;
+	return k1->tile - k2->tile;
+}
 
-		//keep finding the most similar tile until we get character count down
-		int direction = 0;
-		while (nChars > nMaxChars) {
-			for (int iOuter = 0; iOuter < nTiles; iOuter++) {
-				int i = direction ? (nTiles - 1 - iOuter) : iOuter; //criss cross the direction
-				BgTile *t1 = tiles + i;
-				if (t1->masterTile != i) continue;
-
-				for (int j = 0; j < i; j++) {
-					BgTile *t2 = tiles + j;
-					if (t2->masterTile != j) continue;
-
-					double thisErrorEntry = diffBuff[i + j * nTiles];
-					double thisError = thisErrorEntry;
-					double bias = t1->nRepresents + t2->nRepresents;
-					bias *= bias;
-
-					thisError = thisErrorEntry * bias;
-					BgiTdlAdd(&tdl, j, i, thisError);
-				}
+static void BgiFindCandidates(BgTile *tiles, BgSignatureKey *order, int nOrder, int pos, int *candidates) {
+	//nearest signatures to the tile at pos. Tiles are ordered by their first signature term, so
+	//the search stops once that term alone is further than the worst candidate.
+	float dists[BG_CANDIDATE_COUNT];
+	int nFound = 0;
+	BgTile *tile1 = tiles + order[pos].tile;
+
+	for (int dir = -1; dir <= 1; dir += 2) {
+		for (int i = 1; i <= BG_CANDIDATE_SCAN; i++) {
+			int pos2 = pos + i * dir;
+			if (pos2 < 0 || pos2 >= nOrder) break;
+
+			float dk = order[pos2].key - order[pos].key;
+			float maxDist = nFound == BG_CANDIDATE_COUNT ? dists[BG_CANDIDATE_COUNT - 1] : 1e32f;
+			if (dk * dk >= maxDist) break;
+
+			float dist = (float) BgiSignatureDistance(tile1, tiles + order[pos2].tile, maxDist);
+			if (dist >= maxDist) continue;
+
+			//insert sorted
+			int dest = nFound < BG_CANDIDATE_COUNT ? nFound++ : (BG_CANDIDATE_COUNT - 1);
+			while (dest > 0 && dists[dest - 1] > dist) {
+				dists[dest] = dists[dest - 1];
+				candidates[dest] = candidates[dest - 1];
+				dest--;
 			}
+			dists[dest] = dist;
+			candidates[dest] = order[pos2].tile;
+		}
+	}
 
-			//now merge tiles while we can
-			int tile1, tile2;
-			while (tdl.diffBuffLength > 0 && nChars > nMaxChars) {
-				BgTileDiff td;
-				BgiTdlPop(&tdl, &td);
-
-				//tile merging
-				tile1 = td.tile1;
-				tile2 = td.tile2;
-
-				//should we swap tile1 and tile2? tile2 should have <= tile1's nRepresents
-				if (tiles[tile2].nRepresents > tiles[tile1].nRepresents) {
-					int t = tile1;
-					tile1 = tile2;
-					tile2 = t;
-				}
+	for (int i = nFound; i < BG_CANDIDATE_COUNT; i++) candidates[i] = -1;
+}
 
-				//merge tile1 and tile2. All tile2 tiles become tile1 tiles
-				unsigned char flipDiff = flips[tile1 + tile2 * nTiles];
-				for (int i = 0; i < nTiles; i++) {
-					if (tiles[i].masterTile == tile2) {
-						tiles[i].masterTile = tile1;
-						tiles[i].flipMode ^= flipDiff;
-						tiles[i].nRepresents = 0;
-						tiles[tile1].nRepresents++;
-					}
-				}
+typedef struct BgCandidateSearch_ {
+	RxReduction *reduction;
+	BgTile *tiles;
+	BgSignatureKey *order;
+	int nMasters;
+	int *candidates;
+	int *rank;
+	BgTileMerge *merges;
+} BgCandidateSearch;
+
+static void BgiFindCandidatesProc(void *context, int thread, int item) {
+	BgCandidateSearch *search = (BgCandidateSearch *) context;
+	BgiFindCandidates(search->tiles, search->order, search->nMasters, item, search->candidates + item * BG_CANDIDATE_COUNT);
+}
 
-				nChars--;
-				*progress = 500 + (int) (500 * sqrt((float) (nTiles - nChars) / (nTiles - nMaxChars)));
+static void BgiComputeSignatureProc(void *context, int thread, int item) {
+	BgCandidateSearch *search = (BgCandidateSearch *) context;
+	BgTile *tile = search->tiles + item;
+	if (tile->masterTile == item) BgiComputeSignature(search->reduction, tile);
+}
 
-				BgiTdlRemoveAll(&tdl, td.tile1, td.tile2);
+static void BgiComputeCandidateMergesProc(void *context, int thread, int item) {
+	BgCandidateSearch *search = (BgCandidateSearch *) context;
+	BgTile *tiles = search->tiles;
+	int tile1 = search->order[item].tile;
+	int *cand1 = search->candidates + item * BG_CANDIDATE_COUNT;
+	BgTileMerge *merges = search->merges + item * BG_CANDIDATE_COUNT;
+
+	for (int j = 0; j < BG_CANDIDATE_COUNT; j++) {
+		int tile2 = cand1[j];
+		merges[j].tile1 = -1;
+		if (tile2 == -1) continue;
+
+		//skip pairs already covered by the other tile's candidates
+		if (tile2 < tile1) {
+			int *cand2 = search->candidates + search->rank[tile2] * BG_CANDIDATE_COUNT, found = 0;
+			for (int k = 0; k < BG_CANDIDATE_COUNT && cand2[k] != -1; k++) {
+				if (cand2[k] == tile1) found = 1;
 			}
-			direction = !direction;
-			BgiTdlReset(&tdl);
+			if (found) continue;
 		}
-		BgiTdlFree(&tdl);
+
+		unsigned char flip;
+		merges[j].tile1 = tile1;
+		merges[j].tile2 = tile2;
+		merges[j].diff = BgiTileDifference(search->reduction, tiles + tile1, tiles + tile2, &flip);
+		merges[j].flip = flip;
+		BgiComputeMergeCost(tiles, &merges[j]);
 	}
+}
 
-	free(flips);
-	free(diffBuff);
+static void BgiQueueCandidates(RxReduction *reduction, BgTile *tiles, int nTiles, BgMergeQueue *queue, int *progress) {
+	BgCandidateSearch search;
+	search.reduction = reduction;
+	search.tiles = tiles;
 
-	//try to make the compressed result look less bad
+	//order master tiles by signature
+	int nMasters = 0;
+	BgSignatureKey *order = (BgSignatureKey *) calloc(nTiles, sizeof(BgSignatureKey));
 	for (int i = 0; i < nTiles; i++) {
 		if (tiles[i].masterTile != i) continue;
-		if (tiles[i].nRepresents <= 1) continue; //no averaging required for just one tile
-		BgTile *tile = tiles + i;
-
-		//average all tiles that use this master tile.
-		int pxBlock[64 * 4] = { 0 };
-		int nRep = tile->nRepresents;
-		for (int j = 0; j < nTiles; j++) {
-			if (tiles[j].masterTile != i) continue;
-			BgTile *tile2 = tiles + j;
-			BgiAddTileToTotal(reduction, pxBlock, tile2);
-		}
+		order[nMasters].key = tiles[i].signature[0];
+		order[nMasters].tile = i;
+		nMasters++;
+	}
+	qsort(order, nMasters, sizeof(BgSignatureKey), BgiSignatureKeyComparator);
+
+	search.order = order;
+	search.nMasters = nMasters;
+	search.candidates = (int *) calloc(nMasters * BG_CANDIDATE_COUNT, sizeof(int));
+	search.merges = (BgTileMerge *) calloc(nMasters * BG_CANDIDATE_COUNT, sizeof(BgTileMerge));
+	search.rank = (int *) calloc(nTiles, sizeof(int));
+	for (int i = 0; i < nMasters; i++) {
+		search.rank[order[i].tile] = i;
+	}
 
-		//divide by count, convert to 32-bit RGB
-		for (int j = 0; j < 64 * 4; j++) {
-			int ch = pxBlock[j];
+	//search candidates and compute their differences in parallel, then queue them in order.
+	ParRun(nMasters, BgiFindCandidatesProc, &search, NULL, 0, 0);
+	ParRun(nMasters, BgiComputeCandidateMergesProc, &search, progress, 0, 500);
+	for (int i = 0; i < nMasters * BG_CANDIDATE_COUNT; i++) {
+		if (search.merges[i].tile1 != -1) BgiMqPush(queue, &search.merges[i]);
+	}
 
-			//proper round to nearest
-			if (ch >= 0) {
-				ch = (ch * 2 + nRep) / (nRep * 2);
-			} else {
-				ch = (ch * 2 - nRep) / (nRep * 2);
-			}
-			pxBlock[j] = ch;
+	free(search.rank);
+	free(search.merges);
+	free(search.candidates);
+	free(order);
+}
+
+typedef struct BgTileFinalize_ {
+	RxReduction *reduction;
+	BgTile *tiles;
+	int *next;
+	int *masters;
+	COLOR32 *palette;
+	int nBits;
+	int paletteSize;
+	int nPalettes;
+	int paletteBase;
+	int paletteOffset;
+	int balance;
+	int colorBalance;
+} BgTileFinalize;
+
+static void BgiFinalizeTileProc(void *context, int thread, int item) {
+	//the reduction is only read from here, so it is shared by all threads.
+	BgTileFinalize *finalize = (BgTileFinalize *) context;
+	RxReduction *reduction = finalize->reduction;
+	BgTile *tiles = finalize->tiles;
+	int *next = finalize->next;
+	COLOR32 *palette = finalize->palette;
+	int nBits = finalize->nBits, paletteSize = finalize->paletteSize, nPalettes = finalize->nPalettes;
+	int paletteBase = finalize->paletteBase, paletteOffset = finalize->paletteOffset;
+	int balance = finalize->balance, colorBalance = finalize->colorBalance;
+
+	int i = finalize->masters[item];
+	BgTile *tile = tiles + i;
+
+	//average all tiles that use this master tile.
+	int pxBlock[64 * 4] = { 0 };
+	int nRep = tile->nRepresents;
+	for (int j = i; j != -1; j = next[j]) {
+		BgiAddTileToTotal(reduction, pxBlock, tiles + j);
+	}
+
+	//divide by count, convert to 32-bit RGB
+	for (int j = 0; j < 64 * 4; j++) {
+		int ch = pxBlock[j];
+
+		//proper round to nearest
+		if (ch >= 0) {
+			ch = (ch * 2 + nRep) / (nRep * 2);
+		} else {
+			ch = (ch * 2 - nRep) / (nRep * 2);
 		}
-		for (int j = 0; j < 64; j++) {
-			int cy = pxBlock[j * 4 + 0]; //times 16
-			int ci = pxBlock[j * 4 + 1];
-			int cq = pxBlock[j * 4 + 2];
-			int ca = pxBlock[j * 4 + 3];
+		pxBlock[j] = ch;
+	}
+	for (int j = 0; j < 64; j++) {
+		int cy = pxBlock[j * 4 + 0]; //times 16
+		int ci = pxBlock[j * 4 + 1];
+		int cq = pxBlock[j * 4 + 2];
+		int ca = pxBlock[j * 4 + 3];
 
-			double dcy = ((double) cy) / 16.0;
-			cy = (int) (pow(dcy * 0.00195695, 1.0 / reduction->gamma) * 511.0);
+		double dcy = ((double) cy) / 16.0;
+		cy = (int) (pow(dcy * 0.00195695, 1.0 / reduction->gamma) * 511.0);
 
-			RxYiqColor yiq = { cy, ci, cq, ca };
-			RxRgbColor rgb;
-			RxConvertYiqToRgb(&rgb, &yiq);
+		RxYiqColor yiq = { cy, ci, cq, ca };
+		RxRgbColor rgb;
+		RxConvertYiqToRgb(&rgb, &yiq);
+
+		tile->px[j] = rgb.r | (rgb.g << 8) | (rgb.b << 16) | (ca << 24);
+	}
+
+	//try to determine the most optimal palette. Child tiles can be different palettes.
+	int bestPalette = paletteBase;
+	double bestError = 1e32;
+	for (int j = paletteBase; j < paletteBase + nPalettes; j++) {
+		COLOR32 *pal = palette + (j << nBits) + paletteOffset + !paletteOffset;
+		double err = RxComputePaletteError(reduction, tile->px, 64, pal, paletteSize - !paletteOffset, 128, bestError);
+
+		if (err < bestError) {
+			bestError = err;
+			bestPalette = j;
+		}
+	}
 
-			tile->px[j] = rgb.r | (rgb.g << 8) | (rgb.b << 16) | (ca << 24);
+	//now, match colors to indices.
+	COLOR32 *pal = palette + (bestPalette << nBits);
+	RxReduceImageEx(tile->px, NULL, 8, 8, pal + paletteOffset + !paletteOffset,
+		paletteSize - !paletteOffset, 0, 1, 0, 0.0f, balance, colorBalance, 0);
+	for (int j = 0; j < 64; j++) {
+		COLOR32 col = tile->px[j];
+		int index = 0;
+		if (((col >> 24) & 0xFF) > 127) {
+			index = RxPaletteFindClosestColorSimple(col, pal + paletteOffset + !paletteOffset, paletteSize - !paletteOffset)
+				+ !paletteOffset + paletteOffset;
 		}
 
-		//try to determine the most optimal palette. Child tiles can be different palettes.
-		int bestPalette = paletteBase;
-		double bestError = 1e32;
-		for (int j = paletteBase; j < paletteBase + nPalettes; j++) {
-			COLOR32 *pal = palette + (j << nBits) + paletteOffset + !paletteOffset;
-			double err = RxComputePaletteError(reduction, tile->px, 64, pal, paletteSize - !paletteOffset, 128, bestError);
+		tile->indices[j] = index;
+		tile->px[j] = index ? (pal[index] | 0xFF000000) : 0;
+	}
+	tile->palette = bestPalette;
+
+	//lastly, copy tile->indices to all child tile->indices, just to make sure palette and character are in synch.
+	for (int j = next[i]; j != -1; j = next[j]) {
+		BgTile *tile2 = tiles + j;
+
+		memcpy(tile2->indices, tile->indices, 64);
+		tile2->palette = tile->palette;
+	}
+}
+
+int BgPerformCharacterCompression(BgTile *tiles, int nTiles, int nBits, int nMaxChars, COLOR32 *palette, int paletteSize, int nPalettes,
+	int paletteBase, int paletteOffset, int balance, int colorBalance, int *progress) {
+	RxReduction *reduction = (RxReduction *) calloc(1, sizeof(RxReduction));
+	RxInit(reduction, balance, colorBalance, 15, 0, 255);
 
-			if (err < bestError) {
-				bestError = err;
-				bestPalette = j;
+	//links tiles sharing a master tile, starting from the master tile.
+	int *next = (int *) malloc(nTiles * sizeof(int));
+	memset(next, 0xFF, nTiles * sizeof(int));
+
+	//first, combine identical tiles, including flipped.
+	int nChars = BgiMergeIdenticalTiles(tiles, nTiles, next);
+
+	//still too many? 
+	if (nChars > nMaxChars) {
+		//damn
+
+		//compute signatures of the remaining master tiles, and queue merges with each tile's nearest
+		//candidates by signature. Merges are
+		//taken from the queue in order of biased difference. Costs are updated lazily when a merge
+		//is popped, so the queue only holds merges whose cost can have grown since being queued.
+		BgCandidateSearch search;
+		search.reduction = reduction;
+		search.tiles = tiles;
+		ParRun(nTiles, BgiComputeSignatureProc, &search, NULL, 0, 0);
+
+		BgMergeQueue queue;
+		BgiMqInit(&queue, nChars * BG_CANDIDATE_COUNT);
+		BgiQueueCandidates(reduction, tiles, nTiles, &queue, progress);
+
+		//keep merging the most similar tiles until we get character count down
+		while (nChars > nMaxChars) {
+			BgTileMerge merge;
+			if (!BgiMqPop(&queue, &merge)) {
+				//out of candidates, search again among the remaining master tiles
+				BgiQueueCandidates(reduction, tiles, nTiles, &queue, NULL);
+				if (queue.length == 0) break;
+				continue;
 			}
-		}
 
-		//now, match colors to indices.
-		COLOR32 *pal = palette + (bestPalette << nBits);
-		RxReduceImageEx(tile->px, NULL, 8, 8, pal + paletteOffset + !paletteOffset,
-			paletteSize - !paletteOffset, 0, 1, 0, 0.0f, balance, colorBalance, 0);
-		for (int j = 0; j < 64; j++) {
-			COLOR32 col = tile->px[j];
-			int index = 0;
-			if (((col >> 24) & 0xFF) > 127) {
-				index = RxPaletteFindClosestColorSimple(col, pal + paletteOffset + !paletteOffset, paletteSize - !paletteOffset)
-					+ !paletteOffset + paletteOffset;
+			int tile1 = tiles[merge.tile1].masterTile;
+			int tile2 = tiles[merge.tile2].masterTile;
+			if (tile1 == tile2) continue;
+
+			if (tile1 != merge.tile1 || tile2 != merge.tile2) {
+				//a tile was merged away since this was queued. Compare against its new master tile.
+				unsigned char flip;
+				merge.tile1 = tile1;
+				merge.tile2 = tile2;
+				merge.diff = BgiTileDifference(reduction, tiles + tile1, tiles + tile2, &flip);
+				merge.flip = flip;
+				BgiComputeMergeCost(tiles, &merge);
+				BgiMqPush(&queue, &merge);
+				continue;
+			}
+			if (merge.nRepresents != tiles[tile1].nRepresents + tiles[tile2].nRepresents) {
+				//bias changed since this was queued
+				BgiComputeMergeCost(tiles, &merge);
+				BgiMqPush(&queue, &merge);
+				continue;
 			}
 
-			tile->indices[j] = index;
-			tile->px[j] = index ? (pal[index] | 0xFF000000) : 0;
-		}
-		tile->palette = bestPalette;
+			//should we swap tile1 and tile2? tile2 should have <= tile1's nRepresents
+			if (tiles[tile2].nRepresents > tiles[tile1].nRepresents) {
+				int t = tile1;
+				tile1 = tile2;
+				tile2 = t;
+			}
 
-		//lastly, copy tile->indices to all child tile->indices, just to make sure palette and character are in synch.
-		for (int j = 0; j < nTiles; j++) {
-			if (tiles[j].masterTile != i) continue;
-			if (j == i) continue;
-			BgTile *tile2 = tiles + j;
+			//merge tile1 and tile2. All tile2 tiles become tile1 tiles
+			BgiMergeTiles(tiles, next, tile1, tile2, merge.flip);
 
-			memcpy(tile2->indices, tile->indices, 64);
-			tile2->palette = tile->palette;
+			nChars--;
+			*progress = 500 + (int) (500 * sqrt((float) (nTiles - nChars) / (nTiles - nMaxChars)));
 		}
+
+		BgiMqFree(&queue);
+	}
+
+	//try to make the compressed result look less bad. Master tiles are independent of each other.
+	BgTileFinalize finalize;
+	finalize.reduction = reduction;
+	finalize.tiles = tiles;
+	finalize.next = next;
+	finalize.masters = (int *) calloc(nChars, sizeof(int));
+	finalize.palette = palette;
+	finalize.nBits = nBits;
+	finalize.paletteSize = paletteSize;
+	finalize.nPalettes = nPalettes;
+	finalize.paletteBase = paletteBase;
+	finalize.paletteOffset = paletteOffset;
+	finalize.balance = balance;
+	finalize.colorBalance = colorBalance;
+
+	int nFinalize = 0;
+	for (int i = 0; i < nTiles; i++) {
+		if (tiles[i].masterTile != i) continue;
+		if (tiles[i].nRepresents <= 1) continue; //no averaging required for just one tile
+		finalize.masters[nFinalize++] = i;
 	}
+	ParRun(nFinalize, BgiFinalizeTileProc, &finalize, NULL, 0, 0);
+	free(finalize.masters);
 
+	free(next);
 	RxDestroy(reduction);
 	free(reduction);
 	return nChars;
 }
 
-void BgSetupTiles(BgTile *tiles, int nTiles, int nBits, COLOR32 *palette, int paletteSize, int nPalettes, int paletteBase, int paletteOffset, int dither, float diffuse, int balance, int colorBalance, int enhanceColors) {
-	RxReduction *reduction = (RxReduction *) calloc(1, sizeof(RxReduction));
-	RxInit(reduction, balance, colorBalance, 15, enhanceColors, paletteSize);
+typedef struct BgTileSetup_ {
+	RxReduction **reductions;   //one per thread
+	BgTile *tiles;
+	COLOR32 *palette;
+	int nBits;
+	int paletteSize;
+	int nPalettes;
+	int paletteBase;
+	int paletteOffset;
+	float diffuse;
+	int balance;
+	int colorBalance;
+	int enhanceColors;
+} BgTileSetup;
+
+static void BgiSetupTileProc(void *context, int thread, int item) {
+	BgTileSetup *setup = (BgTileSetup *) context;
+	RxReduction *reduction = setup->reductions[thread];
+	COLOR32 *palette = setup->palette;
+	int nBits = setup->nBits, paletteSize = setup->paletteSize, nPalettes = setup->nPalettes;
+	int paletteBase = setup->paletteBase, paletteOffset = setup->paletteOffset;
+	BgTile *tile = setup->tiles + item;
+
+	//create histogram for tile
+	RxHistClear(reduction);
+	RxHistAdd(reduction, tile->px, 8, 8);
+	RxHistFinalize(reduction);
+
+	int bestPalette = paletteBase;
+	double bestError = 1e32;
+	for (int j = paletteBase; j < paletteBase + nPalettes; j++) {
+		COLOR32 *pal = palette + (j << nBits);
+		double err = RxHistComputePaletteError(reduction, pal + paletteOffset + !paletteOffset, paletteSize - !paletteOffset, bestError);
+
+		if (err < bestError) {
+			bestError = err;
+			bestPalette = j;
+		}
+	}
 
-	if (!dither) diffuse = 0.0f;
-	for (int i = 0; i < nTiles; i++) {
-		BgTile *tile = tiles + i;
-
-		//create histogram for tile
-		RxHistClear(reduction);
-		RxHistAdd(reduction, tile->px, 8, 8);
-		RxHistFinalize(reduction);
-
-		int bestPalette = paletteBase;
-		double bestError = 1e32;
-		for (int j = paletteBase; j < paletteBase + nPalettes; j++) {
-			COLOR32 *pal = palette + (j << nBits);
-			double err = RxHistComputePaletteError(reduction, pal + paletteOffset + !paletteOffset, paletteSize - !paletteOffset, bestError);
-
-			if (err < bestError) {
-				bestError = err;
-				bestPalette = j;
-			}
+	//match colors
+	COLOR32 *pal = palette + (bestPalette << nBits);
+
+	//do optional dithering (also matches colors at the same time)
+	RxReduceImageEx(tile->px, NULL, 8, 8, pal + paletteOffset + !paletteOffset, paletteSize - !paletteOffset, FALSE, TRUE, FALSE,
+		setup->diffuse, setup->balance, setup->colorBalance, setup->enhanceColors);
+	for (int j = 0; j < 64; j++) {
+		COLOR32 col = tile->px[j];
+		int index = 0;
+		if (((col >> 24) & 0xFF) > 127) {
+			index = RxPaletteFindClosestColorSimple(col, pal + paletteOffset + !paletteOffset, paletteSize - !paletteOffset)
+				+ !paletteOffset + paletteOffset;
 		}
 
-		//match colors
-		COLOR32 *pal = palette + (bestPalette << nBits);
-
-		//do optional dithering (also matches colors at the same time)
-		RxReduceImageEx(tile->px, NULL, 8, 8, pal + paletteOffset + !paletteOffset, paletteSize - !paletteOffset, FALSE, TRUE, FALSE, diffuse, balance, colorBalance, enhanceColors);
-		for (int j = 0; j < 64; j++) {
-			COLOR32 col = tile->px[j];
-			int index = 0;
-			if (((col >> 24) & 0xFF) > 127) {
-				index = RxPaletteFindClosestColorSimple(col, pal + paletteOffset + !paletteOffset, paletteSize - !paletteOffset)
-					+ !paletteOffset + paletteOffset;
-			}
+		tile->indices[j] = index;
+		tile->px[j] = index ? (pal[index] | 0xFF000000) : 0;
 
-			tile->indices[j] = index;
-			tile->px[j] = index ? (pal[index] | 0xFF000000) : 0;
+		//YIQ color
+		RxYiqColor yiq;
+		RxConvertRgbToYiq(col, &yiq);
+		tile->pxYiq[j].y = (int16_t) yiq.y;
+		tile->pxYiq[j].i = (int16_t) yiq.i;
+		tile->pxYiq[j].q = (int16_t) yiq.q;
+		tile->pxYiq[j].a = (int16_t) yiq.a;
+	}
 
-			//YIQ color
-			RxConvertRgbToYiq(col, &tile->pxYiq[j]);
-		}
+	tile->masterTile = item;
+	tile->nRepresents = 1;
+	tile->palette = bestPalette;
+}
 
-		//compute DCT
-		BgiComputeDct(reduction, tile);
+void BgSetupTiles(BgTile *tiles, int nTiles, int nBits, COLOR32 *palette, int paletteSize, int nPalettes, int paletteBase, int paletteOffset, int dither, float diffuse, int balance, int colorBalance, int enhanceColors) {
+	//tiles are set up independently, each thread gets its own reduction for histograms.
+	int nThreads = ParGetThreadCount();
+	RxReduction **reductions = (RxReduction **) calloc(nThreads, sizeof(RxReduction *));
+	for (int i = 0; i < nThreads; i++) {
+		reductions[i] = (RxReduction *) calloc(1, sizeof(RxReduction));
+		RxInit(reductions[i], balance, colorBalance, 15, enhanceColors, paletteSize);
+	}
 
-		tile->masterTile = i;
-		tile->nRepresents = 1;
-		tile->palette = bestPalette;
+	BgTileSetup setup;
+	setup.reductions = reductions;
+	setup.tiles = tiles;
+	setup.palette = palette;
+	setup.nBits = nBits;
+	setup.paletteSize = paletteSize;
+	setup.nPalettes = nPalettes;
+	setup.paletteBase = paletteBase;
+	setup.paletteOffset = paletteOffset;
+	setup.diffuse = dither ? diffuse : 0.0f;
+	setup.balance = balance;
+	setup.colorBalance = colorBalance;
+	setup.enhanceColors = enhanceColors;
+	ParRun(nTiles, BgiSetupTileProc, &setup, NULL, 0, 0);
+
+	for (int i = 0; i < nThreads; i++) {
+		RxDestroy(reductions[i]);
+		free(reductions[i]);
 	}
-	RxDestroy(reduction);
-	free(reduction);
+	free(reductions);
 }
 
 static COLOR32 BgiSelectColor0(COLOR32 *px, int width, int height, int mode) {
@@ -682,6 +945,30 @@ static COLOR32 BgiSelectColor0(COLOR32 *px, int width, int height, int mode) {
 	return pt;
 }
 
+static void BgiSplitTiles(BgTile *tiles, COLOR32 *px, int width, int tilesX, int tilesY) {
+	//split image into 8x8 tiles.
+	for (int y = 0; y < tilesY; y++) {
+		for (int x = 0; x < tilesX; x++) {
+			int srcOffset = x * 8 + y * 8 * (width);
+			COLOR32 *block = tiles[x + y * tilesX].px;
+
+			memcpy(block, px + srcOffset, 32);
+			memcpy(block + 8, px + srcOffset + width, 32);
+			memcpy(block + 16, px + srcOffset + width * 2, 32);
+			memcpy(block + 24, px + srcOffset + width * 3, 32);
+			memcpy(block + 32, px + srcOffset + width * 4, 32);
+			memcpy(block + 40, px + srcOffset + width * 5, 32);
+			memcpy(block + 48, px + srcOffset + width * 6, 32);
+			memcpy(block + 56, px + srcOffset + width * 7, 32);
+			for (int i = 0; i < 8 * 8; i++) {
+				int a = (block[i] >> 24) & 0xFF;
+				if (a < 128) block[i] = 0; //make transparent pixels transparent black
+				else block[i] |= 0xFF000000; //opaque
+			}
+		}
+	}
+}
+
 void BgGenerate(NCLR *nclr, NCGR *ncgr, NSCR *nscr, COLOR32 *imgBits, int width, int height, 
 	BgGenerateParameters *params,
 	int *progress1, int *progress1Max, int *progress2, int *progress2Max) {
@@ -728,7 +1015,6 @@ void BgGenerate(NCLR *nclr, NCGR *ncgr, NSCR *nscr, COLOR32 *imgBits, int width,
 	int tilesX = width / 8;
 	int tilesY = height / 8;
 	int nTiles = tilesX * tilesY;
-	BgTile *tiles = (BgTile *) calloc(nTiles, sizeof(BgTile));
 
 	//initialize progress
 	*progress1Max = nTiles * 2; //2 passes
@@ -761,87 +1047,80 @@ void BgGenerate(NCLR *nclr, NCGR *ncgr, NSCR *nscr, COLOR32 *imgBits, int width,
 		palette[i] = ColorConvertFromDS(ColorConvertToDS(palette[i]));
 	}
 
-	//split image into 8x8 tiles.
-	for (int y = 0; y < tilesY; y++) {
-		for (int x = 0; x < tilesX; x++) {
-			int srcOffset = x * 8 + y * 8 * (width);
-			COLOR32 *block = tiles[x + y * tilesX].px;
+	//character data and screen entry fields of each tile
+	int nChars = nTiles;
+	unsigned char *chars = NULL;
+	uint16_t *indices = (uint16_t *) calloc(nTiles, 2);
+	unsigned char *modes = (unsigned char *) calloc(nTiles, 1);
+	unsigned char *paletteIndices = (unsigned char *) calloc(nTiles, 1);
+	int indexMask = (nBits == 4) ? 0xF : 0xFF;
 
-			memcpy(block, imgBits + srcOffset, 32);
-			memcpy(block + 8, imgBits + srcOffset + width, 32);
-			memcpy(block + 16, imgBits + srcOffset + width * 2, 32);
-			memcpy(block + 24, imgBits + srcOffset + width * 3, 32);
-			memcpy(block + 32, imgBits + srcOffset + width * 4, 32);
-			memcpy(block + 40, imgBits + srcOffset + width * 5, 32);
-			memcpy(block + 48, imgBits + srcOffset + width * 6, 32);
-			memcpy(block + 56, imgBits + srcOffset + width * 7, 32);
-			for (int i = 0; i < 8 * 8; i++) {
-				int a = (block[i] >> 24) & 0xFF;
-				if (a < 128) block[i] = 0; //make transparent pixels transparent black
-				else block[i] |= 0xFF000000; //opaque
-			}
-		}
-	}
+	if (characterCompression) {
+		BgTile *tiles = (BgTile *) calloc(nTiles, sizeof(BgTile));
+		BgiSplitTiles(tiles, imgBits, width, tilesX, tilesY);
 
-	//match palettes to tiles
-	BgSetupTiles(tiles, nTiles, nBits, palette, paletteSize, nPalettes, paletteBase, paletteOffset,
-		params->dither.dither, params->dither.diffuse, balance, colorBalance, enhanceColors);
+		//match palettes to tiles
+		BgSetupTiles(tiles, nTiles, nBits, palette, paletteSize, nPalettes, paletteBase, paletteOffset,
+			params->dither.dither, params->dither.diffuse, balance, colorBalance, enhanceColors);
 
-	//match tiles to each other
-	int nChars = nTiles;
-	if (characterCompression) {
+		//match tiles to each other
 		nChars = BgPerformCharacterCompression(tiles, nTiles, nBits, nMaxChars, palette, paletteSize, nPalettes, paletteBase,
 			paletteOffset, balance, colorBalance, progress2);
-	}
 
-	COLOR32 *blocks = (COLOR32 *) calloc(64 * nChars, sizeof(COLOR32));
-	int writeIndex = 0;
-	for (int i = 0; i < nTiles; i++) {
-		if (tiles[i].masterTile != i) continue;
-		BgTile *t = tiles + i;
-		COLOR32 *dest = blocks + 64 * writeIndex;
+		//master tiles become characters in the order they appear
+		int *charIndices = (int *) calloc(nTiles, sizeof(int));
+		chars = (unsigned char *) calloc(nChars, 64);
+		int writeIndex = 0;
+		for (int i = 0; i < nTiles && writeIndex < nChars; i++) {
+			if (tiles[i].masterTile != i) continue;
 
-		for (int j = 0; j < 64; j++) {
-			if (nBits == 4) dest[j] = t->indices[j] & 0xF;
-			else dest[j] = t->indices[j];
+			unsigned char *dest = chars + 64 * writeIndex;
+			for (int j = 0; j < 64; j++) {
+				dest[j] = tiles[i].indices[j] & indexMask;
+			}
+			charIndices[i] = writeIndex++;
 		}
 
-		writeIndex++;
-		if (writeIndex >= nTiles) {
-			break;
+		for (int i = 0; i < nTiles; i++) {
+			indices[i] = (uint16_t) (charIndices[tiles[i].masterTile] + tileBase);
+			modes[i] = tiles[i].flipMode;
+			paletteIndices[i] = tiles[i].palette;
 		}
-	}
-	*progress2 = 1000;
-
-	//scrunch down masterTile indices
-	int nFoundMasters = 0;
-	for (int i = 0; i < nTiles; i++) {
-		int master = tiles[i].masterTile;
-		if (master != i) continue;
+		free(charIndices);
+		free(tiles);
+	} else {
+		//every tile is its own character, so tiles don't need to be kept after they're written. Work
+		//through the image in bands of tile rows to keep memory use down for large images.
+		int bandHeight = BG_BAND_TILES / (tilesX ? tilesX : 1);
+		if (bandHeight < 1) bandHeight = 1;
+
+		chars = (unsigned char *) calloc(nTiles, 64);
+		BgTile *tiles = (BgTile *) calloc(bandHeight * tilesX, sizeof(BgTile));
+		for (int y = 0; y < tilesY; y += bandHeight) {
+			int nRows = min(bandHeight, tilesY - y);
+			int nBandTiles = nRows * tilesX;
+			BgiSplitTiles(tiles, imgBits + y * 8 * width, width, tilesX, nRows);
+
+			//match palettes to tiles
+			BgSetupTiles(tiles, nBandTiles, nBits, palette, paletteSize, nPalettes, paletteBase, paletteOffset,
+				params->dither.dither, params->dither.diffuse, balance, colorBalance, enhanceColors);
+
+			for (int i = 0; i < nBandTiles; i++) {
+				int tileIndex = y * tilesX + i;
+				unsigned char *dest = chars + 64 * tileIndex;
+				for (int j = 0; j < 64; j++) {
+					dest[j] = tiles[i].indices[j] & indexMask;
+				}
 
-		//a master tile. Overwrite all tiles that use this master with nFoundMasters with bit 31 set (just in case)
-		for (int j = 0; j < nTiles; j++) {
-			if (tiles[j].masterTile == master) tiles[j].masterTile = nFoundMasters | 0x40000000;
+				indices[tileIndex] = (uint16_t) (tileIndex + tileBase);
+				modes[tileIndex] = 0;
+				paletteIndices[tileIndex] = tiles[i].palette;
+			}
+			*progress2 = (y + nRows) * 1000 / tilesY;
 		}
-		nFoundMasters++;
-	}
-	for (int i = 0; i < nTiles; i++) {
-		tiles[i].masterTile &= 0xFFFF;
-	}
-
-	//prep data output
-	uint16_t *indices = (uint16_t *) calloc(nTiles, 2);
-	for (int i = 0; i < nTiles; i++) {
-		indices[i] = tiles[i].masterTile + tileBase;
-	}
-	unsigned char *modes = (unsigned char *) calloc(nTiles, 1);
-	for (int i = 0; i < nTiles; i++) {
-		modes[i] = tiles[i].flipMode;
-	}
-	unsigned char *paletteIndices = (unsigned char *) calloc(nTiles, 1);
-	for (int i = 0; i < nTiles; i++) {
-		paletteIndices[i] = tiles[i].palette;
+		free(tiles);
 	}
+	*progress2 = 1000;
 
 	//create output
 	int paletteFormat = NCLR_TYPE_NCLR, characterFormat = NCGR_TYPE_NCGR, screenFormat = NSCR_TYPE_NSCR;
@@ -916,29 +1195,22 @@ void BgGenerate(NCLR *nclr, NCGR *ncgr, NSCR *nscr, COLOR32 *imgBits, int width,
 	ncgr->nTiles = nCharsFile;
 	ncgr->tilesX = ChrGuessWidth(ncgr->nTiles);
 	ncgr->tilesY = ncgr->nTiles / ncgr->tilesX;
-	ncgr->tiles = (unsigned char **) calloc(nCharsFile, sizeof(unsigned char *));
-	int charSize = nBits == 4 ? 32 : 64;
-	for (int j = 0; j < nCharsFile; j++) {
-		unsigned char *b = (unsigned char *) calloc(64, 1);
-		if (j < nChars) {
-			for (int i = 0; i < 64; i++) {
-				b[i] = (unsigned char) blocks[i + j * 64];
-			}
-		}
-		ncgr->tiles[j] = b;
-	}
+	ncgr->chars = (unsigned char *) calloc(nCharsFile + 1, 64);
+	memcpy(ncgr->chars, chars, nChars * 64);
+	free(chars);
 
+	//character attribute: palette of the first tile using it
 	ncgr->attr = (unsigned char *) calloc(ncgr->nTiles, 1);
-	for (int i = 0; i < ncgr->nTiles; i++) {
-		int attr = paletteBase;
-		for (int j = 0; j < nTiles; j++) {
-			if (indices[j] == i) {
-				attr = paletteIndices[j];
-				break;
-			}
-		}
-		ncgr->attr[i] = attr;
+	memset(ncgr->attr, paletteBase, ncgr->nTiles);
+	unsigned char *attrSet = (unsigned char *) calloc(ncgr->nTiles, 1);
+	for (int j = 0; j < nTiles; j++) {
+		int i = indices[j];
+		if (i >= ncgr->nTiles || attrSet[i]) continue;
+
+		ncgr->attr[i] = paletteIndices[j];
+		attrSet[i] = 1;
 	}
+	free(attrSet);
 
 	int bgScreenFormat = SCREENFORMAT_TEXT, screenColorMode = SCREENCOLORMODE_16x16;
 	if (nBits == 4) {
@@ -968,7 +1240,6 @@ void BgGenerate(NCLR *nclr, NCGR *ncgr, NSCR *nscr, COLOR32 *imgBits, int width,
 	ScrComputeHighestCharacter(nscr);
 
 	free(modes);
-	free(blocks);
 	free(indices);
 	free(palette);
 	free(paletteIndices);
@@ -1208,7 +1479,7 @@ void BgReplaceSection(NCLR *nclr, NCGR *ncgr, NSCR *nscr, COLOR32 *px, int width
 					int flip = (d & 0x0C00) >> 10;
 					if (charIndex < 0) continue;
 
-					unsigned char *chr = ncgr->tiles[charIndex];
+					unsigned char *chr = NCGR_CHAR(ncgr, charIndex);
 					COLOR32 *thisPalette = pals + palIndex * maxPaletteSize + paletteOffset + !paletteOffset;
 					RxReduceImageEx(tile->px, NULL, 8, 8, thisPalette, paletteSize - !paletteOffset,
 						FALSE, TRUE, FALSE, dither ? diffuse : 0.0f, balance, colorBalance, enhanceColors);
@@ -1247,7 +1518,7 @@ void BgReplaceSection(NCLR *nclr, NCGR *ncgr, NSCR *nscr, COLOR32 *px, int width
 				if (tile->masterTile != i) continue;
 
 				//master tile
-				unsigned char *destTile = ncgr->tiles[nCharsWritten + writeCharBase];
+				unsigned char *destTile = NCGR_CHAR(ncgr, nCharsWritten + writeCharBase);
 				for (int j = 0; j < 64; j++)
 					destTile[j] = tile->indices[j] & indexMask;
 				masterMap[i] = nCharsWritten + writeCharBase;
@@ -1281,7 +1552,7 @@ void BgReplaceSection(NCLR *nclr, NCGR *ncgr, NSCR *nscr, COLOR32 *px, int width
 					for (int j = 0; j < ncgr->nTiles; j++) {
 						for (int i = 0; i < nPalettes; i++) {
 							int charId = j, mode;
-							double err = BgiBestPaletteCharError(reduction, block, palsYiq + i * maxPaletteSize, ncgr->tiles[charId], &mode, minError);
+							double err = BgiBestPaletteCharError(reduction, block, palsYiq + i * maxPaletteSize, NCGR_CHAR(ncgr, charId), &mode, minError);
 							if (err < minError) {
 								chosenCharacter = charId;
 								chosenPalette = i;
@@ -1337,7 +1608,7 @@ void BgReplaceSection(NCLR *nclr, NCGR *ncgr, NSCR *nscr, COLOR32 *px, int width
 
 						int charOrigin = d & 0x3FF;
 						if (charOrigin - charBase < 0) continue;
-						unsigned char *ncgrTile = ncgr->tiles[charOrigin - charBase];
+						unsigned char *ncgrTile = NCGR_CHAR(ncgr, charOrigin - charBase);
 
 						COLOR32 *thisPal = pals + leastIndex * maxPaletteSize + paletteOffset + !paletteOffset;
 						RxReduceImageEx(block, NULL, 8, 8, thisPal, paletteSize - !paletteOffset, FALSE, TRUE, FALSE, dither ? diffuse : 0.0f,
@@ -1369,7 +1640,7 @@ void BgReplaceSection(NCLR *nclr, NCGR *ncgr, NSCR *nscr, COLOR32 *px, int width
 						double minError = 1e32;
 						for (int i = 0; i < nPalettes; i++) {
 							int mode;
-							double err = BgiBestPaletteCharError(reduction, block, palsYiq + i * maxPaletteSize, ncgr->tiles[charId], &mode, minError);
+							double err = BgiBestPaletteCharError(reduction, block, palsYiq + i * maxPaletteSize, NCGR_CHAR(ncgr, charId), &mode, minError);
 							if (err < minError) {
 								chosenPalette = i;
 								minError = err;
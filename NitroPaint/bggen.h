@@ -20,14 +20,24 @@ typedef struct BgDctBlock_ {
 	float blockA[64];
 } BgDctBlock;
 
+#define BG_SIGNATURE_SIZE            16         //number of DCT terms in a tile signature
+
+//YIQA color quantized to 16 bits per channel
+typedef struct BgYiqColor_ {
+	int16_t y;
+	int16_t i;
+	int16_t q;
+	int16_t a;
+} BgYiqColor;
+
 //
 // Structure used for character compression. Fill them out and pass them to
 // BgPerformCharacterCompression.
 //
 typedef struct BgTile_ {
 	COLOR32 px[64];               //RGBA colors: redundant, speed
-	RxYiqColor pxYiq[64];         //YIQA colors
-	BgDctBlock dct;               //DCT coefficients
+	BgYiqColor pxYiq[64];         //YIQA colors
+	float signature[BG_SIGNATURE_SIZE]; //low-frequency DCT terms, set during compression
 	unsigned char indices[64];    //color indices per pixel
 	int masterTile;               //index of master tile for this tile 
 	int nRepresents;              //number of tiles this tile represents
@@ -10,6 +10,7 @@ void bstreamCreate(BSTREAM *stream, void *init, int initSize) {
 	stream->bufferSize = 0;
 	stream->size = 0;
 	stream->pos = 0;
+	stream->headroom = 0;
 
 	if (initSize && init != NULL) {
 		stream->buffer = malloc(initSize);
@@ -22,13 +23,38 @@ void bstreamCreate(BSTREAM *stream, void *init, int initSize) {
 
 void bstreamFree(BSTREAM *stream) {
 	if (stream->buffer != NULL) {
-		free(stream->buffer);
+		free(stream->buffer - stream->headroom);
 		stream->buffer = NULL;
 	}
 
 	stream->pos = 0;
 	stream->size = 0;
 	stream->bufferSize = 0;
+	stream->headroom = 0;
+}
+
+static void bstreamResize(BSTREAM *stream, int headroom, int bufferSize) {
+	//the buffer is allocated with its headroom in front
+	unsigned char *base = stream->buffer == NULL ? NULL : stream->buffer - stream->headroom;
+	if (headroom == stream->headroom) {
+		base = (unsigned char *) realloc(base, headroom + bufferSize);
+	} else {
+		unsigned char *newBase = (unsigned char *) malloc(headroom + bufferSize);
+		if (base != NULL) memcpy(newBase + headroom, base + stream->headroom, stream->size);
+		free(base);
+		base = newBase;
+	}
+	stream->buffer = base + headroom;
+	stream->headroom = headroom;
+	stream->bufferSize = bufferSize;
+}
+
+void bstreamReserve(BSTREAM *stream, int size) {
+	if (size > stream->bufferSize) bstreamResize(stream, stream->headroom, size);
+}
+
+void bstreamReserveFront(BSTREAM *stream, int size) {
+	if (size > stream->headroom) bstreamResize(stream, size, max(stream->bufferSize, BSTREAM_MIN_CAPACITY));
 }
 
 void bstreamWrite(BSTREAM *stream, void *data, int dataSize) {
@@ -38,13 +64,12 @@ void bstreamWrite(BSTREAM *stream, void *data, int dataSize) {
 	int requiredSize = max(stream->pos + dataSize, stream->size);
 	if (stream->bufferSize < requiredSize) {
 
-		//keep expanding by 1.5x until it's big enough
-		int newSize = stream->bufferSize;
+		//keep doubling until it's big enough
+		int newSize = max(stream->bufferSize, BSTREAM_MIN_CAPACITY);
 		while (newSize < requiredSize) {
-			newSize = (newSize + 2) * 3 / 2;
+			newSize *= 2;
 		}
-		stream->bufferSize = newSize;
-		stream->buffer = realloc(stream->buffer, newSize);
+		bstreamResize(stream, stream->headroom, newSize);
 	}
 
 	//write data to stream.
@@ -70,6 +95,34 @@ void bstreamAlign(BSTREAM *stream, int by) {
 	}
 }
 
+void bstreamPrepend(BSTREAM *stream, const void *data, int size) {
+	if (size == 0) return;
+	if (stream->headroom < size) bstreamReserveFront(stream, size);
+
+	stream->buffer -= size;
+	stream->headroom -= size;
+	stream->bufferSize += size;
+	stream->size += size;
+	stream->pos += size;
+	memcpy(stream->buffer, data, size);
+}
+
+void bstreamSplice(BSTREAM *out, BSTREAM *in) {
+	if (out->size > 0) {
+		//copy, keeping the source's buffer for reuse
+		bstreamWrite(out, in->buffer, in->size);
+		in->size = 0;
+		in->pos = 0;
+		return;
+	}
+
+	//take over the source's buffer
+	bstreamFree(out);
+	*out = *in;
+	out->pos = out->size;
+	bstreamCreate(in, NULL, 0);
+}
+
 int bstreamSeek(BSTREAM *stream, int pos, int relative) {
 	int newPos = stream->pos;
 	if (relative) newPos += pos;
@@ -106,10 +159,11 @@ int bstreamCompress(BSTREAM *stream, int algorithm, int start, int size) {
 	memcpy(newBuffer, stream->buffer, beforeCompressed);
 	memcpy(newBuffer + beforeCompressed, compressed, compressedSize);
 	memcpy(newBuffer + beforeCompressed + compressedSize, stream->buffer + start + size, afterCompressed);
-	free(stream->buffer);
+	free(stream->buffer - stream->headroom);
 	stream->buffer = newBuffer;
 	stream->bufferSize = bufferSize;
 	stream->size = bufferSize;
+	stream->headroom = 0;
 
 	if (compressed != NULL) free(compressed);
 	return compressedSize;
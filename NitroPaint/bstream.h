@@ -1,11 +1,14 @@
 #pragma once
 #include "compression.h"
 
+#define BSTREAM_MIN_CAPACITY   64     // smallest buffer allocated for a stream
+
 typedef struct BTREAM_ {
 	unsigned char *buffer;
 	int bufferSize;
 	int size;
 	int pos;
+	int headroom;                      // bytes allocated in front of buffer, for bstreamPrepend
 } BSTREAM;
 
 void bstreamCreate(BSTREAM *stream, void *init, int initSize);
@@ -14,6 +17,31 @@ void bstreamFree(BSTREAM *stream);
 
 void bstreamWrite(BSTREAM *stream, void *data, int size);
 
+//
+// Make room for a stream to grow to a size without reallocating, for writers
+// that can estimate their output size up front.
+//
+void bstreamReserve(BSTREAM *stream, int size);
+
+//
+// Make room for bytes to be prepended to a stream without moving its data.
+//
+void bstreamReserveFront(BSTREAM *stream, int size);
+
+//
+// Insert bytes at the start of a stream. The current position stays on the
+// same data.
+//
+void bstreamPrepend(BSTREAM *stream, const void *data, int size);
+
+//
+// Write the contents of one stream to another at its current position and
+// empty the source. If the destination is empty, it takes over the source's
+// buffer rather than copying it. Otherwise the source keeps its buffer, so
+// that it can be written again without reallocating.
+//
+void bstreamSplice(BSTREAM *out, BSTREAM *in);
+
 void bstreamAlign(BSTREAM *stream, int by);
 
 int bstreamSeek(BSTREAM *stream, int pos, int relative);
@@ -0,0 +1,793 @@
+#include <stdio.h>
+
+#include "cellbatch.h"
+#include "palette.h"
+#include "parallel.h"
+#include "gdip.h"
+
+#define CELLBATCH_FLIP_H           1   // OBJ is flipped horizontally
+#define CELLBATCH_FLIP_V           2   // OBJ is flipped vertically
+#define CELLBATCH_MAX_PASSES      16   // maximum passes of layout selection
+#define CELLBATCH_MAX_CONFIGS    100   // maximum layout configurations tried per frame
+
+typedef struct CellBatchLayout_ {
+	int nObj;
+	OBJ_BOUNDS *bounds;                // OBJ positions relative to the frame center
+	unsigned char *chars;              // characters of all OBJ in OBJ order, 64 bytes each
+	int *objGraphics;                  // index of the shared graphics of each OBJ
+	int *objFlip;                      // flip applied to the shared graphics of each OBJ
+} CellBatchLayout;
+
+typedef struct CellBatchConfig_ {
+	int aggressiveness;
+	int full;
+	int cut;                           // cut overlapping parts of OBJ out of later OBJ
+	int flip;                          // divide the flipped frame, mirroring the OBJ back
+} CellBatchConfig;
+
+//
+// Table of distinct OBJ graphics. OBJ with equal graphics, or graphics equal
+// under flipping, share one entry.
+//
+typedef struct CellBatchGraphicsTable_ {
+	int nGraphics;
+	int capacity;                      // capacity of the graphics arrays
+	int *widths;
+	int *heights;
+	uint32_t *hashes;
+	unsigned char **chars;
+	int tableSize;                     // number of hash slots, a power of 2
+	int *table;                        // graphics index of each hash slot, -1 for none
+} CellBatchGraphicsTable;
+
+typedef struct CellBatchContext_ {
+	const COLOR32 *px;
+	int width;
+	int height;
+	const CellBatchFrame *frames;
+	const CellBatchParams *params;
+	COLOR32 *palette;                  // generated colors, excluding color 0
+	CellBatchConfig config;            // configuration of the layouts being generated
+	CellBatchLayout *layouts;          // generated layouts, one per frame
+} CellBatchContext;
+
+void CellBatchGetDefaultParams(CellBatchParams *params) {
+	memset(params, 0, sizeof(CellBatchParams));
+	params->aggressiveness = 100;
+	params->nBits = 4;
+	params->mappingMode = GX_OBJVRAMMODE_CHAR_1D_32K;
+	params->nColors = 15;
+	params->balance = BALANCE_DEFAULT;
+	params->colorBalance = BALANCE_DEFAULT;
+	params->dedupe = 1;
+	params->timeBudget = 10000;
+}
+
+int CellBatchMakeGridFrames(int width, int height, int frameWidth, int frameHeight, int maxFrames, CellBatchFrame **pFrames) {
+	*pFrames = NULL;
+	if (frameWidth <= 0 || frameHeight <= 0) return 0;
+
+	int framesX = width / frameWidth, framesY = height / frameHeight;
+	int nFrames = framesX * framesY;
+	if (maxFrames > 0 && nFrames > maxFrames) nFrames = maxFrames;
+	if (nFrames <= 0) return 0;
+
+	CellBatchFrame *frames = (CellBatchFrame *) calloc(nFrames, sizeof(CellBatchFrame));
+	for (int i = 0; i < nFrames; i++) {
+		frames[i].x = (i % framesX) * frameWidth;
+		frames[i].y = (i / framesX) * frameHeight;
+		frames[i].width = frameWidth;
+		frames[i].height = frameHeight;
+	}
+	*pFrames = frames;
+	return nFrames;
+}
+
+static void CellBatchCopyFrame(const COLOR32 *px, int width, int height, const CellBatchFrame *frame, COLOR32 *out, int outStride) {
+	//pixels outside of the sheet are transparent
+	for (int y = 0; y < frame->height; y++) {
+		for (int x = 0; x < frame->width; x++) {
+			int srcX = frame->x + x, srcY = frame->y + y;
+			COLOR32 c = 0;
+			if (srcX >= 0 && srcY >= 0 && srcX < width && srcY < height) c = px[srcX + srcY * width];
+			out[x + y * outStride] = c;
+		}
+	}
+}
+
+static void CellBatchCreatePalette(CellBatchContext *ctx, int nFrames) {
+	//stack all frames vertically so that only frame pixels contribute to the palette
+	int stripWidth = 0, stripHeight = 0;
+	for (int i = 0; i < nFrames; i++) {
+		if (ctx->frames[i].width > stripWidth) stripWidth = ctx->frames[i].width;
+		stripHeight += ctx->frames[i].height;
+	}
+
+	COLOR32 *strip = (COLOR32 *) calloc(stripWidth * stripHeight, sizeof(COLOR32));
+	int y = 0;
+	for (int i = 0; i < nFrames; i++) {
+		CellBatchCopyFrame(ctx->px, ctx->width, ctx->height, ctx->frames + i, strip + y * stripWidth, stripWidth);
+		y += ctx->frames[i].height;
+	}
+
+	RxCreatePalette(strip, stripWidth, stripHeight, ctx->palette, ctx->params->nColors);
+	free(strip);
+}
+
+static void CellBatchFrameProc(void *context, int thread, int item) {
+	CellBatchContext *ctx = (CellBatchContext *) context;
+	const CellBatchParams *params = ctx->params;
+	const CellBatchConfig *config = &ctx->config;
+	const CellBatchFrame *frame = ctx->frames + item;
+	CellBatchLayout *layout = ctx->layouts + item;
+	int frameWidth = frame->width, frameHeight = frame->height;
+
+	COLOR32 *framePx = (COLOR32 *) calloc(frameWidth * frameHeight, sizeof(COLOR32));
+	CellBatchCopyFrame(ctx->px, ctx->width, ctx->height, frame, framePx, frameWidth);
+
+	//divide the frame and chunk it
+	int nObj;
+	OBJ_BOUNDS *bounds;
+	if (config->flip) {
+		//dividing the flipped frame gives the mirror of the layout of a frame it mirrors
+		COLOR32 *flipped = (COLOR32 *) calloc(frameWidth * frameHeight, sizeof(COLOR32));
+		for (int y = 0; y < frameHeight; y++) {
+			for (int x = 0; x < frameWidth; x++) {
+				int srcX = (config->flip & CELLBATCH_FLIP_H) ? (frameWidth - 1 - x) : x;
+				int srcY = (config->flip & CELLBATCH_FLIP_V) ? (frameHeight - 1 - y) : y;
+				flipped[x + y * frameWidth] = framePx[srcX + srcY * frameWidth];
+			}
+		}
+		bounds = CellgenMakeCell(flipped, frameWidth, frameHeight, config->aggressiveness, config->full, params->affine, &nObj);
+		free(flipped);
+
+		for (int i = 0; i < nObj; i++) {
+			if (config->flip & CELLBATCH_FLIP_H) bounds[i].x = frameWidth - bounds[i].x - bounds[i].width;
+			if (config->flip & CELLBATCH_FLIP_V) bounds[i].y = frameHeight - bounds[i].y - bounds[i].height;
+		}
+	} else {
+		bounds = CellgenMakeCell(framePx, frameWidth, frameHeight, config->aggressiveness, config->full, params->affine, &nObj);
+	}
+	OBJ_IMAGE_SLICE *slices = CellgenSliceImage(framePx, frameWidth, frameHeight, bounds, nObj, config->cut);
+	free(bounds);
+	free(framePx);
+
+	int nChars = 0;
+	for (int i = 0; i < nObj; i++) {
+		nChars += slices[i].bounds.width * slices[i].bounds.height / 64;
+	}
+
+	layout->nObj = nObj;
+	layout->bounds = (OBJ_BOUNDS *) calloc(nObj + 1, sizeof(OBJ_BOUNDS));
+	layout->chars = (unsigned char *) calloc(nChars + 1, 64);
+	layout->objGraphics = (int *) calloc(nObj + 1, sizeof(int));
+	layout->objFlip = (int *) calloc(nObj + 1, sizeof(int));
+
+	//reduce each OBJ to characters
+	int *indices = (int *) calloc(64 * 64, sizeof(int));
+	unsigned char *chars = layout->chars;
+	for (int i = 0; i < nObj; i++) {
+		OBJ_IMAGE_SLICE *slice = slices + i;
+		int objWidth = slice->bounds.width, objHeight = slice->bounds.height;
+
+		RxReduceImageEx(slice->px, indices, objWidth, objHeight, ctx->palette, params->nColors,
+			1, 1, 0, params->diffuse, params->balance, params->colorBalance, params->enhanceColors);
+
+		for (int j = 0; j < objWidth * objHeight / 64; j++) {
+			int objX = (j * 8) % objWidth;
+			int objY = (j * 8) / objWidth * 8;
+
+			for (int y = 0; y < 8; y++) {
+				for (int x = 0; x < 8; x++) {
+					int offs = objX + x + (objY + y) * objWidth;
+					int index = indices[offs] + 1;
+					if ((slice->px[offs] >> 24) < 128) index = 0;
+					chars[x + y * 8] = index;
+				}
+			}
+			chars += 64;
+		}
+
+		//position relative to the frame center
+		OBJ_BOUNDS *out = layout->bounds + i;
+		*out = slice->bounds;
+		out->x -= frameWidth / 2;
+		out->y -= frameHeight / 2;
+		if (params->affine) {
+			out->x -= objWidth / 2;
+			out->y -= objHeight / 2;
+		}
+	}
+
+	free(indices);
+	free(slices);
+}
+
+static void CellBatchFreeLayouts(CellBatchLayout *layouts, int nLayouts) {
+	for (int i = 0; i < nLayouts; i++) {
+		free(layouts[i].bounds);
+		free(layouts[i].chars);
+		free(layouts[i].objGraphics);
+		free(layouts[i].objFlip);
+	}
+	free(layouts);
+}
+
+static uint32_t CellBatchHashObj(int width, int height, const unsigned char *chars) {
+	//FNV-1a
+	uint32_t hash = 0x811C9DC5;
+	hash = (hash ^ width) * 0x01000193;
+	hash = (hash ^ height) * 0x01000193;
+	for (int i = 0; i < width * height; i++) {
+		hash = (hash ^ chars[i]) * 0x01000193;
+	}
+	return hash;
+}
+
+static void CellBatchFlipObj(const unsigned char *chars, int width, int height, int flip, unsigned char *out) {
+	//OBJ flips mirror the whole OBJ, moving characters as well as their pixels
+	int charsX = width / 8;
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			int srcX = (flip & CELLBATCH_FLIP_H) ? (width - 1 - x) : x;
+			int srcY = (flip & CELLBATCH_FLIP_V) ? (height - 1 - y) : y;
+			int src = ((srcY / 8) * charsX + srcX / 8) * 64 + (srcY % 8) * 8 + (srcX % 8);
+			int dst = ((y / 8) * charsX + x / 8) * 64 + (y % 8) * 8 + (x % 8);
+			out[dst] = chars[src];
+		}
+	}
+}
+
+static void CellBatchInitGraphicsTable(CellBatchGraphicsTable *table) {
+	memset(table, 0, sizeof(CellBatchGraphicsTable));
+	table->tableSize = 256;
+	table->table = (int *) malloc(table->tableSize * sizeof(int));
+	for (int i = 0; i < table->tableSize; i++) table->table[i] = -1;
+}
+
+static void CellBatchFreeGraphicsTable(CellBatchGraphicsTable *table) {
+	for (int i = 0; i < table->nGraphics; i++) free(table->chars[i]);
+	free(table->widths);
+	free(table->heights);
+	free(table->hashes);
+	free(table->chars);
+	free(table->table);
+}
+
+static void CellBatchInsertSlot(CellBatchGraphicsTable *table, int index) {
+	uint32_t slot = table->hashes[index] & (table->tableSize - 1);
+	while (table->table[slot] != -1) slot = (slot + 1) & (table->tableSize - 1);
+	table->table[slot] = index;
+}
+
+static int CellBatchAddGraphics(CellBatchGraphicsTable *table, const unsigned char *chars, int width, int height, int share) {
+	uint32_t hash = CellBatchHashObj(width, height, chars);
+	if (share) {
+		uint32_t slot = hash & (table->tableSize - 1);
+		while (table->table[slot] != -1) {
+			int index = table->table[slot];
+			if (table->hashes[index] == hash && table->widths[index] == width && table->heights[index] == height
+				&& memcmp(table->chars[index], chars, width * height) == 0) return index;
+			slot = (slot + 1) & (table->tableSize - 1);
+		}
+	}
+
+	if (table->nGraphics == table->capacity) {
+		table->capacity = table->capacity ? table->capacity * 2 : 64;
+		table->widths = (int *) realloc(table->widths, table->capacity * sizeof(int));
+		table->heights = (int *) realloc(table->heights, table->capacity * sizeof(int));
+		table->hashes = (uint32_t *) realloc(table->hashes, table->capacity * sizeof(uint32_t));
+		table->chars = (unsigned char **) realloc(table->chars, table->capacity * sizeof(unsigned char *));
+	}
+
+	int index = table->nGraphics++;
+	table->widths[index] = width;
+	table->heights[index] = height;
+	table->hashes[index] = hash;
+	table->chars[index] = (unsigned char *) malloc(width * height);
+	memcpy(table->chars[index], chars, width * height);
+
+	//keep the hash table at most half full
+	if (table->nGraphics * 2 > table->tableSize) {
+		table->tableSize *= 2;
+		table->table = (int *) realloc(table->table, table->tableSize * sizeof(int));
+		for (int i = 0; i < table->tableSize; i++) table->table[i] = -1;
+		for (int i = 0; i < table->nGraphics; i++) CellBatchInsertSlot(table, i);
+	} else {
+		CellBatchInsertSlot(table, index);
+	}
+	return index;
+}
+
+static void CellBatchAddLayoutGraphics(CellBatchGraphicsTable *table, CellBatchLayout *layout, int share, int allowFlip) {
+	unsigned char *flipped = (unsigned char *) malloc(4 * 64 * 64);
+	const unsigned char *chars = layout->chars;
+
+	for (int i = 0; i < layout->nObj; i++) {
+		int width = layout->bounds[i].width, height = layout->bounds[i].height;
+		int size = width * height;
+
+		//share graphics in the form that orders first among its flips
+		const unsigned char *graphics = chars;
+		int flip = 0;
+		for (int j = 1; j < 4 && allowFlip; j++) {
+			CellBatchFlipObj(chars, width, height, j, flipped + j * size);
+			if (memcmp(flipped + j * size, graphics, size) < 0) {
+				graphics = flipped + j * size;
+				flip = j;
+			}
+		}
+
+		layout->objGraphics[i] = CellBatchAddGraphics(table, graphics, width, height, share);
+		layout->objFlip[i] = flip;
+		chars += size;
+	}
+	free(flipped);
+}
+
+static int CellBatchGraphicsCost(CellBatchGraphicsTable *table, int index, int granularity) {
+	//each placement starts at a multiple of the granularity
+	int nChars = table->widths[index] * table->heights[index] / 64;
+	return (nChars + granularity - 1) / granularity * granularity;
+}
+
+static int CellBatchCountLayoutCharacters(CellBatchLayout **layouts, const int *selection, int nFrames, CellBatchGraphicsTable *table, int granularity) {
+	unsigned char *used = (unsigned char *) calloc(table->nGraphics + 1, 1);
+	int nChars = 0;
+	for (int i = 0; i < nFrames; i++) {
+		CellBatchLayout *layout = layouts[selection[i]] + i;
+		for (int j = 0; j < layout->nObj; j++) {
+			int index = layout->objGraphics[j];
+			if (used[index]) continue;
+
+			used[index] = 1;
+			nChars += CellBatchGraphicsCost(table, index, granularity);
+		}
+	}
+	free(used);
+	return nChars;
+}
+
+static int CellBatchLayoutAddedCost(CellBatchLayout *layout, const int *refs, int *stamps, int stamp, CellBatchGraphicsTable *table, int granularity) {
+	//characters a layout adds beyond the graphics already in use
+	int cost = 0;
+	for (int i = 0; i < layout->nObj; i++) {
+		int index = layout->objGraphics[i];
+		if (refs[index] > 0 || stamps[index] == stamp) continue;
+
+		stamps[index] = stamp;
+		cost += CellBatchGraphicsCost(table, index, granularity);
+	}
+	return cost;
+}
+
+static int CellBatchFramesEqual(CellBatchLayout **layouts, int nConfigs, int frame1, int frame2) {
+	//frames are equal when every configuration divides them into the same graphics
+	for (int c = 0; c < nConfigs; c++) {
+		CellBatchLayout *layout1 = layouts[c] + frame1, *layout2 = layouts[c] + frame2;
+		if (layout1->nObj != layout2->nObj) return 0;
+		if (memcmp(layout1->objGraphics, layout2->objGraphics, layout1->nObj * sizeof(int)) != 0) return 0;
+	}
+	return 1;
+}
+
+static int CellBatchGroupFrames(CellBatchLayout **layouts, int nConfigs, int nFrames, int *groups) {
+	//map each frame to the first frame equal to it
+	uint32_t *hashes = (uint32_t *) calloc(nFrames, sizeof(uint32_t));
+	int nGroups = 0;
+	for (int i = 0; i < nFrames; i++) {
+		uint32_t hash = 0x811C9DC5;
+		for (int c = 0; c < nConfigs; c++) {
+			CellBatchLayout *layout = layouts[c] + i;
+			for (int j = 0; j < layout->nObj; j++) hash = (hash ^ layout->objGraphics[j]) * 0x01000193;
+			hash = (hash ^ 0xFFFFFFFF) * 0x01000193;
+		}
+		hashes[i] = hash;
+
+		groups[i] = i;
+		for (int j = 0; j < i; j++) {
+			if (groups[j] == j && hashes[j] == hash && CellBatchFramesEqual(layouts, nConfigs, i, j)) {
+				groups[i] = j;
+				break;
+			}
+		}
+		if (groups[i] == i) nGroups++;
+	}
+	free(hashes);
+	return nGroups;
+}
+
+static void CellBatchSelectLayouts(CellBatchLayout **layouts, int nConfigs, int nFrames, CellBatchGraphicsTable *table, int granularity,
+	int *selection, DWORD deadline) {
+	//equal frames hold each other's graphics in use, so they switch layouts together
+	int *groups = (int *) calloc(nFrames, sizeof(int));
+	int *groupSizes = (int *) calloc(nFrames, sizeof(int));
+	CellBatchGroupFrames(layouts, nConfigs, nFrames, groups);
+	for (int i = 0; i < nFrames; i++) groupSizes[groups[i]]++;
+
+	//count the uses of each graphics by the selected layouts
+	int *refs = (int *) calloc(table->nGraphics + 1, sizeof(int));
+	int *stamps = (int *) calloc(table->nGraphics + 1, sizeof(int));
+	int stamp = 0;
+	for (int i = 0; i < nFrames; i++) {
+		if (groups[i] != i) continue;
+		CellBatchLayout *layout = layouts[selection[i]] + i;
+		for (int j = 0; j < layout->nObj; j++) refs[layout->objGraphics[j]] += groupSizes[i];
+	}
+
+	//switch each group to the layout adding the fewest characters given the other
+	//frames, until no group improves. Every switch lowers the total.
+	for (int pass = 0; pass < CELLBATCH_MAX_PASSES; pass++) {
+		int improved = 0;
+
+		for (int i = 0; i < nFrames; i++) {
+			if (groups[i] != i) continue;
+
+			CellBatchLayout *current = layouts[selection[i]] + i;
+			for (int j = 0; j < current->nObj; j++) refs[current->objGraphics[j]] -= groupSizes[i];
+
+			int best = selection[i], bestObj = current->nObj;
+			int bestCost = CellBatchLayoutAddedCost(current, refs, stamps, ++stamp, table, granularity);
+			for (int c = 0; c < nConfigs; c++) {
+				CellBatchLayout *layout = layouts[c] + i;
+				if (c == selection[i]) continue;
+
+				//fewer OBJ break ties
+				int cost = CellBatchLayoutAddedCost(layout, refs, stamps, ++stamp, table, granularity);
+				if (cost < bestCost || (cost == bestCost && layout->nObj < bestObj)) {
+					best = c;
+					bestCost = cost;
+					bestObj = layout->nObj;
+				}
+			}
+
+			if (best != selection[i]) improved = 1;
+			selection[i] = best;
+			current = layouts[best] + i;
+			for (int j = 0; j < current->nObj; j++) refs[current->objGraphics[j]] += groupSizes[i];
+		}
+
+		if (!improved || GetTickCount() >= deadline) break;
+	}
+
+	for (int i = 0; i < nFrames; i++) selection[i] = selection[groups[i]];
+	free(groups);
+	free(groupSizes);
+	free(refs);
+	free(stamps);
+}
+
+static int CellBatchMakeConfigs(const CellBatchParams *params, CellBatchConfig *configs) {
+	//the requested configuration comes first, it is the layout used without optimization
+	configs[0].aggressiveness = params->aggressiveness;
+	configs[0].full = params->full;
+	configs[0].cut = !params->affine;
+	configs[0].flip = 0;
+	if (!params->optimize) return 1;
+
+	//then other aggressiveness levels, covered regions and slicing. Affine OBJ are never cut.
+	static const int levels[] = { 100, 90, 75, 50, 25, 0 };
+	int nConfigs = 1;
+	for (int cut = 0; cut < (params->affine ? 1 : 2); cut++) {
+		for (int full = 0; full < 2; full++) {
+			for (int i = 0; i < (int) (sizeof(levels) / sizeof(levels[0])); i++) {
+				CellBatchConfig *config = configs + nConfigs;
+				config->aggressiveness = levels[i];
+				config->full = full ? !params->full : params->full;
+				config->cut = cut ? params->affine : !params->affine;
+				config->flip = 0;
+				if (memcmp(config, configs, sizeof(CellBatchConfig)) != 0) nConfigs++;
+			}
+		}
+	}
+	if (params->affine || !params->dedupe) return nConfigs;
+
+	//mirrored layouts let mirrored frames share flipped OBJ. Those of the requested
+	//configuration are tried first.
+	int nBase = nConfigs, nFlipped = 0;
+	CellBatchConfig flipped[CELLBATCH_MAX_CONFIGS];
+	for (int i = 0; i < nBase; i++) {
+		for (int flip = CELLBATCH_FLIP_H; flip <= (CELLBATCH_FLIP_H | CELLBATCH_FLIP_V); flip++) {
+			flipped[nFlipped] = configs[i];
+			flipped[nFlipped].flip = flip;
+			nFlipped++;
+		}
+	}
+
+	//order: requested, its flips, the other base configurations, then their flips
+	CellBatchConfig base[CELLBATCH_MAX_CONFIGS];
+	memcpy(base, configs, nBase * sizeof(CellBatchConfig));
+	nConfigs = 0;
+	configs[nConfigs++] = base[0];
+	for (int i = 0; i < 3; i++) configs[nConfigs++] = flipped[i];
+	for (int i = 1; i < nBase && nConfigs < CELLBATCH_MAX_CONFIGS; i++) configs[nConfigs++] = base[i];
+	for (int i = 3; i < nFlipped && nConfigs < CELLBATCH_MAX_CONFIGS; i++) configs[nConfigs++] = flipped[i];
+	return nConfigs;
+}
+
+int CellBatchGenerate(COLOR32 *px, int width, int height, const CellBatchFrame *frames, int nFrames, const CellBatchParams *params,
+	NCER *ncer, NCGR *ncgr, NCLR *nclr, CellBatchStats *stats, int *progress) {
+
+	int nBits = params->nBits;
+	if (nBits != 4 && nBits != 8) return CELLBATCH_STATUS_INVALID_PARAMS;
+	if (NCGR_2D(params->mappingMode)) return CELLBATCH_STATUS_INVALID_PARAMS;
+	if (params->nColors < 1 || params->nColors >= (1 << nBits)) return CELLBATCH_STATUS_INVALID_PARAMS;
+	if (params->paletteIndex < 0 || params->paletteIndex >= 16) return CELLBATCH_STATUS_INVALID_PARAMS;
+	for (int i = 0; i < nFrames; i++) {
+		//cell coordinates must fit in the OBJ position range
+		if (frames[i].width <= 0 || frames[i].height <= 0 || frames[i].width > 512 || frames[i].height > 256) {
+			return CELLBATCH_STATUS_INVALID_PARAMS;
+		}
+	}
+	DWORD deadline = GetTickCount() + params->timeBudget;
+
+	//character names address units of the mapping boundary
+	int charSize = nBits * 8;
+	int boundary = NCGR_BYTE_BOUNDARY(params->mappingMode);
+	int granularity = boundary / charSize;
+	if (granularity < 1) granularity = 1;
+	int maxChars = 0x400 * boundary / charSize;
+
+	CellBatchConfig configs[CELLBATCH_MAX_CONFIGS];
+	int nConfigsMax = CellBatchMakeConfigs(params, configs);
+
+	CellBatchContext ctx;
+	ctx.px = px;
+	ctx.width = width;
+	ctx.height = height;
+	ctx.frames = frames;
+	ctx.params = params;
+	ctx.palette = (COLOR32 *) calloc(params->nColors, sizeof(COLOR32));
+	CellBatchCreatePalette(&ctx, nFrames);
+
+	//generate the layouts of each configuration for all frames. The first is always
+	//generated, the others while the time budget lasts.
+	int share = params->dedupe, allowFlip = params->dedupe && params->optimize && !params->affine;
+	int *selection = (int *) calloc(nFrames, sizeof(int));
+	CellBatchLayout **layouts = (CellBatchLayout **) calloc(nConfigsMax, sizeof(CellBatchLayout *));
+	CellBatchGraphicsTable table;
+	CellBatchInitGraphicsTable(&table);
+
+	int nConfigs = 0, charsBefore = -1;
+	while (nConfigs < nConfigsMax && (nConfigs == 0 || GetTickCount() < deadline)) {
+		ctx.config = configs[nConfigs];
+		ctx.layouts = (CellBatchLayout *) calloc(nFrames, sizeof(CellBatchLayout));
+		ParRun(nFrames, CellBatchFrameProc, &ctx, progress, nConfigs * 900 / nConfigsMax, 900 / nConfigsMax);
+		layouts[nConfigs] = ctx.layouts;
+
+		if (nConfigs == 0 && params->optimize) {
+			//characters of the requested layout sharing only identical OBJ, for comparison
+			CellBatchGraphicsTable exact;
+			CellBatchInitGraphicsTable(&exact);
+			for (int i = 0; i < nFrames; i++) CellBatchAddLayoutGraphics(&exact, ctx.layouts + i, share, 0);
+			charsBefore = CellBatchCountLayoutCharacters(layouts, selection, nFrames, &exact, granularity);
+			CellBatchFreeGraphicsTable(&exact);
+		}
+
+		for (int i = 0; i < nFrames; i++) CellBatchAddLayoutGraphics(&table, ctx.layouts + i, share, allowFlip);
+		nConfigs++;
+	}
+
+	if (params->optimize) {
+		CellBatchSelectLayouts(layouts, nConfigs, nFrames, &table, granularity, selection, deadline);
+	}
+
+	//allocate characters in frame order
+	int status = CELLBATCH_STATUS_OK;
+	int nChars = 0, charsCapacity = 256;
+	unsigned char *chars = (unsigned char *) malloc(charsCapacity * 64);
+	int *graphicsStart = (int *) malloc((table.nGraphics + 1) * sizeof(int));
+	for (int i = 0; i < table.nGraphics; i++) graphicsStart[i] = -1;
+
+	NCER_CELL *cells = (NCER_CELL *) calloc(nFrames, sizeof(NCER_CELL));
+	for (int i = 0; i < nFrames && status == CELLBATCH_STATUS_OK; i++) {
+		CellBatchLayout *layout = layouts[selection[i]] + i;
+		NCER_CELL *cell = cells + i;
+		cell->nAttribs = layout->nObj;
+		cell->attr = (uint16_t *) calloc(layout->nObj * 3 + 1, sizeof(uint16_t));
+
+		for (int j = 0; j < layout->nObj; j++) {
+			OBJ_BOUNDS *bounds = layout->bounds + j;
+			int index = layout->objGraphics[j];
+			int nObjChars = bounds->width * bounds->height / 64;
+
+			if (graphicsStart[index] == -1) {
+				//place new characters at the next character name
+				int charStart = (nChars + granularity - 1) / granularity * granularity;
+				if (charStart + nObjChars > maxChars) {
+					status = CELLBATCH_STATUS_NO_SPACE;
+					break;
+				}
+
+				while (charStart + nObjChars > charsCapacity) {
+					charsCapacity *= 2;
+					chars = (unsigned char *) realloc(chars, charsCapacity * 64);
+				}
+				memset(chars + nChars * 64, 0, (charStart - nChars) * 64);
+				memcpy(chars + charStart * 64, table.chars[index], nObjChars * 64);
+				nChars = charStart + nObjChars;
+				graphicsStart[index] = charStart;
+			}
+
+			int shape, size;
+			int flip = layout->objFlip[j];
+			int charName = graphicsStart[index] * charSize / boundary;
+			CellgenGetObjShape(bounds->width, bounds->height, &shape, &size);
+			cell->attr[j * 3 + 0] = (bounds->y & 0x0FF) | (params->affine << 8) | (params->affine << 9) | ((nBits == 8) << 13) | (shape << 14);
+			cell->attr[j * 3 + 1] = (bounds->x & 0x1FF) | (!!(flip & CELLBATCH_FLIP_H) << 12) | (!!(flip & CELLBATCH_FLIP_V) << 13) | (size << 14);
+			cell->attr[j * 3 + 2] = (params->paletteIndex << 12) | charName;
+		}
+		CellCalculateBounds(cell);
+	}
+
+	for (int i = 0; i < nConfigs; i++) CellBatchFreeLayouts(layouts[i], nFrames);
+	CellBatchFreeGraphicsTable(&table);
+	free(graphicsStart);
+	free(selection);
+	free(layouts);
+
+	if (status != CELLBATCH_STATUS_OK) {
+		for (int i = 0; i < nFrames; i++) {
+			if (cells[i].attr != NULL) free(cells[i].attr);
+		}
+		free(cells);
+		free(chars);
+		free(ctx.palette);
+		return status;
+	}
+
+	//palette
+	PalInit(nclr, NCLR_TYPE_NCLR);
+	nclr->nBits = nBits;
+	nclr->nColors = (nBits == 4) ? 256 : (256 * (params->paletteIndex + 1));
+	nclr->extPalette = nBits == 8 && params->paletteIndex > 0;
+	nclr->colors = (COLOR *) calloc(nclr->nColors, sizeof(COLOR));
+	COLOR *dest = nclr->colors + (params->paletteIndex << nBits);
+	dest[0] = ColorConvertToDS(0xFF00FF);
+	for (int i = 0; i < params->nColors; i++) {
+		dest[i + 1] = ColorConvertToDS(ctx.palette[i]);
+	}
+	free(ctx.palette);
+
+	//graphics, padded to the mapping boundary
+	int nCharsFile = (nChars + granularity - 1) / granularity * granularity;
+	if (nCharsFile == 0) nCharsFile = granularity;
+	if (stats != NULL) {
+		stats->charsBefore = charsBefore == -1 ? nCharsFile : charsBefore;
+		stats->charsAfter = nCharsFile;
+		stats->bytesBefore = stats->charsBefore * charSize;
+		stats->bytesAfter = stats->charsAfter * charSize;
+	}
+	ChrInit(ncgr, NCGR_TYPE_NCGR);
+	ncgr->nBits = nBits;
+	ncgr->extPalette = nclr->extPalette;
+	ncgr->mappingMode = params->mappingMode;
+	ncgr->nTiles = nCharsFile;
+	ncgr->tilesX = ChrGuessWidth(ncgr->nTiles);
+	ncgr->tilesY = ncgr->nTiles / ncgr->tilesX;
+	ncgr->chars = (unsigned char *) calloc(nCharsFile + 1, 64);
+	ncgr->attr = (unsigned char *) calloc(nCharsFile, 1);
+	memset(ncgr->attr, params->paletteIndex, nCharsFile);
+	memcpy(ncgr->chars, chars, nChars * 64);
+	free(chars);
+
+	//cells
+	CellInit(ncer, NCER_TYPE_NCER);
+	ncer->nCells = nFrames;
+	ncer->cells = cells;
+	ncer->bankAttribs = 1;
+	ncer->mappingMode = params->mappingMode;
+
+	if (progress != NULL) *progress = 1000;
+	return CELLBATCH_STATUS_OK;
+}
+
+static int CellBatchReadFrameList(LPCWSTR manifestPath, CellBatchFrame **pFrames) {
+	int nFrames = GetPrivateProfileInt(L"Frames", L"Count", 0, manifestPath);
+	*pFrames = NULL;
+	if (nFrames <= 0) return 0;
+
+	CellBatchFrame *frames = (CellBatchFrame *) calloc(nFrames, sizeof(CellBatchFrame));
+	for (int i = 0; i < nFrames; i++) {
+		WCHAR key[32], value[64];
+		wsprintfW(key, L"Frame%d", i);
+		GetPrivateProfileString(L"Frames", key, L"", value, sizeof(value) / sizeof(WCHAR), manifestPath);
+
+		CellBatchFrame *frame = frames + i;
+		if (swscanf(value, L"%d,%d,%d,%d", &frame->x, &frame->y, &frame->width, &frame->height) != 4) {
+			free(frames);
+			return 0;
+		}
+	}
+	*pFrames = frames;
+	return nFrames;
+}
+
+static int CellBatchWriteReport(LPCWSTR path, const CellBatchStats *stats, int nFrames) {
+	HANDLE hFile = CreateFile(path, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE) return 0;
+
+	char report[256];
+	DWORD dwWritten;
+	sprintf(report, "frames:        %d\r\nVRAM before:   %d characters (%d bytes)\r\nVRAM after:    %d characters (%d bytes)\r\n",
+		nFrames, stats->charsBefore, stats->bytesBefore, stats->charsAfter, stats->bytesAfter);
+	WriteFile(hFile, report, strlen(report), &dwWritten, NULL);
+	CloseHandle(hFile);
+	return 1;
+}
+
+int CellBatchRunManifest(LPCWSTR manifestPath) {
+	static const int mappings[] = {
+		GX_OBJVRAMMODE_CHAR_2D, GX_OBJVRAMMODE_CHAR_1D_32K, GX_OBJVRAMMODE_CHAR_1D_64K,
+		GX_OBJVRAMMODE_CHAR_1D_128K, GX_OBJVRAMMODE_CHAR_1D_256K
+	};
+
+	//profile functions look in the Windows directory for relative paths
+	WCHAR path[MAX_PATH], imagePath[MAX_PATH], cellPath[MAX_PATH], charPath[MAX_PATH], palPath[MAX_PATH], reportPath[MAX_PATH];
+	if (!GetFullPathName(manifestPath, MAX_PATH, path, NULL)) return 0;
+	GetPrivateProfileString(L"Sheet", L"Image", L"", imagePath, MAX_PATH, path);
+	GetPrivateProfileString(L"Output", L"Cell", L"", cellPath, MAX_PATH, path);
+	GetPrivateProfileString(L"Output", L"Character", L"", charPath, MAX_PATH, path);
+	GetPrivateProfileString(L"Output", L"Palette", L"", palPath, MAX_PATH, path);
+	GetPrivateProfileString(L"Output", L"Report", L"", reportPath, MAX_PATH, path);
+	if (!imagePath[0] || !cellPath[0] || !charPath[0] || !palPath[0]) return 0;
+
+	CellBatchParams params;
+	CellBatchGetDefaultParams(&params);
+	int mapping = GetPrivateProfileInt(L"Cell", L"Mapping", 1, path);
+	if (mapping < 0 || mapping >= (int) (sizeof(mappings) / sizeof(mappings[0]))) return 0;
+	params.aggressiveness = GetPrivateProfileInt(L"Cell", L"Aggressiveness", params.aggressiveness, path);
+	params.full = GetPrivateProfileInt(L"Cell", L"Full", params.full, path);
+	params.affine = GetPrivateProfileInt(L"Cell", L"Affine", params.affine, path);
+	params.nBits = GetPrivateProfileInt(L"Cell", L"Depth", params.nBits, path);
+	params.mappingMode = mappings[mapping];
+	params.paletteIndex = GetPrivateProfileInt(L"Cell", L"Palette", params.paletteIndex, path);
+	params.nColors = GetPrivateProfileInt(L"Cell", L"Colors", (1 << params.nBits) - 1, path);
+	params.balance = GetPrivateProfileInt(L"Cell", L"Balance", params.balance, path);
+	params.colorBalance = GetPrivateProfileInt(L"Cell", L"ColorBalance", params.colorBalance, path);
+	params.enhanceColors = GetPrivateProfileInt(L"Cell", L"EnhanceColors", params.enhanceColors, path);
+	params.dedupe = GetPrivateProfileInt(L"Cell", L"Dedupe", params.dedupe, path);
+	params.optimize = GetPrivateProfileInt(L"Cell", L"Optimize", params.optimize, path);
+	params.timeBudget = GetPrivateProfileInt(L"Cell", L"TimeBudget", params.timeBudget, path);
+	if (GetPrivateProfileInt(L"Cell", L"Dither", 0, path)) {
+		params.diffuse = ((float) GetPrivateProfileInt(L"Cell", L"Diffuse", 100, path)) / 100.0f;
+	}
+
+	int width, height;
+	COLOR32 *px = ImgRead(imagePath, &width, &height);
+	if (px == NULL) return 0;
+
+	//an explicit frame list takes the place of the grid
+	CellBatchFrame *frames;
+	int nFrames = CellBatchReadFrameList(path, &frames);
+	if (nFrames == 0) {
+		int frameWidth = GetPrivateProfileInt(L"Sheet", L"FrameWidth", width, path);
+		int frameHeight = GetPrivateProfileInt(L"Sheet", L"FrameHeight", height, path);
+		int maxFrames = GetPrivateProfileInt(L"Sheet", L"FrameCount", 0, path);
+		nFrames = CellBatchMakeGridFrames(width, height, frameWidth, frameHeight, maxFrames, &frames);
+	}
+	if (nFrames == 0) {
+		free(px);
+		return 0;
+	}
+
+	NCER ncer;
+	NCGR ncgr;
+	NCLR nclr;
+	ncer.header.size = sizeof(NCER);
+	ncgr.header.size = sizeof(NCGR);
+	nclr.header.size = sizeof(NCLR);
+	CellBatchStats stats;
+	int status = CellBatchGenerate(px, width, height, frames, nFrames, &params, &ncer, &ncgr, &nclr, &stats, NULL);
+	free(frames);
+	free(px);
+	if (status != CELLBATCH_STATUS_OK) return 0;
+
+	int success = OBJ_SUCCEEDED(CellWriteFile(&ncer, cellPath)) && OBJ_SUCCEEDED(ChrWriteFile(&ncgr, charPath))
+		&& OBJ_SUCCEEDED(PalWriteFile(&nclr, palPath));
+	if (success && reportPath[0]) success = CellBatchWriteReport(reportPath, &stats, nFrames);
+	ObjFree(&ncer.header);
+	ObjFree(&ncgr.header);
+	ObjFree(&nclr.header);
+	return success;
+}
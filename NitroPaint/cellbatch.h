@@ -0,0 +1,85 @@
+#pragma once
+#include <Windows.h>
+
+#include "cellgen.h"
+#include "ncer.h"
+#include "ncgr.h"
+#include "nclr.h"
+
+#define CELLBATCH_STATUS_OK              0   // generation succeeded
+#define CELLBATCH_STATUS_INVALID_PARAMS  1   // unsupported depth, mapping or frame
+#define CELLBATCH_STATUS_NO_SPACE        2   // characters exceed the range of character names
+
+//
+// Region of a sprite sheet holding one frame.
+//
+typedef struct CellBatchFrame_ {
+	int x;
+	int y;
+	int width;
+	int height;
+} CellBatchFrame;
+
+typedef struct CellBatchParams_ {
+	int aggressiveness;        // cell generation aggressiveness (0-100)
+	int full;                  // cover the whole frame rather than its opaque region
+	int affine;                // generate cells for affine use
+	int nBits;                 // graphics bit depth (4 or 8)
+	int mappingMode;           // OBJ VRAM mapping mode, must be a 1D mode
+	int paletteIndex;          // palette number used by the OBJ
+	int nColors;               // number of colors generated after transparent color 0
+	float diffuse;             // dither diffusion amount, 0 for no dithering
+	int balance;
+	int colorBalance;
+	int enhanceColors;
+	int dedupe;                // share the characters of identical OBJ across frames
+	int optimize;              // choose OBJ layouts minimizing the total characters of all frames
+	int timeBudget;            // milliseconds spent searching layouts when optimizing
+} CellBatchParams;
+
+typedef struct CellBatchStats_ {
+	int charsBefore;           // characters used by the requested layout
+	int charsAfter;            // characters used by the chosen layouts
+	int bytesBefore;
+	int bytesAfter;
+} CellBatchStats;
+
+//
+// Fill parameters with the defaults of the cell generation dialog.
+//
+void CellBatchGetDefaultParams(CellBatchParams *params);
+
+//
+// Divide a sprite sheet into a grid of frames, left to right and top to bottom.
+// At most maxFrames frames are produced when maxFrames is positive. Returns the
+// number of frames; the frame array is freed by the caller.
+//
+int CellBatchMakeGridFrames(int width, int height, int frameWidth, int frameHeight, int maxFrames, CellBatchFrame **pFrames);
+
+//
+// Generate one cell per frame of a sprite sheet, with graphics and a palette
+// shared by all frames. Frames are divided into OBJ in parallel. With dedupe
+// set, OBJ with identical graphics share their characters. Cells are
+// positioned relative to the center of their frame, so that frames of an
+// animation stay aligned. With optimize set, each frame is also divided with
+// other aggressiveness levels and coverage, and one layout per frame is chosen
+// to minimize the characters of the whole sheet, sharing flipped OBJ graphics
+// when the cell is not affine. The output structures are initialized by this
+// function. If stats is not NULL, it receives the VRAM use. If progress is not
+// NULL, it is advanced from 0 to 1000.
+//
+int CellBatchGenerate(COLOR32 *px, int width, int height, const CellBatchFrame *frames, int nFrames, const CellBatchParams *params,
+	NCER *ncer, NCGR *ncgr, NCLR *nclr, CellBatchStats *stats, int *progress);
+
+//
+// Run batch cell generation described by an INI manifest, writing the NCER,
+// NCGR and NCLR it names. Returns 1 on success, 0 on failure.
+//
+// [Sheet]   Image, FrameWidth, FrameHeight, FrameCount (grid of frames)
+// [Frames]  Count, Frame0..FrameN as x,y,width,height (replaces the grid)
+// [Cell]    Aggressiveness, Full, Affine, Depth, Mapping (0-4 as 2D, 1D 32K,
+//           1D 64K, 1D 128K, 1D 256K), Palette, Colors, Dither, Diffuse,
+//           Balance, ColorBalance, EnhanceColors, Dedupe, Optimize, TimeBudget
+// [Output]  Cell, Character, Palette, Report (VRAM use before and after)
+//
+int CellBatchRunManifest(LPCWSTR manifestPath);
@@ -0,0 +1,188 @@
+#include "cellcache.h"
+
+//cells are rendered to the cache at this offset
+#define CELLCACHE_OFFSET_X    256
+#define CELLCACHE_OFFSET_Y    128
+
+void CellCacheInit(CellCache *cache) {
+	memset(cache, 0, sizeof(CellCache));
+}
+
+static void CellCacheFreeEntry(CellCacheEntry *entry) {
+	if (entry->runs != NULL) free(entry->runs);
+	if (entry->px != NULL) free(entry->px);
+	if (entry->cov != NULL) free(entry->cov);
+	memset(entry, 0, sizeof(CellCacheEntry));
+}
+
+void CellCacheFree(CellCache *cache) {
+	for (int i = 0; i < cache->nEntries; i++) {
+		CellCacheFreeEntry(&cache->entries[i]);
+	}
+	if (cache->scratch != NULL) free(cache->scratch);
+	if (cache->scratchCov != NULL) free(cache->scratchCov);
+	CellCacheInit(cache);
+}
+
+static int CellCacheKeyMatches(CellCacheEntry *entry, NCER *ncer, int cellno, NCGR *ncgr, NCLR *nclr, CHAR_VRAM_TRANSFER *vramTransfer, float a, float b, float c, float d, int flags) {
+	if (entry->ncer != ncer || entry->ncgr != ncgr || entry->nclr != nclr) return 0;
+	if (entry->cellno != cellno || entry->mapping != ncer->mappingMode || entry->flags != flags) return 0;
+	if (entry->a != a || entry->b != b || entry->c != c || entry->d != d) return 0;
+	if (entry->hasTransfer != (vramTransfer != NULL)) return 0;
+	if (vramTransfer != NULL && memcmp(&entry->transfer, vramTransfer, sizeof(CHAR_VRAM_TRANSFER)) != 0) return 0;
+	return 1;
+}
+
+static int CellCacheIsCurrent(CellCacheEntry *entry, NCER *ncer, NCGR *ncgr, NCLR *nclr) {
+	if (entry->ncerGeneration != ncer->header.generation) return 0;
+	if (ncgr != NULL && entry->ncgrGeneration != ncgr->header.generation) return 0;
+	if (nclr != NULL && entry->nclrGeneration != nclr->header.generation) return 0;
+	return 1;
+}
+
+static void CellCacheComposite(CellCacheEntry *entry, COLOR32 *px, int *covbuf, int xOffs, int yOffs) {
+	int dx = xOffs - CELLCACHE_OFFSET_X, dy = yOffs - CELLCACHE_OFFSET_Y;
+
+	const COLOR32 *src = entry->px;
+	const uint16_t *cov = entry->cov;
+	for (int i = 0; i < entry->nRuns; i++) {
+		const uint16_t *run = entry->runs + i * 3;
+		int destY = (run[1] + dy) & 0xFF;
+		COLOR32 *destRow = px + destY * 512;
+		int *covRow = covbuf == NULL ? NULL : covbuf + destY * 512;
+
+		for (int j = 0; j < run[2]; j++) {
+			int destX = (run[0] + j + dx) & 0x1FF;
+			destRow[destX] = src[j];
+			if (covRow != NULL) covRow[destX] = cov[j];
+		}
+		src += run[2];
+		cov += run[2];
+	}
+}
+
+static void CellCacheStoreRender(CellCacheEntry *entry, NCER_CELL *cell, const COLOR32 *px, const int *covbuf) {
+	//mark rows the OBJ can cover, so that only those are scanned
+	unsigned char rows[256] = { 0 };
+	for (int i = 0; i < cell->nAttribs; i++) {
+		NCER_CELL_INFO info;
+		CellDecodeOamAttributes(&info, cell, i);
+		for (int y = 0; y < info.height * 2; y++) {
+			rows[(info.y + y + CELLCACHE_OFFSET_Y) & 0xFF] = 1;
+		}
+	}
+
+	//count runs and pixels
+	int nRuns = 0, nPx = 0;
+	for (int y = 0; y < 256; y++) {
+		if (!rows[y]) continue;
+		for (int x = 0; x < 512; x++) {
+			if (!covbuf[x + y * 512]) continue;
+			if (x == 0 || !covbuf[x - 1 + y * 512]) nRuns++;
+			nPx++;
+		}
+	}
+
+	entry->nRuns = nRuns;
+	entry->runs = (uint16_t *) malloc(nRuns * 3 * sizeof(uint16_t) + 1);
+	entry->px = (COLOR32 *) malloc(nPx * sizeof(COLOR32) + 1);
+	entry->cov = (uint16_t *) malloc((nPx + 1) * sizeof(uint16_t));
+
+	int iRun = 0, iPx = 0;
+	for (int y = 0; y < 256; y++) {
+		if (!rows[y]) continue;
+		for (int x = 0; x < 512; x++) {
+			if (!covbuf[x + y * 512]) continue;
+			if (x == 0 || !covbuf[x - 1 + y * 512]) {
+				entry->runs[iRun * 3 + 0] = x;
+				entry->runs[iRun * 3 + 1] = y;
+				entry->runs[iRun * 3 + 2] = 0;
+				iRun++;
+			}
+			entry->runs[(iRun - 1) * 3 + 2]++;
+			entry->px[iPx] = px[x + y * 512];
+			entry->cov[iPx] = covbuf[x + y * 512];
+			iPx++;
+		}
+	}
+}
+
+static CellCacheEntry *CellCacheAllocEntry(CellCache *cache) {
+	if (cache->nEntries < CELLCACHE_SIZE) return &cache->entries[cache->nEntries++];
+
+	//evict least recently used entry
+	CellCacheEntry *lru = &cache->entries[0];
+	for (int i = 1; i < cache->nEntries; i++) {
+		if ((cache->useCounter - cache->entries[i].lastUse) > (cache->useCounter - lru->lastUse)) lru = &cache->entries[i];
+	}
+	CellCacheFreeEntry(lru);
+	return lru;
+}
+
+void CellCacheRender(CellCache *cache, COLOR32 *px, int *covbuf, NCER *ncer, int cellno, NCGR *ncgr, NCLR *nclr, CHAR_VRAM_TRANSFER *vramTransfer, int xOffs, int yOffs, float a, float b, float c, float d, int flags) {
+	NCER_CELL *cell = ncer->cells + cellno;
+	if (cache == NULL) {
+		CellRenderCellEx(px, covbuf, cell, ncer->mappingMode, ncgr, nclr, vramTransfer, xOffs, yOffs, a, b, c, d, flags);
+		return;
+	}
+
+	cache->useCounter++;
+
+	//find the render of this cell with these parameters
+	CellCacheEntry *entry = NULL;
+	for (int i = 0; i < cache->nEntries; i++) {
+		if (CellCacheKeyMatches(&cache->entries[i], ncer, cellno, ncgr, nclr, vramTransfer, a, b, c, d, flags)) {
+			entry = &cache->entries[i];
+			break;
+		}
+	}
+
+	if (entry != NULL) {
+		entry->lastUse = cache->useCounter;
+		if (CellCacheIsCurrent(entry, ncer, ncgr, nclr)) {
+			CellCacheComposite(entry, px, covbuf, xOffs, yOffs);
+			return;
+		}
+
+		//data was edited since it was rendered: render again in its place
+		CellCacheFreeEntry(entry);
+	} else {
+		entry = CellCacheAllocEntry(cache);
+	}
+
+	//render the cell at the cache offset. Only pixels with coverage are read back, so the
+	//coverage buffer is kept clear between renders.
+	if (cache->scratch == NULL) {
+		cache->scratch = (COLOR32 *) malloc(512 * 256 * sizeof(COLOR32));
+		cache->scratchCov = (int *) calloc(512 * 256, sizeof(int));
+	}
+	CellRenderCellEx(cache->scratch, cache->scratchCov, cell, ncer->mappingMode, ncgr, nclr, vramTransfer,
+		CELLCACHE_OFFSET_X, CELLCACHE_OFFSET_Y, a, b, c, d, flags);
+
+	//store it
+	entry->ncer = ncer;
+	entry->ncgr = ncgr;
+	entry->nclr = nclr;
+	entry->cellno = cellno;
+	entry->mapping = ncer->mappingMode;
+	entry->flags = flags;
+	entry->a = a;
+	entry->b = b;
+	entry->c = c;
+	entry->d = d;
+	entry->hasTransfer = vramTransfer != NULL;
+	if (vramTransfer != NULL) memcpy(&entry->transfer, vramTransfer, sizeof(CHAR_VRAM_TRANSFER));
+
+	entry->ncerGeneration = ncer->header.generation;
+	entry->ncgrGeneration = ncgr == NULL ? 0 : ncgr->header.generation;
+	entry->nclrGeneration = nclr == NULL ? 0 : nclr->header.generation;
+
+	CellCacheStoreRender(entry, cell, cache->scratch, cache->scratchCov);
+	entry->lastUse = cache->useCounter;
+	for (int i = 0; i < entry->nRuns; i++) {
+		const uint16_t *run = entry->runs + i * 3;
+		memset(cache->scratchCov + run[0] + run[1] * 512, 0, run[2] * sizeof(int));
+	}
+
+	CellCacheComposite(entry, px, covbuf, xOffs, yOffs);
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <Windows.h>
+
+#include "color.h"
+#include "ncgr.h"
+#include "nclr.h"
+#include "ncer.h"
+
+#define CELLCACHE_SIZE        64      // maximum number of cached cells
+
+//
+// A rendered cell, stored as runs of drawn pixels at a fixed offset in the
+// 512x256 render space.
+//
+typedef struct CellCacheEntry_ {
+	//key
+	const NCER *ncer;
+	const NCGR *ncgr;
+	const NCLR *nclr;
+	int cellno;
+	int mapping;
+	int flags;
+	float a;
+	float b;
+	float c;
+	float d;
+	int hasTransfer;
+	CHAR_VRAM_TRANSFER transfer;
+
+	//edit generations of the data the cell was rendered from
+	unsigned int ncerGeneration;
+	unsigned int ncgrGeneration;
+	unsigned int nclrGeneration;
+
+	//rendered pixels
+	int nRuns;
+	uint16_t *runs;                    // x, y and length of each run
+	COLOR32 *px;                       // pixels of all runs
+	uint16_t *cov;                     // OBJ index + 1 of all run pixels
+	unsigned int lastUse;
+} CellCacheEntry;
+
+//
+// Least recently used cache of rendered cells. Entries are keyed by cell and
+// render parameters, and hold the edit generations of the cell, character and
+// palette data they were rendered from. Editors advance those generations with
+// ObjMarkModified, so edits are picked up without explicit invalidation.
+//
+typedef struct CellCache_ {
+	CellCacheEntry entries[CELLCACHE_SIZE];
+	int nEntries;
+	unsigned int useCounter;
+
+	COLOR32 *scratch;                  // 512x256 render buffer
+	int *scratchCov;                   // 512x256 coverage buffer
+} CellCache;
+
+void CellCacheInit(CellCache *cache);
+
+void CellCacheFree(CellCache *cache);
+
+//
+// Render a cell to a 512x256 buffer like CellRenderCellEx, using a cached
+// render when one matches. cache may be NULL to render without caching.
+//
+void CellCacheRender(CellCache *cache, COLOR32 *px, int *covbuf, NCER *ncer, int cellno, NCGR *ncgr, NCLR *nclr, CHAR_VRAM_TRANSFER *vramTransfer, int xOffs, int yOffs, float a, float b, float c, float d, int flags);
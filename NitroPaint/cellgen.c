@@ -13,40 +13,134 @@
 
 #define CELLGEN_ROUNDUP8(x)  (((x)+7)&~7)
 
-static void CellgenGetXYBounds(COLOR32 *px, const unsigned char *ignores, int width, int height, int xMin, int xMax, int yMin, int yMax,
-		int *pxMin, int *pxMax, int *pyMin, int *pyMax) {
+//
+// Occupancy of the image being divided. Opaque pixels and pixels accounted for
+// by OBJ are kept as bitmasks, 64 pixels per word, so rectangle queries and
+// accounting work on whole words instead of single pixels.
+//
+typedef struct CellgenOccupancy_ {
+	int width;                 // image width
+	int height;                // image height
+	int stride;                // words per row
+	uint64_t *opaque;          // opaque pixels of the image
+	uint64_t *accounted;       // pixels covered by accounted OBJ
+	uint64_t *rowAcc;          // scratch row for bounds queries
+} CellgenOccupancy;
+
+static void CellgenOccupancyInit(CellgenOccupancy *occ, COLOR32 *px, int width, int height) {
+	occ->width = width;
+	occ->height = height;
+	occ->stride = (width + 63) / 64;
+	occ->opaque = (uint64_t *) calloc(occ->stride * height + 1, sizeof(uint64_t));
+	occ->accounted = (uint64_t *) calloc(occ->stride * height + 1, sizeof(uint64_t));
+	occ->rowAcc = (uint64_t *) calloc(occ->stride + 1, sizeof(uint64_t));
+
+	for (int y = 0; y < height; y++) {
+		uint64_t *row = occ->opaque + y * occ->stride;
+		for (int x = 0; x < width; x++) {
+			if ((px[y * width + x] >> 24) >= 128) row[x / 64] |= 1ull << (x % 64);
+		}
+	}
+}
+
+static void CellgenOccupancyFree(CellgenOccupancy *occ) {
+	free(occ->opaque);
+	free(occ->accounted);
+	free(occ->rowAcc);
+}
+
+static void CellgenClearAccount(CellgenOccupancy *occ) {
+	memset(occ->accounted, 0, occ->stride * occ->height * sizeof(uint64_t));
+}
+
+static int CellgenPopCount(uint64_t x) {
+	x = x - ((x >> 1) & 0x5555555555555555ull);
+	x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+	x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+	return (int) ((x * 0x0101010101010101ull) >> 56);
+}
 
-	//clamp bounds
-	yMin = min(max(yMin, 0), height);
-	yMax = min(max(yMax, 0), height);
-	xMin = min(max(xMin, 0), width);
-	xMax = min(max(xMax, 0), width);
+static int CellgenLowestBit(uint64_t x) {
+	int n = 0;
+	if (!(x & 0xFFFFFFFFull)) { n += 32; x >>= 32; }
+	if (!(x & 0xFFFFull)) { n += 16; x >>= 16; }
+	if (!(x & 0xFFull)) { n += 8; x >>= 8; }
+	if (!(x & 0xFull)) { n += 4; x >>= 4; }
+	if (!(x & 0x3ull)) { n += 2; x >>= 2; }
+	if (!(x & 0x1ull)) { n += 1; }
+	return n;
+}
+
+static int CellgenHighestBit(uint64_t x) {
+	int n = 0;
+	if (x >> 32) { n += 32; x >>= 32; }
+	if (x >> 16) { n += 16; x >>= 16; }
+	if (x >> 8) { n += 8; x >>= 8; }
+	if (x >> 4) { n += 4; x >>= 4; }
+	if (x >> 2) { n += 2; x >>= 2; }
+	if (x >> 1) { n += 1; }
+	return n;
+}
+
+static uint64_t CellgenWordMask(int word, int xMin, int xMax) {
+	//mask of the pixels of a word within [xMin, xMax)
+	int lo = xMin - word * 64, hi = xMax - word * 64;
+	uint64_t mask = ~0ull;
+	if (lo > 0) mask &= ~0ull << lo;
+	if (hi < 64) mask &= ~(~0ull << hi);
+	return mask;
+}
+
+static int CellgenClampRect(CellgenOccupancy *occ, int *xMin, int *xMax, int *yMin, int *yMax) {
+	*yMin = min(max(*yMin, 0), occ->height);
+	*yMax = min(max(*yMax, 0), occ->height);
+	*xMin = min(max(*xMin, 0), occ->width);
+	*xMax = min(max(*xMax, 0), occ->width);
+	return *xMin < *xMax && *yMin < *yMax;
+}
+
+static void CellgenGetXYBounds(CellgenOccupancy *occ, int xMin, int xMax, int yMin, int yMax,
+		int *pxMin, int *pxMax, int *pyMin, int *pyMax) {
 
 	//init -1 to indicate none found (yet)
 	//must be same in case none ever found
-	int xOutMin = -1, xOutMax = -1;
-	int yOutMin = -1, yOutMax = -1;
+	*pxMin = *pxMax = *pyMin = *pyMax = -1;
+	if (!CellgenClampRect(occ, &xMin, &xMax, &yMin, &yMax)) return;
 
-	//scan rectangle
-	for (int y = yMin; y < yMax; y++) {
-		for (int x = xMin; x < xMax; x++) {
-			COLOR32 c = px[y * width + x];
-			int a = ((c >> 24) & 0xFF) >= 128;
+	//gather the opaque, unaccounted pixels of all rows into one row
+	int w0 = xMin / 64, w1 = (xMax - 1) / 64;
+	uint64_t *acc = occ->rowAcc;
+	memset(acc + w0, 0, (w1 - w0 + 1) * sizeof(uint64_t));
 
-			int ignore = 0;
-			if (ignores != NULL) {
-				ignore = ignores[y * width + x];
-			}
-
-			//ignore marks pixel as effectively transparent
-			if (ignore) a = 0;
+	int yOutMin = -1, yOutMax = -1;
+	for (int y = yMin; y < yMax; y++) {
+		const uint64_t *opaque = occ->opaque + y * occ->stride;
+		const uint64_t *accounted = occ->accounted + y * occ->stride;
+
+		uint64_t any = 0;
+		for (int w = w0; w <= w1; w++) {
+			uint64_t bits = opaque[w] & ~accounted[w] & CellgenWordMask(w, xMin, xMax);
+			acc[w] |= bits;
+			any |= bits;
+		}
+		if (any) {
+			if (yOutMin == -1) yOutMin = y;
+			yOutMax = y + 1;
+		}
+	}
+	if (yOutMin == -1) return;
 
-			if (a) {
-				if (xOutMin == -1 || x < xOutMin) xOutMin = x;
-				if (yOutMin == -1 || y < yOutMin) yOutMin = y;
-				if (x + 1 > xOutMax) xOutMax = x + 1;
-				if (y + 1 > yOutMax) yOutMax = y + 1;
-			}
+	int xOutMin = -1, xOutMax = -1;
+	for (int w = w0; w <= w1; w++) {
+		if (acc[w]) {
+			xOutMin = w * 64 + CellgenLowestBit(acc[w]);
+			break;
+		}
+	}
+	for (int w = w1; w >= w0; w--) {
+		if (acc[w]) {
+			xOutMax = w * 64 + CellgenHighestBit(acc[w]) + 1;
+			break;
 		}
 	}
 
@@ -56,39 +150,31 @@ static void CellgenGetXYBounds(COLOR32 *px, const unsigned char *ignores, int wi
 	*pyMax = yOutMax;
 }
 
-static int CellgenObjContainsPixels(COLOR32 *px, const unsigned char *ignores, int width, int height, OBJ_BOUNDS *bounds) {
+static int CellgenObjContainsPixels(CellgenOccupancy *occ, OBJ_BOUNDS *bounds) {
 	int xMin, xMax, yMin, yMax;
-	CellgenGetXYBounds(px, ignores, width, height, bounds->x, bounds->x + bounds->width, bounds->y, bounds->y + bounds->height,
+	CellgenGetXYBounds(occ, bounds->x, bounds->x + bounds->width, bounds->y, bounds->y + bounds->height,
 		&xMin, &xMax, &yMin, &yMax);
 
 	//if xMin == xMax or yMin == yMax, this bound is empty.
 	return xMin != xMax && yMin != yMax;
 }
 
-static int CellgenCountTransparent(COLOR32 *px, const unsigned char *accountBuf, int width, int height, OBJ_BOUNDS *bounds) {
+static int CellgenCountTransparent(CellgenOccupancy *occ, OBJ_BOUNDS *bounds) {
 	int xMin = bounds->x, xMax = bounds->x + bounds->width;
 	int yMin = bounds->y, yMax = bounds->y + bounds->height;
-	yMin = min(max(yMin, 0), height);
-	yMax = min(max(yMax, 0), height);
-	xMin = min(max(xMin, 0), width);
-	xMax = min(max(xMax, 0), width);
+	if (!CellgenClampRect(occ, &xMin, &xMax, &yMin, &yMax)) return 0;
 
-	int nTransparent = 0;
+	//pixels accounted for count as transparent
+	int w0 = xMin / 64, w1 = (xMax - 1) / 64;
+	int nOpaque = 0;
 	for (int y = yMin; y < yMax; y++) {
-		for (int x = xMin; x < xMax; x++) {
-			COLOR32 c = px[y * width + x];
-			int a = (c >> 24) >= 128;
-
-			int skip = 0;
-			if (accountBuf != NULL) {
-				skip = accountBuf[y * width + x];
-			}
-			if (skip) a = 0;
-
-			if (!a) nTransparent++;
+		const uint64_t *opaque = occ->opaque + y * occ->stride;
+		const uint64_t *accounted = occ->accounted + y * occ->stride;
+		for (int w = w0; w <= w1; w++) {
+			nOpaque += CellgenPopCount(opaque[w] & ~accounted[w] & CellgenWordMask(w, xMin, xMax));
 		}
 	}
-	return nTransparent;
+	return (xMax - xMin) * (yMax - yMin) - nOpaque;
 }
 
 static int CellgenGetLargestObjDimension(int x) {
@@ -111,20 +197,19 @@ static int CellgenAdjustCorrectObjHeight(int width, int height) {
 	return CellgenAdjustCorrectObjWidth(width, height);
 }
 
-static void CellgenAccountRegion(unsigned char *accountBuf, int width, int height, OBJ_BOUNDS *bounds) {
+static void CellgenAccountRegion(CellgenOccupancy *occ, OBJ_BOUNDS *bounds) {
 	int objXMin = bounds->x, objXMax = bounds->x + bounds->width;
 	int objYMin = bounds->y, objYMax = bounds->y + bounds->height;
 
 	//clamp to image size
-	objXMin = min(max(objXMin, 0), width);
-	objXMax = min(max(objXMax, 0), width);
-	objYMin = min(max(objYMin, 0), height);
-	objYMax = min(max(objYMax, 0), height);
+	if (!CellgenClampRect(occ, &objXMin, &objXMax, &objYMin, &objYMax)) return;
 
 	//account for all of this OBJ's pixels
+	int w0 = objXMin / 64, w1 = (objXMax - 1) / 64;
 	for (int y = objYMin; y < objYMax; y++) {
-		for (int x = objXMin; x < objXMax; x++) {
-			accountBuf[y * width + x] = 1;
+		uint64_t *accounted = occ->accounted + y * occ->stride;
+		for (int w = w0; w <= w1; w++) {
+			accounted[w] |= CellgenWordMask(w, objXMin, objXMax);
 		}
 	}
 }
@@ -145,7 +230,7 @@ static void CellgenSplitObj(OBJ_BOUNDS *obj, int dir, OBJ_BOUNDS *out1, OBJ_BOUN
 	}
 }
 
-static int CellgenDecideSplitDirection(COLOR32 *px, const unsigned char *accountBuf, int width, int height, OBJ_BOUNDS *bounds) {
+static int CellgenDecideSplitDirection(CellgenOccupancy *occ, OBJ_BOUNDS *bounds) {
 	//can we split both ways?
 	int canHSplit = 0, canVSplit = 0;
 
@@ -172,10 +257,10 @@ static int CellgenDecideSplitDirection(COLOR32 *px, const unsigned char *account
 	CellgenSplitObj(bounds, CELLGEN_DIR_H, tempH + 0, tempH + 1);
 	CellgenSplitObj(bounds, CELLGEN_DIR_V, tempV + 0, tempV + 1);
 
-	int diffH = CellgenCountTransparent(px, accountBuf, width, height, tempH + 0)
-		- CellgenCountTransparent(px, accountBuf, width, height, tempH + 1);
-	int diffV = CellgenCountTransparent(px, accountBuf, width, height, tempV + 0)
-		- CellgenCountTransparent(px, accountBuf, width, height, tempV + 1);
+	int diffH = CellgenCountTransparent(occ, tempH + 0)
+		- CellgenCountTransparent(occ, tempH + 1);
+	int diffV = CellgenCountTransparent(occ, tempV + 0)
+		- CellgenCountTransparent(occ, tempV + 1);
 	if (diffH < 0) diffH = -diffH;
 	if (diffV < 0) diffV = -diffV;
 
@@ -187,17 +272,17 @@ static int CellgenDecideSplitDirection(COLOR32 *px, const unsigned char *account
 	return CELLGEN_DIR_V;
 }
 
-static int CellgenProcessSubdivision(COLOR32 *px, unsigned char *accountBuf, int width, int height, int aggressiveness, 
+static int CellgenProcessSubdivision(CellgenOccupancy *occ, int aggressiveness, 
 		OBJ_BOUNDS *boundBuffer, int *pCount, int index, int maxDepth) {
 	//should we give up here based on the aggressiveness parameter?
 	int area = boundBuffer[index].width * boundBuffer[index].height;
-	int nTrans = CellgenCountTransparent(px, accountBuf, width, height, boundBuffer + index);
+	int nTrans = CellgenCountTransparent(occ, boundBuffer + index);
 
 	//if nTrans / size >= proportionRequired
 	if (nTrans * 100 / area < (100 - aggressiveness)) return 0; //did not split
 
 	//can split?
-	int splitDir = CellgenDecideSplitDirection(px, accountBuf, width, height, boundBuffer + index);
+	int splitDir = CellgenDecideSplitDirection(occ, boundBuffer + index);
 	if (splitDir == CELLGEN_DIR_NONE) return 0; //did not split
 
 	//can split. 
@@ -211,8 +296,8 @@ static int CellgenProcessSubdivision(COLOR32 *px, unsigned char *accountBuf, int
 	(*pCount)++; //buffer grew by 1
 
 	//are either of the two OBJ fully transparent?
-	int split1HasPixels = CellgenObjContainsPixels(px, accountBuf, width, height, boundBuffer + split1Index);
-	int split2HasPixels = CellgenObjContainsPixels(px, accountBuf, width, height, boundBuffer + split2Index);
+	int split1HasPixels = CellgenObjContainsPixels(occ, boundBuffer + split1Index);
+	int split2HasPixels = CellgenObjContainsPixels(occ, boundBuffer + split2Index);
 
 	int didCull = 0;
 	if (!split1HasPixels) {
@@ -231,10 +316,10 @@ static int CellgenProcessSubdivision(COLOR32 *px, unsigned char *accountBuf, int
 	//try split children
 	int split1DidCull = 0, split2DidCull = 0;
 	if (split1HasPixels && maxDepth > 1) {
-		split1DidCull = CellgenProcessSubdivision(px, accountBuf, width, height, aggressiveness, boundBuffer, pCount, split1Index, maxDepth - 1);
+		split1DidCull = CellgenProcessSubdivision(occ, aggressiveness, boundBuffer, pCount, split1Index, maxDepth - 1);
 	}
 	if (split2HasPixels && maxDepth > 1) {
-		split2DidCull = CellgenProcessSubdivision(px, accountBuf, width, height, aggressiveness, boundBuffer, pCount, split2Index, maxDepth - 1);
+		split2DidCull = CellgenProcessSubdivision(occ, aggressiveness, boundBuffer, pCount, split2Index, maxDepth - 1);
 	}
 
 	//if either child did cull, we cannot re-merge.
@@ -255,7 +340,7 @@ static int CellgenProcessSubdivision(COLOR32 *px, unsigned char *accountBuf, int
 #define SHIFT_FLAG_RIGHT        2
 #define SHIFT_FLAG_NOREMOVE     4
 
-static int CellgenShiftObj(COLOR32 *px, unsigned char *accountBuf, int width, int height, OBJ_BOUNDS *obj, int nObj, int flag) {
+static int CellgenShiftObj(CellgenOccupancy *occ, OBJ_BOUNDS *obj, int nObj, int flag) {
 	//edges to fit pixels to
 	int matchLeft = !(flag & SHIFT_FLAG_RIGHT);
 	int matchTop = !(flag & SHIFT_FLAG_BOTTOM);
@@ -268,7 +353,7 @@ static int CellgenShiftObj(COLOR32 *px, unsigned char *accountBuf, int width, in
 
 		//get pixel bounds of this OBJ
 		int bxMin, bxMax, byMin, byMax;
-		CellgenGetXYBounds(px, accountBuf, width, height, objXMin, objXMax, objYMin, objYMax, &bxMin, &bxMax, &byMin, &byMax);
+		CellgenGetXYBounds(occ, objXMin, objXMax, objYMin, objYMax, &bxMin, &bxMax, &byMin, &byMax);
 
 		//if xMin == xMax or yMin == yMax, this OBJ has become useless in this step, so remove it.
 		if ((bxMin == bxMax || byMin == byMax) && !(flag & SHIFT_FLAG_NOREMOVE)) {
@@ -304,28 +389,28 @@ static int CellgenShiftObj(COLOR32 *px, unsigned char *accountBuf, int width, in
 		objYMin = bounds->y, objYMax = bounds->y + bounds->height;
 
 		//account for all of this OBJ's pixels
-		CellgenAccountRegion(accountBuf, width, height, bounds);
+		CellgenAccountRegion(occ, bounds);
 	}
 
 	return nObj;
 }
 
-static int CellgenIterateAllShifts(COLOR32 *px, unsigned char *accountBuf, int width, int height, OBJ_BOUNDS *obj, int nObj) {
+static int CellgenIterateAllShifts(CellgenOccupancy *occ, OBJ_BOUNDS *obj, int nObj) {
 	//all combinations of flags
 	for (int i = 0; i < 4; i++) {
-		memset(accountBuf, 0, width * height);
-		nObj = CellgenShiftObj(px, accountBuf, width, height, obj, nObj, i);
+		CellgenClearAccount(occ);
+		nObj = CellgenShiftObj(occ, obj, nObj, i);
 	}
 	return nObj;
 }
 
-static int CellgenTryIterateSplit(COLOR32 *px, unsigned char *accountBuf, int width, int height, int agr, OBJ_BOUNDS *obj, int nObj, int maxDepth) {
-	//memset(accountBuf, 0, width * height);
+static int CellgenTryIterateSplit(CellgenOccupancy *occ, int agr, OBJ_BOUNDS *obj, int nObj, int maxDepth) {
+	//CellgenClearAccount(occ);
 
 	int nObjInit = nObj;
 	for (int i = 0; i < nObjInit; i++) {
 		OBJ_BOUNDS *bounds = obj + i;
-		//int nTrans = CellgenCountTransparent(px, accountBuf, obj->width, obj->height, bounds);
+		//int nTrans = CellgenCountTransparent(occ, bounds);
 		//if (nTrans < 64) continue;
 
 		//TODO: adjustable criteria here based on nTrans or nTrans/size?
@@ -335,7 +420,7 @@ static int CellgenTryIterateSplit(COLOR32 *px, unsigned char *accountBuf, int wi
 		memcpy(boundBuffer, bounds, sizeof(OBJ_BOUNDS));
 
 		//try subdividing to cull regions
-		int didCull = CellgenProcessSubdivision(px, accountBuf, width, height, agr, boundBuffer, &boundBufferSize, 0, maxDepth);
+		int didCull = CellgenProcessSubdivision(occ, agr, boundBuffer, &boundBufferSize, 0, maxDepth);
 		if (!didCull) continue;
 
 		//did cull, so process accordingly
@@ -344,7 +429,7 @@ static int CellgenTryIterateSplit(COLOR32 *px, unsigned char *accountBuf, int wi
 			if (boundBuffer[j].width == 0 && boundBuffer[j].height == 0) continue; //deleted entry
 
 			//account this created entry
-			CellgenAccountRegion(accountBuf, width, height, boundBuffer + j);
+			CellgenAccountRegion(occ, boundBuffer + j);
 
 			//if nObjWritten == 0, write to bounds (obj[i])
 			if (nObjWritten == 0) {
@@ -432,21 +517,21 @@ static int CellgenTryCoalesce(OBJ_BOUNDS *obj, int nObj) {
 	return nObj;
 }
 
-static int CellgenTryRemoveOverlapping(COLOR32 *px, unsigned char *accountBuf, int width, int height, OBJ_BOUNDS *obj, int nObj) {
+static int CellgenTryRemoveOverlapping(CellgenOccupancy *occ, OBJ_BOUNDS *obj, int nObj) {
 	//scan through list of OBJ and see if they are redundant
 	for (int i = 0; i < nObj; i++) {
 		OBJ_BOUNDS *obj1 = obj + i;
-		memset(accountBuf, 0, width * height);
+		CellgenClearAccount(occ);
 
 		for (int j = 0; j < nObj; j++) {
 			if (j == i) continue;
 			OBJ_BOUNDS *obj2 = obj + j;
 
-			CellgenAccountRegion(accountBuf, width, height, obj2);
+			CellgenAccountRegion(occ, obj2);
 		}
 
 		//is OBJ useful?
-		int nTrans = CellgenCountTransparent(px, accountBuf, width, height, obj1);
+		int nTrans = CellgenCountTransparent(occ, obj1);
 		if (nTrans == obj1->width * obj1->height) {
 			//not useful
 			memmove(obj1, obj1 + 1, (nObj - i - 1) * sizeof(OBJ_BOUNDS));
@@ -459,7 +544,7 @@ static int CellgenTryRemoveOverlapping(COLOR32 *px, unsigned char *accountBuf, i
 }
 
 
-static int CellgenTryAggressiveMerge(COLOR32 *px, unsigned char *accountBuf, int width, int height, OBJ_BOUNDS *obj1, OBJ_BOUNDS *obj2) {
+static int CellgenTryAggressiveMerge(CellgenOccupancy *occ, OBJ_BOUNDS *obj1, OBJ_BOUNDS *obj2) {
 	int w = obj1->width, h = obj1->height;
 	int x1 = obj1->x, y1 = obj1->y, x2 = obj2->x, y2 = obj2->y;
 	if (obj2->width != w || obj2->height != h) return 0; //cannot merge
@@ -467,8 +552,8 @@ static int CellgenTryAggressiveMerge(COLOR32 *px, unsigned char *accountBuf, int
 	//get bounding box of both objects
 	int xMin1, yMin1, xMax1, yMax1;
 	int xMin2, yMin2, xMax2, yMax2;
-	CellgenGetXYBounds(px, accountBuf, width, height, x1, x1 + w, y1, y1 + h, &xMin1, &xMax1, &yMin1, &yMax1);
-	CellgenGetXYBounds(px, accountBuf, width, height, x2, x2 + w, y2, y2 + h, &xMin2, &xMax2, &yMin2, &yMax2);
+	CellgenGetXYBounds(occ, x1, x1 + w, y1, y1 + h, &xMin1, &xMax1, &yMin1, &yMax1);
+	CellgenGetXYBounds(occ, x2, x2 + w, y2, y2 + h, &xMin2, &xMax2, &yMin2, &yMax2);
 
 	//get total bounding box
 	int xMin = min(xMin1, xMin2);
@@ -513,8 +598,8 @@ static int CellgenTryAggressiveMerge(COLOR32 *px, unsigned char *accountBuf, int
 	return 0;
 }
 
-static int CellgenCoalesceAggressively(COLOR32 *px, unsigned char *accountBuf, int width, int height, OBJ_BOUNDS *obj, int nObj) {
-	memset(accountBuf, 0, width * height);
+static int CellgenCoalesceAggressively(CellgenOccupancy *occ, OBJ_BOUNDS *obj, int nObj) {
+	CellgenClearAccount(occ);
 
 	//some cells may not be directly adjacent but still make for viable merges. 
 	//the goal here is to coalesce those that would be candidates for this kind
@@ -536,14 +621,14 @@ static int CellgenCoalesceAggressively(COLOR32 *px, unsigned char *accountBuf, i
 			if (w1 == 64 && h1 == 64) continue;
 
 			//set account buffer to every OBJ excluding these two
-			memset(accountBuf, 0, width * height);
+			CellgenClearAccount(occ);
 			for (int k = 0; k < nObj; k++) {
 				if (k == i || k == j) continue;
-				CellgenAccountRegion(accountBuf, width, height, obj + k);
+				CellgenAccountRegion(occ, obj + k);
 			}
 
 			//can these merge?
-			int merged = CellgenTryAggressiveMerge(px, accountBuf, width, height, obj1, obj2);
+			int merged = CellgenTryAggressiveMerge(occ, obj1, obj2);
 
 			//if merged...
 			if (merged) {
@@ -560,8 +645,8 @@ static int CellgenCoalesceAggressively(COLOR32 *px, unsigned char *accountBuf, i
 	return nObj;
 }
 
-static int CellgenCondenseObj(COLOR32 *px, unsigned char *accountBuf, int width, int height, int cx, int cy, OBJ_BOUNDS *obj, int nObj) {
-	memset(accountBuf, 0, width * height);
+static int CellgenCondenseObj(CellgenOccupancy *occ, int cx, int cy, OBJ_BOUNDS *obj, int nObj) {
+	CellgenClearAccount(occ);
 
 	//push towards center
 	for (int i = 0; i < nObj; i++) {
@@ -574,25 +659,25 @@ static int CellgenCondenseObj(COLOR32 *px, unsigned char *accountBuf, int width,
 		int flag = 0;
 		if (x > cx) flag |= SHIFT_FLAG_RIGHT;  //right edge
 		if (y > cy) flag |= SHIFT_FLAG_BOTTOM; //bottom edge
-		CellgenShiftObj(px, accountBuf, width, height, o, 1, flag | SHIFT_FLAG_NOREMOVE);
-		CellgenAccountRegion(accountBuf, width, height, o);
+		CellgenShiftObj(occ, o, 1, flag | SHIFT_FLAG_NOREMOVE);
+		CellgenAccountRegion(occ, o);
 	}
 
 	return nObj;
 }
 
-static int CellgenRemoveHalfRedundant(COLOR32 *px, unsigned char *accountBuf, int width, int height, OBJ_BOUNDS *obj, int nObj) {
+static int CellgenRemoveHalfRedundant(CellgenOccupancy *occ, OBJ_BOUNDS *obj, int nObj) {
 	//for each, add all others to account buffer and remove half
 	for (int i = 0; i < nObj; i++) {
-		memset(accountBuf, 0, width * height);
+		CellgenClearAccount(occ);
 
 		for (int j = 0; j < nObj; j++) {
 			if (j == i) continue;
-			CellgenAccountRegion(accountBuf, width, height, obj + j);
+			CellgenAccountRegion(occ, obj + j);
 		}
 
 		//try make split
-		int n = CellgenTryIterateSplit(px, accountBuf, width, height, 100, obj + i, 1, 1);
+		int n = CellgenTryIterateSplit(occ, 100, obj + i, 1, 1);
 		if (n == 0) {
 			//object was removed
 			memmove(obj + i, obj + i + 1, (nObj - i - 1) * sizeof(OBJ_BOUNDS));
@@ -623,9 +708,17 @@ static int CellgenPositionComparator(const void *v1, const void *v2) {
 }
 
 OBJ_BOUNDS *CellgenMakeCell(COLOR32 *px, int width, int height, int aggressiveness, int full, int affine, int *pnObj) {
+	//create the occupancy of the image. It keeps track of which opaque pixels of
+	//the image have been accounted for in some OBJ. This will be useful for
+	//potentially overlapping OBJ, so we know which pixels overlap and don't need
+	//to worry about (so we may potentially move another OBJ over).
+	CellgenOccupancy occupancy;
+	CellgenOccupancy *occ = &occupancy;
+	CellgenOccupancyInit(occ, px, width, height);
+
 	//get image bounds
 	int xMin, xMax, yMin, yMax;
-	CellgenGetXYBounds(px, NULL, width, height, 0, width, 0, height, &xMin, &xMax, &yMin, &yMax);
+	CellgenGetXYBounds(occ, 0, width, 0, height, &xMin, &xMax, &yMin, &yMax);
 
 	//if full image rectangle requested
 	if (full) {
@@ -645,6 +738,7 @@ OBJ_BOUNDS *CellgenMakeCell(COLOR32 *px, int width, int height, int aggressivene
 
 	//trivial case: (0, 0) size
 	if (boundingWidth == 0 && boundingHeight == 0) {
+		CellgenOccupancyFree(occ);
 		*pnObj = 0;
 		return NULL;
 	}
@@ -657,6 +751,7 @@ OBJ_BOUNDS *CellgenMakeCell(COLOR32 *px, int width, int height, int aggressivene
 		obj->width = 8;
 		obj->height = 8;
 
+		CellgenOccupancyFree(occ);
 		*pnObj = 1;
 		return obj;
 	}
@@ -700,7 +795,7 @@ OBJ_BOUNDS *CellgenMakeCell(COLOR32 *px, int width, int height, int aggressivene
 
 			//check bounding region
 			int bxMin, bxMax, byMin, byMax;
-			CellgenGetXYBounds(px, NULL, width, height, bounds->x, bounds->x + bounds->width, bounds->y, bounds->y + bounds->height,
+			CellgenGetXYBounds(occ, bounds->x, bounds->x + bounds->width, bounds->y, bounds->y + bounds->height,
 				&bxMin, &bxMax, &byMin, &byMax);
 
 			if (bxMin == bxMax && byMin == byMax) {
@@ -716,38 +811,31 @@ OBJ_BOUNDS *CellgenMakeCell(COLOR32 *px, int width, int height, int aggressivene
 	//covering some amount of pixels. Now, adjust the OBJ positions so that their
 	//pixels are towards the top and left edge.
 	
-	//create a "pixels accounted" buffer, 1 byte per pixel of image. It will keep
-	//track of which opaque pixels of image have been accounted for in some OBJ. 
-	//this will be useful for potentially overlapping OBJ, so we know which pixels
-	//overlap and don't need to worry about (so we may potentially move another OBJ
-	//over).
-	unsigned char *accountBuf = (unsigned char *) calloc(width * height, sizeof(unsigned char));
-	
 	//run one shift round
 	if (aggressiveness > 0)
-		nObj = CellgenIterateAllShifts(px, accountBuf, width, height, obj, nObj);
+		nObj = CellgenIterateAllShifts(occ, obj, nObj);
 
 	//run 6 rounds (maximum possible times an OBJ can be divided)
 	if (aggressiveness > 0) {
 		for (int i = 0; i < CELLGEN_MAX_DIV; i++) {
 			//next, begin the subdivision step.
-			memset(accountBuf, 0, width * height);
-			nObj = CellgenTryIterateSplit(px, accountBuf, width, height, aggressiveness, obj, nObj, CELLGEN_MAX_DIV);
+			CellgenClearAccount(occ);
+			nObj = CellgenTryIterateSplit(occ, aggressiveness, obj, nObj, CELLGEN_MAX_DIV);
 			nObj = CellgenTryCoalesce(obj, nObj);
 
 			//iterate OBJ shift again
 			if (aggressiveness > 0)
-				nObj = CellgenIterateAllShifts(px, accountBuf, width, height, obj, nObj);
+				nObj = CellgenIterateAllShifts(occ, obj, nObj);
 
 			//remove any overlapped
-			nObj = CellgenTryRemoveOverlapping(px, accountBuf, width, height, obj, nObj);
+			nObj = CellgenTryRemoveOverlapping(occ, obj, nObj);
 		}
 	}
 
 	//try to aid in coalescing: push objects towards the center and remove overlapping
 	if (aggressiveness > 0) {
-		CellgenCondenseObj(px, accountBuf, width, height, (xMin + xMax) / 2, (yMin + yMax) / 2, obj, nObj);
-		nObj = CellgenTryRemoveOverlapping(px, accountBuf, width, height, obj, nObj);
+		CellgenCondenseObj(occ, (xMin + xMax) / 2, (yMin + yMax) / 2, obj, nObj);
+		nObj = CellgenTryRemoveOverlapping(occ, obj, nObj);
 
 		//reverse OBJ array and try splitting one last time
 		for (int i = 0; i < nObj / 2; i++) {
@@ -757,15 +845,15 @@ OBJ_BOUNDS *CellgenMakeCell(COLOR32 *px, int width, int height, int aggressivene
 			memcpy(obj + nObj - i - 1, &aux, sizeof(aux));
 		}
 
-		memset(accountBuf, 0, width * height);
-		nObj = CellgenTryIterateSplit(px, accountBuf, width, height, aggressiveness, obj, nObj, CELLGEN_MAX_DIV);
-		nObj = CellgenTryRemoveOverlapping(px, accountBuf, width, height, obj, nObj);
+		CellgenClearAccount(occ);
+		nObj = CellgenTryIterateSplit(occ, aggressiveness, obj, nObj, CELLGEN_MAX_DIV);
+		nObj = CellgenTryRemoveOverlapping(occ, obj, nObj);
 	}
 
 	//try aggressive coalesce
 	if (aggressiveness > 0) {
 		for (int i = 0; i < CELLGEN_MAX_DIV; i++) {
-			nObj = CellgenCoalesceAggressively(px, accountBuf, width, height, obj, nObj);
+			nObj = CellgenCoalesceAggressively(occ, obj, nObj);
 		}
 	}
 
@@ -775,11 +863,11 @@ OBJ_BOUNDS *CellgenMakeCell(COLOR32 *px, int width, int height, int aggressivene
 
 		//with new OBJ division, ensure none are redundant
 		if (aggressiveness > 0) {
-			nObj = CellgenIterateAllShifts(px, accountBuf, width, height, obj, nObj);
+			nObj = CellgenIterateAllShifts(occ, obj, nObj);
 		}
 
 		//shift in
-		nObj = CellgenCondenseObj(px, accountBuf, width, height, (xMin + xMax) / 2, (yMin + yMax) / 2, obj, nObj);
+		nObj = CellgenCondenseObj(occ, (xMin + xMax) / 2, (yMin + yMax) / 2, obj, nObj);
 	}
 
 	//order from big->small
@@ -787,15 +875,15 @@ OBJ_BOUNDS *CellgenMakeCell(COLOR32 *px, int width, int height, int aggressivene
 
 	//remove objects that are over half overlapped by another, starting from big
 	if (aggressiveness > 0) {
-		nObj = CellgenTryRemoveOverlapping(px, accountBuf, width, height, obj, nObj);
-		if (!affine) nObj = CellgenRemoveHalfRedundant(px, accountBuf, width, height, obj, nObj);
+		nObj = CellgenTryRemoveOverlapping(occ, obj, nObj);
+		if (!affine) nObj = CellgenRemoveHalfRedundant(occ, obj, nObj);
 	}
 
 	//sort OBJ by position
 	qsort(obj, nObj, sizeof(OBJ_BOUNDS), CellgenPositionComparator);
 
 	//resize buffer and return
-	free(accountBuf);
+	CellgenOccupancyFree(occ);
 	obj = realloc(obj, nObj * sizeof(OBJ_BOUNDS));
 	*pnObj = nObj;
 	return obj;
@@ -829,13 +917,46 @@ OBJ_BOUNDS *CellgenEnsureRatio(OBJ_BOUNDS *obj, int nObj, int maxRatio, int *pnO
 	return obj;
 }
 
+void CellgenGetObjShape(int width, int height, int *pShape, int *pSize) {
+	int shape = 0, size = 0;
+	if (width == height) {
+		shape = 0; //square
+
+		if (width == 8) size = 0; //8
+		else if (width == 16) size = 1; //16
+		else if (width == 32) size = 2; //32
+		else if (width == 64) size = 3; //64
+	} else if (width > height) {
+		shape = 1; //wide
+
+		if (width == 16) size = 0; //16x8
+		else if (height == 8) size = 1; //32x8
+		else if (width == 32) size = 2; //32x16
+		else if (width == 64) size = 3; //64x32
+	} else if (width < height) {
+		shape = 2; //tall
+
+		if (height == 16) size = 0; //8x16
+		else if (width == 8) size = 1; //8x32
+		else if (height == 32) size = 2; //16x32
+		else if (height == 64) size = 3; //32x64
+	}
+
+	*pShape = shape;
+	*pSize = size;
+}
+
 void CellgenGetBounds(COLOR32 *px, int width, int height, int *pxMin, int *pxMax, int *pyMin, int *pyMax) {
 	//get bounding box
-	CellgenGetXYBounds(px, NULL, width, height, 0, width, 0, height, pxMin, pxMax, pyMin, pyMax);
+	CellgenOccupancy occ;
+	CellgenOccupancyInit(&occ, px, width, height);
+	CellgenGetXYBounds(&occ, 0, width, 0, height, pxMin, pxMax, pyMin, pyMax);
+	CellgenOccupancyFree(&occ);
 }
 
 OBJ_IMAGE_SLICE *CellgenSliceImage(COLOR32 *px, int width, int height, OBJ_BOUNDS *bounds, int nObj, int cut) {
-	unsigned char *accountBuf = (unsigned char *) calloc(width * height, 1);
+	CellgenOccupancy occ;
+	CellgenOccupancyInit(&occ, px, width, height);
 	OBJ_IMAGE_SLICE *slices = (OBJ_IMAGE_SLICE *) calloc(nObj, sizeof(OBJ_IMAGE_SLICE));
 	
 	//go in order
@@ -851,7 +972,7 @@ OBJ_IMAGE_SLICE *CellgenSliceImage(COLOR32 *px, int width, int height, OBJ_BOUND
 
 				int objX = x - obj->x, objY = y - obj->y;
 				COLOR32 col = px[x + y * width];
-				int ignore = accountBuf[x + y * width];
+				int ignore = (occ.accounted[y * occ.stride + x / 64] >> (x % 64)) & 1;
 				if (!ignore) {
 					slice->px[objX + objY * obj->width] = col;
 				}
@@ -859,9 +980,9 @@ OBJ_IMAGE_SLICE *CellgenSliceImage(COLOR32 *px, int width, int height, OBJ_BOUND
 		}
 
 		//account it
-		if (cut) CellgenAccountRegion(accountBuf, width, height, obj);
+		if (cut) CellgenAccountRegion(&occ, obj);
 	}
 
-	free(accountBuf);
+	CellgenOccupancyFree(&occ);
 	return slices;
 }
@@ -80,6 +80,22 @@ OBJ_BOUNDS *CellgenEnsureRatio(OBJ_BOUNDS *obj, int nObj, int maxRatio, int *pnO
 \******************************************************************************/
 OBJ_IMAGE_SLICE *CellgenSliceImage(COLOR32 *px, int width, int height, OBJ_BOUNDS *bounds, int nObj, int cut);
 
+/******************************************************************************\
+*
+* Gets the OBJ shape and size attributes of a valid hardware OBJ size.
+*
+* Parameters:
+*   width                   the OBJ width
+*   height                  the OBJ height
+*   pShape                  pointer to the output shape attribute
+*   pSize                   pointer to the output size attribute
+*
+* Returns:
+*	Nothing
+*
+\******************************************************************************/
+void CellgenGetObjShape(int width, int height, int *pShape, int *pSize);
+
 /******************************************************************************\
 *
 * Gets the bounding box of the image's opaque pixels.
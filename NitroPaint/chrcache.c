@@ -0,0 +1,168 @@
+#include "chrcache.h"
+#include "nclrviewer.h"
+
+#define CHRCACHE_OPAQUE       0xFF000000
+
+void ChrCacheInit(ChrCache *cache) {
+	memset(cache, 0, sizeof(ChrCache));
+	cache->generation = 1;
+	cache->hlStart = -1;
+	cache->hlEnd = -1;
+	for (int i = 0; i < 64; i++) cache->blank[i] = CHRCACHE_OPAQUE;
+}
+
+void ChrCacheFree(ChrCache *cache) {
+	if (cache->tiles != NULL) free(cache->tiles);
+	if (cache->keys != NULL) free(cache->keys);
+	if (cache->generations != NULL) free(cache->generations);
+	ChrCacheInit(cache);
+}
+
+static void ChrCacheInvalidate(ChrCache *cache) {
+	cache->generation++;
+	if (cache->generation == 0) {
+		//generation wrapped around, entries from the first generations could appear valid again
+		if (cache->generations != NULL) memset(cache->generations, 0, CHRCACHE_SIZE * sizeof(unsigned int));
+		cache->generation = 1;
+	}
+}
+
+void ChrCacheSetSource(ChrCache *cache, const NCGR *ncgr, const NCLR *nclr, int transparent, int hlStart, int hlEnd, int hl2d) {
+	unsigned int ncgrGeneration = ncgr == NULL ? 0 : ncgr->header.generation;
+	unsigned int nclrGeneration = nclr == NULL ? 0 : nclr->header.generation;
+	const COLOR *colors = nclr == NULL ? NULL : nclr->colors;
+	int nColors = nclr == NULL ? 0 : nclr->nColors;
+	int nBits = ncgr == NULL ? 0 : ncgr->nBits;
+	if (hlStart == -1 || hlEnd == -1) hlStart = hlEnd = -1;
+
+	if (cache->ncgr == ncgr && cache->nclr == nclr && cache->ncgrGeneration == ncgrGeneration && cache->nclrGeneration == nclrGeneration
+		&& cache->colors == colors && cache->nColors == nColors && cache->nBits == nBits && cache->transparent == transparent
+		&& cache->hlStart == hlStart && cache->hlEnd == hlEnd && cache->hl2d == hl2d) return;
+
+	cache->ncgr = ncgr;
+	cache->nclr = nclr;
+	cache->ncgrGeneration = ncgrGeneration;
+	cache->nclrGeneration = nclrGeneration;
+	cache->colors = colors;
+	cache->nColors = nColors;
+	cache->nBits = nBits;
+	cache->transparent = transparent;
+	cache->hlStart = hlStart;
+	cache->hlEnd = hlEnd;
+	cache->hl2d = hl2d;
+
+	//out of range characters have no color, so they show as transparent or black
+	for (int i = 0; i < 64; i++) cache->blank[i] = transparent ? 0 : CHRCACHE_OPAQUE;
+	ChrCacheInvalidate(cache);
+}
+
+static void ChrCacheDecodeTile(ChrCache *cache, COLOR32 *out, const unsigned char *chr, int palno, int flip) {
+	int palBase = palno << cache->nBits;
+
+	for (int i = 0; i < 64; i++) {
+		int srcX = i & 7, srcY = i >> 3;
+		if (flip & TILE_FLIPX) srcX ^= 7;
+		if (flip & TILE_FLIPY) srcY ^= 7;
+
+		int rawIdx = chr[srcX + srcY * 8];
+		int idx = rawIdx + palBase;
+
+		//color out of palette bounds: fill with black
+		COLOR32 col = 0;
+		if (idx < cache->nColors) col = ColorConvertFromDS(cache->colors[idx]) & 0xFFFFFF;
+
+		//color 0 is rendered transparent
+		int opaque = !(cache->transparent && rawIdx == 0);
+
+		//process verify color indication. The transparency checker is always light.
+		if (cache->hlStart != -1 && PalViewerIndexInRange(idx, cache->hlStart, cache->hlEnd, cache->hl2d)) {
+			int lightness = (col & 0xFF) + ((col >> 8) & 0xFF) + ((col >> 16) & 0xFF);
+			if (!opaque) lightness = 765;
+
+			col = lightness < 383 ? 0xFFFFFF : 0x000000;
+			opaque = 1;
+		}
+
+		out[i] = REVERSE(col) | (opaque ? CHRCACHE_OPAQUE : 0);
+	}
+}
+
+const COLOR32 *ChrCacheGetTile(ChrCache *cache, int chrno, int palno, int flip) {
+	if (cache->ncgr == NULL || chrno < 0 || chrno >= cache->ncgr->nTiles) return cache->blank;
+
+	if (cache->tiles == NULL) {
+		cache->tiles = (COLOR32 *) malloc(CHRCACHE_SIZE * 64 * sizeof(COLOR32));
+		cache->keys = (uint32_t *) calloc(CHRCACHE_SIZE, sizeof(uint32_t));
+		cache->generations = (unsigned int *) calloc(CHRCACHE_SIZE, sizeof(unsigned int));
+	}
+
+	//direct mapped by hash of key
+	uint32_t key = (((uint32_t) chrno) << 6) | ((palno & 0xF) << 2) | (flip & 3);
+	uint32_t slot = (key * 0x9E3779B1u) >> (32 - CHRCACHE_SIZE_LOG2);
+
+	COLOR32 *tile = cache->tiles + slot * 64;
+	if (cache->generations[slot] != cache->generation || cache->keys[slot] != key) {
+		ChrCacheDecodeTile(cache, tile, NCGR_CHAR(cache->ncgr, chrno), palno, flip);
+		cache->keys[slot] = key;
+		cache->generations[slot] = cache->generation;
+	}
+	return tile;
+}
+
+void ChrCacheRender(FrameBuffer *fb, int scrollX, int scrollY, int renderWidth, int renderHeight, int scale, ChrCacheTileCallback callback, void *param) {
+	if (renderWidth <= 0 || renderHeight <= 0) return;
+
+	const COLOR32 checker[] = { 0xFFFFFF, 0xC0C0C0 };
+
+	//range of tiles covered horizontally
+	int srcX0 = scrollX / scale;
+	int tileX0 = srcX0 / 8;
+	int tileX1 = ((scrollX + renderWidth - 1) / scale) / 8;
+	int stripWidth = (tileX1 - tileX0 + 1) * 8;
+
+	//a row of tiles is copied out of the cache, since fetching a tile may evict another
+	COLOR32 *strip = (COLOR32 *) calloc(stripWidth * 8, sizeof(COLOR32));
+
+	int lastTileY = -1, lastSrcY = -1;
+	for (int y = 0; y < renderHeight; y++) {
+		COLOR32 *dest = fb->px + y * fb->width;
+		int srcY = (y + scrollY) / scale;
+
+		//rows from the same source row are identical within a checker band
+		if (srcY == lastSrcY && ((y ^ (y - 1)) & 4) == 0) {
+			memcpy(dest, dest - fb->width, renderWidth * sizeof(COLOR32));
+			continue;
+		}
+		lastSrcY = srcY;
+
+		int tileY = srcY / 8;
+		if (tileY != lastTileY) {
+			for (int i = 0; i < stripWidth / 8; i++) {
+				const COLOR32 *tile = callback(param, tileX0 + i, tileY);
+				for (int j = 0; j < 8; j++) {
+					memcpy(strip + j * stripWidth + i * 8, tile + j * 8, 8 * sizeof(COLOR32));
+				}
+			}
+			lastTileY = tileY;
+		}
+
+		//emit one span of up to scale pixels per source pixel
+		const COLOR32 *src = strip + (srcY % 8) * stripWidth + (srcX0 - tileX0 * 8);
+		int span = scale - scrollX % scale;
+		int x = 0;
+		while (x < renderWidth) {
+			COLOR32 c = *(src++);
+			int end = x + span;
+			if (end > renderWidth) end = renderWidth;
+
+			if (c >> 24) {
+				for (; x < end; x++) dest[x] = c;
+			} else {
+				for (; x < end; x++) dest[x] = checker[((x ^ y) >> 2) & 1];
+			}
+			span = scale;
+		}
+	}
+
+	free(strip);
+}
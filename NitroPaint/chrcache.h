@@ -0,0 +1,69 @@
+#pragma once
+#include <Windows.h>
+
+#include "color.h"
+#include "ncgr.h"
+#include "nclr.h"
+#include "nscr.h"
+#include "framebuffer.h"
+
+#define CHRCACHE_SIZE_LOG2         13                       // log2 of number of cache entries
+#define CHRCACHE_SIZE              (1<<CHRCACHE_SIZE_LOG2)  // number of cache entries
+
+//
+// Cache of decoded 8x8 character tiles, keyed by character, palette and flip.
+// Tiles are stored in framebuffer pixel order. Pixels with an alpha of 0 are
+// rendered with the transparency checkerboard.
+//
+// Character and palette data may be edited from any editor, so the cache is
+// keyed on the edit generations of the graphics and palette. A change to
+// either, or to how tiles are decoded, advances the cache generation,
+// discarding every entry decoded in an earlier generation.
+//
+typedef struct ChrCache_ {
+	COLOR32 *tiles;                    // decoded tile pixels, 64 per entry
+	uint32_t *keys;                    // key of the tile held by each entry
+	unsigned int *generations;         // generation each entry was decoded in
+	unsigned int generation;           // current generation
+	COLOR32 blank[64];                 // tile used for out of range characters
+
+	//state the decoded tiles depend on
+	const NCGR *ncgr;
+	const NCLR *nclr;
+	unsigned int ncgrGeneration;
+	unsigned int nclrGeneration;
+	const COLOR *colors;
+	int nColors;
+	int nBits;
+	int transparent;
+	int hlStart;
+	int hlEnd;
+	int hl2d;
+} ChrCache;
+
+//
+// Callback to get the decoded tile at a tile position of the rendered image.
+//
+typedef const COLOR32 *(*ChrCacheTileCallback) (void *param, int tileX, int tileY);
+
+void ChrCacheInit(ChrCache *cache);
+
+void ChrCacheFree(ChrCache *cache);
+
+//
+// Set the data tiles are decoded from. Call before each render. ncgr and nclr
+// may be NULL. Verify highlighting is off when hlStart or hlEnd is -1.
+//
+void ChrCacheSetSource(ChrCache *cache, const NCGR *ncgr, const NCLR *nclr, int transparent, int hlStart, int hlEnd, int hl2d);
+
+//
+// Get a decoded tile. Characters out of range of the graphics produce a blank
+// tile.
+//
+const COLOR32 *ChrCacheGetTile(ChrCache *cache, int chrno, int palno, int flip);
+
+//
+// Render a scaled region of tiles to a framebuffer. Tiles are fetched once per
+// row of tiles using the callback.
+//
+void ChrCacheRender(FrameBuffer *fb, int scrollX, int scrollY, int renderWidth, int renderHeight, int scale, ChrCacheTileCallback callback, void *param);
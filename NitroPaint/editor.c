@@ -6,11 +6,87 @@
 #include "editor.h"
 #include "combo2d.h"
 
+static LRESULT CALLBACK EditorWndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
+
 static BOOL CALLBACK EditorSetThemeProc(HWND hWnd, LPARAM lParam) {
 	SetWindowTheme(hWnd, L"DarkMode_Explorer", NULL);
 	return TRUE;
 }
 
+// ----- undo
+
+static UNDO *EditorGetUndo(HWND hWnd) {
+	EDITOR_CLASS *cls = (EDITOR_CLASS *) GetClassLongPtr(hWnd, EDITOR_CD_CLASSINFO);
+	if (cls == NULL || cls->saveState == NULL || cls->restoreState == NULL) return NULL;
+
+	//created on first use
+	UNDO *undo = (UNDO *) GetWindowLongPtr(hWnd, EDITOR_WD_UNDO);
+	if (undo == NULL) {
+		undo = (UNDO *) calloc(1, sizeof(UNDO));
+		UndoInit(undo, UNDO_DEFAULT_MAX_ENTRIES, UNDO_DEFAULT_MEMORY_LIMIT);
+		SetWindowLongPtr(hWnd, EDITOR_WD_UNDO, (LONG_PTR) undo);
+	}
+	return undo;
+}
+
+static void EditorFreeUndo(HWND hWnd) {
+	UNDO *undo = (UNDO *) GetWindowLongPtr(hWnd, EDITOR_WD_UNDO);
+	if (undo == NULL) return;
+
+	UndoFree(undo);
+	free(undo);
+	SetWindowLongPtr(hWnd, EDITOR_WD_UNDO, 0);
+}
+
+void EditorCheckpoint(HWND hWnd, unsigned int group) {
+	//nothing to record before the editor has its object
+	if (EditorGetObject(hWnd) == NULL) return;
+
+	UNDO *undo = EditorGetUndo(hWnd);
+	if (undo == NULL) return;
+
+	EDITOR_CLASS *cls = (EDITOR_CLASS *) GetClassLongPtr(hWnd, EDITOR_CD_CLASSINFO);
+	BSTREAM stream;
+	bstreamCreate(&stream, NULL, 0);
+	cls->saveState(hWnd, &stream);
+	UndoCheckpoint(undo, stream.buffer, stream.size, group);
+	bstreamFree(&stream);
+}
+
+static BOOL EditorIsEditor(HWND hWnd) {
+	return GetClassLongPtr(hWnd, GCLP_WNDPROC) == (LONG_PTR) EditorWndProc;
+}
+
+void EditorCheckpointInput(HWND hWndMain, HWND hWndInput, unsigned int group) {
+	//find the editor containing the window that got the input
+	HWND hWnd = hWndInput;
+	while (hWnd != NULL && hWnd != hWndMain && !EditorIsEditor(hWnd)) hWnd = GetParent(hWnd);
+
+	if (hWnd == NULL || hWnd == hWndMain) {
+		//input to the main window, its menus and dialogs goes to the active editor
+		NITROPAINTSTRUCT *nitroPaintStruct = NpGetData(hWndMain);
+		hWnd = (HWND) SendMessage(nitroPaintStruct->hWndMdi, WM_MDIGETACTIVE, 0, 0);
+		if (hWnd == NULL || !EditorIsEditor(hWnd)) return;
+	}
+
+	EditorCheckpoint(hWnd, group);
+}
+
+static void EditorStepUndo(HWND hWnd, BOOL redo) {
+	UNDO *undo = EditorGetUndo(hWnd);
+	if (undo == NULL) return;
+
+	//changes not yet recorded are undone first
+	EditorCheckpoint(hWnd, 0);
+
+	unsigned int size;
+	const unsigned char *state = redo ? UndoStepForward(undo, &size) : UndoStepBack(undo, &size);
+	if (state == NULL) return;
+
+	EDITOR_CLASS *cls = (EDITOR_CLASS *) GetClassLongPtr(hWnd, EDITOR_CD_CLASSINFO);
+	cls->restoreState(hWnd, state, size);
+}
+
 static void EditorHandleMenu(HWND hWnd, WPARAM wParam, LPARAM lParam) {
 	//get editor data
 	EDITOR_DATA *data = (EDITOR_DATA *) EditorGetData(hWnd);
@@ -47,6 +123,12 @@ static void EditorHandleMenu(HWND hWnd, WPARAM wParam, LPARAM lParam) {
 			CheckMenuItem(GetMenu(getMainWindow(hWnd)), checkBox, MF_CHECKED);
 			break;
 		}
+		case ID_EDIT_UNDO:
+			EditorStepUndo(hWnd, FALSE);
+			break;
+		case ID_EDIT_REDO:
+			EditorStepUndo(hWnd, TRUE);
+			break;
 		case ID_EDIT_COMMENT:
 		{
 			HWND hWndMain = getMainWindow(hWnd);
@@ -283,6 +365,7 @@ static LRESULT CALLBACK EditorWndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM
 
 		//WM_DESTROY should free data
 		if (msg == WM_DESTROY) {
+			EditorFreeUndo(hWnd);
 			EDITOR_DATA *data = (EDITOR_DATA *) GetWindowLongPtr(hWnd, EDITOR_WD_DATA);
 			if (data != NULL) {
 				if (ObjIsValid(&data->file)) ObjFree(&data->file);
@@ -362,6 +445,11 @@ void EditorAddFilter(EDITOR_CLASS *cls, int format, LPCWSTR extension, LPCWSTR f
 	cls->filters[format] = filter;
 }
 
+void EditorSetUndoProcs(EDITOR_CLASS *cls, EditorSaveStateProc saveState, EditorRestoreStateProc restoreState) {
+	cls->saveState = saveState;
+	cls->restoreState = restoreState;
+}
+
 static int EditorGetFilterLength(LPCWSTR filter) {
 	const WCHAR *pos = filter;
 	const WCHAR *end = filter;
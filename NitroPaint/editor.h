@@ -3,12 +3,27 @@
 #include "childwindow.h"
 #include "ui.h"
 #include "filecommon.h"
+#include "undo.h"
+
+//
+// Write the undoable state of an editor to a stream. Equal states must produce
+// equal bytes.
+//
+typedef void (*EditorSaveStateProc) (HWND hWnd, BSTREAM *stream);
+
+//
+// Replace the state of an editor with a state written by its save procedure,
+// and update the views showing it.
+//
+typedef void (*EditorRestoreStateProc) (HWND hWnd, const unsigned char *state, unsigned int size);
 
 typedef struct EDITOR_CLASS_ {
 	ATOM aclass;
 	int nFilters;
 	LPCWSTR *filters;
 	LPCWSTR *extensions;
+	EditorSaveStateProc saveState;
+	EditorRestoreStateProc restoreState;
 } EDITOR_CLASS;
 
 // ----- Class data slots
@@ -27,10 +42,11 @@ typedef struct EDITOR_CLASS_ {
 
 // ----- Window data slots
 #define EDITOR_WD_SLOT(n)     ((n)*sizeof(void*))
-#define EDITOR_WD_SIZE        (2*sizeof(void*))
+#define EDITOR_WD_SIZE        (3*sizeof(void*))
 
 #define EDITOR_WD_DATA        EDITOR_WD_SLOT(0)
 #define EDITOR_WD_INITIALIZED EDITOR_WD_SLOT(1)
+#define EDITOR_WD_UNDO        EDITOR_WD_SLOT(2)
 
 // ----- editor features bitmap
 #define EDITOR_FEATURE_ZOOM      (1<<0)
@@ -66,6 +82,27 @@ EDITOR_CLASS *EditorRegister(LPCWSTR lpszClassName, WNDPROC lpfnWndProc, LPCWSTR
 
 void EditorAddFilter(EDITOR_CLASS *cls, int format, LPCWSTR extension, LPCWSTR filter);
 
+//
+// Set the procedures saving and restoring the state of an editor class for
+// undo. The class should be registered with EDITOR_FEATURE_UNDO.
+//
+void EditorSetUndoProcs(EDITOR_CLASS *cls, EditorSaveStateProc saveState, EditorRestoreStateProc restoreState);
+
+//
+// Record the changes made to an editor since its last checkpoint as an undo
+// step. A nonzero group merges the changes into the last step if it was made
+// with the same group.
+//
+void EditorCheckpoint(HWND hWnd, unsigned int group);
+
+//
+// Checkpoint the editor that input was sent to: the editor containing the
+// window, or the active editor for input to the main window and its dialogs.
+// Edits an action makes to other editors' objects are recorded by those
+// editors' next checkpoint.
+//
+void EditorCheckpointInput(HWND hWndMain, HWND hWndInput, unsigned int group);
+
 void EditorSetFile(HWND hWnd, LPCWSTR file);
 
 void *EditorGetData(HWND hWnd);
@@ -124,6 +124,9 @@ LPCWSTR *ObjGetFormatNamesByType(int type) {
 	}
 }
 
+//edit generations are drawn from one counter, so that no two objects share one
+static unsigned int sObjGeneration = 0;
+
 void ObjInit(OBJECT_HEADER *header, int type, int format) {
 	int size = header->size; //restore this
 	memset(header, 0, size);
@@ -134,6 +137,11 @@ void ObjInit(OBJECT_HEADER *header, int type, int format) {
 	header->link.nFrom = 0;
 	header->link.to = NULL;
 	header->link.from = NULL;
+	header->generation = ++sObjGeneration;
+}
+
+void ObjMarkModified(OBJECT_HEADER *header) {
+	header->generation = ++sObjGeneration;
 }
 
 int ObjIsValid(OBJECT_HEADER *obj) {
@@ -494,26 +502,79 @@ void *ObjReadWholeFile(LPCWSTR name, int *size) {
 	return buffer;
 }
 
-int ObjReadFile(LPCWSTR name, OBJECT_HEADER *object, OBJECT_READER reader) {
-	unsigned int size;
-	void *buffer = ObjReadWholeFile(name, &size);
-	if (buffer == NULL) {
+int ObjMapFile(LPCWSTR name, OBJ_FILE_MAPPING *mapping) {
+	memset(mapping, 0, sizeof(OBJ_FILE_MAPPING));
+	mapping->hFile = CreateFile(name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (mapping->hFile == INVALID_HANDLE_VALUE) {
+		mapping->hFile = NULL;
 		return OBJ_STATUS_NO_ACCESS;
 	}
 
-	int status;
-	int compType = CxGetCompressionType(buffer, size);
+	DWORD dwRead, dwSizeLow, dwSizeHigh = 0;
+	if (ObjiPathStartsWith(name, L"\\\\.\\pipe\\")) {
+		//pipe protocol: first 4 bytes file size, followed by file data.
+		ReadFile(mapping->hFile, &dwSizeLow, 4, &dwRead, NULL);
+		mapping->buffer = (unsigned char *) malloc(dwSizeLow);
+		ReadFile(mapping->hFile, mapping->buffer, dwSizeLow, &dwRead, NULL);
+		mapping->size = dwSizeLow;
+		return OBJ_STATUS_SUCCESS;
+	}
+
+	dwSizeLow = GetFileSize(mapping->hFile, &dwSizeHigh);
+	mapping->size = dwSizeLow;
+	if (dwSizeLow == 0 || dwSizeHigh != 0) {
+		//empty files cannot be mapped, and files over 4GB are not supported
+		mapping->buffer = (unsigned char *) calloc(1, 1);
+		mapping->size = 0;
+		return OBJ_STATUS_SUCCESS;
+	}
+
+	//copy-on-write, so that readers modifying their input do not write to the file
+	mapping->hMapping = CreateFileMapping(mapping->hFile, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	if (mapping->hMapping != NULL) {
+		mapping->buffer = (unsigned char *) MapViewOfFile(mapping->hMapping, FILE_MAP_COPY, 0, 0, 0);
+	}
+	if (mapping->buffer == NULL) {
+		//fall back to reading the file
+		if (mapping->hMapping != NULL) CloseHandle(mapping->hMapping);
+		mapping->hMapping = NULL;
+		mapping->buffer = (unsigned char *) malloc(dwSizeLow);
+		ReadFile(mapping->hFile, mapping->buffer, dwSizeLow, &dwRead, NULL);
+	}
+	return OBJ_STATUS_SUCCESS;
+}
+
+void ObjUnmapFile(OBJ_FILE_MAPPING *mapping) {
+	if (mapping->hMapping != NULL) {
+		UnmapViewOfFile(mapping->buffer);
+		CloseHandle(mapping->hMapping);
+	} else if (mapping->buffer != NULL) {
+		free(mapping->buffer);
+	}
+	if (mapping->hFile != NULL) CloseHandle(mapping->hFile);
+	memset(mapping, 0, sizeof(OBJ_FILE_MAPPING));
+}
+
+int ObjReadFile(LPCWSTR name, OBJECT_HEADER *object, OBJECT_READER reader) {
+	//readers parse the mapped file in place, only compressed files are copied
+	OBJ_FILE_MAPPING mapping;
+	int status = ObjMapFile(name, &mapping);
+	if (!OBJ_SUCCEEDED(status)) {
+		return status;
+	}
+
+	int compType = CxGetCompressionType(mapping.buffer, mapping.size);
 	if (compType == COMPRESSION_NONE) {
-		status = reader(object, buffer, size);
+		status = reader(object, mapping.buffer, mapping.size);
 	} else {
 		int decompressedSize;
-		void *decompressed = CxDecompress(buffer, size, &decompressedSize);
+		void *decompressed = CxDecompress(mapping.buffer, mapping.size, &decompressedSize);
 		status = reader(object, decompressed, decompressedSize);
 		free(decompressed);
 		object->compression = compType;
 	}
 
-	free(buffer);
+	ObjUnmapFile(&mapping);
 	return status;
 }
 
@@ -29,6 +29,17 @@ extern const wchar_t *gFileTypeNames[];
 
 #define OBJ_SUCCEEDED(s)       ((s)==OBJ_STATUS_SUCCESS)
 
+//
+// A file mapped into memory for reading. Pipes, which cannot be mapped, are
+// read into memory instead.
+//
+typedef struct OBJ_FILE_MAPPING_ {
+	unsigned char *buffer;                      // The file contents
+	unsigned int size;                          // The file size in bytes
+	HANDLE hFile;                               // The open file
+	HANDLE hMapping;                            // The file mapping, NULL if the contents were read into memory
+} OBJ_FILE_MAPPING;
+
 
 typedef int(*OBJECT_READER) (struct OBJECT_HEADER_ *object, char *buffer, int size);
 typedef int(*OBJECT_WRITER) (struct OBJECT_HEADER_ *object, BSTREAM *stream);
@@ -50,6 +61,7 @@ typedef struct OBJECT_HEADER_ {
 	ObjLink link;                               // A structure maintaining file links to this file
 	char *fileLink;                             // The name of the file that this object references
 	char *comment;                              // The stored file comment (if supported)
+	unsigned int generation;                    // The edit generation, unique among all objects and edits
 } OBJECT_HEADER;
 
 extern LPCWSTR g_ObjCompressionNames[];
@@ -84,6 +96,12 @@ void ObjInit(OBJECT_HEADER *header, int type, int format);
 //
 void ObjCompressFile(LPWSTR name, int compression);
 
+//
+// Mark an object as modified by advancing its edit generation. Views keeping
+// data derived from an object compare generations to detect edits.
+//
+void ObjMarkModified(OBJECT_HEADER *header);
+
 //
 // Free the resources held by an open file, after which it can be safely freed
 //
@@ -99,6 +117,19 @@ int ObjIsValid(OBJECT_HEADER *header);
 //
 void *ObjReadWholeFile(LPCWSTR name, int *size);
 
+//
+// Map a file into memory from path without copying it. The contents are
+// copy-on-write, so writes to the buffer do not reach the file. No
+// decompression is performed. Returns OBJ_STATUS_NO_ACCESS if the file cannot
+// be opened.
+//
+int ObjMapFile(LPCWSTR name, OBJ_FILE_MAPPING *mapping);
+
+//
+// Release a file mapped by ObjMapFile.
+//
+void ObjUnmapFile(OBJ_FILE_MAPPING *mapping);
+
 //
 // Reads a file into the specified object with the given reader function.
 //
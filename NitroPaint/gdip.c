@@ -3,6 +3,8 @@
 #include <math.h>
 
 #include "gdip.h"
+#include "filecommon.h"
+#include "parallel.h"
 
 #pragma comment(lib, "windowscodecs.lib")
 
@@ -456,19 +458,13 @@ COLOR32 *ImgReadMemEx(const unsigned char *buffer, unsigned int size, int *pWidt
 
 COLOR32 *ImgReadEx(LPCWSTR lpszFileName, int *pWidth, int *pHeight, unsigned char **indices, COLOR32 **pImagePalette, int *pPaletteSize) {
 	//test for valid file, or TGA file, which WIC does not support.
-	HANDLE hFile = CreateFile(lpszFileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-	if (hFile == INVALID_HANDLE_VALUE) {
+	OBJ_FILE_MAPPING mapping;
+	if (!OBJ_SUCCEEDED(ObjMapFile(lpszFileName, &mapping))) {
 		return NULL;
 	}
 
-	DWORD dwSizeHigh, dwSizeLow, dwRead;
-	dwSizeLow = GetFileSize(hFile, &dwSizeHigh);
-	BYTE *buffer = (BYTE *) malloc(dwSizeLow);
-	ReadFile(hFile, buffer, dwSizeLow, &dwRead, NULL);
-	CloseHandle(hFile);
-
-	COLOR32 *bits = ImgReadMemEx(buffer, dwSizeLow, pWidth, pHeight, indices, pImagePalette, pPaletteSize);
-	free(buffer);
+	COLOR32 *bits = ImgReadMemEx(mapping.buffer, mapping.size, pWidth, pHeight, indices, pImagePalette, pPaletteSize);
+	ObjUnmapFile(&mapping);
 
 	return bits;
 }
@@ -513,36 +509,90 @@ void ImgSwapRedBlue(COLOR32 *px, int width, int height) {
 	}
 }
 
-static int ImgiPixelComparator(const void *p1, const void *p2) {
-	return *(COLOR32 *) p1 - (*(COLOR32 *) p2);
+//
+// Open addressing hash set of 24-bit colors, kept at most half full. Its size
+// follows the number of colors found rather than the 24-bit color space.
+//
+typedef struct ImgiColorSet_ {
+	uint32_t *slots;                   // colors, IMGI_COLORSET_EMPTY for free slots
+	int bits;                          // log2 of the number of slots
+	int count;
+} ImgiColorSet;
+
+#define IMGI_COLORSET_EMPTY      0xFFFFFFFF
+#define IMGI_COLORSET_MIN_BITS   8
+
+static void ImgiColorSetInit(ImgiColorSet *set, int bits) {
+	set->bits = bits;
+	set->count = 0;
+	set->slots = (uint32_t *) malloc(sizeof(uint32_t) << bits);
+	memset(set->slots, 0xFF, sizeof(uint32_t) << bits);
 }
 
-int ImgCountColors(COLOR32 *px, int nPx) {
-	//sort the colors by raw RGB value. This way, same colors are grouped.
-	COLOR32 *copy = (COLOR32 *) malloc(nPx * 4);
-	memcpy(copy, px, nPx * 4);
-	qsort(copy, nPx, 4, ImgiPixelComparator);
-	int nColors = 0;
-	int hasTransparent = 0;
+static uint32_t *ImgiColorSetFind(ImgiColorSet *set, uint32_t c) {
+	//slot holding the color, or the free slot it would go in
+	uint32_t mask = (1u << set->bits) - 1;
+	uint32_t i = (c * 0x9E3779B1u) >> (32 - set->bits);
+	while (set->slots[i] != IMGI_COLORSET_EMPTY && set->slots[i] != c) i = (i + 1) & mask;
+	return set->slots + i;
+}
+
+static int ImgiColorSetAdd(ImgiColorSet *set, uint32_t c) {
+	uint32_t *slot = ImgiColorSetFind(set, c);
+	if (*slot == c) return 0;
+	*slot = c;
+	set->count++;
+
+	if (set->count * 2 > (1 << set->bits)) {
+		//grow, reinserting every color
+		ImgiColorSet grown;
+		ImgiColorSetInit(&grown, set->bits + 1);
+		for (int i = 0; i < (1 << set->bits); i++) {
+			if (set->slots[i] != IMGI_COLORSET_EMPTY) *ImgiColorSetFind(&grown, set->slots[i]) = set->slots[i];
+		}
+		grown.count = set->count;
+		free(set->slots);
+		*set = grown;
+	}
+	return 1;
+}
+
+int ImgCountOpaqueColors(const COLOR32 *px, int nPx, int alphaThreshold, int maxColors, COLOR32 *palette, int *pHasTransparent) {
+	ImgiColorSet seen;
+	ImgiColorSetInit(&seen, IMGI_COLORSET_MIN_BITS);
+	int nColors = 0, hasTransparent = 0;
+	COLOR32 last = 0;
+
 	for (int i = 0; i < nPx; i++) {
-		int a = copy[i] >> 24;
-		if (!a) hasTransparent = 1;
-		else {
-			COLOR32 color = copy[i] & 0xFFFFFF;
-			//has this color come before?
-			int repeat = 0;
-			if (i) {
-				COLOR32 comp = copy[i - 1] & 0xFFFFFF;
-				if (comp == color) {
-					repeat = 1;
-				}
-			}
-			if (!repeat) {
-				nColors++;
-			}
+		COLOR32 c = px[i];
+		if (i > 0 && c == last) continue; // runs of one color are common
+		last = c;
+
+		if ((int) (c >> 24) < alphaThreshold) {
+			hasTransparent = 1;
+			continue;
 		}
+
+		c &= 0xFFFFFF;
+		if (!ImgiColorSetAdd(&seen, c)) continue;
+
+		if (nColors == maxColors) {
+			//too many colors, the rest of the image is not checked
+			nColors++;
+			break;
+		}
+		if (palette != NULL) palette[nColors] = c | 0xFF000000;
+		nColors++;
 	}
-	free(copy);
+
+	free(seen.slots);
+	if (pHasTransparent != NULL) *pHasTransparent = hasTransparent;
+	return nColors;
+}
+
+int ImgCountColors(COLOR32 *px, int nPx) {
+	int hasTransparent;
+	int nColors = ImgCountOpaqueColors(px, nPx, 1, nPx, NULL, &hasTransparent);
 	return nColors + hasTransparent;
 }
 
@@ -646,6 +696,122 @@ unsigned char *ImgCreateColorMask(COLOR32 *px, int width, int height, int *pRows
 	return bits;
 }
 
+#define IMG_SCALE_WEIGHT_BITS      16                       // fraction bits of resampling weights
+#define IMG_SCALE_PARALLEL_PIXELS  (512 * 512)              // pixels touched before scaling is split across threads
+
+//
+// Resampling weights along one axis. Each output pixel is the area-weighted
+// average of the source pixels it covers, with weights summing to exactly
+// 1 << IMG_SCALE_WEIGHT_BITS.
+//
+typedef struct ImgiScaleAxis_ {
+	int *first;                        // first source pixel of each output pixel
+	int *nTaps;                        // number of source pixels of each output pixel
+	int *offset;                       // index of each output pixel's first weight
+	uint32_t *weights;
+} ImgiScaleAxis;
+
+typedef struct ImgiScaleContext_ {
+	const COLOR32 *px;
+	int width;
+	int height;
+	COLOR32 *out;
+	int outWidth;
+	ImgiScaleAxis axisX;
+	ImgiScaleAxis axisY;
+	uint32_t *rows;                    // per-thread row of vertically resampled premultiplied RGBA
+} ImgiScaleContext;
+
+static void ImgiScaleAxisInit(ImgiScaleAxis *axis, int size, int outSize) {
+	axis->first = (int *) calloc(outSize, sizeof(int));
+	axis->nTaps = (int *) calloc(outSize, sizeof(int));
+	axis->offset = (int *) calloc(outSize, sizeof(int));
+	axis->weights = (uint32_t *) calloc(size + outSize, sizeof(uint32_t));
+
+	//work in units of 1/(size*outSize) of the source, so coverage is exact
+	int nWeights = 0;
+	for (int i = 0; i < outSize; i++) {
+		long long start = (long long) i * size, end = (long long) (i + 1) * size;
+		int first = (int) (start / outSize);
+		int last = (int) ((end + outSize - 1) / outSize);
+		if (last > size) last = size;
+
+		axis->first[i] = first;
+		axis->nTaps[i] = last - first;
+		axis->offset[i] = nWeights;
+
+		//weigh each source pixel by its coverage, giving any rounding error to the largest weight
+		uint32_t total = 0;
+		int largest = nWeights;
+		for (int j = first; j < last; j++) {
+			long long covStart = (long long) j * outSize, covEnd = (long long) (j + 1) * outSize;
+			if (covStart < start) covStart = start;
+			if (covEnd > end) covEnd = end;
+
+			uint32_t w = (uint32_t) (((covEnd - covStart) << IMG_SCALE_WEIGHT_BITS) + size / 2) / size;
+			axis->weights[nWeights] = w;
+			if (w > axis->weights[largest]) largest = nWeights;
+			total += w;
+			nWeights++;
+		}
+		axis->weights[largest] += (1u << IMG_SCALE_WEIGHT_BITS) - total;
+	}
+}
+
+static void ImgiScaleAxisFree(ImgiScaleAxis *axis) {
+	free(axis->first);
+	free(axis->nTaps);
+	free(axis->offset);
+	free(axis->weights);
+}
+
+static void ImgiScaleRow(void *context, int thread, int y) {
+	ImgiScaleContext *ctx = (ImgiScaleContext *) context;
+	uint32_t *row = ctx->rows + thread * ctx->width * 4;
+	memset(row, 0, ctx->width * 4 * sizeof(uint32_t));
+
+	//resample vertically, premultiplying by alpha. Weights sum to 1 << 16, so each
+	//channel sum stays below 2^16 * 255 * 255 and fits in 32 bits.
+	const uint32_t *wy = ctx->axisY.weights + ctx->axisY.offset[y];
+	for (int j = 0; j < ctx->axisY.nTaps[y]; j++) {
+		const COLOR32 *src = ctx->px + (ctx->axisY.first[y] + j) * ctx->width;
+		uint32_t w = wy[j];
+		for (int x = 0; x < ctx->width; x++) {
+			COLOR32 c = src[x];
+			uint32_t wa = w * (c >> 24);
+			row[x * 4 + 0] += wa * ((c >>  0) & 0xFF);
+			row[x * 4 + 1] += wa * ((c >>  8) & 0xFF);
+			row[x * 4 + 2] += wa * ((c >> 16) & 0xFF);
+			row[x * 4 + 3] += wa;
+		}
+	}
+
+	//resample horizontally and un-premultiply
+	COLOR32 *out = ctx->out + y * ctx->outWidth;
+	for (int x = 0; x < ctx->outWidth; x++) {
+		const uint32_t *wx = ctx->axisX.weights + ctx->axisX.offset[x];
+		const uint32_t *srcRow = row + ctx->axisX.first[x] * 4;
+		uint64_t tr = 0, tg = 0, tb = 0, ta = 0;
+		for (int i = 0; i < ctx->axisX.nTaps[x]; i++) {
+			uint64_t w = wx[i];
+			tr += w * srcRow[i * 4 + 0];
+			tg += w * srcRow[i * 4 + 1];
+			tb += w * srcRow[i * 4 + 2];
+			ta += w * srcRow[i * 4 + 3];
+		}
+
+		if (ta == 0) {
+			out[x] = 0;
+			continue;
+		}
+		COLOR32 r = (COLOR32) ((tr + ta / 2) / ta);
+		COLOR32 g = (COLOR32) ((tg + ta / 2) / ta);
+		COLOR32 b = (COLOR32) ((tb + ta / 2) / ta);
+		COLOR32 a = (COLOR32) ((ta + (1ull << (2 * IMG_SCALE_WEIGHT_BITS - 1))) >> (2 * IMG_SCALE_WEIGHT_BITS));
+		out[x] = r | (g << 8) | (b << 16) | (a << 24);
+	}
+}
+
 COLOR32 *ImgScale(COLOR32 *px, int width, int height, int outWidth, int outHeight) {
 	//alloc out
 	COLOR32 *out = (COLOR32 *) calloc(outWidth * outHeight, sizeof(COLOR32));
@@ -661,72 +827,31 @@ COLOR32 *ImgScale(COLOR32 *px, int width, int height, int outWidth, int outHeigh
 		return out;
 	}
 
-	//scale image
-	for (int y = 0; y < outHeight; y++) {
-		for (int x = 0; x < outWidth; x++) {
-			//determine sample rectangle in source image
-			float sX1 = ((float) (x + 0)) * ((float) width)  / ((float) outWidth);
-			float sY1 = ((float) (y + 0)) * ((float) height) / ((float) outHeight);
-			float sX2 = ((float) (x + 1)) * ((float) width)  / ((float) outWidth);
-			float sY2 = ((float) (y + 1)) * ((float) height) / ((float) outHeight);
-
-			//compute sample
-			double tr = 0.0, tg = 0.0, tb = 0.0, ta = 0.0;
-			double sampleArea = (sX2 - sX1) * (sY2 - sY1);
-
-			//determine the pixel rectangle to sample. Float coordinates are between pixels, and integer
-			//coordinates are in the centers of pixels.
-			int sampleRectX = (int) sX1;
-			int sampleRectY = (int) sY1;
-			int sampleRectW = (int) ceil(sX2) - sampleRectX;
-			int sampleRectH = (int) ceil(sY2) - sampleRectY;
-
-			//compute rectangle trims
-			double trimL = sX1 - (double) (int) sX1;
-			double trimR = ceil(sX2) - sX2;
-			double trimU = sY1 - (double) (int) sY1;
-			double trimD = ceil(sY2) - sY2;
-
-			for (int sy = 0; sy < sampleRectH; sy++) {
-				double rowH = 1.0;
-				if (sy == 0) rowH -= trimU;                 // trim from top
-				if (sy == (sampleRectH - 1)) rowH -= trimD; // trim from bottom
-
-
-				for (int sx = 0; sx < sampleRectW; sx++) {
-					double colW = 1.0;
-					if (sx == 0) colW -= trimL;                 // trim from left
-					if (sx == (sampleRectW - 1)) colW -= trimR; // trim from right
-
-					//sum colors
-					COLOR32 col = px[(sampleRectX + sx) + (sampleRectY + sy) * width];
-					unsigned int colA = (col >> 24);
-					double weight = colW * rowH * colA;
-					tr += ((col >>  0) & 0xFF) * weight;
-					tg += ((col >>  8) & 0xFF) * weight;
-					tb += ((col >> 16) & 0xFF) * weight;
-					ta += weight;
-				}
-			}
-
-			if (ta > 0) {
-				tr /= ta;
-				tg /= ta;
-				tb /= ta;
-				ta /= sampleArea;
-			} else {
-				tr = tg = tb = ta = 0.0;
-			}
-
-			unsigned int sampleR = (unsigned int) (int) (tr + 0.5);
-			unsigned int sampleG = (unsigned int) (int) (tg + 0.5);
-			unsigned int sampleB = (unsigned int) (int) (tb + 0.5);
-			unsigned int sampleA = (unsigned int) (int) (ta + 0.5);
-			COLOR32 sample = sampleR | (sampleG << 8) | (sampleB << 16) | (sampleA << 24);
-			out[x + y * outWidth] = sample;
+	//the filter is separable: each output row is resampled vertically into a row
+	//buffer, which is then resampled horizontally.
+	ImgiScaleContext ctx;
+	ctx.px = px;
+	ctx.width = width;
+	ctx.height = height;
+	ctx.out = out;
+	ctx.outWidth = outWidth;
+	ImgiScaleAxisInit(&ctx.axisX, width, outWidth);
+	ImgiScaleAxisInit(&ctx.axisY, height, outHeight);
+
+	//split large images across threads by output row
+	if (width * height + outWidth * outHeight >= IMG_SCALE_PARALLEL_PIXELS) {
+		ctx.rows = (uint32_t *) calloc(ParGetThreadCount() * width * 4, sizeof(uint32_t));
+		ParRun(outHeight, ImgiScaleRow, &ctx, NULL, 0, 0);
+	} else {
+		ctx.rows = (uint32_t *) calloc(width * 4, sizeof(uint32_t));
+		for (int y = 0; y < outHeight; y++) {
+			ImgiScaleRow(&ctx, 0, y);
 		}
 	}
 
+	free(ctx.rows);
+	ImgiScaleAxisFree(&ctx.axisX);
+	ImgiScaleAxisFree(&ctx.axisY);
 	return out;
 }
 
@@ -58,6 +58,15 @@ void ImgSwapRedBlue(COLOR32 *px, int width, int height);
 //
 int ImgCountColors(COLOR32 *px, int nPx);
 
+//
+// Count the unique colors of the opaque pixels in an image, ignoring their alpha channel. Pixels with an alpha below
+// alphaThreshold are transparent. Counting stops once more than maxColors colors are found, returning maxColors + 1. If palette is
+// not NULL, it receives up to maxColors colors in order of first appearance, so that an image with few enough colors
+// can use them directly as its palette. If pHasTransparent is not NULL, it receives whether a transparent pixel was
+// found before counting stopped.
+//
+int ImgCountOpaqueColors(const COLOR32 *px, int nPx, int alphaThreshold, int maxColors, COLOR32 *palette, int *pHasTransparent);
+
 //
 // Crop an image with a source bounding box.
 //
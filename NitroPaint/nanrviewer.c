@@ -122,7 +122,7 @@ static int getDrawFrameIndex(NANR_SEQUENCE *sequence, int frame) {
 	return drawFrameIndex;
 }
 
-DWORD *nanrDrawFrame(DWORD *frameBuffer, NCLR *nclr, NCGR *ncgr, NCER *ncer, NANR *nanr, int sequenceIndex, int frame, int checker, int ofsX, int ofsY) {
+DWORD *nanrDrawFrame(DWORD *frameBuffer, NCLR *nclr, NCGR *ncgr, NCER *ncer, NANR *nanr, int sequenceIndex, int frame, int checker, int ofsX, int ofsY, CellCache *cellCache) {
 	if (frameBuffer == NULL || ncgr == NULL || ncer == NULL || nanr == NULL) return NULL;
 	NANR_SEQUENCE *sequence = nanr->sequences + sequenceIndex;
 	int mode = sequence->mode;
@@ -140,13 +140,20 @@ DWORD *nanrDrawFrame(DWORD *frameBuffer, NCLR *nclr, NCGR *ncgr, NCER *ncer, NAN
 	FRAME_DATA *frameData = sequence->frames + frameIndex;
 
 	if (checker) {
-		for (int i = 0; i < 256 * 512; i++) {
-			int x = i % 512;
-			int y = i / 512;
-			int p = ((x >> 2) ^ (y >> 2)) & 1;
-			DWORD c = p ? 0xFFFFFF : 0xC0C0C0;
-			frameBuffer[i] = c;
+		//the checkerboard is the same every frame, so build it once
+		static DWORD checkerBuffer[256 * 512];
+		static int checkerInitialized = 0;
+		if (!checkerInitialized) {
+			for (int i = 0; i < 256 * 512; i++) {
+				int x = i % 512;
+				int y = i / 512;
+				int p = ((x >> 2) ^ (y >> 2)) & 1;
+				DWORD c = p ? 0xFFFFFF : 0xC0C0C0;
+				checkerBuffer[i] = c;
+			}
+			checkerInitialized = 1;
 		}
+		memcpy(frameBuffer, checkerBuffer, sizeof(checkerBuffer));
 	}
 
 	CHAR_VRAM_TRANSFER *vramTransfer = NULL;
@@ -170,7 +177,7 @@ DWORD *nanrDrawFrame(DWORD *frameBuffer, NCLR *nclr, NCGR *ncgr, NCER *ncer, NAN
 
 		NCER_CELL *cell = ncer->cells + animData->index;
 		int translateX = 256 - (cell->maxX + cell->minX) / 2, translateY = 128 - (cell->maxY + cell->minY) / 2;
-		CellRenderCell(frameBuffer, cell, ncer->mappingMode, ncgr, nclr, vramTransfer, translateX + ofsX, translateY + ofsY, 1.0f, 0.0f, 0.0f, 1.0f);
+		CellCacheRender(cellCache, frameBuffer, NULL, ncer, animData->index, ncgr, nclr, vramTransfer, translateX + ofsX, translateY + ofsY, 1.0f, 0.0f, 0.0f, 1.0f, 0);
 	} else if (animType == 1) { //SRT
 		ANIM_DATA_SRT *animData = (ANIM_DATA_SRT *) frameData->animationData;
 
@@ -189,13 +196,13 @@ DWORD *nanrDrawFrame(DWORD *frameBuffer, NCLR *nclr, NCGR *ncgr, NCER *ncer, NAN
 
 		NCER_CELL *cell = ncer->cells + animData->index;
 		int translateX = 256 - (cell->maxX + cell->minX) / 2, translateY = 128 - (cell->maxY + cell->minY) / 2;
-		CellRenderCell(frameBuffer, cell, ncer->mappingMode, ncgr, nclr, vramTransfer, translateX + animData->px + ofsX, translateY + animData->py + ofsY, a, b, c, d);
+		CellCacheRender(cellCache, frameBuffer, NULL, ncer, animData->index, ncgr, nclr, vramTransfer, translateX + animData->px + ofsX, translateY + animData->py + ofsY, a, b, c, d, 0);
 	} else if (animType == 2) { //index+translation
 		ANIM_DATA_T *animData = (ANIM_DATA_T *) frameData->animationData;
 
 		NCER_CELL *cell = ncer->cells + animData->index;
 		int translateX = 256 - (cell->maxX + cell->minX) / 2, translateY = 128 - (cell->maxY + cell->minY) / 2;
-		CellRenderCell(frameBuffer, cell, ncer->mappingMode, ncgr, nclr, vramTransfer, translateX + animData->px + ofsX, translateY + animData->py + ofsY, 1.0f, 0.0f, 0.0f, 1.0f);
+		CellCacheRender(cellCache, frameBuffer, NULL, ncer, animData->index, ncgr, nclr, vramTransfer, translateX + animData->px + ofsX, translateY + animData->py + ofsY, 1.0f, 0.0f, 0.0f, 1.0f, 0);
 	}
 
 	return frameBuffer;
@@ -234,7 +241,7 @@ static void AnmViewerPaintFrame(HWND hWnd, HDC hDC) {
 		int sequence = data->sequence;
 
 		if (nanr->sequences[sequence].nFrames > 0) {
-			nanrDrawFrame(data->frameBuffer, nclr, ncgr, ncer, nanr, sequence, frame, 1, 0, 0);
+			nanrDrawFrame(data->frameBuffer, nclr, ncgr, ncer, nanr, sequence, frame, 1, 0, 0, &data->cellCache);
 
 			HBITMAP hBitmap = CreateBitmap(512, 256, 1, 32, data->frameBuffer);
 			HDC hOffDC = CreateCompatibleDC(hDC);
@@ -496,6 +503,7 @@ static void AnmViewerOnCreate(NANRVIEWERDATA *data, HWND hWnd) {
 	data->sequence = 0;
 	data->frameBuffer = (DWORD *) calloc(256 * 512, 4);
 	data->ignoreInputMsg = FALSE;
+	CellCacheInit(&data->cellCache);
 
 	CreateStatic(hWnd, L"Sequence:", 522, 10, 70, 22);
 	CreateStatic(hWnd, L"Frames:", 632, 95, 50, 22);
@@ -892,6 +900,7 @@ static void AnmViewerOnDestroy(NANRVIEWERDATA *data, HWND hWnd) {
 	DWORD *frameBuffer = data->frameBuffer;
 	data->frameBuffer = NULL;
 	free(frameBuffer);
+	CellCacheFree(&data->cellCache);
 	AnmViewerFreeTickThread(hWnd);
 }
 
@@ -3,6 +3,7 @@
 #include "ncer.h"
 #include "ncgr.h"
 #include "nclr.h"
+#include "cellcache.h"
 
 #include <Windows.h>
 
@@ -18,6 +19,7 @@ typedef struct {
 	int playing;
 	DWORD *frameBuffer;
 	BOOL ignoreInputMsg;
+	CellCache cellCache;
 
 	HWND hWndAnimationDropdown;
 	HWND hWndPauseButton;
@@ -47,7 +49,11 @@ typedef struct {
 	HWND hWndDeleteSequence;
 } NANRVIEWERDATA;
 
-DWORD *nanrDrawFrame(DWORD *frameBuffer, NCLR *nclr, NCGR *ncgr, NCER *ncer, NANR *nanr, int sequenceIndex, int frame, int checker, int ofsX, int ofsY);
+//
+// Draw a frame of an animation sequence. cellCache may be NULL to render cells
+// without caching.
+//
+DWORD *nanrDrawFrame(DWORD *frameBuffer, NCLR *nclr, NCGR *ncgr, NCER *ncer, NANR *nanr, int sequenceIndex, int frame, int checker, int ofsX, int ofsY, CellCache *cellCache);
 
 VOID RegisterNanrViewerClass(VOID);
 
@@ -1,3 +1,5 @@
+#include <math.h>
+
 #include "ncer.h"
 #include "nclr.h"
 #include "ncgr.h"
@@ -293,6 +295,63 @@ void CellGetObjDimensions(int shape, int size, int *width, int *height) {
 	*height = heights[shape][size];
 }
 
+#define CELLI_SEXT8(n)   (((n)<0x080)?(n):((n)-0x100))
+#define CELLI_SEXT9(n)   (((n)<0x100)?(n):((n)-0x200))
+
+static float CelliComputeDistanceToCenter(int cx, int cy, int x, int y) {
+	int d2 = (x - cx) * (x - cx) + (y - cy) * (y - cy);
+	return (float) sqrt((float) d2);
+}
+
+void CellCalculateBounds(NCER_CELL *cell) {
+	int xMin = 0, xMax = 0, yMin = 0, yMax = 0;
+
+	for (int i = 0; i < cell->nAttribs; i++) {
+		NCER_CELL_INFO info;
+		CellDecodeOamAttributes(&info, cell, i);
+
+		int objX = CELLI_SEXT9(info.x), objY = CELLI_SEXT8(info.y);
+		int objW = info.width << info.doubleSize, objH = info.height << info.doubleSize;
+		if (i == 0 || objX < xMin) xMin = objX;
+		if (i == 0 || objY < yMin) yMin = objY;
+		if (i == 0 || (objX + objW) > xMax) xMax = objX + objW;
+		if (i == 0 || (objY + objH) > yMax) yMax = objY + objH;
+	}
+
+	cell->minX = xMin;
+	cell->minY = yMin;
+	cell->maxX = xMax;
+	cell->maxY = yMax;
+
+	int centerX = (xMin + xMax) / 2;
+	int centerY = (yMin + yMax) / 2;
+
+	//find OBJ with furthest extent point
+	float dMax = 0.0f;
+	for (int i = 0; i < cell->nAttribs; i++) {
+		NCER_CELL_INFO info;
+		CellDecodeOamAttributes(&info, cell, i);
+
+		int objX = CELLI_SEXT9(info.x), objY = CELLI_SEXT8(info.y);
+		int objW = info.width << info.doubleSize, objH = info.height << info.doubleSize;
+
+		float d1 = CelliComputeDistanceToCenter(centerX, centerY, objX,        objY       );
+		float d2 = CelliComputeDistanceToCenter(centerX, centerY, objX + objW, objY       );
+		float d3 = CelliComputeDistanceToCenter(centerX, centerY, objX,        objY + objH);
+		float d4 = CelliComputeDistanceToCenter(centerX, centerY, objX + objW, objY + objH);
+
+		if (d1 > dMax) dMax = d1;
+		if (d2 > dMax) dMax = d2;
+		if (d3 > dMax) dMax = d3;
+		if (d4 > dMax) dMax = d4;
+	}
+
+	int dInt = (int) ceil(dMax);
+	dInt = (dInt + 3) >> 2;
+	if (dInt > 0x3F) dInt = 0x3F;
+	cell->cellAttr = (cell->cellAttr & ~0x3F) | (dInt & 0x3F);
+}
+
 int CellDecodeOamAttributes(NCER_CELL_INFO *info, NCER_CELL *cell, int oam) {
 	if (oam >= cell->nAttribs) {
 		return 1;
@@ -344,27 +403,28 @@ int CellDecodeOamAttributes(NCER_CELL_INFO *info, NCER_CELL *cell, int oam) {
 	return 0;
 }
 
+int CellGetObjCharacter(NCER_CELL_INFO *info, int mapping, NCGR *ncgr, int x, int y) {
+	int ncgrStart = NCGR_CHNAME(info->characterName, mapping, ncgr->nBits);
+	if (NCGR_2D(mapping)) {
+		int ncx = x + ncgrStart % ncgr->tilesX;
+		int ncy = y + ncgrStart / ncgr->tilesX;
+		return ncx + ncgr->tilesX * ncy;
+	} else {
+		return ncgrStart + x + y * (info->width / 8);
+	}
+}
+
 void CellRenderObj(NCER_CELL_INFO *info, int mapping, NCGR *ncgr, NCLR *nclr, CHAR_VRAM_TRANSFER *vramTransfer, COLOR32 *out) {
 	int tilesX = info->width / 8;
 	int tilesY = info->height / 8;
 
 	if (ncgr != NULL) {
-		int charSize = ncgr->nBits * 8;
-		int ncgrStart = NCGR_CHNAME(info->characterName, mapping, ncgr->nBits);
 		for (int y = 0; y < tilesY; y++) {
 			for (int x = 0; x < tilesX; x++) {
 				COLOR32 block[64];
 
 				int bitsOffset = x * 8 + (y * 8 * tilesX * 8);
-				int index;
-				if (NCGR_2D(mapping)) {
-					int ncx = x + ncgrStart % ncgr->tilesX;
-					int ncy = y + ncgrStart / ncgr->tilesX;
-					index = ncx + ncgr->tilesX * ncy;
-				} else {
-					index = ncgrStart + x + y * tilesX;
-				}
-
+				int index = CellGetObjCharacter(info, mapping, ncgr, x, y);
 				ChrRenderCharacterTransfer(ncgr, nclr, index, vramTransfer, block, info->palette, TRUE);
 				for (int i = 0; i < 8; i++) {
 					memcpy(out + bitsOffset + tilesX * 8 * i, block + i * 8, 32);
@@ -374,87 +434,139 @@ void CellRenderObj(NCER_CELL_INFO *info, int mapping, NCGR *ncgr, NCLR *nclr, CH
 	}
 }
 
-COLOR32 *CellRenderCell(COLOR32 *px, NCER_CELL *cell, int mapping, NCGR *ncgr, NCLR *nclr, CHAR_VRAM_TRANSFER *vramTransfer, int xOffs, int yOffs, float a, float b, float c, float d) {
-	COLOR32 *block = (COLOR32 *) calloc(64 * 64, 4);
-	for (int i = cell->nAttribs - 1; i >= 0; i--) {
-		NCER_CELL_INFO info;
-		CellDecodeOamAttributes(&info, cell, i);
+static int CelliFixedToInt(int x) {
+	//truncate 16.16 fixed point toward zero
+	return x >= 0 ? (x >> 16) : -((-x) >> 16);
+}
 
-		CellRenderObj(&info, mapping, ncgr, nclr, vramTransfer, block);
+static void CelliRenderObjDirect(COLOR32 *px, int *covbuf, int covValue, NCER_CELL_INFO *info, int mapping, NCGR *ncgr, NCLR *nclr, CHAR_VRAM_TRANSFER *vramTransfer, int xOffs, int yOffs, float a, float b, float c, float d, int flags) {
+	int tilesX = info->width / 8;
+	int tilesY = info->height / 8;
 
-		//HV flip? Only if not affine!
-		if (!info.rotateScale) {
-			COLOR32 temp[64];
-			if (info.flipY) {
-				for (int i = 0; i < info.height / 2; i++) {
-					memcpy(temp, block + i * info.width, info.width * 4);
-					memcpy(block + i * info.width, block + (info.height - 1 - i) * info.width, info.width * 4);
-					memcpy(block + (info.height - 1 - i) * info.width, temp, info.width * 4);
+	//characters of the OBJ and the colors they index. Characters are read in place when no VRAM
+	//transfer applies to them.
+	unsigned char chrBuf[64][64];
+	const unsigned char *chars[64];
+	COLOR32 palette[256];
 
-				}
-			}
-			if (info.flipX) {
-				for (int i = 0; i < info.width / 2; i++) {
-					for (int j = 0; j < info.height; j++) {
-						COLOR32 left = block[i + j * info.width];
-						block[i + j * info.width] = block[info.width - 1 - i + j * info.width];
-						block[info.width - 1 - i + j * info.width] = left;
-					}
+	if (ncgr != NULL) {
+		for (int y = 0; y < tilesY; y++) {
+			for (int x = 0; x < tilesX; x++) {
+				int index = CellGetObjCharacter(info, mapping, ncgr, x, y);
+				unsigned char *buf = chrBuf[x + y * tilesX];
+				if (vramTransfer != NULL) {
+					ChrGetChar(ncgr, index, vramTransfer, buf);
+					chars[x + y * tilesX] = buf;
+				} else if (index < ncgr->nTiles) {
+					chars[x + y * tilesX] = NCGR_CHAR(ncgr, index);
+				} else {
+					memset(buf, 0, 64);
+					chars[x + y * tilesX] = buf;
 				}
 			}
 		}
 
-		if (!info.disable) {
-			int x = info.x;
-			int y = info.y;
-			//adjust for double size
-			if (info.doubleSize) {
-				x += info.width / 2;
-				y += info.height / 2;
+		//color 0 is transparent, colors outside of the palette are black
+		int nPltt = 1 << ncgr->nBits;
+		int pltBase = info->palette << ncgr->nBits;
+		palette[0] = 0;
+		for (int i = 1; i < nPltt; i++) {
+			COLOR w = 0;
+			if (nclr != NULL && (i + pltBase) < nclr->nColors) w = nclr->colors[i + pltBase];
+			palette[i] = ColorConvertFromDS(CREVERSE(w)) | 0xFF000000;
+		}
+	} else {
+		if (!(flags & CELL_RENDER_NULL_COVERAGE)) return;
+
+		//no graphics: cover the OBJ with color 0 of the palette
+		memset(chrBuf[0], 1, 64);
+		for (int i = 0; i < tilesX * tilesY; i++) chars[i] = chrBuf[0];
+		palette[1] = 0xFF000000;
+		if (nclr != NULL && nclr->nColors >= 1) palette[1] |= ColorConvertFromDS(nclr->colors[0]);
+	}
+
+	int x = info->x;
+	int y = info->y;
+
+	//adjust for double size
+	if (info->doubleSize) {
+		x += info->width / 2;
+		y += info->height / 2;
+	}
+
+	if (!info->rotateScale) {
+		//flip folded into source addressing
+		int flipX = info->flipX ? (info->width - 1) : 0;
+		int flipY = info->flipY ? (info->height - 1) : 0;
+
+		for (int j = 0; j < info->height; j++) {
+			int destY = (y + j + yOffs) & 0xFF;
+			int srcY = j ^ flipY;
+			const unsigned char *const *chrRow = chars + (srcY >> 3) * tilesX;
+			int chrOffsY = (srcY & 7) * 8;
+
+			COLOR32 *destRow = px + destY * 512;
+			int *covRow = covbuf == NULL ? NULL : covbuf + destY * 512;
+			for (int k = 0; k < info->width; k++) {
+				int srcX = k ^ flipX;
+				unsigned char idx = chrRow[srcX >> 3][chrOffsY + (srcX & 7)];
+				if (!idx) continue;
+
+				int destX = (x + k + xOffs) & 0x1FF;
+				destRow[destX] = palette[idx];
+				if (covRow != NULL) covRow[destX] = covValue;
 			}
-			//copy data
-			if (!info.rotateScale) {
-				for (int j = 0; j < info.height; j++) {
-					int _y = (y + j + yOffs) & 0xFF;
-					for (int k = 0; k < info.width; k++) {
-						int _x = (x + k + xOffs) & 0x1FF;
-						COLOR32 col = block[j * info.width + k];
-						if (col >> 24) {
-							px[_x + _y * 512] = block[j * info.width + k];
-						}
-					}
-				}
-			} else {
-				//transform about center
-				int realWidth = info.width << info.doubleSize;
-				int realHeight = info.height << info.doubleSize;
-				int cx = realWidth / 2;
-				int cy = realHeight / 2;
-				int realX = x - (realWidth - info.width) / 2;
-				int realY = y - (realHeight - info.height) / 2;
-				for (int j = 0; j < realHeight; j++) {
-					int destY = (realY + j + yOffs) & 0xFF;
-					for (int k = 0; k < realWidth; k++) {
-						int destX = (realX + k + xOffs) & 0x1FF;
-
-						int srcX = (int) ((k - cx) * a + (j - cy) * b) + cx;
-						int srcY = (int) ((k - cx) * c + (j - cy) * d) + cy;
-
-						if (info.doubleSize) {
-							srcX -= realWidth / 4;
-							srcY -= realHeight / 4;
-						}
-						if (srcX >= 0 && srcY >= 0 && srcX < info.width && srcY < info.height) {
-							COLOR32 src = block[srcY * info.width + srcX];
-							if(src >> 24) px[destX + destY * 512] = src;
-						}
-
-					}
-				}
+		}
+	} else {
+		//transform about center, stepping the source position in 16.16 fixed point
+		int realWidth = info->width << info->doubleSize;
+		int realHeight = info->height << info->doubleSize;
+		int cx = realWidth / 2;
+		int cy = realHeight / 2;
+		int realX = x - (realWidth - info->width) / 2;
+		int realY = y - (realHeight - info->height) / 2;
+		int ofs = info->doubleSize ? (realWidth / 4) : 0;
+		int ofsY = info->doubleSize ? (realHeight / 4) : 0;
+
+		int fxA = (int) floor(a * 65536.0f + 0.5f), fxB = (int) floor(b * 65536.0f + 0.5f);
+		int fxC = (int) floor(c * 65536.0f + 0.5f), fxD = (int) floor(d * 65536.0f + 0.5f);
+		for (int j = 0; j < realHeight; j++) {
+			int destY = (realY + j + yOffs) & 0xFF;
+			COLOR32 *destRow = px + destY * 512;
+			int *covRow = covbuf == NULL ? NULL : covbuf + destY * 512;
+
+			int fxX = -cx * fxA + (j - cy) * fxB;
+			int fxY = -cx * fxC + (j - cy) * fxD;
+			for (int k = 0; k < realWidth; k++, fxX += fxA, fxY += fxC) {
+				int srcX = CelliFixedToInt(fxX) + cx - ofs;
+				int srcY = CelliFixedToInt(fxY) + cy - ofsY;
+				if (srcX < 0 || srcY < 0 || srcX >= info->width || srcY >= info->height) continue;
+
+				unsigned char idx = chars[(srcX >> 3) + (srcY >> 3) * tilesX][(srcX & 7) + (srcY & 7) * 8];
+				if (!idx) continue;
+
+				int destX = (realX + k + xOffs) & 0x1FF;
+				destRow[destX] = palette[idx];
+				if (covRow != NULL) covRow[destX] = covValue;
 			}
 		}
 	}
-	free(block);
+}
+
+void CellRenderCellEx(COLOR32 *px, int *covbuf, NCER_CELL *cell, int mapping, NCGR *ncgr, NCLR *nclr, CHAR_VRAM_TRANSFER *vramTransfer, int xOffs, int yOffs, float a, float b, float c, float d, int flags) {
+	for (int i = cell->nAttribs - 1; i >= 0; i--) {
+		NCER_CELL_INFO info;
+		CellDecodeOamAttributes(&info, cell, i);
+
+		//if OBJ is marked disabled, skip rendering
+		if (info.disable) continue;
+
+		CelliRenderObjDirect(px, covbuf, i + 1, &info, mapping, ncgr, nclr, vramTransfer, xOffs, yOffs, a, b, c, d, flags);
+	}
+}
+
+COLOR32 *CellRenderCell(COLOR32 *px, NCER_CELL *cell, int mapping, NCGR *ncgr, NCLR *nclr, CHAR_VRAM_TRANSFER *vramTransfer, int xOffs, int yOffs, float a, float b, float c, float d) {
+	CellRenderCellEx(px, NULL, cell, mapping, ncgr, nclr, vramTransfer, xOffs, yOffs, a, b, c, d, 0);
 	return px;
 }
 
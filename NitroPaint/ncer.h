@@ -10,6 +10,8 @@
 #define NCER_TYPE_GHOSTTRICK 4
 #define NCER_TYPE_COMBO      5
 
+#define CELL_RENDER_NULL_COVERAGE    1   // with no graphics, cover OBJ with palette color 0
+
 extern LPCWSTR cellFormatNames[];
 
 typedef struct NCER_CELL_ {
@@ -88,12 +90,29 @@ void CellGetObjDimensions(int shape, int size, int *width, int *height);
 
 int CellDecodeOamAttributes(NCER_CELL_INFO *info, NCER_CELL *cell, int oam);
 
+//
+// Compute the bounding box and bounding radius of a cell from its OBJ.
+//
+void CellCalculateBounds(NCER_CELL *cell);
+
 int CellFree(OBJECT_HEADER *header);
 
+//
+// Get the index of the character at a character position within an OBJ.
+//
+int CellGetObjCharacter(NCER_CELL_INFO *info, int mapping, NCGR *ncgr, int x, int y);
+
 void CellRenderObj(NCER_CELL_INFO *info, int mapping, NCGR *ncgr, NCLR *nclr, CHAR_VRAM_TRANSFER *vramTransfer, COLOR32 *out);
 
 COLOR32 *CellRenderCell(COLOR32 *px, NCER_CELL *cell, int mapping, NCGR *ncgr, NCLR *nclr, CHAR_VRAM_TRANSFER *vramTransfer, int xOffs, int yOffs, float a, float b, float c, float d);
 
+//
+// Render a cell to a 512x256 buffer, drawing each OBJ directly from its
+// characters. If covbuf is not NULL, it receives the OBJ index + 1 of each
+// covered pixel.
+//
+void CellRenderCellEx(COLOR32 *px, int *covbuf, NCER_CELL *cell, int mapping, NCGR *ncgr, NCLR *nclr, CHAR_VRAM_TRANSFER *vramTransfer, int xOffs, int yOffs, float a, float b, float c, float d, int flags);
+
 void CellDeleteCell(NCER *ncer, int idx);
 
 void CellMoveCellIndex(NCER *ncer, int iSrc, int iDst);
@@ -55,7 +55,6 @@ static const unsigned short sMenuIdSizes[] = {
 	ID_OBJSIZE_8X16, ID_OBJSIZE_8X32,  ID_OBJSIZE_16X32, ID_OBJSIZE_32X64
 };
 
-static void CellViewerRenderCell(COLOR32 *px, int *covbuf, NCER_CELL *cell, int mapping, NCGR *ncgr, NCLR *nclr, CHAR_VRAM_TRANSFER *vramTransfer, int xOffs, int yOffs, float a, float b, float c, float d);
 static COLOR32 *CellViewerCropRenderedCell(COLOR32 *px, int width, int height, int *pMinX, int *pMinY, int *outWidth, int *outHeight);
 
 
@@ -144,7 +143,7 @@ static unsigned char *CellViewerMapGraphicsUsage(NCERVIEWERDATA *data, int exclu
 	if (excludeNonClearCharacters) {
 		unsigned char zero[64] = { 0 };
 		for (int i = 0; i < ncgr->nTiles; i++) {
-			if (memcmp(ncgr->tiles[i], zero, sizeof(zero)) != 0) {
+			if (memcmp(NCGR_CHAR(ncgr, i), zero, sizeof(zero)) != 0) {
 				map[i] = 1;
 			}
 		}
@@ -631,61 +630,11 @@ static void CellViewerDeleteSelection(NCERVIEWERDATA *data) {
 	data->nSelectedOBJ = 0;
 }
 
-static float CellViewerComputeDistanceToCenter(int cx, int cy, int x, int y) {
-	int d2 = (x - cx) * (x - cx) + (y - cy) * (y - cy);
-	return (float) sqrt((float) d2);
-}
-
 static void CellViewerUpdateBounds(NCERVIEWERDATA *data) {
 	NCER_CELL *cell = CellViewerGetCurrentCell(data);
 	if (cell == NULL) return;
 
-	int xMin = 0, xMax = 0, yMin = 0, yMax = 0;
-
-	for (int i = 0; i < cell->nAttribs; i++) {
-		NCER_CELL_INFO info;
-		CellDecodeOamAttributes(&info, cell, i);
-
-		int objX = SEXT9(info.x), objY = SEXT8(info.y);
-		int objW = info.width << info.doubleSize, objH = info.height << info.doubleSize;
-		if (i == 0 || objX < xMin) xMin = objX;
-		if (i == 0 || objY < yMin) yMin = objY;
-		if (i == 0 || (objX + objW) > xMax) xMax = objX + objW;
-		if (i == 0 || (objY + objH) > yMax) yMax = objY + objH;
-	}
-
-	cell->minX = xMin;
-	cell->minY = yMin;
-	cell->maxX = xMax;
-	cell->maxY = yMax;
-
-	int centerX = (xMin + xMax) / 2;
-	int centerY = (yMin + yMax) / 2;
-
-	//find OBJ with furthest extent point
-	float dMax = 0.0f;
-	for (int i = 0; i < cell->nAttribs; i++) {
-		NCER_CELL_INFO info;
-		CellDecodeOamAttributes(&info, cell, i);
-
-		int objX = SEXT9(info.x), objY = SEXT8(info.y);
-		int objW = info.width << info.doubleSize, objH = info.height << info.doubleSize;
-
-		float d1 = CellViewerComputeDistanceToCenter(centerX, centerY, objX,        objY       );
-		float d2 = CellViewerComputeDistanceToCenter(centerX, centerY, objX + objW, objY       );
-		float d3 = CellViewerComputeDistanceToCenter(centerX, centerY, objX,        objY + objH);
-		float d4 = CellViewerComputeDistanceToCenter(centerX, centerY, objX + objW, objY + objH);
-
-		if (d1 > dMax) dMax = d1;
-		if (d2 > dMax) dMax = d2;
-		if (d3 > dMax) dMax = d3;
-		if (d4 > dMax) dMax = d4;
-	}
-
-	int dInt = (int) ceil(dMax);
-	dInt = (dInt + 3) >> 2;
-	if (dInt > 0x3F) dInt = 0x3F;
-	cell->cellAttr = (cell->cellAttr & ~0x3F) | (dInt & 0x3F);
+	CellCalculateBounds(cell);
 }
 
 
@@ -774,7 +723,7 @@ static void CellViewerCopyDIB(NCERVIEWERDATA *data) {
 	tmpCell->nAttribs = nSel;
 	tmpCell->attr = selAttr;
 
-	CellViewerRenderCell(buf, NULL, tmpCell, data->ncer.mappingMode, ncgr, nclr, vramTransfer, 256, 128, 1.0f, 0.0f, 0.0f, 1.0f);
+	CellRenderCellEx(buf, NULL, tmpCell, data->ncer.mappingMode, ncgr, nclr, vramTransfer, 256, 128, 1.0f, 0.0f, 0.0f, 1.0f, CELL_RENDER_NULL_COVERAGE);
 	free(tmpCell);
 	free(selAttr);
 
@@ -947,140 +896,11 @@ static void CellViewerPaste(NCERVIEWERDATA *data) {
 // ----- rendering helper routines
 
 
-static void CellViewerRenderObj(COLOR32 *out, NCER_CELL_INFO *info, NCGR *ncgr, NCLR *nclr, int mapping, CHAR_VRAM_TRANSFER *vramTransfer) {
-	int tilesX = info->width / 8;
-	int tilesY = info->height / 8;
-
-	if (ncgr == NULL) {
-		//null NCGR, render opaque coverage by OBJ
-		COLOR32 fill = 0xFF000000;
-		if (nclr != NULL && nclr->nColors >= 1) {
-			fill = 0xFF000000 | ColorConvertFromDS(nclr->colors[0]);
-		}
-		for (int i = 0; i < (tilesX * tilesY * 8 * 8); i++) out[i] = fill;
-		return;
-	}
-
-	int ncgrStart = NCGR_CHNAME(info->characterName, mapping, ncgr->nBits);
-	for (int y = 0; y < tilesY; y++) {
-		for (int x = 0; x < tilesX; x++) {
-			COLOR32 block[64];
-
-			int bitsOffset = x * 8 + (y * 8 * tilesX * 8);
-			int index;
-			if (NCGR_2D(mapping)) {
-				int ncx = x + ncgrStart % ncgr->tilesX;
-				int ncy = y + ncgrStart / ncgr->tilesX;
-				index = ncx + ncgr->tilesX * ncy;
-			} else {
-				index = ncgrStart + x + y * tilesX;
-			}
-
-			ChrRenderCharacterTransfer(ncgr, nclr, index, vramTransfer, block, info->palette, TRUE);
-			for (int i = 0; i < 8; i++) {
-				memcpy(out + bitsOffset + tilesX * 8 * i, block + i * 8, 32);
-			}
-		}
-	}
-}
-
-static void CellViewerRenderCell(COLOR32 *px, int *covbuf, NCER_CELL *cell, int mapping, NCGR *ncgr, NCLR *nclr, CHAR_VRAM_TRANSFER *vramTransfer, int xOffs, int yOffs, float a, float b, float c, float d) {
-	COLOR32 *block = (COLOR32 *) calloc(64 * 64, sizeof(COLOR32));
-	for (int i = cell->nAttribs - 1; i >= 0; i--) {
-		NCER_CELL_INFO info;
-		CellDecodeOamAttributes(&info, cell, i);
-
-		//if OBJ is marked disabled, skip rendering
-		if (info.disable) continue;
-
-		CellViewerRenderObj(block, &info, ncgr, nclr, mapping, vramTransfer);
-
-		//HV flip? Only if not affine!
-		if (!info.rotateScale) {
-			COLOR32 temp[64];
-			if (info.flipY) {
-				for (int i = 0; i < info.height / 2; i++) {
-					memcpy(temp, block + i * info.width, info.width * 4);
-					memcpy(block + i * info.width, block + (info.height - 1 - i) * info.width, info.width * 4);
-					memcpy(block + (info.height - 1 - i) * info.width, temp, info.width * 4);
-
-				}
-			}
-			if (info.flipX) {
-				for (int i = 0; i < info.width / 2; i++) {
-					for (int j = 0; j < info.height; j++) {
-						COLOR32 left = block[i + j * info.width];
-						block[i + j * info.width] = block[info.width - 1 - i + j * info.width];
-						block[info.width - 1 - i + j * info.width] = left;
-					}
-				}
-			}
-		}
-
-		int x = info.x;
-		int y = info.y;
-
-		//adjust for double size
-		if (info.doubleSize) {
-			x += info.width / 2;
-			y += info.height / 2;
-		}
-
-		//copy data
-		if (!info.rotateScale) {
-			for (int j = 0; j < info.height; j++) {
-				int _y = (y + j + yOffs) & 0xFF;
-				for (int k = 0; k < info.width; k++) {
-					int _x = (x + k + xOffs) & 0x1FF;
-					COLOR32 col = block[j * info.width + k];
-					if (col >> 24) {
-						px[_x + _y * 512] = col;
-						if (covbuf != NULL) covbuf[_x + _y * 512] = i + 1; // 0=no OBJ
-					}
-				}
-			}
-		} else {
-			//transform about center
-			int realWidth = info.width << info.doubleSize;
-			int realHeight = info.height << info.doubleSize;
-			int cx = realWidth / 2;
-			int cy = realHeight / 2;
-			int realX = x - (realWidth - info.width) / 2;
-			int realY = y - (realHeight - info.height) / 2;
-			for (int j = 0; j < realHeight; j++) {
-				int destY = (realY + j + yOffs) & 0xFF;
-				for (int k = 0; k < realWidth; k++) {
-					int destX = (realX + k + xOffs) & 0x1FF;
-
-					int srcX = (int) ((k - cx) * a + (j - cy) * b) + cx;
-					int srcY = (int) ((k - cx) * c + (j - cy) * d) + cy;
-
-					if (info.doubleSize) {
-						srcX -= realWidth / 4;
-						srcY -= realHeight / 4;
-					}
-					if (srcX >= 0 && srcY >= 0 && srcX < info.width && srcY < info.height) {
-						COLOR32 src = block[srcY * info.width + srcX];
-						if (src >> 24) {
-							px[destX + destY * 512] = src;
-							if (covbuf != NULL) covbuf[destX + destY * 512] = i + 1; // 0=no OBJ
-						}
-					}
-
-				}
-			}
-		}
-	}
-	free(block);
-}
-
-static void CellViewerRenderCellByIndex(COLOR32 *buf, int *covbuf, NCER *ncer, NCGR *ncgr, NCLR *nclr, int cellno) {
-	NCER_CELL *cell = ncer->cells + cellno;
-
+static void CellViewerRenderCellByIndex(CellCache *cache, COLOR32 *buf, int *covbuf, NCER *ncer, NCGR *ncgr, NCLR *nclr, int cellno) {
 	CHAR_VRAM_TRANSFER *vramTransfer = NULL;
 	if (ncer->vramTransfer != NULL) vramTransfer = ncer->vramTransfer + cellno;
 
-	CellViewerRenderCell(buf, covbuf, cell, ncer->mappingMode, ncgr, nclr, vramTransfer, 256, 128, 1.0f, 0.0f, 0.0f, 1.0f);
+	CellCacheRender(cache, buf, covbuf, ncer, cellno, ncgr, nclr, vramTransfer, 256, 128, 1.0f, 0.0f, 0.0f, 1.0f, CELL_RENDER_NULL_COVERAGE);
 }
 
 static void CellViewerUpdateCellRender(NCERVIEWERDATA *data) {
@@ -1090,7 +910,7 @@ static void CellViewerUpdateCellRender(NCERVIEWERDATA *data) {
 	memset(data->frameBuffer, 0, sizeof(data->frameBuffer));
 	memset(data->covBuffer, 0, sizeof(data->covBuffer));
 	if (data->cell != -1) {
-		CellViewerRenderCellByIndex(data->frameBuffer, data->covBuffer, &data->ncer, ncgr, nclr, data->cell);
+		CellViewerRenderCellByIndex(&data->cellCache, data->frameBuffer, data->covBuffer, &data->ncer, ncgr, nclr, data->cell);
 	}
 }
 
@@ -1160,10 +980,10 @@ static COLOR32 *CellViewerCropRenderedCell(COLOR32 *px, int width, int height, i
 	return out;
 }
 
-static HBITMAP CellViewerRenderImageListBitmap(NCER *ncer, int cellno, NCGR *ncgr, NCLR *nclr, HBITMAP *pMaskBitmap) {
+static HBITMAP CellViewerRenderImageListBitmap(CellCache *cache, NCER *ncer, int cellno, NCGR *ncgr, NCLR *nclr, HBITMAP *pMaskBitmap) {
 	//first, render the cell to a framebuffer.
 	COLOR32 *pxbuf = (COLOR32 *) calloc(512 * 256, sizeof(COLOR32));
-	CellViewerRenderCellByIndex(pxbuf, NULL, ncer, ncgr, nclr, cellno);
+	CellViewerRenderCellByIndex(cache, pxbuf, NULL, ncer, ncgr, nclr, cellno);
 
 	//next, crop the rendered cell
 	int minX, minY, cropW, cropH;
@@ -1358,7 +1178,7 @@ static void CellViewerUpdateCellListPreview(NCERVIEWERDATA *data, int i) {
 	NCLR *nclr = CellViewerGetAssociatedPalette(data);
 	NCGR *ncgr = CellViewerGetAssociatedCharacter(data);
 	HBITMAP hMaskbm;
-	HBITMAP hColorbm = CellViewerRenderImageListBitmap(&data->ncer, i, ncgr, nclr, &hMaskbm);
+	HBITMAP hColorbm = CellViewerRenderImageListBitmap(&data->cellCache, &data->ncer, i, ncgr, nclr, &hMaskbm);
 
 	//
 	HIMAGELIST himl = ListView_GetImageList(data->hWndCellList, LVSIL_NORMAL);
@@ -1480,6 +1300,7 @@ static void CellViewerMoveCell(NCERVIEWERDATA *data, int iSrc, int iDst) {
 
 	//rearrange
 	CellMoveCellIndex(&data->ncer, iSrc, iDst);
+	ObjMarkModified(&data->ncer.header);
 
 	//move cell listing (TODO: a better way?)
 	HIMAGELIST himl = ListView_GetImageList(data->hWndCellList, LVSIL_NORMAL);
@@ -1500,6 +1321,7 @@ static void CellViewerDeleteCell(NCERVIEWERDATA *data, int i) {
 	//update cell bank structure
 	int newsel = data->cell;
 	CellDeleteCell(&data->ncer, i);
+	ObjMarkModified(&data->ncer.header);
 
 	//move cell listing (TODO: a better way?)
 	HIMAGELIST himl = ListView_GetImageList(data->hWndCellList, LVSIL_NORMAL);
@@ -1691,6 +1513,7 @@ static void CellViewerOnCtlCommand(NCERVIEWERDATA *data, HWND hWndControl, int n
 
 		NCER_CELL *cell = data->ncer.cells + data->ncer.nCells - 1;
 		memset(cell, 0, sizeof(NCER_CELL));
+		ObjMarkModified(&data->ncer.header);
 
 		CellViewerAppendCellToCellList(data, name, cell);
 		CellViewerSetCurrentCell(data, data->ncer.nCells - 1, TRUE);
@@ -1933,7 +1756,7 @@ static void CellViewerOnMenuCommand(NCERVIEWERDATA *data, int idMenu) {
 			NCGR *ncgr = CellViewerGetAssociatedCharacter(data);
 
 			COLOR32 *bits = (COLOR32 *) calloc(256 * 512, sizeof(COLOR32));
-			CellViewerRenderCellByIndex(bits, NULL, ncer, ncgr, nclr, data->cell);
+			CellViewerRenderCellByIndex(NULL, bits, NULL, ncer, ncgr, nclr, data->cell);
 			ImgSwapRedBlue(bits, 512, 256);
 			ImgWrite(bits, 512, 256, location);
 
@@ -2152,6 +1975,109 @@ static void CellViewerOnTimer(NCERVIEWERDATA *data, int idTimer) {
 	}
 }
 
+// ----- undo
+
+typedef struct CellViewerUndoHeader_ {
+	int nCells;
+	int mappingMode;
+	int hasVramTransfer;
+} CellViewerUndoHeader;
+
+typedef struct CellViewerUndoCell_ {
+	int nAttribs;
+	int cellAttr;
+	uint32_t attrEx;
+	int minX;
+	int minY;
+	int maxX;
+	int maxY;
+} CellViewerUndoCell;
+
+static void CellViewerSaveState(HWND hWnd, BSTREAM *stream) {
+	NCERVIEWERDATA *data = (NCERVIEWERDATA *) EditorGetData(hWnd);
+	NCER *ncer = &data->ncer;
+
+	CellViewerUndoHeader header = { ncer->nCells, ncer->mappingMode, ncer->vramTransfer != NULL };
+	bstreamWrite(stream, &header, sizeof(header));
+	for (int i = 0; i < ncer->nCells; i++) {
+		NCER_CELL *cell = ncer->cells + i;
+		CellViewerUndoCell cellHeader = { cell->nAttribs, cell->cellAttr, cell->attrEx, cell->minX, cell->minY, cell->maxX, cell->maxY };
+		bstreamWrite(stream, &cellHeader, sizeof(cellHeader));
+		bstreamWrite(stream, cell->attr, cell->nAttribs * 3 * sizeof(uint16_t));
+	}
+	if (ncer->vramTransfer != NULL) bstreamWrite(stream, ncer->vramTransfer, ncer->nCells * sizeof(CHAR_VRAM_TRANSFER));
+}
+
+static void CellViewerRestoreState(HWND hWnd, const unsigned char *state, unsigned int size) {
+	NCERVIEWERDATA *data = (NCERVIEWERDATA *) EditorGetData(hWnd);
+	NCER *ncer = &data->ncer;
+
+	CellViewerUndoHeader header;
+	memcpy(&header, state, sizeof(header));
+	state += sizeof(header);
+
+	//rebuild cells
+	for (int i = 0; i < ncer->nCells; i++) {
+		if (ncer->cells[i].attr != NULL) free(ncer->cells[i].attr);
+	}
+	ncer->cells = (NCER_CELL *) realloc(ncer->cells, (header.nCells + 1) * sizeof(NCER_CELL));
+	ncer->nCells = header.nCells;
+	for (int i = 0; i < header.nCells; i++) {
+		CellViewerUndoCell cellHeader;
+		memcpy(&cellHeader, state, sizeof(cellHeader));
+		state += sizeof(cellHeader);
+
+		NCER_CELL *cell = ncer->cells + i;
+		unsigned int attrSize = cellHeader.nAttribs * 3 * sizeof(uint16_t);
+		cell->nAttribs = cellHeader.nAttribs;
+		cell->cellAttr = cellHeader.cellAttr;
+		cell->attrEx = cellHeader.attrEx;
+		cell->minX = cellHeader.minX;
+		cell->minY = cellHeader.minY;
+		cell->maxX = cellHeader.maxX;
+		cell->maxY = cellHeader.maxY;
+		cell->attr = (uint16_t *) malloc(attrSize + 1);
+		memcpy(cell->attr, state, attrSize);
+		state += attrSize;
+	}
+
+	if (header.hasVramTransfer) {
+		ncer->vramTransfer = (CHAR_VRAM_TRANSFER *) realloc(ncer->vramTransfer, (header.nCells + 1) * sizeof(CHAR_VRAM_TRANSFER));
+		memcpy(ncer->vramTransfer, state, header.nCells * sizeof(CHAR_VRAM_TRANSFER));
+	} else if (ncer->vramTransfer != NULL) {
+		free(ncer->vramTransfer);
+		ncer->vramTransfer = NULL;
+	}
+
+	if (header.mappingMode != ncer->mappingMode) {
+		const int mappings[] = {
+			GX_OBJVRAMMODE_CHAR_2D,
+			GX_OBJVRAMMODE_CHAR_1D_32K,
+			GX_OBJVRAMMODE_CHAR_1D_64K,
+			GX_OBJVRAMMODE_CHAR_1D_128K,
+			GX_OBJVRAMMODE_CHAR_1D_256K
+		};
+		ncer->mappingMode = header.mappingMode;
+		for (int i = 0; i < sizeof(mappings) / sizeof(mappings[0]); i++) {
+			if (mappings[i] == header.mappingMode) SendMessage(data->hWndMappingMode, CB_SETCURSEL, i, 0);
+		}
+	}
+
+	//refresh cell listing, keeping the selected cell where it still exists
+	ObjMarkModified(&ncer->header);
+	CellViewerSuppressRedraw(data);
+	int sel = data->cell;
+	HIMAGELIST himl = ListView_GetImageList(data->hWndCellList, LVSIL_NORMAL);
+	ListView_DeleteAllItems(data->hWndCellList);
+	ImageList_RemoveAll(himl);
+	CellViewerDeselect(data);
+	CellViewerPopulateCellList(data);
+
+	if (sel >= ncer->nCells) sel = ncer->nCells - 1;
+	CellViewerSetCurrentCell(data, sel, TRUE);
+	CellViewerRestoreRedraw(data);
+}
+
 static LRESULT WINAPI CellViewerWndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 	NCERVIEWERDATA *data = (NCERVIEWERDATA *) EditorGetData(hWnd);
 
@@ -2166,6 +2092,7 @@ static LRESULT WINAPI CellViewerWndProc(HWND hWnd, UINT msg, WPARAM wParam, LPAR
 			data->cellListRedrawCount = 0;
 			data->autoCalcBounds = 0;
 			FbCreate(&data->fb, hWnd, 0, 0);
+			CellCacheInit(&data->cellCache);
 			data->hWndViewer = CreateWindow(L"CellPreviewClass", L"", WS_VISIBLE | WS_CHILD | WS_HSCROLL | WS_VSCROLL | WS_CLIPSIBLINGS, 200, 0, 200, 20, hWnd, NULL, NULL, NULL);
 
 			//mapping modes
@@ -2267,6 +2194,7 @@ static LRESULT WINAPI CellViewerWndProc(HWND hWnd, UINT msg, WPARAM wParam, LPAR
 			nitroPaintStruct->hWndNcerViewer = NULL;
 			if (nitroPaintStruct->hWndNclrViewer) InvalidateRect(nitroPaintStruct->hWndNclrViewer, NULL, FALSE);
 			FbDestroy(&data->fb);
+			CellCacheFree(&data->cellCache);
 			CellViewerDeselect(data);
 
 			if (data->hWndObjWindow) DestroyChild(data->hWndObjWindow);
@@ -2814,7 +2742,7 @@ static LRESULT CALLBACK NcerCreateCellWndProc(HWND hWnd, UINT msg, WPARAM wParam
 						//compare nCharsCompare chars
 						int differed = 0;
 						for (int k = 0; k < nCharsCompare; k++) {
-							if (memcmp(ncgr->tiles[j + k], indicesBuffer8 + k * 64, 64) != 0) {
+							if (memcmp(NCGR_CHAR(ncgr, j + k), indicesBuffer8 + k * 64, 64) != 0) {
 								differed = 1;
 								break;
 							}
@@ -2838,35 +2766,14 @@ static LRESULT CALLBACK NcerCreateCellWndProc(HWND hWnd, UINT msg, WPARAM wParam
 
 					//read out character
 					for (int j = nFoundChars; j < nChars; j++) {
-						unsigned char *ch = ncgr->tiles[foundStart + j];
+						unsigned char *ch = NCGR_CHAR(ncgr, foundStart + j);
 
 						memcpy(ch, indicesBuffer8 + 64 * j, 64);
 					}
 
 					//get shape/size
-					int shape = 0, size = 0;
-					if (width == height) {
-						shape = 0; //square
-
-						if (width == 8) size = 0; //8
-						else if (width == 16) size = 1; //16
-						else if (width == 32) size = 2; //32
-						else if (width == 64) size = 3; //64
-					} else if (width > height) {
-						shape = 1; //wide
-
-						if (width == 16) size = 0; //16x8
-						else if (height == 8) size = 1; //32x8
-						else if (width == 32) size = 2; //32x16
-						else if (width == 64) size = 3; //64x32
-					} else if (width < height) {
-						shape = 2; //tall
-
-						if (height == 16) size = 0; //8x16
-						else if (width == 8) size = 1; //8x32
-						else if (height == 32) size = 2; //16x32
-						else if (height == 64) size = 3; //32x64
-					}
+					int shape, size;
+					CellgenGetObjShape(width, height, &shape, &size);
 
 					slice->bounds.x -= centerX;
 					slice->bounds.y -= centerY;
@@ -3314,7 +3221,6 @@ static void CellViewerOnMouseMove(NCERVIEWERDATA *data) {
 					//update selection movement
 					CellViewerMoveSelection(data, dx, dy);
 					if (data->autoCalcBounds) CellViewerUpdateBounds(data);
-					CellViewerUpdateCellRender(data);
 					CellViewerGraphicsUpdated(data->hWnd);
 					data->selMoved = 1;
 				}
@@ -3709,8 +3615,9 @@ static LRESULT CALLBACK CellViewerObjListWndProc(HWND hWnd, UINT msg, WPARAM wPa
 }
 
 void RegisterNcerViewerClass(void) {
-	int features = EDITOR_FEATURE_ZOOM | EDITOR_FEATURE_GRIDLINES;
-	EditorRegister(L"NcerViewerClass", CellViewerWndProc, L"Cell Editor", sizeof(NCERVIEWERDATA), features);
+	int features = EDITOR_FEATURE_ZOOM | EDITOR_FEATURE_GRIDLINES | EDITOR_FEATURE_UNDO;
+	EDITOR_CLASS *cls = EditorRegister(L"NcerViewerClass", CellViewerWndProc, L"Cell Editor", sizeof(NCERVIEWERDATA), features);
+	EditorSetUndoProcs(cls, CellViewerSaveState, CellViewerRestoreState);
 	RegisterGenericClass(L"NcerCreateCellClass", NcerCreateCellWndProc, 12 * sizeof(void *));
 	RegisterGenericClass(L"CellPreviewClass", CellViewerPreviewWndProc, sizeof(void *));
 	RegisterGenericClass(L"ObjListClass", CellViewerObjListWndProc, sizeof(void *));
@@ -3723,6 +3630,9 @@ void RegisterNcerViewerClass(void) {
 void CellViewerGraphicsUpdated(HWND hWndEditor) {
 	NCERVIEWERDATA *data = (NCERVIEWERDATA *) EditorGetData(hWndEditor);
 
+	//called after the cells or the graphics they use are edited
+	ObjMarkModified(&data->ncer.header);
+
 	//mark graphics update
 	KillTimer(hWndEditor, ID_TIMER_GFX_UPDATE);
 	data->foreignDataUpdate = 1;
@@ -3,6 +3,7 @@
 #include "framebuffer.h"
 #include "childwindow.h"
 #include "ncer.h"
+#include "cellcache.h"
 #include "undo.h"
 
 typedef struct NCERVIEWERDATA_ {
@@ -32,6 +33,7 @@ typedef struct NCERVIEWERDATA_ {
 	COLOR32 frameBuffer[256 * 512];      // buffer where the current cell is rendered
 	int covBuffer[256 * 512];            // coverage buffer for current cell render
 	FrameBuffer fb;                      // frame buffer the viewer renders
+	CellCache cellCache;                 // cache of rendered cells for the viewer and cell list
 	HWND hWndViewer;
 
 	HWND hWndCellList;
@@ -170,13 +170,10 @@ int ChrIdentify(const unsigned char *buffer, unsigned int size) {
 
 void ChrFree(OBJECT_HEADER *header) {
 	NCGR *ncgr = (NCGR *) header;
-	if (ncgr->tiles != NULL) {
-		for (int i = 0; i < ncgr->nTiles; i++) {
-			free(ncgr->tiles[i]);
-		}
-		free(ncgr->tiles);
+	if (ncgr->chars != NULL) {
+		free(ncgr->chars);
 	}
-	ncgr->tiles = NULL;
+	ncgr->chars = NULL;
 
 	if (ncgr->attr != NULL) {
 		free(ncgr->attr);
@@ -200,41 +197,31 @@ void ChrInit(NCGR *ncgr, int format) {
 void ChrReadChars(NCGR *ncgr, const unsigned char *buffer) {
 	int nChars = ncgr->nTiles;
 
-	unsigned char **tiles = (unsigned char **) calloc(nChars, sizeof(BYTE **));
-	for (int i = 0; i < nChars; i++) {
-		tiles[i] = (unsigned char *) calloc(64, 1);
-		unsigned char *tile = tiles[i];
-
-		if (ncgr->nBits == 8) {
-			//8-bit graphics: no need to unpack
-
-			memcpy(tile, buffer, 64);
-			buffer += 64;
-		} else if (ncgr->nBits == 4) {
-			//4-bit graphics: unpack
-
-			for (int j = 0; j < 32; j++) {
-				BYTE b = *buffer;
-				tile[j * 2] = b & 0xF;
-				tile[j * 2 + 1] = b >> 4;
-				buffer++;
-			}
+	unsigned char *chars = (unsigned char *) calloc(nChars + 1, 64);
+	if (ncgr->nBits == 8) {
+		//8-bit graphics: no need to unpack
+		memcpy(chars, buffer, nChars * 64);
+	} else if (ncgr->nBits == 4) {
+		//4-bit graphics: unpack
+		for (int i = 0; i < nChars * 32; i++) {
+			BYTE b = buffer[i];
+			chars[i * 2] = b & 0xF;
+			chars[i * 2 + 1] = b >> 4;
 		}
 	}
-	ncgr->tiles = tiles;
+	ncgr->chars = chars;
 }
 
 void ChrReadBitmap(NCGR *ncgr, const unsigned char *buffer) {
 	int depth = ncgr->nBits;
 	int tilesX = ncgr->tilesX, tilesY = ncgr->tilesY;
-	unsigned char **tiles = (unsigned char **) calloc(ncgr->nTiles, sizeof(unsigned char **));
+	unsigned char *chars = (unsigned char *) calloc(ncgr->nTiles + 1, 64);
 
 	for (int y = 0; y < tilesY; y++) {
 		for (int x = 0; x < tilesX; x++) {
 
 			int offset = x * 4 + 4 * y * tilesX * 8;
-			unsigned char *tile = calloc(64, 1);
-			tiles[x + y * tilesX] = tile;
+			unsigned char *tile = chars + (x + y * tilesX) * 64;
 			if (depth == 8) {
 				offset *= 2;
 				const unsigned char *indices = buffer + offset;
@@ -259,7 +246,7 @@ void ChrReadBitmap(NCGR *ncgr, const unsigned char *buffer) {
 		}
 	}
 
-	ncgr->tiles = tiles;
+	ncgr->chars = chars;
 }
 
 void ChrReadGraphics(NCGR *ncgr, const unsigned char *buffer) {
@@ -447,7 +434,6 @@ int ChrReadGhostTrick(NCGR *ncgr, const unsigned char *buffer, unsigned int size
 	ncgr->nTiles = uncompSize / 0x20;
 	ncgr->tilesX = ChrGuessWidth(ncgr->nTiles);
 	ncgr->tilesY = ncgr->nTiles / ncgr->tilesX;
-	ncgr->tiles = (unsigned char **) calloc(ncgr->nTiles, sizeof(unsigned char *));
 	ncgr->slices = slices;
 	ncgr->nSlices = nSlices;
 	ChrReadGraphics(ncgr, uncomp);
@@ -561,7 +547,7 @@ int ChrReadFile(NCGR *ncgr, LPCWSTR path) {
 void ChrGetChar(NCGR *ncgr, int chno, CHAR_VRAM_TRANSFER *transfer, unsigned char *out) {
 	//if transfer == NULL, don't simulate any VRAM transfer operation
 	if (transfer == NULL) {
-		if (chno < ncgr->nTiles) memcpy(out, ncgr->tiles[chno], 64);
+		if (chno < ncgr->nTiles) memcpy(out, NCGR_CHAR(ncgr, chno), 64);
 		else memset(out, 0, 64);
 		return;
 	}
@@ -570,7 +556,7 @@ void ChrGetChar(NCGR *ncgr, int chno, CHAR_VRAM_TRANSFER *transfer, unsigned cha
 	unsigned int chrSize = 8 * ncgr->nBits;
 	unsigned int srcAddr = chno * chrSize;
 	if ((srcAddr + chrSize) < transfer->dstAddr || srcAddr >= (transfer->dstAddr + transfer->size)) {
-		if (chno < ncgr->nTiles) memcpy(out, ncgr->tiles[chno], 64);
+		if (chno < ncgr->nTiles) memcpy(out, NCGR_CHAR(ncgr, chno), 64);
 		else memset(out, 0, 64);
 		return;
 	}
@@ -578,7 +564,7 @@ void ChrGetChar(NCGR *ncgr, int chno, CHAR_VRAM_TRANSFER *transfer, unsigned cha
 	//character is within the destination region. For bytes within the region, copy from src.
 	//TODO: handle bitmapped graphics transfers too
 	for (unsigned int i = 0; i < 64; i++) {
-		//copy ncgr->tiles[chrno][i] to out[i]
+		//copy pixel i of character chno to out[i]
 		unsigned int pxaddr = srcAddr + (i >> (ncgr->nBits == 4 ? 1 : 0));
 		if (pxaddr >= transfer->dstAddr && pxaddr < (transfer->dstAddr + transfer->size)) {
 			//in transfer destination
@@ -590,10 +576,10 @@ void ChrGetChar(NCGR *ncgr, int chno, CHAR_VRAM_TRANSFER *transfer, unsigned cha
 				pxno <<= 1;
 				pxno += (i & 1);
 			}
-			out[i] = ncgr->tiles[transferChr][pxno];
+			out[i] = NCGR_CHAR(ncgr, transferChr)[pxno];
 		} else {
 			//out of transfer destination
-			out[i] = ncgr->tiles[chno][i];
+			out[i] = NCGR_CHAR(ncgr, chno)[i];
 		}
 	}
 }
@@ -615,7 +601,7 @@ static int ChriRenderCharacter(unsigned char *chr, int depth, int palette, NCLR
 
 int ChrRenderCharacter(NCGR *ncgr, NCLR *nclr, int chNo, COLOR32 *out, int previewPalette, int transparent) {
 	if (chNo < ncgr->nTiles) {
-		unsigned char *tile = ncgr->tiles[chNo];
+		unsigned char *tile = NCGR_CHAR(ncgr, chNo);
 		return ChriRenderCharacter(tile, ncgr->nBits, previewPalette, nclr, out, transparent);
 	} else {
 		memset(out, 0, 64 * 4);
@@ -649,7 +635,7 @@ void ChrSetWidth(NCGR *ncgr, int width) {
 	int bmpWidth = ncgr->tilesX * 8, bmpHeight = ncgr->tilesY * 8;
 	for (int y = 0; y < ncgr->tilesY; y++) {
 		for (int x = 0; x < ncgr->tilesX; x++) {
-			BYTE *tile = ncgr->tiles[y * ncgr->tilesX + x];
+			BYTE *tile = NCGR_CHAR(ncgr, y * ncgr->tilesX + x);
 			int bmpX = x * 8;
 			int bmpY = y * 8;
 
@@ -665,7 +651,7 @@ void ChrSetWidth(NCGR *ncgr, int width) {
 	bmpWidth = ncgr->tilesX * 8, bmpHeight = ncgr->tilesY * 8;
 	for (int y = 0; y < ncgr->tilesY; y++) {
 		for (int x = 0; x < ncgr->tilesX; x++) {
-			BYTE *tile = ncgr->tiles[y * ncgr->tilesX + x];
+			BYTE *tile = NCGR_CHAR(ncgr, y * ncgr->tilesX + x);
 			int bmpX = x * 8;
 			int bmpY = y * 8;
 
@@ -679,16 +665,16 @@ void ChrSetWidth(NCGR *ncgr, int width) {
 }
 
 void ChrWriteChars(NCGR *ncgr, BSTREAM *stream) {
-	for (int i = 0; i < ncgr->nTiles; i++) {
-		if (ncgr->nBits == 8) {
-			bstreamWrite(stream, ncgr->tiles[i], 64);
-		} else {
-			unsigned char t[32];
-			for (int j = 0; j < 32; j++) {
-				t[j] = ncgr->tiles[i][j * 2] | (ncgr->tiles[i][j * 2 + 1] << 4);
-			}
-			bstreamWrite(stream, t, 32);
+	if (ncgr->nBits == 8) {
+		bstreamWrite(stream, ncgr->chars, ncgr->nTiles * 64);
+	} else {
+		//pack pixel pairs of all characters at once
+		unsigned char *packed = (unsigned char *) malloc(ncgr->nTiles * 32 + 1);
+		for (int i = 0; i < ncgr->nTiles * 32; i++) {
+			packed[i] = ncgr->chars[i * 2] | (ncgr->chars[i * 2 + 1] << 4);
 		}
+		bstreamWrite(stream, packed, ncgr->nTiles * 32);
+		free(packed);
 	}
 }
 
@@ -699,7 +685,7 @@ void ChrWriteBitmap(NCGR *ncgr, BSTREAM *stream) {
 	int nWidth = ncgr->tilesX * 8;
 	for (int y = 0; y < ncgr->tilesY; y++) {
 		for (int x = 0; x < ncgr->tilesX; x++) {
-			unsigned char *tile = ncgr->tiles[x + y * ncgr->tilesX];
+			unsigned char *tile = NCGR_CHAR(ncgr, x + y * ncgr->tilesX);
 			if (ncgr->nBits == 8) {
 				for (int i = 0; i < 64; i++) {
 					int tX = x * 8 + (i % 8);
@@ -755,6 +741,7 @@ int ChrWriteNcgr(NCGR *ncgr, BSTREAM *stream) {
 	NnsStreamCreate(&nnsStream, "NCGR", 1, 0, NNS_TYPE_G2D, NNS_SIG_LE);
 
 	NnsStreamStartBlock(&nnsStream, "CHAR");
+	bstreamReserve(NnsStreamGetBlockStream(&nnsStream), 8 + sizeof(charHeader) + nTiles * nBytesPerTile);
 	NnsStreamWrite(&nnsStream, charHeader, sizeof(charHeader));
 	ChrWriteGraphics(ncgr, NnsStreamGetBlockStream(&nnsStream));
 	NnsStreamEndBlock(&nnsStream);
@@ -977,14 +964,13 @@ void ChrSetDepth(NCGR *ncgr, int depth) {
 		//8bpp -> 4bpp, tile count *= 2
 		nTiles2 *= 2;
 	}
-	unsigned char **tiles2 = (unsigned char **) calloc(nTiles2, sizeof(unsigned char **));
+	unsigned char *chars2 = (unsigned char *) calloc(nTiles2 + 1, 64);
 
 	if (depth == 8) {
 		//convert 4bpp graphic to 8bpp
 		for (int i = 0; i < nTiles2; i++) {
-			unsigned char *tile1 = ncgr->tiles[i * 2];
-			unsigned char *dest = (unsigned char *) calloc(64, 1);
-			tiles2[i] = dest;
+			unsigned char *tile1 = NCGR_CHAR(ncgr, i * 2);
+			unsigned char *dest = chars2 + i * 64;
 
 			//first half
 			for (int j = 0; j < 32; j++) {
@@ -993,7 +979,7 @@ void ChrSetDepth(NCGR *ncgr, int depth) {
 
 			//second half, only if it exists
 			if ((i * 2 + 1) < ncgr->nTiles) {
-				unsigned char *tile2 = ncgr->tiles[i * 2 + 1];
+				unsigned char *tile2 = NCGR_CHAR(ncgr, i * 2 + 1);
 				for (int j = 0; j < 32; j++) {
 					dest[j + 32] = tile2[j * 2] | (tile2[j * 2 + 1] << 4);
 				}
@@ -1003,11 +989,9 @@ void ChrSetDepth(NCGR *ncgr, int depth) {
 	} else {
 		//covert 8bpp graphic to 4bpp
 		for (int i = 0; i < ncgr->nTiles; i++) {
-			unsigned char *tile1 = calloc(64, 1);
-			unsigned char *tile2 = calloc(64, 1);
-			unsigned char *src = ncgr->tiles[i];
-			tiles2[i * 2] = tile1;
-			tiles2[i * 2 + 1] = tile2;
+			unsigned char *tile1 = chars2 + (i * 2) * 64;
+			unsigned char *tile2 = chars2 + (i * 2 + 1) * 64;
+			unsigned char *src = NCGR_CHAR(ncgr, i);
 
 			for (int j = 0; j < 32; j++) {
 				tile1[j * 2 + 0] = (src[j + 0] >> 0) & 0xF;
@@ -1019,11 +1003,8 @@ void ChrSetDepth(NCGR *ncgr, int depth) {
 	}
 
 	//replace graphics
-	for (int i = 0; i < ncgr->nTiles; i++) {
-		if (ncgr->tiles[i] != NULL) free(ncgr->tiles[i]);
-	}
-	free(ncgr->tiles);
-	ncgr->tiles = tiles2;
+	free(ncgr->chars);
+	ncgr->chars = chars2;
 
 	//adjust dimensions and size
 	ncgr->nTiles = nTiles2;
@@ -1047,29 +1028,20 @@ void ChrResize(NCGR *ncgr, int width, int height) {
 	if (ncgr->tilesX == width && ncgr->tilesY == height) return;
 
 	//allocate new buffer
-	unsigned char **chars2 = (unsigned char **) calloc(width * height, sizeof(unsigned char *));
+	unsigned char *chars2 = (unsigned char *) calloc(width * height + 1, 64);
 	unsigned char *attr2 = (unsigned char *) calloc(width * height, 1);
-	for (int y = 0; y < height; y++) {
-		for (int x = 0; x < width; x++) {
-			unsigned char *chr = (unsigned char *) calloc(64, 1);
-			chars2[x + y * width] = chr;
-
-			//read in
-			if (x < ncgr->tilesX && y < ncgr->tilesY) {
-				unsigned char *src = ncgr->tiles[x + y * ncgr->tilesX];
-				memcpy(chr, src, 64);
-				if (ncgr->attr != NULL) attr2[x + y * width] = ncgr->attr[x + y * ncgr->tilesX];
-			}
-		}
+
+	//copy rows of characters that are kept
+	int copyWidth = min(width, ncgr->tilesX), copyHeight = min(height, ncgr->tilesY);
+	for (int y = 0; y < copyHeight; y++) {
+		memcpy(chars2 + y * width * 64, NCGR_CHAR(ncgr, y * ncgr->tilesX), copyWidth * 64);
+		if (ncgr->attr != NULL) memcpy(attr2 + y * width, ncgr->attr + y * ncgr->tilesX, copyWidth);
 	}
 
 	//free original character
-	for (int i = 0; i < ncgr->nTiles; i++) {
-		free(ncgr->tiles[i]);
-	}
-	free(ncgr->tiles);
+	free(ncgr->chars);
 	if (ncgr->attr != NULL) free(ncgr->attr);
-	ncgr->tiles = chars2;
+	ncgr->chars = chars2;
 	ncgr->attr = attr2;
 
 	ncgr->tilesX = width;
@@ -24,6 +24,7 @@
 #define NCGR_BYTE_BOUNDARY(m)   (1<<((((m)>>20)&0x7)+5))
 #define NCGR_BOUNDARY(n,x)      (NCGR_BYTE_BOUNDARY((n)->mappingMode)*(x)/(((n)->nBits)<<3))
 #define NCGR_CHNAME(x,m,b)      (NCGR_BYTE_BOUNDARY(m)*(x)/((b)<<3))
+#define NCGR_CHAR(n,x)          ((n)->chars+(x)*64)
 
 extern LPCWSTR characterFormatNames[];
 
@@ -42,7 +43,7 @@ typedef struct NCGR_{
 	int nBits;
 	int extPalette;     //whether character is using an extended palette
 	unsigned char *attr; //unused by most things
-	BYTE **tiles;
+	unsigned char *chars;     //8bpp pixels of all characters, 64 bytes each (see NCGR_CHAR)
 	CHAR_SLICE *slices;       //for Ghost Trick files
 	int nSlices;              //for Ghost Trick files
 } NCGR;
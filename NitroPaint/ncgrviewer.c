@@ -134,6 +134,37 @@ static void ChrViewerInvalidateAllDependents(HWND hWnd) {
 	}
 }
 
+static int ChrViewerPixelToTile(int px) {
+	//character containing a pixel, also for pixels left of or above the graphics
+	return (px < 0) ? -((7 - px) / 8) : (px / 8);
+}
+
+static void ChrViewerCharactersChanged(NCGRVIEWERDATA *data, int tileX, int tileY, int tilesX, int tilesY) {
+	ObjMarkModified(&data->ncgr.header);
+
+	//clip to graphics bounds
+	if (tileX < 0) tilesX += tileX, tileX = 0;
+	if (tileY < 0) tilesY += tileY, tileY = 0;
+	if (tileX + tilesX > data->ncgr.tilesX) tilesX = data->ncgr.tilesX - tileX;
+	if (tileY + tilesY > data->ncgr.tilesY) tilesY = data->ncgr.tilesY - tileY;
+	if (tilesX <= 0 || tilesY <= 0) return;
+
+	//repaint only the changed characters in this view and in screen viewers
+	HWND hWndMain = getMainWindow(data->hWnd);
+	TedInvalidateTiles((EDITOR_DATA *) data, &data->ted, tileX, tileY, tilesX, tilesY);
+	for (int y = tileY; y < tileY + tilesY; y++) {
+		InvalidateAllEditorsChars(hWndMain, FILE_TYPE_SCREEN, tileX + y * data->ncgr.tilesX, tilesX);
+	}
+
+	//cell and animation editors are updated entirely
+	InvalidateAllEditors(hWndMain, FILE_TYPE_NANR);
+	InvalidateAllEditors(hWndMain, FILE_TYPE_NMCR);
+	NITROPAINTSTRUCT *nitroPaintStruct = NpGetData(hWndMain);
+	if (nitroPaintStruct->hWndNcerViewer != NULL) {
+		CellViewerGraphicsUpdated(nitroPaintStruct->hWndNcerViewer);
+	}
+}
+
 static void ChrViewerGraphicsUpdated(NCGRVIEWERDATA *data) {
 	//graphics data updated, so invalidate the view window.
 	InvalidateRect(data->ted.hWndViewer, NULL, FALSE);
@@ -148,7 +179,7 @@ static void ChrViewerGraphicsUpdated(NCGRVIEWERDATA *data) {
 static void ChrViewerFill(NCGRVIEWERDATA *data, int x, int y, int w, int h, const unsigned char *pat) {
 	for (int i = 0; i < h; i++) {
 		for (int j = 0; j < w; j++) {
-			memcpy(data->ncgr.tiles[(j + x) + (i + y) * data->ncgr.tilesX], pat, 8 * 8);
+			memcpy(NCGR_CHAR(&data->ncgr, (j + x) + (i + y) * data->ncgr.tilesX), pat, 8 * 8);
 		}
 	}
 }
@@ -235,7 +266,7 @@ static void ChrViewerCopyDIB(NCGRVIEWERDATA *data) {
 		unsigned char *scan = px + ((bmHeight - 1 - y) * stride);
 		for (int x = 0; x < bmWidth; x++) {
 			int tileX = x / 8;
-			unsigned char *chr = ncgr->tiles[(selX + tileX) + (selY + tileY) * ncgr->tilesX];
+			unsigned char *chr = NCGR_CHAR(ncgr, (selX + tileX) + (selY + tileY) * ncgr->tilesX);
 
 			int idx = chr[(x % 8) + (y % 8) * 8];
 			if (data->useAttribute) {
@@ -346,7 +377,7 @@ static void ChrViewerCopyNP_CHARS(NCGRVIEWERDATA *data) {
 	unsigned char *chrDest = npc->data + clipPaletteSize;
 	for (int y = 0; y < selH; y++) {
 		for (int x = 0; x < selW; x++) {
-			memcpy(chrDest + 64 * (x + y * selW), data->ncgr.tiles[(selX + x) + (selY + y) * data->ncgr.tilesX], 64);
+			memcpy(chrDest + 64 * (x + y * selW), NCGR_CHAR(&data->ncgr, (selX + x) + (selY + y) * data->ncgr.tilesX), 64);
 		}
 	}
 
@@ -646,7 +677,7 @@ static void ChrViewerPaste(NCGRVIEWERDATA *data, BOOL contextMenu) {
 				if ((pasteY + y) >= ncgr->tilesY) continue;
 
 				int i = x + y * npc->width;
-				memcpy(ncgr->tiles[(pasteX + x) + (pasteY + y) * data->ncgr.tilesX], chars + i * 64, 64);
+				memcpy(NCGR_CHAR(ncgr, (pasteX + x) + (pasteY + y) * data->ncgr.tilesX), chars + i * 64, 64);
 				ChrViewerSetAttribute(data, pasteX + x, pasteY + y, attrs[i]);
 			}
 		}
@@ -783,13 +814,13 @@ static int ChrViewerSetSelectedColor(NCGRVIEWERDATA *data, int col) {
 
 static void ChrViewerPutPixelInternal(NCGR *ncgr, int x, int y, int col) {
 	int chrX = x / 8, chrY = y / 8;
-	unsigned char *chr = ncgr->tiles[chrX + chrY * ncgr->tilesX];
+	unsigned char *chr = NCGR_CHAR(ncgr, chrX + chrY * ncgr->tilesX);
 	chr[(x & 7) + (y & 7) * 8] = col;
 }
 
 static int ChrViewerGetPixelInternal(NCGR *ncgr, int x, int y) {
 	int chrX = x / 8, chrY = y / 8;
-	unsigned char *chr = ncgr->tiles[chrX + chrY * ncgr->tilesX];
+	unsigned char *chr = NCGR_CHAR(ncgr, chrX + chrY * ncgr->tilesX);
 	return chr[(x & 7) + (y & 7) * 8];
 }
 
@@ -908,11 +939,12 @@ static void ChrViewerFlipSelection(NCGRVIEWERDATA *data, BOOL flipH, BOOL flipV)
 		for (int y = 0; y < selH; y++) {
 			for (int x = 0; x < selW / 2; x++) {
 				//flip graphics positions
-				unsigned char **p1 = &data->ncgr.tiles[(selX + x) + (selY + y) * data->ncgr.tilesX];
-				unsigned char **p2 = &data->ncgr.tiles[(selX + selW - 1 - x) + (selY + y) * data->ncgr.tilesX];
-				unsigned char *tmp = *p1;
-				*p1 = *p2;
-				*p2 = tmp;
+				unsigned char *p1 = NCGR_CHAR(&data->ncgr, (selX + x) + (selY + y) * data->ncgr.tilesX);
+				unsigned char *p2 = NCGR_CHAR(&data->ncgr, (selX + selW - 1 - x) + (selY + y) * data->ncgr.tilesX);
+				unsigned char tmp[64];
+				memcpy(tmp, p1, 64);
+				memcpy(p1, p2, 64);
+				memcpy(p2, tmp, 64);
 
 				//flip attributes
 				if (data->ncgr.attr != NULL) {
@@ -927,11 +959,12 @@ static void ChrViewerFlipSelection(NCGRVIEWERDATA *data, BOOL flipH, BOOL flipV)
 		for (int y = 0; y < selH / 2; y++) {
 			for (int x = 0; x < selW; x++) {
 				//flip graphics positions
-				unsigned char **p1 = &data->ncgr.tiles[(selX + x) + (selY + y) * data->ncgr.tilesX];
-				unsigned char **p2 = &data->ncgr.tiles[(selX + x) + (selY + selH - 1 - y) * data->ncgr.tilesX];
-				unsigned char *tmp = *p1;
-				*p1 = *p2;
-				*p2 = tmp;
+				unsigned char *p1 = NCGR_CHAR(&data->ncgr, (selX + x) + (selY + y) * data->ncgr.tilesX);
+				unsigned char *p2 = NCGR_CHAR(&data->ncgr, (selX + x) + (selY + selH - 1 - y) * data->ncgr.tilesX);
+				unsigned char tmp[64];
+				memcpy(tmp, p1, 64);
+				memcpy(p1, p2, 64);
+				memcpy(p2, tmp, 64);
 
 				//flip attributes
 				if (data->ncgr.attr != NULL) {
@@ -946,7 +979,7 @@ static void ChrViewerFlipSelection(NCGRVIEWERDATA *data, BOOL flipH, BOOL flipV)
 	//2: flip individual pixels
 	for (int y = 0; y < selH; y++) {
 		for (int x = 0; x < selW; x++) {
-			unsigned char *chr = data->ncgr.tiles[(x + selX) + (y + selY) * data->ncgr.tilesX];
+			unsigned char *chr = NCGR_CHAR(&data->ncgr, (x + selX) + (y + selY) * data->ncgr.tilesX);
 			if (flipH) {
 				for (int i = 0; i < 32; i++) {
 					int idx = (i % 4) + 8 * (i / 4);
@@ -982,11 +1015,12 @@ static void ChrViewerStampTile(NCGRVIEWERDATA *data, int x, int y) {
 	srcTileX += selX;
 	srcTileY += selY;
 
-	unsigned char *src = data->ncgr.tiles[srcTileX + srcTileY * data->ncgr.tilesX];
-	unsigned char *dst = data->ncgr.tiles[x + y * data->ncgr.tilesX];
+	unsigned char *src = NCGR_CHAR(&data->ncgr, srcTileX + srcTileY * data->ncgr.tilesX);
+	unsigned char *dst = NCGR_CHAR(&data->ncgr, x + y * data->ncgr.tilesX);
 	memcpy(dst, src, 64);
 
-	ChrViewerGraphicsUpdated(data);
+	ChrViewerCharactersChanged(data, x, y, 1, 1);
+	SendMessage(data->hWnd, NV_UPDATEPREVIEW, 0, 0);
 }
 
 
@@ -1013,7 +1047,7 @@ static void ChrViewerExportBitmap(NCGRVIEWERDATA *data, NCGR *ncgr, NCLR *nclr,
 			//no attribute usage
 			for (int tileY = 0; tileY < tilesY; tileY++) {
 				for (int tileX = 0; tileX < tilesX; tileX++) {
-					unsigned char *tile = ncgr->tiles[tileX + tileY * tilesX];
+					unsigned char *tile = NCGR_CHAR(ncgr, tileX + tileY * tilesX);
 					for (int y = 0; y < 8; y++) {
 						memcpy(bits + tileX * 8 + (tileY * 8 + y) * width, tile + y * 8, 8);
 					}
@@ -1023,7 +1057,7 @@ static void ChrViewerExportBitmap(NCGRVIEWERDATA *data, NCGR *ncgr, NCLR *nclr,
 			//attribute usage. for 4-bit graphics, most significant 4 bits are the palette number.
 			for (int tileY = 0; tileY < tilesY; tileY++) {
 				for (int tileX = 0; tileX < tilesX; tileX++) {
-					unsigned char *tile = ncgr->tiles[tileX + tileY * tilesX];
+					unsigned char *tile = NCGR_CHAR(ncgr, tileX + tileY * tilesX);
 					int attr = ChrViewerGetCharPalette(data, tileX, tileY);
 					for (int y = 0; y < 8; y++) {
 						memcpy(bits + tileX * 8 + (tileY * 8 + y) * width, tile + y * 8, 8);
@@ -1063,7 +1097,7 @@ static void ChrViewerExportBitmap(NCGRVIEWERDATA *data, NCGR *ncgr, NCLR *nclr,
 		for (int y = 0; y < height; y++) {
 			for (int x = 0; x < width; x++) {
 				int tileX = x / 8, tileY = y / 8;
-				unsigned char *chr = ncgr->tiles[tileX + tileY * ncgr->tilesX];
+				unsigned char *chr = NCGR_CHAR(ncgr, tileX + tileY * ncgr->tilesX);
 				int idx = chr[(x % 8) + (y % 8) * 8];
 				idx |= ChrViewerGetCharPalette(data, tileX, tileY) << 8;
 
@@ -1145,6 +1179,63 @@ static void ChrViewerSetDepth(HWND hWnd, int depth) {
 	}
 }
 
+// ----- undo
+
+typedef struct ChrViewerUndoHeader_ {
+	int nTiles;
+	int tilesX;
+	int tilesY;
+	int nBits;
+	int hasAttr;
+} ChrViewerUndoHeader;
+
+static void ChrViewerSaveState(HWND hWnd, BSTREAM *stream) {
+	NCGRVIEWERDATA *data = (NCGRVIEWERDATA *) EditorGetData(hWnd);
+	NCGR *ncgr = &data->ncgr;
+
+	ChrViewerUndoHeader header = { ncgr->nTiles, ncgr->tilesX, ncgr->tilesY, ncgr->nBits, ncgr->attr != NULL };
+	bstreamWrite(stream, &header, sizeof(header));
+	bstreamWrite(stream, ncgr->chars, ncgr->nTiles * 64);
+	if (ncgr->attr != NULL) bstreamWrite(stream, ncgr->attr, ncgr->tilesX * ncgr->tilesY);
+}
+
+static void ChrViewerRestoreState(HWND hWnd, const unsigned char *state, unsigned int size) {
+	NCGRVIEWERDATA *data = (NCGRVIEWERDATA *) EditorGetData(hWnd);
+	NCGR *ncgr = &data->ncgr;
+
+	ChrViewerUndoHeader header;
+	memcpy(&header, state, sizeof(header));
+	const unsigned char *chars = state + sizeof(header);
+	const unsigned char *attr = chars + header.nTiles * 64;
+
+	//the graphics may have been resized
+	int resized = header.nTiles != ncgr->nTiles || header.tilesX != ncgr->tilesX || header.tilesY != ncgr->tilesY || header.nBits != ncgr->nBits;
+	if (header.nTiles != ncgr->nTiles) {
+		free(ncgr->chars);
+		ncgr->chars = (unsigned char *) calloc(header.nTiles + 1, 64);
+	}
+	if (ncgr->attr != NULL && (!header.hasAttr || header.tilesX * header.tilesY != ncgr->tilesX * ncgr->tilesY)) {
+		free(ncgr->attr);
+		ncgr->attr = NULL;
+	}
+	if (header.hasAttr && ncgr->attr == NULL) {
+		ncgr->attr = (unsigned char *) calloc(header.tilesX * header.tilesY + 1, 1);
+	}
+	ncgr->nTiles = header.nTiles;
+	ncgr->tilesX = header.tilesX;
+	ncgr->tilesY = header.tilesY;
+	ncgr->nBits = header.nBits;
+	memcpy(ncgr->chars, chars, header.nTiles * 64);
+	if (header.hasAttr) memcpy(ncgr->attr, attr, header.tilesX * header.tilesY);
+
+	if (resized) {
+		TedUpdateSize((EDITOR_DATA *) data, &data->ted, ncgr->tilesX, ncgr->tilesY);
+		ChrViewerPopulateWidthField(hWnd);
+		SendMessage(data->ted.hWndViewer, NV_RECALCULATE, 0, 0);
+	}
+	ChrViewerGraphicsUpdated(data);
+}
+
 typedef struct CHARIMPORTDATA_ {
 	COLOR32 *px;
 	int width;
@@ -1178,6 +1269,8 @@ static void ChrViewerOnCreate(HWND hWnd) {
 	data->mode = CHRVIEWER_MODE_SELECT;
 	data->lastMode = CHRVIEWER_MODE_PEN;
 	data->showBorders = 1;
+	ChrCacheInit(&data->chrCache);
+	data->hoverChar = -1;
 	data->scale = 2; //default 200%
 	data->selectedPalette = 0;
 	data->useAttribute = 0;
@@ -1319,6 +1412,7 @@ static void ChrViewerOnDestroy(HWND hWnd) {
 	if (hWndNclrViewer != NULL) InvalidateRect(hWndNclrViewer, NULL, FALSE);
 	ChrViewerInvalidateAllDependents(hWnd);
 	TedDestroy(&data->ted);
+	ChrCacheFree(&data->chrCache);
 }
 
 static int ChrViewerOnTimer(HWND hWnd, int idTimer) {
@@ -1426,14 +1520,12 @@ static void ChrViewerImportDialog(NCGRVIEWERDATA *data, BOOL createPalette, int
 
 static void ChrViewerImportAttributesFromScreen(NCGRVIEWERDATA *data, NSCRVIEWERDATA *nscrViewerData) {
 	NCGR *ncgr = &data->ncgr;
-	NSCR *nscr = &nscrViewerData->nscr;
+	ScrUsage *usage = ScrViewerGetUsage(nscrViewerData->hWnd);
 
-	int nTiles = nscr->tilesX * nscr->tilesY;
-	for (int i = 0; i < nTiles; i++) {
-		uint16_t d = nscr->data[i];
-		int chrno = (d >>  0) & 0x03FF;
-		int palno = (d >> 12) & 0x000F;
-		chrno -= nscrViewerData->tileBase;
+	//each character takes the palette most of the screen uses it with
+	for (int chrno = 0; chrno < ncgr->nTiles; chrno++) {
+		int palno = ScrUsageGetPalette(usage, chrno + nscrViewerData->tileBase);
+		if (palno == -1) continue;
 
 		ChrViewerSetAttribute(data, chrno % ncgr->tilesX, chrno / ncgr->tilesX, palno);
 	}
@@ -1660,16 +1752,22 @@ static void ChrViewerUpdateCursorCallback(HWND hWnd, int pxX, int pxY) {
 		{
 			int pcol = ChrViewerGetSelectedColor(data);
 			if (pcol != -1) {
+				int lastPxX = pxX, lastPxY = pxY;
 				if (data->ted.lastMouseX != -1 && data->ted.lastMouseY != -1) {
 					//connect last point
-					int lastPxX = (data->ted.lastMouseX + scrollX) / data->scale;
-					int lastPxY = (data->ted.lastMouseY + scrollY) / data->scale;
+					lastPxX = (data->ted.lastMouseX + scrollX) / data->scale;
+					lastPxY = (data->ted.lastMouseY + scrollY) / data->scale;
 					ChrViewerConnectLine(data, lastPxX, lastPxY, pxX, pxY, pcol);
 				} else {
 					//draw single pixel
 					ChrViewerPutPixel(data, pxX, pxY, pcol);
 				}
-				ChrViewerInvalidateAllDependents(data->hWnd);
+
+				//update characters the stroke passed through. Either end may lie off the
+				//graphics, so round toward negative infinity and let the update clip.
+				int tileX1 = ChrViewerPixelToTile(min(pxX, lastPxX)), tileX2 = ChrViewerPixelToTile(max(pxX, lastPxX));
+				int tileY1 = ChrViewerPixelToTile(min(pxY, lastPxY)), tileY2 = ChrViewerPixelToTile(max(pxY, lastPxY));
+				ChrViewerCharactersChanged(data, tileX1, tileY1, tileX2 - tileX1 + 1, tileY2 - tileY1 + 1);
 			}
 			break;
 		}
@@ -1713,20 +1811,43 @@ static void ChrViewerOnHoverChange(HWND hWnd, int tileX, int tileY) {
 
 	ChrViewerUpdateCharacterLabel(hWnd);
 
-	//update screen viewers
-	int nScrViewers = GetAllEditors(getMainWindow(hWnd), FILE_TYPE_SCREEN, NULL, 0);
-	if (nScrViewers > 0) {
-		HWND *hWnds = (HWND *) calloc(nScrViewers, sizeof(HWND));
-		GetAllEditors(getMainWindow(hWnd), FILE_TYPE_SCREEN, hWnds, nScrViewers);
+	//update hover indication of the previous and new character in screen viewers
+	HWND hWndMain = getMainWindow(hWnd);
+	if (data->hoverChar != -1) InvalidateAllEditorsChars(hWndMain, FILE_TYPE_SCREEN, data->hoverChar, 1);
+	data->hoverChar = data->ted.hoverIndex;
+	if (data->hoverChar != -1) InvalidateAllEditorsChars(hWndMain, FILE_TYPE_SCREEN, data->hoverChar, 1);
+}
+
+static LRESULT ChrViewerOnInvalidateColors(NCGRVIEWERDATA *data, int start, int count) {
+	//range of palettes using the changed colors
+	int paltFirst = start >> data->ncgr.nBits;
+	int paltLast = (start + count - 1) >> data->ncgr.nBits;
+
+	if (!data->useAttribute || data->ncgr.attr == NULL) {
+		//all characters use the same palette
+		int plt = ChrViewerGetCharPalette(data, 0, 0);
+		if (plt >= paltFirst && plt <= paltLast) InvalidateRect(data->ted.hWndViewer, NULL, FALSE);
+		return 1;
+	}
+
+	//invalidate runs of characters using an affected palette
+	for (int y = 0; y < data->ncgr.tilesY; y++) {
+		int runStart = -1;
+		for (int x = 0; x <= data->ncgr.tilesX; x++) {
+			int inRange = 0;
+			if (x < data->ncgr.tilesX) {
+				int plt = ChrViewerGetCharPalette(data, x, y);
+				inRange = plt >= paltFirst && plt <= paltLast;
+			}
 
-		//invalidate viewer region of each BG screen editor
-		for (int i = 0; i < nScrViewers; i++) {
-			NSCRVIEWERDATA *nscrViewerData = (NSCRVIEWERDATA *) EditorGetData(hWnds[i]);
-			InvalidateRect(nscrViewerData->ted.hWndViewer, NULL, FALSE);
+			if (inRange && runStart == -1) runStart = x;
+			if (!inRange && runStart != -1) {
+				TedInvalidateTiles((EDITOR_DATA *) data, &data->ted, runStart, y, x - runStart, 1);
+				runStart = -1;
+			}
 		}
-
-		free(hWnds);
 	}
+	return 1;
 }
 
 static BOOL ChrViewerSetCursor(NCGRVIEWERDATA *data, WPARAM wParam, LPARAM lParam) {
@@ -1809,9 +1930,13 @@ static LRESULT WINAPI ChrViewerWndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARA
 			ChrViewerOnInitialize(hWnd, (LPCWSTR) wParam, (NCGR *) lParam, msg == NV_INITIALIZE_IMMEDIATE);
 			break;
 		case NV_UPDATEPREVIEW:
+			//sent after the graphics are edited, also by other editors
+			ObjMarkModified(&data->ncgr.header);
 			PreviewLoadBgCharacter(&data->ncgr);
 			PreviewLoadObjCharacter(&data->ncgr);
 			break;
+		case NV_INVALIDATECOLORS:
+			return ChrViewerOnInvalidateColors(data, (int) wParam, (int) lParam);
 		case WM_COMMAND:
 			ChrViewerOnCommand(hWnd, wParam, lParam);
 			break;
@@ -1853,6 +1978,12 @@ static int ChrViewerShouldSuppressHighlight(HWND hWnd) {
 	return !(data->mode == CHRVIEWER_MODE_SELECT || data->mode == CHRVIEWER_MODE_STAMP);
 }
 
+static const COLOR32 *ChrViewerGetRenderTile(void *param, int tileX, int tileY) {
+	NCGRVIEWERDATA *data = (NCGRVIEWERDATA *) param;
+	int plt = ChrViewerGetCharPalette(data, tileX, tileY);
+	return ChrCacheGetTile(&data->chrCache, tileX + tileY * data->ncgr.tilesX, plt, 0);
+}
+
 static void ChrViewerRender(HWND hWnd, FrameBuffer *fb, int scrollX, int scrollY, int renderWidth, int renderHeight) {
 	NCGRVIEWERDATA *data = (NCGRVIEWERDATA *) EditorGetData(hWnd);
 
@@ -1861,7 +1992,6 @@ static void ChrViewerRender(HWND hWnd, FrameBuffer *fb, int scrollX, int scrollY
 	int hlMode = data->verifySelMode;
 	if ((data->verifyFrames & 1) == 0) hlStart = hlEnd = -1;
 
-	NCGR *ncgr = &data->ncgr;
 	NCLR *nclr = NULL;
 
 	HWND hWndMain = getMainWindow(data->hWnd);
@@ -1870,48 +2000,9 @@ static void ChrViewerRender(HWND hWnd, FrameBuffer *fb, int scrollX, int scrollY
 		nclr = (NCLR *) EditorGetObject(nitroPaintStruct->hWndNclrViewer);
 	}
 
-	int tilesX = ncgr->tilesX, tilesY = ncgr->tilesY;
-
-	for (int y = 0; y < renderHeight; y++) {
-		for (int x = 0; x < renderWidth; x++) {
-			int srcX = (x + scrollX) / data->scale;
-			int srcY = (y + scrollY) / data->scale;
-
-			int srcTileX = srcX / 8;
-			int srcTileY = srcY / 8;
-			unsigned char *chr = ncgr->tiles[srcTileX + srcTileY * tilesX];
-			int plt = ChrViewerGetCharPalette(data, srcTileX, srcTileY);
-			int rawIdx = chr[(srcX % 8) + (srcY % 8) * 8];
-			int idx = rawIdx + (plt << ncgr->nBits);
-
-			COLOR32 col;
-			if (!data->transparent || rawIdx > 0) {
-				//do not render transparent background
-				if (nclr != NULL && idx < nclr->nColors) {
-					//color from palette
-					col = ColorConvertFromDS(nclr->colors[idx]);
-				} else {
-					//color out of palette bounds: fill with black
-					col = 0;
-				}
-			} else {
-				//render transparent
-				COLOR32 checker[] = { 0xFFFFFF, 0xC0C0C0 };
-				col = checker[((x ^ y) >> 2) & 1];
-			}
-
-			//process verify color indication
-			if (hlStart != -1 && hlEnd != -1) {
-				if (PalViewerIndexInRange(idx, hlStart, hlEnd, hlMode == PALVIEWER_SELMODE_2D)) {
-					int lightness = (col & 0xFF) + ((col >> 8) & 0xFF) + ((col >> 16) & 0xFF);
-					if (lightness < 383) col = 0xFFFFFFFF;
-					else col = 0xFF000000;
-				}
-			}
-
-			data->ted.fb.px[x + y * data->ted.fb.width] = REVERSE(col);
-		}
-	}
+	//render from cached tiles
+	ChrCacheSetSource(&data->chrCache, &data->ncgr, nclr, data->transparent, hlStart, hlEnd, hlMode == PALVIEWER_SELMODE_2D);
+	ChrCacheRender(fb, scrollX, scrollY, renderWidth, renderHeight, data->scale, ChrViewerGetRenderTile, data);
 }
 
 static void ChrViewerOnLButtonDown(NCGRVIEWERDATA *data) {
@@ -1944,7 +2035,8 @@ static void ChrViewerOnLButtonDown(NCGRVIEWERDATA *data) {
 			} else {
 				//put pixel at coordinates
 				ChrViewerPutPixel(data, pxX, pxY, pcol);
-				ChrViewerGraphicsUpdated(data);
+				ChrViewerCharactersChanged(data, pxX / 8, pxY / 8, 1, 1);
+				SendMessage(data->hWnd, NV_UPDATEPREVIEW, 0, 0);
 			}
 			break;
 		}
@@ -2211,6 +2303,8 @@ static int ChrImportCallback(void *cbdata) {
 	HWND hWndMain = getMainWindow(data->hWnd);
 	BOOL import1D = cim->import1D;
 
+	ObjMarkModified(&data->ncgr.header);
+	if (cim->nclr != NULL) ObjMarkModified(&cim->nclr->header);
 	InvalidateAllEditors(hWndMain, FILE_TYPE_PALETTE);
 	InvalidateAllEditors(hWndMain, FILE_TYPE_CHAR);
 	InvalidateAllEditors(hWndMain, FILE_TYPE_SCREEN);
@@ -2307,7 +2401,7 @@ static void charImport(NCLR *nclr, NCGR *ncgr, COLOR32 *pixels, int width, int h
 		for (int y = 0; y < tilesY; y++) {
 			for (int x = 0; x < tilesX; x++) {
 				int offset = (y + originY) * ncgr->tilesX + x + originX;
-				BYTE *tile = ncgr->tiles[offset];
+				BYTE *tile = NCGR_CHAR(ncgr, offset);
 
 				//write out this tile using the palette. Diffuse any error accordingly.
 				for (int i = 0; i < 64; i++) {
@@ -2388,7 +2482,7 @@ static void charImport(NCLR *nclr, NCGR *ncgr, COLOR32 *pixels, int width, int h
 		int destBaseIndex = originX + originY * ncgr->tilesX;
 		int nWriteChars = min(nChars, ncgr->nTiles - destBaseIndex);
 		for (int i = 0; i < nWriteChars; i++) {
-			BYTE *tile = ncgr->tiles[i + destBaseIndex];
+			BYTE *tile = NCGR_CHAR(ncgr, i + destBaseIndex);
 			COLOR32 *srcTile = tiles + i * 64;
 
 			for (int j = 0; j < 64; j++) {
@@ -2582,8 +2676,9 @@ static void RegisterCharImportClass(void) {
 }
 
 void RegisterNcgrViewerClass(void) {
-	int features = EDITOR_FEATURE_ZOOM | EDITOR_FEATURE_GRIDLINES;
+	int features = EDITOR_FEATURE_ZOOM | EDITOR_FEATURE_GRIDLINES | EDITOR_FEATURE_UNDO;
 	EDITOR_CLASS *cls = EditorRegister(L"NcgrViewerClass", ChrViewerWndProc, L"Character Editor", sizeof(NCGRVIEWERDATA), features);
+	EditorSetUndoProcs(cls, ChrViewerSaveState, ChrViewerRestoreState);
 	EditorAddFilter(cls, NCGR_TYPE_NCGR, L"ncgr", L"NCGR Files (*.ncgr)\0*.ncgr\0");
 	EditorAddFilter(cls, NCGR_TYPE_NC, L"ncg", L"NCG Files (*.ncg)\0*.ncg\0");
 	EditorAddFilter(cls, NCGR_TYPE_IC, L"icg", L"ICG Files (*.icg)\0*.icg\0");
@@ -4,6 +4,7 @@
 #include "ncgr.h"
 #include "framebuffer.h"
 #include "tilededitor.h"
+#include "chrcache.h"
 
 typedef enum ChrViewerMode_ {
 	CHRVIEWER_MODE_SELECT,            // create selections
@@ -40,6 +41,8 @@ typedef struct {
 	HWND hWnd8bpp;
 	
 	TedData ted;
+	ChrCache chrCache;
+	int hoverChar;              // character last indicated as hovered to screen viewers
 } NCGRVIEWERDATA;
 
 VOID RegisterNcgrViewerClass(VOID);
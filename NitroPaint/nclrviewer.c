@@ -678,6 +678,7 @@ static void PalViewerUpdateNcerViewer(HWND hWndMain) {
 
 static void PalViewerUpdateViewers(HWND hWnd, int updateMask) {
 	HWND hWndMain = getMainWindow(hWnd);
+	ObjMarkModified(EditorGetObject(hWnd));
 
 	//update viewers
 	if (updateMask & PALVIEWER_UPDATE_CHAR) {
@@ -694,6 +695,16 @@ static void PalViewerUpdateViewers(HWND hWnd, int updateMask) {
 	}
 }
 
+static void PalViewerColorsChanged(HWND hWnd, int start, int count) {
+	HWND hWndMain = getMainWindow(hWnd);
+	ObjMarkModified(EditorGetObject(hWnd));
+
+	//character and screen viewers repaint only what uses the changed colors
+	InvalidateAllEditorsColors(hWndMain, FILE_TYPE_CHARACTER, start, count);
+	InvalidateAllEditorsColors(hWndMain, FILE_TYPE_SCREEN, start, count);
+	PalViewerUpdateNcerViewer(hWndMain);
+}
+
 static int CountPaletteUsages(HWND hWndMain, NCLR *nclr, int *counts) {
 	//if no screen editor open, get use counts from character
 	int nScreen = GetAllEditors(hWndMain, FILE_TYPE_SCREEN, NULL, 0);
@@ -708,7 +719,7 @@ static int CountPaletteUsages(HWND hWndMain, NCLR *nclr, int *counts) {
 		int palBase = data->selectedPalette;
 		int palSize = 1 << data->ncgr.nBits;
 		for (int i = 0; i < data->ncgr.nTiles; i++) {
-			unsigned char *tile = data->ncgr.tiles[i];
+			unsigned char *tile = NCGR_CHAR(&data->ncgr, i);
 			for (int j = 0; j < 64; j++) {
 				int index = tile[j] + palBase * palSize;
 				if (index < nclr->nColors) counts[index]++;
@@ -728,24 +739,25 @@ static int CountPaletteUsages(HWND hWndMain, NCLR *nclr, int *counts) {
 		HWND *hWndScreens = (HWND *) calloc(nScreen, sizeof(HWND));
 		GetAllEditors(hWndMain, FILE_TYPE_SCREEN, hWndScreens, nScreen);
 
-		//measure every screen
+		//measure every screen, once per character and palette it is used with
 		for (int i = 0; i < nScreen; i++) {
 			NSCRVIEWERDATA *data = (NSCRVIEWERDATA *) EditorGetData(hWndScreens[i]);
-			for (unsigned int j = 0; j < data->nscr.dataSize / 2; j++) {
-				uint16_t tile = data->nscr.data[j];
-				int charIndex = (tile & 0x3FF) - data->tileBase;
-				int palBase = (tile >> 12) & 0xF;
-				if (charIndex < 0) continue;
+			ScrUsage *usage = ScrViewerGetUsage(hWndScreens[i]);
+			for (int charIndex = 0; charIndex < ncgrData->ncgr.nTiles; charIndex++) {
+				int chrno = charIndex + data->tileBase;
+				if (ScrUsageGetFirstCell(usage, chrno) == -1) continue;
 
 				//tally up palette indices
-				if (charIndex < ncgrData->ncgr.nTiles) {
+				for (int palBase = 0; palBase < 16; palBase++) {
+					unsigned int nUses = ScrUsageGetPaletteCount(usage, chrno, palBase);
+					if (nUses == 0) continue;
+
 					for (int k = 0; k < 64; k++) {
-						int index = ncgrData->ncgr.tiles[charIndex][k];
+						int index = NCGR_CHAR(&ncgrData->ncgr, charIndex)[k];
 						index += palBase * palSize;
-						if (index < nclr->nColors) counts[index]++;
+						if (index < nclr->nColors) counts[index] += nUses;
 					}
 				}
-
 			}
 		}
 
@@ -764,7 +776,9 @@ static COLOR32 MakeContrastingColor(COLOR32 c) {
 }
 
 static void PalViewerUpdatePreview(HWND hWnd) {
+	//called after each edit of the palette, also by other editors through NV_UPDATEPREVIEW
 	NCLRVIEWERDATA *data = (NCLRVIEWERDATA *) EditorGetData(hWnd);
+	ObjMarkModified(&data->nclr.header);
 	PreviewLoadBgPalette(&data->nclr); //send to preview target
 	PreviewLoadObjPalette(&data->nclr);
 	InvalidateRect(hWnd, NULL, FALSE); //redraw
@@ -783,24 +797,19 @@ static COLOR *PalViewerComputeViewPalette(NCLRVIEWERDATA *data) {
 	return cols;
 }
 
-static int PalViewerCharUsedByScreens(int ch, NSCR **screens, int nScreens, uint16_t *pFoundTile) {
+static int PalViewerCharUsedByScreens(int ch, ScrUsage **usages, const int *tileBases, int nScreens, int *pUsedPalette) {
 	for (int i = 0; i < nScreens; i++) {
-		NSCR *nscr = screens[i];
-
-		for (unsigned int j = 0; j < nscr->dataSize / 2; j++) {
-			uint16_t d = nscr->data[j];
-			int cno = d & 0x3FF;
-			if (cno == ch) {
-				*pFoundTile = d;
-				return 1; //TODO: tile base setting in screen viewer
-			}
+		int palno = ScrUsageGetPalette(usages[i], ch + tileBases[i]);
+		if (palno != -1) {
+			*pUsedPalette = palno;
+			return 1;
 		}
 	}
 
 	return 0;
 }
 
-static void PalViewerDoPreserveTransform(NCLRVIEWERDATA *data, NCGR *ncgr, NSCR **screens, int nScreens) {
+static void PalViewerDoPreserveTransform(NCLRVIEWERDATA *data, NCGR *ncgr, HWND *hWndScreens, int nScreens) {
 	//if no character or screen, return
 	if (ncgr == NULL && nScreens == 0) return;
 
@@ -836,7 +845,7 @@ static void PalViewerDoPreserveTransform(NCLRVIEWERDATA *data, NCGR *ncgr, NSCR
 		int palDest = (selX + selY * 16 + delta) >> depth;
 		int palDestEnd = (selX + selWidth - 1 + 16 * (selY + selHeight - 1) + delta) >> depth;
 		for (int i = 0; i < nScreens; i++) {
-			NSCR *nscr = screens[i];
+			NSCR *nscr = (NSCR *) EditorGetObject(hWndScreens[i]);
 
 			//for each tile in screen
 			for (unsigned int j = 0; j < nscr->dataSize / 2; j++) {
@@ -867,20 +876,27 @@ static void PalViewerDoPreserveTransform(NCLRVIEWERDATA *data, NCGR *ncgr, NSCR
 				d = (d & 0xFFF) | (dpal << 12);
 				nscr->data[j] = d;
 			}
+			ObjMarkModified(&nscr->header);
 		}
 		PalViewerUpdateViewers(data->hWnd, PALVIEWER_UPDATE_SCREEN);
 	} else {
 		//update graphics data
 		if (ncgr == NULL) return;
 
+		//bring each screen's usage index up to date once, the loop below only reads them
+		ScrUsage **usages = (ScrUsage **) calloc(nScreens, sizeof(ScrUsage *));
+		int *tileBases = (int *) calloc(nScreens, sizeof(int));
+		for (int i = 0; i < nScreens; i++) {
+			usages[i] = ScrViewerGetUsage(hWndScreens[i]);
+			tileBases[i] = ((NSCRVIEWERDATA *) EditorGetData(hWndScreens[i]))->tileBase;
+		}
+
 		//for each character of graphics, update the graphics indices.
 		for (int i = 0; i < ncgr->nTiles; i++) {
-			unsigned char *chr = ncgr->tiles[i];
+			unsigned char *chr = NCGR_CHAR(ncgr, i);
 
-			uint16_t foundTile = 0;
-			if (nScreens == 0 || PalViewerCharUsedByScreens(i, screens, nScreens, &foundTile)) {
-				//which palette this char was found with
-				int usedPalette = foundTile >> 12;
+			int usedPalette = 0; //which palette this char was found with
+			if (nScreens == 0 || PalViewerCharUsedByScreens(i, usages, tileBases, nScreens, &usedPalette)) {
 				int palBaseIndex = usedPalette << depth;
 
 				for (int j = 0; j < 64; j++) {
@@ -890,7 +906,10 @@ static void PalViewerDoPreserveTransform(NCLRVIEWERDATA *data, NCGR *ncgr, NSCR
 				}
 			}
 		}
+		free(usages);
+		free(tileBases);
 
+		ObjMarkModified(&ncgr->header);
 		PalViewerUpdateViewers(data->hWnd, PALVIEWER_UPDATE_ALL);
 	}
 	free(invmap);
@@ -1317,13 +1336,12 @@ static void PalViewerSortSelection(HWND hWnd, NCLRVIEWERDATA *data, int command)
 					GetAllEditors(hWndMain, FILE_TYPE_SCREEN, hScreenEditors, nScreenEditors);
 					for (int i = 0; i < nScreenEditors; i++) {
 						//determine which palette each tile is using.
-						NSCR *nscr = (NSCR *) EditorGetObject(hScreenEditors[i]);
 						NSCRVIEWERDATA *nscrViewerData = (NSCRVIEWERDATA *) EditorGetData(hScreenEditors[i]);
+						ScrUsage *usage = ScrViewerGetUsage(hScreenEditors[i]);
 
-						for (unsigned int i = 0; i < nscr->dataSize / 2; i++) {
-							uint16_t scrd = nscr->data[i];
-							int chrno = (scrd & 0x3FF) - nscrViewerData->tileBase;
-							if (chrno >= 0 && chrno < ncgr->nTiles) tilePalettes[chrno] = scrd >> 12;
+						for (int j = 0; j < ncgr->nTiles; j++) {
+							int palno = ScrUsageGetPalette(usage, j + nscrViewerData->tileBase);
+							if (palno != -1) tilePalettes[j] = palno;
 						}
 					}
 					free(hScreenEditors);
@@ -1339,7 +1357,7 @@ static void PalViewerSortSelection(HWND hWnd, NCLRVIEWERDATA *data, int command)
 				//apply transform
 				for (int i = 0; i < ncgr->nTiles; i++) {
 					int pltBase = tilePalettes[i] << ncgr->nBits;
-					unsigned char *tile = ncgr->tiles[i];
+					unsigned char *tile = NCGR_CHAR(ncgr, i);
 
 					for (int i = 0; i < 64; i++) {
 						int cidx = tile[i] + pltBase;
@@ -1355,6 +1373,7 @@ static void PalViewerSortSelection(HWND hWnd, NCLRVIEWERDATA *data, int command)
 						tile[i] = (to - pltBase) & ((1 << ncgr->nBits) - 1);
 					}
 				}
+				ObjMarkModified(&ncgr->header);
 
 				free(tilePalettes);
 
@@ -1363,6 +1382,7 @@ static void PalViewerSortSelection(HWND hWnd, NCLRVIEWERDATA *data, int command)
 		free(tmp);
 
 		//update all editors dependent
+		ObjMarkModified(&data->nclr.header);
 		InvalidateAllEditors(hWndMain, FILE_TYPE_CHAR);
 		InvalidateAllEditors(hWndMain, FILE_TYPE_SCREEN);
 		PalViewerUpdateNcerViewer(hWndMain);
@@ -1373,6 +1393,39 @@ static void PalViewerSortSelection(HWND hWnd, NCLRVIEWERDATA *data, int command)
 	PalViewerUpdatePreview(hWnd);
 }
 
+static void PalViewerSaveState(HWND hWnd, BSTREAM *stream) {
+	NCLRVIEWERDATA *data = (NCLRVIEWERDATA *) EditorGetData(hWnd);
+
+	bstreamWrite(stream, &data->nclr.nColors, sizeof(data->nclr.nColors));
+	bstreamWrite(stream, data->nclr.colors, data->nclr.nColors * sizeof(COLOR));
+}
+
+static void PalViewerRestoreState(HWND hWnd, const unsigned char *state, unsigned int size) {
+	NCLRVIEWERDATA *data = (NCLRVIEWERDATA *) EditorGetData(hWnd);
+
+	int nColors;
+	memcpy(&nColors, state, sizeof(nColors));
+	if (nColors != data->nclr.nColors) {
+		data->nclr.colors = (COLOR *) realloc(data->nclr.colors, (nColors + 1) * sizeof(COLOR));
+		data->nclr.nColors = nColors;
+
+		//selection may be out of the palette
+		data->selStart = data->selEnd = -1;
+		data->frameData.contentHeight = ((nColors + 15) / 16) * COLOR_SIZE;
+
+		SCROLLINFO info;
+		info.cbSize = sizeof(info);
+		info.nMin = 0;
+		info.nMax = data->frameData.contentHeight;
+		info.fMask = SIF_RANGE;
+		SetScrollInfo(hWnd, SB_VERT, &info, TRUE);
+	}
+	memcpy(data->nclr.colors, state + sizeof(nColors), nColors * sizeof(COLOR));
+
+	PalViewerUpdatePreview(hWnd);
+	PalViewerUpdateViewers(hWnd, PALVIEWER_UPDATE_ALL);
+}
+
 static LRESULT WINAPI PalViewerWndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 	NCLRVIEWERDATA *data = (NCLRVIEWERDATA *) EditorGetData(hWnd);
 
@@ -1623,9 +1676,7 @@ static LRESULT WINAPI PalViewerWndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARA
 							DWORD result = cc.rgbResult;
 							data->nclr.colors[index] = ColorConvertToDS(result);
 							
-							InvalidateAllEditors(hWndMain, FILE_TYPE_CHAR);
-							InvalidateAllEditors(hWndMain, FILE_TYPE_SCREEN);
-							PalViewerUpdateNcerViewer(hWndMain);
+							PalViewerColorsChanged(hWnd, index, 1);
 							PalViewerUpdatePreview(hWnd);
 						}
 					}
@@ -1641,7 +1692,6 @@ static LRESULT WINAPI PalViewerWndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARA
 				//now: if we use a preserve drag, update accordingly.
 				if (data->preserveDragging) {
 					NCGR *ncgr = NULL;
-					NSCR **nscrs = NULL;
 					HWND hWndNcgrViewer = PalViewerGetAssociatedWindow(hWnd, FILE_TYPE_CHAR);
 					if (hWndNcgrViewer != NULL) ncgr = (NCGR *) EditorGetObject(hWndNcgrViewer);
 					
@@ -1649,15 +1699,10 @@ static LRESULT WINAPI PalViewerWndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARA
 					HWND hWndMain = getMainWindow(hWnd);
 					int nScreens = GetAllEditors(hWndMain, FILE_TYPE_SCREEN, NULL, 0);
 					HWND *hWndScreenEditors = (HWND *) calloc(nScreens, sizeof(HWND));
-					nscrs = (NSCR **) calloc(nScreens, sizeof(NSCR *));
 					GetAllEditors(hWndMain, FILE_TYPE_SCREEN, hWndScreenEditors, nScreens);
-					for (int i = 0; i < nScreens; i++) {
-						nscrs[i] = (NSCR *) EditorGetObject(hWndScreenEditors[i]);
-					}
-					free(hWndScreenEditors);
 
-					PalViewerDoPreserveTransform(data, ncgr, nscrs, nScreens);
-					free(nscrs);
+					PalViewerDoPreserveTransform(data, ncgr, hWndScreenEditors, nScreens);
+					free(hWndScreenEditors);
 				}
 
 				//move drag selection
@@ -1720,6 +1765,8 @@ static LRESULT WINAPI PalViewerWndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARA
 			break;
 		}
 		case NV_XTINVALIDATE:
+			//the palette was sorted in another thread
+			ObjMarkModified(&data->nclr.header);
 			InvalidateRect(hWnd, NULL, FALSE);
 			break;
 		case WM_PAINT:
@@ -1815,11 +1862,14 @@ static LRESULT WINAPI PalViewerWndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARA
 						CloseClipboard();
 
 						//erase all colors in selected region
+						int first = -1, last = -1;
 						for (int i = 0; i < data->nclr.nColors; i++) {
 							if (!PalViewerIndexInSelection(data, i)) continue;
 							data->nclr.colors[i] = 0;
+							if (first == -1) first = i;
+							last = i;
 						}
-						PalViewerUpdateViewers(hWnd, PALVIEWER_UPDATE_ALL);
+						if (first != -1) PalViewerColorsChanged(hWnd, first, last + 1 - first);
 						PalViewerUpdatePreview(hWnd);
 						break;
 					}
@@ -2055,12 +2105,15 @@ static LRESULT WINAPI PalViewerWndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARA
 			switch (cc) {
 				case VK_DELETE:
 				{
+					int first = -1, last = -1;
 					for (int i = 0; i < data->nclr.nColors; i++) {
 						if (!PalViewerIndexInSelection(data, i)) continue;
 						data->nclr.colors[i] = 0;
+						if (first == -1) first = i;
+						last = i;
 					}
 					InvalidateRect(hWnd, NULL, FALSE);
-					PalViewerUpdateViewers(hWnd, PALVIEWER_UPDATE_CHAR | PALVIEWER_UPDATE_CELL | PALVIEWER_UPDATE_SCREEN);
+					if (first != -1) PalViewerColorsChanged(hWnd, first, last + 1 - first);
 					break;
 				}
 				case VK_ESCAPE:
@@ -2343,8 +2396,9 @@ static void PalViewerRegisterPaletteFillClass(void) {
 }
 
 void RegisterNclrViewerClass(void) {
-	int features = 0;
+	int features = EDITOR_FEATURE_UNDO;
 	EDITOR_CLASS *cls = EditorRegister(L"NclrViewerClass", PalViewerWndProc, L"Palette Editor", sizeof(NCLRVIEWERDATA), features);
+	EditorSetUndoProcs(cls, PalViewerSaveState, PalViewerRestoreState);
 	EditorAddFilter(cls, NCLR_TYPE_NCLR, L"nclr", L"NCLR Files (*.nclr)\0*.nclr\0");
 	EditorAddFilter(cls, NCLR_TYPE_BIN, L"bin", L"Palette Files (*.bin, *ncl.bin, *icl.bin, *.nbfp, *.icl, *.acl)\0*.bin;*.nbfp;*.icl;*.acl;\0");
 	EditorAddFilter(cls, NCLR_TYPE_HUDSON, L"bin", L"Palette Files (*.bin, *ncl.bin, *icl.bin, *.nbfp, *.icl, *.acl)\0*.bin;*.nbfp;*.icl;*.acl;\0");
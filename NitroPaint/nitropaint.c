@@ -25,6 +25,8 @@
 #include "bggen.h"
 #include "editor.h"
 #include "preview.h"
+#include "texbench.h"
+#include "cellbatch.h"
 
 #pragma comment(linker, "\"/manifestdependency:type='win32' \
 name='Microsoft.Windows.Common-Controls' version='6.0.0.0' \
@@ -786,8 +788,10 @@ VOID CreateImageDialog(HWND hWnd, LPCWSTR path);
 
 VOID OpenFileByName(HWND hWnd, LPCWSTR path) {
 	NITROPAINTSTRUCT *data = (NITROPAINTSTRUCT *) GetWindowLongPtr(hWnd, 0);
-	DWORD dwSize = 0;
-	char *buffer = (char *) ObjReadWholeFile(path, &dwSize);
+	OBJ_FILE_MAPPING mapping;
+	ObjMapFile(path, &mapping);
+	char *buffer = (char *) mapping.buffer;
+	DWORD dwSize = mapping.size;
 
 	//test: Is this a specification file to open a file with?
 	if (specIsSpec(buffer, dwSize)) {
@@ -1013,7 +1017,7 @@ VOID OpenFileByName(HWND hWnd, LPCWSTR path) {
 	}
 
 cleanup:
-	free(buffer);
+	ObjUnmapFile(&mapping);
 }
 
 NITROPAINTSTRUCT *NpGetData(HWND hWndMain) {
@@ -1101,6 +1105,28 @@ void InvalidateAllEditors(HWND hWndMain, int type) {
 	EnumChildWindows(hWndMdi, InvalidateAllEditorsProc, type);
 }
 
+static BOOL InvalidateEditorRangeProc(HWND hWnd, void *param) {
+	struct { UINT msg; int start; int count; } *inv = param;
+
+	//editors that can't repaint only the affected region repaint entirely
+	if (!SendMessage(hWnd, inv->msg, inv->start, inv->count)) {
+		InvalidateRect(hWnd, NULL, FALSE);
+	}
+	return TRUE;
+}
+
+void InvalidateAllEditorsChars(HWND hWndMain, int type, int start, int count) {
+	struct { UINT msg; int start; int count; } inv = { NV_INVALIDATECHARS, start, count };
+	if (count <= 0) return;
+	EnumAllEditors(hWndMain, type, InvalidateEditorRangeProc, &inv);
+}
+
+void InvalidateAllEditorsColors(HWND hWndMain, int type, int start, int count) {
+	struct { UINT msg; int start; int count; } inv = { NV_INVALIDATECOLORS, start, count };
+	if (count <= 0) return;
+	EnumAllEditors(hWndMain, type, InvalidateEditorRangeProc, &inv);
+}
+
 BOOL CALLBACK EnumAllEditorsProc(HWND hWnd, LPARAM lParam) {
 	struct { BOOL (*pfn) (HWND, void *); void *param; int type; } *data = (void *) lParam;
 	int type = GetEditorType(hWnd);
@@ -1234,6 +1260,12 @@ BOOL CALLBACK UpdatePreviewProc(HWND hWnd, LPARAM lParam) {
 VOID HandleSwitch(LPWSTR lpSwitch) {
 	if (!wcsncmp(lpSwitch, L"EVENT:", 6)) {
 		g_hEvent = (HANDLE) _wtol(lpSwitch + 6);
+	} else if (!wcsncmp(lpSwitch, L"TXBENCH:", 8)) {
+		//run the texture conversion benchmark, writing the report to the given path, and exit
+		ExitProcess(TxBenchRun(lpSwitch + 8) ? 0 : 1);
+	} else if (!wcsncmp(lpSwitch, L"CELLGEN:", 8)) {
+		//generate cells for a sprite sheet described by the given manifest, and exit
+		ExitProcess(CellBatchRunManifest(lpSwitch + 8) ? 0 : 1);
 	}
 }
 
@@ -2513,11 +2545,8 @@ LRESULT CALLBACK SpriteSheetDialogProc(HWND hWnd, UINT msg, WPARAM wParam, LPARA
 					ncgr.tilesX = 32;
 					ncgr.tilesY = height;
 					ncgr.nTiles = ncgr.tilesX * ncgr.tilesY;
-					ncgr.tiles = (unsigned char **) calloc(ncgr.nTiles, sizeof(unsigned char *));
+					ncgr.chars = (unsigned char *) calloc(ncgr.nTiles + 1, 64);
 					ncgr.attr = (unsigned char *) calloc(ncgr.nTiles, 1);
-					for (int i = 0; i < ncgr.nTiles; i++) {
-						ncgr.tiles[i] = (BYTE *) calloc(64, 1);
-					}
 
 					if (nitroPaintStruct->hWndNclrViewer != NULL) DestroyChild(nitroPaintStruct->hWndNclrViewer);
 					if (nitroPaintStruct->hWndNcgrViewer != NULL) DestroyChild(nitroPaintStruct->hWndNcgrViewer);
@@ -3268,11 +3297,45 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 	if (g_hEvent != NULL) SetEvent(g_hEvent);
 
 	MSG msg;
+	unsigned int keyGroup = 0;
 	while (GetMessage(&msg, NULL, 0, 0)) {
+		//undo steps are separated where mouse and key actions start and end. Keys
+		//pressed during a mouse drag are part of the drag.
+		BOOL keyRepeat = (msg.message == WM_KEYDOWN || msg.message == WM_SYSKEYDOWN) && (msg.lParam & (1 << 30));
+		BOOL dragging = GetCapture() != NULL;
+		switch (msg.message) {
+			case WM_LBUTTONDOWN:
+			case WM_RBUTTONDOWN:
+			case WM_MBUTTONDOWN:
+			case WM_NCLBUTTONDOWN:
+				EditorCheckpointInput(hWnd, msg.hwnd, 0);
+				break;
+			case WM_KEYDOWN:
+			case WM_SYSKEYDOWN:
+				if (!keyRepeat && !dragging) EditorCheckpointInput(hWnd, msg.hwnd, 0);
+				break;
+		}
+
 		if (!TranslateAccelerator(hWnd, hAccel, &msg)) {
 			TranslateMessage(&msg);
 			DispatchMessage(&msg);
 		}
+
+		switch (msg.message) {
+			case WM_KEYDOWN:
+			case WM_SYSKEYDOWN:
+				//a held key repeating its action is one step
+				if (dragging) break;
+				if (!keyRepeat && ++keyGroup == 0) keyGroup = 1;
+				EditorCheckpointInput(hWnd, msg.hwnd, keyGroup);
+				break;
+			case WM_LBUTTONUP:
+			case WM_RBUTTONUP:
+			case WM_MBUTTONUP:
+			case WM_COMMAND:
+				EditorCheckpointInput(hWnd, msg.hwnd, 0);
+				break;
+		}
 	}
 	return msg.wParam;
 }
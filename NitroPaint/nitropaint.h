@@ -228,6 +228,18 @@ int GetEditorType(HWND hWndEditor);
 //
 void InvalidateAllEditors(HWND hWndMain, int type);
 
+//
+// Notify all editor windows of a specified type that a range of characters
+// changed. Editors that do not handle NV_INVALIDATECHARS are invalidated.
+//
+void InvalidateAllEditorsChars(HWND hWndMain, int type, int start, int count);
+
+//
+// Notify all editor windows of a specified type that a range of palette colors
+// changed. Editors that do not handle NV_INVALIDATECOLORS are invalidated.
+//
+void InvalidateAllEditorsColors(HWND hWndMain, int type, int start, int count);
+
 //
 // Enumerate all editor windows of a specified type.
 //
@@ -259,3 +271,5 @@ HWND GetEditorFromObject(HWND hWndMain, OBJECT_HEADER *obj);
 #define NV_XTINVALIDATE (WM_USER+10)
 #define NV_CHILDNOTIF (WM_USER+11)
 #define NV_UPDATEPREVIEW (WM_USER+12)
+#define NV_INVALIDATECHARS (WM_USER+13)   //wParam=first character, lParam=count. Return nonzero if handled
+#define NV_INVALIDATECOLORS (WM_USER+14)  //wParam=first color, lParam=count. Return nonzero if handled
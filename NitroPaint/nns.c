@@ -146,334 +146,224 @@ unsigned char *NnsG2dFindBlockBySignature(const unsigned char *buffer, unsigned
 // ----- NNS G3D functions
 
 
-typedef struct NnsG3dTreeNode_ {
-	int leafIndex; //to control output index for a leaf node (set by user)
-	char name[16]; //name (for leaf nodes, read by user)
-
-	//internals
-	int isLeaf;
-	int refBit;    //for leaf nodes - equal to parent refBit
-	int writtenTo; //for branch nodes - the index in the P-tree that this was written to
-				   //for leaf nodes - the index in the P-tree that holds its leaf info
-	struct NnsG3dTreeNode_ *parent;
-
-	//for branch nodes
-	struct NnsG3dTreeNode_ *left;
-	struct NnsG3dTreeNode_ *right;
-} NnsG3dTreeNode;
-
-static int NnsiG3dGetResourceNameBit(const char *name, unsigned int bit) {
-	return (name[bit / 8] >> (bit % 8)) & 1;
-}
-
-static int NnsiG3dFindBitDivergence(const char *const *names, int nNames) {
-	if (nNames <= 1) return -1;
-
-	//find a divergence. Return highest index of this.
-	for (int i = 127; i >= 0; i--) {
-		//check if any have a different value
-		int diverged = 0;
-		int b0 = NnsiG3dGetResourceNameBit(names[0], i);
-		for (int j = 1; j < nNames; j++) {
-			int bj = NnsiG3dGetResourceNameBit(names[j], i);
-			if (bj != b0) {
-				diverged = 1;
-				break;
-			}
-		}
-
-		//if we diverged here, return i.
-		if (diverged) return i;
+//
+// Crit-bit tree of resource names, as written to a P-tree. Names are compared
+// as 128-bit little endian numbers, and each branch tests the highest bit in
+// which the names under it differ. The leaves are the names in sorted order,
+// so a branch is the gap between two neighboring leaves, and tests the highest
+// bit in which those two differ.
+//
+typedef struct NnsiG3dTree_ {
+	int nLeaves;
+	int *leaves;       // resource index of each leaf, in sorted order
+	int *refBits;      // bit tested by each branch
+	int *left;         // left branch of each branch, -1 if the left child is a leaf
+	int *right;        // right branch of each branch, -1 if the right child is a leaf
+	int *preorder;     // order each branch is written in, from 0
+	int root;          // root branch, -1 if the tree has at most one leaf
+} NnsiG3dTree;
+
+static void NnsiG3dSortNames(const unsigned char *names, int *order, int nNames) {
+	//LSD radix sort from the least significant byte, keeping equal names in resource order
+	int *scratch = (int *) calloc(nNames + 1, sizeof(int));
+	for (int i = 0; i < nNames; i++) order[i] = i;
+
+	for (int byte = 0; byte < 16; byte++) {
+		int counts[257] = { 0 };
+		for (int i = 0; i < nNames; i++) counts[names[order[i] * 16 + byte] + 1]++;
+		for (int i = 0; i < 256; i++) counts[i + 1] += counts[i];
+		for (int i = 0; i < nNames; i++) scratch[counts[names[order[i] * 16 + byte]]++] = order[i];
+		memcpy(order, scratch, nNames * sizeof(int));
+	}
+	free(scratch);
+}
+
+static int NnsiG3dFindBitDivergence(const unsigned char *name1, const unsigned char *name2) {
+	//highest bit in which two names differ, -1 if they are equal
+	for (int byte = 15; byte >= 0; byte--) {
+		unsigned int diff = name1[byte] ^ name2[byte];
+		if (diff == 0) continue;
+
+		int bit = 7;
+		while (!(diff & (1 << bit))) bit--;
+		return byte * 8 + bit;
 	}
 	return -1;
 }
 
-static int g_bitCompareBit = 0;
-static int NnsiG3dBitComparator(const void *p1, const void *p2) {
-	const char *name1 = *(const char **) p1;
-	const char *name2 = *(const char **) p2;
-	int bit = g_bitCompareBit;
+static void NnsiG3dConstructTree(NnsiG3dTree *tree, const unsigned char *names, int nNames) {
+	int *order = (int *) calloc(nNames + 1, sizeof(int));
+	NnsiG3dSortNames(names, order, nNames);
 
-	//p1 - p2
-	return NnsiG3dGetResourceNameBit(name1, bit) - NnsiG3dGetResourceNameBit(name2, bit);
-}
-
-static NnsG3dTreeNode *NnsiG3dConstructTreeRecursive(const char **names, int nNames) {
-	NnsG3dTreeNode *root = (NnsG3dTreeNode *) calloc(1, sizeof(NnsG3dTreeNode));
-	root->parent = NULL;
-	if (nNames == 1) {
-		root->isLeaf = 1;
-		root->refBit = 0x80;
-		memcpy(root->name, *names, 16);
-		return root;
-	}
-	root->isLeaf = 0;
-
-	//find first bit in the set of names that diverges. (duplicate resources prohibited!!)
-	int divergedBit = NnsiG3dFindBitDivergence(names, nNames);
-	root->refBit = divergedBit;
-	if (divergedBit == -1) {
-		free(root);
-		return NULL;
-	}
-
-	//trash the name list? Of course, for sorting!
-	g_bitCompareBit = divergedBit;
-	qsort((void *) names, nNames, sizeof(char *), NnsiG3dBitComparator);
-
-	//create children
-	int nLeftNodes = nNames;
+	//duplicate names can't be told apart, the first of them is kept
+	tree->leaves = (int *) calloc(nNames + 1, sizeof(int));
+	tree->nLeaves = 0;
 	for (int i = 0; i < nNames; i++) {
-		int b = NnsiG3dGetResourceNameBit(names[i], divergedBit);
-		if (b) {
-			nLeftNodes = i;
-			break;
+		if (tree->nLeaves > 0 && memcmp(names + order[i] * 16, names + tree->leaves[tree->nLeaves - 1] * 16, 16) == 0) continue;
+		tree->leaves[tree->nLeaves++] = order[i];
+	}
+	free(order);
+
+	int nBranches = tree->nLeaves > 0 ? tree->nLeaves - 1 : 0;
+	tree->refBits = (int *) calloc(nBranches + 1, sizeof(int));
+	tree->left = (int *) calloc(nBranches + 1, sizeof(int));
+	tree->right = (int *) calloc(nBranches + 1, sizeof(int));
+	tree->preorder = (int *) calloc(nBranches + 1, sizeof(int));
+	tree->root = -1;
+	if (nBranches == 0) return;
+
+	//the branches form a Cartesian tree by their tested bit, built with a stack of the rightmost path
+	int *stack = (int *) calloc(nBranches, sizeof(int));
+	int nStack = 0;
+	for (int i = 0; i < nBranches; i++) {
+		tree->refBits[i] = NnsiG3dFindBitDivergence(names + tree->leaves[i] * 16, names + tree->leaves[i + 1] * 16);
+		tree->left[i] = -1;
+		tree->right[i] = -1;
+
+		while (nStack > 0 && tree->refBits[stack[nStack - 1]] < tree->refBits[i]) {
+			tree->left[i] = stack[--nStack];
 		}
-	}
-
-	//create left+right
-	root->left = NnsiG3dConstructTreeRecursive(names, nLeftNodes);
-	root->right = NnsiG3dConstructTreeRecursive(names + nLeftNodes, nNames - nLeftNodes);
-	root->left->parent = root;
-	root->right->parent = root;
-	if (root->left->isLeaf) root->left->refBit = root->refBit;
-	if (root->right->isLeaf) root->right->refBit = root->refBit;
-	return root;
-}
-
-static NnsG3dTreeNode *NnsiG3dLookupResource(NnsG3dTreeNode *tree, const char *name) {
-	//traverse tree
-	while (!tree->isLeaf) {
-		int refBit = tree->refBit;
-		int bit = NnsiG3dGetResourceNameBit(name, refBit);
-
-		tree = bit ? tree->right : tree->left;
-	}
-	if (memcmp(tree->name, name, 16) == 0) return tree;
-	return NULL;
-}
-
-static NnsG3dTreeNode *NnsiG3dConstructTree(const char *const *names, int nNames) {
-	//create buffer for sorting
-	char **namesCopy = (char **) calloc(nNames, sizeof(char *));
-	char *namesBlob = (char *) calloc(nNames, 16);
-	for (int i = 0; i < nNames; i++) {
-		char *base = namesBlob + 16 * i;
-		namesCopy[i] = base;
-
-		//copy name (NUL-pad if <16 chars)
-		int pad = 0;
-		for (int j = 0; j < 16; j++) {
-			if (!pad) {
-				base[j] = names[i][j];
-				if (base[j] == '\0') pad = 0;
-			} else {
-				base[j] = '\0';
-			}
+		if (nStack > 0) tree->right[stack[nStack - 1]] = i;
+		stack[nStack++] = i;
+	}
+	tree->root = stack[0];
+
+	//number branches in preorder, left before right
+	int nWritten = 0;
+	nStack = 0;
+	stack[nStack++] = tree->root;
+	while (nStack > 0) {
+		int branch = stack[--nStack];
+		tree->preorder[branch] = nWritten++;
+		if (tree->right[branch] != -1) stack[nStack++] = tree->right[branch];
+		if (tree->left[branch] != -1) stack[nStack++] = tree->left[branch];
+	}
+	free(stack);
+}
+
+static void NnsiG3dFreeTree(NnsiG3dTree *tree) {
+	free(tree->leaves);
+	free(tree->refBits);
+	free(tree->left);
+	free(tree->right);
+	free(tree->preorder);
+	memset(tree, 0, sizeof(NnsiG3dTree));
+}
+
+static void NnsiG3dSerializeTree(BSTREAM *stream, NnsiG3dTree *tree) {
+	//node 0 is a header pointing to the root. Branches follow in preorder, then one node for a last leaf.
+	int nLeaves = tree->nLeaves, nBranches = nLeaves > 0 ? nLeaves - 1 : 0;
+	int dummyNode = nBranches + 1;
+	uint8_t *nodes = (uint8_t *) calloc(nBranches + 2, 4);
+	nodes[0] = 0x7F;
+	nodes[1] = nLeaves > 0;
+	if (nLeaves == 0) {
+		bstreamWrite(stream, nodes, 4);
+		free(nodes);
+		return;
+	}
+
+	//each branch holds the leaf to its right if it has one, or else the leaf to its left. The
+	//leaves left over are the left leaves of branches with two leaves, and the single leaf of a
+	//tree without branches. Bucket them, and the branches without a leaf, by tested bit.
+	int *leafNext = (int *) calloc(nLeaves, sizeof(int));
+	int *branchNext = (int *) calloc(nBranches + 1, sizeof(int));
+	int leafHeads[129], leafTails[129], branchHeads[128], branchTails[128];
+	for (int i = 0; i < 129; i++) leafHeads[i] = leafTails[i] = -1;
+	for (int i = 0; i < 128; i++) branchHeads[i] = branchTails[i] = -1;
+
+	for (int i = 0; i < nBranches; i++) {
+		uint8_t *node = nodes + 4 * (tree->preorder[i] + 1);
+		node[0] = tree->refBits[i];
+		if (tree->left[i] != -1) node[1] = tree->preorder[tree->left[i]] + 1;
+		if (tree->right[i] != -1) node[2] = tree->preorder[tree->right[i]] + 1;
+
+		if (tree->right[i] == -1) {
+			node[2] = tree->preorder[i] + 1;
+			node[3] = tree->leaves[i + 1];
+		} else if (tree->left[i] == -1) {
+			node[1] = tree->preorder[i] + 1;
+			node[3] = tree->leaves[i];
 		}
 	}
 
-	NnsG3dTreeNode *constructed = NnsiG3dConstructTreeRecursive(namesCopy, nNames);
-	free(namesCopy);
-	free(namesBlob);
-
-	//set out indices
-	for (int i = 0; i < nNames; i++) {
-		NnsG3dTreeNode *thisLeaf = NnsiG3dLookupResource(constructed, names[i]);
-		thisLeaf->leafIndex = i;
-	}
-	return constructed;
-}
-
-static void NnsiG3dFreeTree(NnsG3dTreeNode *root) {
-	if (root->left != NULL) {
-		NnsiG3dFreeTree(root->left);
-		free(root->left);
-	}
-	if (root->right != NULL) {
-		NnsiG3dFreeTree(root->right);
-		free(root->right);
-	}
-	memset(root, 0, sizeof(NnsG3dTreeNode));
-}
-
-static void NnsiG3dWriteNode(BSTREAM *stream, NnsG3dTreeNode *node, int *baseIndex) {
-	//if this node is a leaf, don't write anything
-	node->writtenTo = -1; //not written
-	if (node->isLeaf) return;
-
-	//set node index
-	node->leafIndex = -1; //not assigned to any leaf nodes (yet)
-	node->writtenTo = *baseIndex; //was actually written
-
-	//count child leaf nodes
-	int nChildLeaves = node->left->isLeaf + node->right->isLeaf;
-
-	//prepare node output
-	uint8_t data[4] = { 0 };
-	int thisOffset = stream->pos;
-	data[0] = node->refBit;
-	bstreamWrite(stream, data, sizeof(data));
-	(*baseIndex)++;
-
-	//write children
-	NnsiG3dWriteNode(stream, node->left, baseIndex);
-	NnsiG3dWriteNode(stream, node->right, baseIndex);
-	int afterOffset = stream->pos;
-
-	//if our children aren't leaf nodes, build references
-	if (!node->left->isLeaf) {
-		data[1] = node->left->writtenTo;
-	}
-	if (!node->right->isLeaf) {
-		data[2] = node->right->writtenTo;
-	}
-
-	//if we have a child leaf, point it here. Point right first, then left (g3dcvtr does this?)
-	if (node->right->isLeaf) {
-		node->right->writtenTo = node->writtenTo;
-		node->leafIndex = node->right->leafIndex;
-		data[2] = node->writtenTo;
-		data[3] = node->leafIndex;
-	} else if (node->left->isLeaf) {
-		node->left->writtenTo = node->writtenTo;
-		node->leafIndex = node->left->leafIndex;
-		data[1] = node->writtenTo;
-		data[3] = node->leafIndex;
-	}
-
-	//if both children are leaf nodes, only the right node will have been set. node->right->writtenTo
-	//will still be -1 by now. This will be fixed up later.
-
-	bstreamSeek(stream, thisOffset, 0);
-	bstreamWrite(stream, data, sizeof(data));
-
-	//restore to end
-	bstreamSeek(stream, afterOffset, 0);
-}
-
-static NnsG3dTreeNode *NnsiG3dFindUnassignedLeaf(NnsG3dTreeNode *tree) {
-	//find a node with writtenTo == -1. If multiple, find the one with higher refBit.
-	if (tree->isLeaf) {
-		return tree->writtenTo == -1 ? tree : NULL;
-	}
-
-	NnsG3dTreeNode *foundLeft = NnsiG3dFindUnassignedLeaf(tree->left);
-	NnsG3dTreeNode *foundRight = NnsiG3dFindUnassignedLeaf(tree->right);
-	if (foundLeft == NULL && foundRight == NULL) return NULL;
-	if (foundLeft != NULL && foundRight == NULL) return foundLeft;
-	if (foundLeft == NULL && foundRight != NULL) return foundRight;
-
-	if (foundLeft->refBit > foundRight->refBit) return foundLeft;
-	return foundRight;
-}
-
-static NnsG3dTreeNode *NnsiG3dFindUnassignedBranch(NnsG3dTreeNode *tree) {
-	//consider all nodes, not just children. If this node is a leaf, return NULL
-	if (tree->isLeaf) return NULL;
-	if (tree->left->isLeaf && tree->right->isLeaf) {
-		return tree->leafIndex == -1 ? tree : NULL;
-	}
-
-	//search children
-	NnsG3dTreeNode *foundLeft = NnsiG3dFindUnassignedBranch(tree->left);
-	NnsG3dTreeNode *foundRight = NnsiG3dFindUnassignedBranch(tree->right);
-
-	NnsG3dTreeNode *bestNode = NULL;
-	if (tree->leafIndex == -1) bestNode = tree;
-	if (foundLeft != NULL) {
-		if (bestNode == NULL || foundLeft->refBit > bestNode->refBit) bestNode = foundLeft;
-	}
-	if (foundRight != NULL) {
-		if (bestNode == NULL || foundRight->refBit > bestNode->refBit) bestNode = foundRight;
-	}
-
-	return bestNode;
-}
+	//leaves are taken by highest bit, then last in sorted order. A left leaf's branch is the gap after it.
+	for (int i = nLeaves - 1; i >= 0; i--) {
+		if (nBranches > 0) {
+			if (i == nBranches || tree->left[i] != -1) continue; //right leaf of branch i - 1
+			if (tree->right[i] != -1) continue;                  //taken by its branch
+		}
 
-static void NnsiG3dSerializeTree(BSTREAM *stream, NnsG3dTreeNode *tree) {
-	//write node 0 header
-	int baseOffset = stream->pos;
-	{
-		uint8_t baseHeader[4] = { 0x7F, 1, 0, 0 };
-		if (tree == NULL) baseHeader[1] = 0; //indicate empty tree to NNS
-		bstreamWrite(stream, baseHeader, sizeof(baseHeader));
+		int bucket = nBranches == 0 ? 128 : tree->refBits[i];
+		leafNext[i] = -1;
+		if (leafTails[bucket] == -1) leafHeads[bucket] = i;
+		else leafNext[leafTails[bucket]] = i;
+		leafTails[bucket] = i;
 	}
-	if (tree == NULL) return;
 
-	//start writing each node
-	int baseIndex = 1;
-	NnsiG3dWriteNode(stream, tree, &baseIndex);
+	//branches are taken by highest bit, then first in preorder
+	int *byPreorder = (int *) calloc(nBranches + 1, sizeof(int));
+	for (int i = 0; i < nBranches; i++) byPreorder[tree->preorder[i]] = i;
+	for (int j = 0; j < nBranches; j++) {
+		int i = byPreorder[j];
+		if (tree->left[i] == -1 || tree->right[i] == -1) continue;
 
-	//write final node. Since we've only written branches, we need one more for a leaf.
-	int dummyNodePos = stream->pos;
-	{
-		uint8_t lastNode[4] = { 0, 0, 0, 0 };
-		bstreamWrite(stream, lastNode, sizeof(lastNode));
+		int bucket = tree->refBits[i];
+		branchNext[i] = -1;
+		if (branchTails[bucket] == -1) branchHeads[bucket] = i;
+		else branchNext[branchTails[bucket]] = i;
+		branchTails[bucket] = i;
 	}
-	int endPos = stream->pos;
+	free(byPreorder);
 
-	//next, fixup unassigned child nodes. Keep searching for the unassigned child node
-	//of highest refBit, then assign it a branch.
+	//pair the leaves with the branches in order. One leaf is left for the last node.
+	int leafBucket = 128, branchBucket = 127;
+	int leaf = leafHeads[leafBucket], branch = -1;
+	while (branchBucket >= 0 && (branch = branchHeads[branchBucket]) == -1) branchBucket--;
 	while (1) {
-		NnsG3dTreeNode *unassigned = NnsiG3dFindUnassignedLeaf(tree);
-		if (unassigned == NULL) break;
-
-		//search for branch node not assigned to a leaf of highest refBit.
-		NnsG3dTreeNode *toAssign = NnsiG3dFindUnassignedBranch(tree);
-		uint8_t idxBuffer = 0;
-		int destNodePos = dummyNodePos;
-		if (toAssign != NULL) { //a node existed, write out info to it
-			toAssign->leafIndex = unassigned->leafIndex;
-			unassigned->writtenTo = toAssign->writtenTo;
-			destNodePos = baseOffset + toAssign->writtenTo * 4;
-		}
-
-		//write back leaf index
-		idxBuffer = unassigned->leafIndex;
-		bstreamSeek(stream, destNodePos + 3, 0);
-		bstreamWrite(stream, &idxBuffer, sizeof(idxBuffer));
-
-		//if we're writing to the dummy node, set refBit to 0x7F to ensure it's interpreted as a leaf
-		if (destNodePos == dummyNodePos) {
-			uint8_t refBitBuffer = 0x7F;
-			bstreamSeek(stream, dummyNodePos, 0);
-			bstreamWrite(stream, &refBitBuffer, sizeof(refBitBuffer));
-			unassigned->writtenTo = (dummyNodePos - baseOffset) / 4;
+		while (leaf == -1 && leafBucket > 0) leaf = leafHeads[--leafBucket];
+		if (leaf == -1) break;
+
+		int dest = dummyNode;
+		if (branch != -1) {
+			dest = tree->preorder[branch] + 1;
+			branch = branchNext[branch];
+			while (branch == -1 && branchBucket > 0) branch = branchHeads[--branchBucket];
+		} else {
+			nodes[4 * dest + 0] = 0x7F;
 		}
+		nodes[4 * dest + 3] = tree->leaves[leaf];
 
-		//update parent to point to the child location (after we're sure writtenTo is set!)
-		NnsG3dTreeNode *leafParent = unassigned->parent;
-		if (leafParent != NULL) {
-			uint8_t childIndexBuffer = unassigned->writtenTo;
-			int leftRight = leafParent->left == unassigned ? 0 : 1; //0 for left, 1 for right
-			bstreamSeek(stream, baseOffset + leafParent->writtenTo * 4 + 1 + leftRight, 0);
-			bstreamWrite(stream, &childIndexBuffer, sizeof(childIndexBuffer));
-		}
+		//the left child of its branch points to where it was put
+		if (nBranches > 0) nodes[4 * (tree->preorder[leaf] + 1) + 1] = dest;
+		leaf = leafNext[leaf];
 	}
-	bstreamSeek(stream, endPos, 0);
+
+	bstreamWrite(stream, nodes, 4 * (nBranches + 2));
+	free(nodes);
+	free(leafNext);
+	free(branchNext);
 }
 
 static void NnsiG3dConstructTreeFromResources(BSTREAM *stream, void *items, int itemSize, int nItems, NnsGetResourceNameCallback getNamePtr) {
-	char **namesBuf = (char **) calloc(nItems, sizeof(char *));
-	char *namesBlob = (char *) calloc(nItems, 16);
+	unsigned char *namesBlob = (unsigned char *) calloc(nItems + 1, 16);
 	for (int i = 0; i < nItems; i++) {
-		namesBuf[i] = namesBlob + i * 16;
+		unsigned char *name = namesBlob + i * 16;
 		void *obj = (void *) (i * itemSize + (uintptr_t) items);
-		memcpy(namesBuf[i], getNamePtr(obj), 16);
+		memcpy(name, getNamePtr(obj), 16);
 
 		int zeroFill = 0;
 		for (int j = 0; j < 16; j++) {
-			if (namesBuf[i][j] == '\0') zeroFill = 1;
-			if (zeroFill) namesBuf[i][j] = '\0';
+			if (name[j] == '\0') zeroFill = 1;
+			if (zeroFill) name[j] = '\0';
 		}
 	}
 
 	//create tree
-	NnsG3dTreeNode *tree = NnsiG3dConstructTree(namesBuf, nItems);
-	NnsiG3dSerializeTree(stream, tree);
-	NnsiG3dFreeTree(tree);
-	free(namesBuf);
+	NnsiG3dTree tree;
+	NnsiG3dConstructTree(&tree, namesBlob, nItems);
+	NnsiG3dSerializeTree(stream, &tree);
+	NnsiG3dFreeTree(&tree);
 	free(namesBlob);
 }
 
@@ -578,6 +468,9 @@ unsigned char *NnsG3dGetSectionByIndex(const unsigned char *buffer, unsigned int
 
 // ----- NNS Stream functions
 
+//room kept in front of the first block for the file header, so that flushing to an empty stream need not copy the blocks
+#define NNS_STREAM_HEADROOM 0x40
+
 void NnsStreamCreate(NnsStream *stream, const char *identifier, int versionHigh, int versionLow, int type, int sigByteOrder) {
 	//initialize
 	memset(stream->header, 0, sizeof(stream->header));
@@ -603,13 +496,14 @@ void NnsStreamCreate(NnsStream *stream, const char *identifier, int versionHigh,
 	
 	bstreamCreate(&stream->headerStream, NULL, 0);
 	bstreamCreate(&stream->blockStream, NULL, 0);
+	bstreamCreate(&stream->currentStream, NULL, 0);
 	bstreamWrite(&stream->headerStream, stream->header, sizeof(stream->header));
 }
 
 void NnsStreamStartBlock(NnsStream *stream, const char *identifier) {
-	//create a new block stream
+	//the block stream is empty, and keeps the buffer of the last block copied out
 	char header[8] = { 0 };
-	bstreamCreate(&stream->currentStream, NULL, 0);
+	if (stream->blockStream.size == 0) bstreamReserveFront(&stream->currentStream, NNS_STREAM_HEADROOM);
 
 	if (stream->sigByteorder == NNS_SIG_BE) {
 		memcpy(header, identifier, 4);
@@ -645,9 +539,8 @@ void NnsStreamEndBlock(NnsStream *stream) {
 	bstreamSeek(&stream->headerStream, 0xE, 0);
 	bstreamWrite(&stream->headerStream, &stream->nBlocks, sizeof(stream->nBlocks));
 
-	//write block to out, clean buffer
-	bstreamWrite(&stream->blockStream, stream->currentStream.buffer, stream->currentStream.size);
-	bstreamFree(&stream->currentStream);
+	//move block to out
+	bstreamSplice(&stream->blockStream, &stream->currentStream);
 }
 
 void NnsStreamWrite(NnsStream *stream, const void *bytes, unsigned int size) {
@@ -679,9 +572,15 @@ void NnsStreamFinalize(NnsStream *stream) {
 }
 
 void NnsStreamFlushOut(NnsStream *stream, BSTREAM *out) {
-	//write to stream
+	//an empty stream takes over the blocks with the header put in front of them
+	if (out->size == 0) {
+		bstreamPrepend(&stream->blockStream, stream->headerStream.buffer, stream->headerStream.size);
+		bstreamSplice(out, &stream->blockStream);
+		return;
+	}
+
 	bstreamWrite(out, stream->headerStream.buffer, stream->headerStream.size);
-	bstreamWrite(out, stream->blockStream.buffer, stream->blockStream.size);
+	bstreamSplice(out, &stream->blockStream);
 }
 
 void NnsStreamFree(NnsStream *stream) {
@@ -32,8 +32,28 @@ typedef struct DICTPLTTDATA_ {
 
 //----- END Code for constructing an TexArc dictionary
 
+static void TexarciFreeNameIndex(TexarcNameIndex *index) {
+	if (index->slots != NULL) free(index->slots);
+	memset(index, 0, sizeof(TexarcNameIndex));
+}
+
+static void TexarciFreeWriteCache(TexarcWriteCache *cache) {
+	if (cache->image != NULL) free(cache->image);
+	if (cache->textures != NULL) free(cache->textures);
+	if (cache->palettes != NULL) free(cache->palettes);
+	if (cache->textureOffsets != NULL) free(cache->textureOffsets);
+	if (cache->indexOffsets != NULL) free(cache->indexOffsets);
+	if (cache->paletteOffsets != NULL) free(cache->paletteOffsets);
+	if (cache->textureShared != NULL) free(cache->textureShared);
+	if (cache->paletteShared != NULL) free(cache->paletteShared);
+	memset(cache, 0, sizeof(TexarcWriteCache));
+}
+
 void TexarcFree(OBJECT_HEADER *header) {
 	TexArc *nsbtx = (TexArc *) header;
+	TexarciFreeNameIndex(&nsbtx->textureNames);
+	TexarciFreeNameIndex(&nsbtx->paletteNames);
+	TexarciFreeWriteCache(&nsbtx->writeCache);
 	if (nsbtx->textures != NULL) {
 		for (int i = 0; i < nsbtx->nTextures; i++) {
 			TEXELS *texture = nsbtx->textures + i;
@@ -72,6 +92,7 @@ void TexarcInit(TexArc *nsbtx, int format) {
 	nsbtx->header.size = sizeof(TexArc);
 	ObjInit((OBJECT_HEADER *) nsbtx, FILE_TYPE_NSBTX, format);
 	nsbtx->header.dispose = TexarcFree;
+	nsbtx->vramFlags = TEXARC_VRAM_PACK;
 }
 
 //TexArc code adapted from Gericom's code in Fvery File Explorer.
@@ -96,6 +117,193 @@ unsigned char *readDictionary(DICTIONARY *dict, unsigned char *base, int entrySi
 	return pos;
 }
 
+// ----- write cache. The image is patched in place, so data it shares cannot be patched.
+
+static int TexarciGetTexelSize(TEXELS *texture) {
+	return TxGetTexelSize(TEXW(texture->texImageParam), texture->height, texture->texImageParam);
+}
+
+typedef struct TexarciRange_ {
+	unsigned int start;
+	unsigned int end;
+	int index;                         // texture index, or palette index + number of textures
+} TexarciRange;
+
+static int TexarciRangeComparator(const void *p1, const void *p2) {
+	const TexarciRange *r1 = (const TexarciRange *) p1, *r2 = (const TexarciRange *) p2;
+	if (r1->start != r2->start) return r1->start < r2->start ? -1 : 1;
+	return r1->index - r2->index;
+}
+
+static int TexarciInImage(unsigned int start, unsigned int length, unsigned int size) {
+	return start <= size && length <= size - start;
+}
+
+static void TexarciAddRange(TexarciRange *ranges, int *nRanges, unsigned int start, unsigned int length, int index) {
+	//empty data overlaps nothing
+	if (length == 0) return;
+	ranges[*nRanges].start = start;
+	ranges[*nRanges].end = start + length;
+	ranges[*nRanges].index = index;
+	(*nRanges)++;
+}
+
+static void TexarciMarkOverlaps(TexarciRange *ranges, int nRanges, unsigned char *shared) {
+	//sorted by start, a range overlaps an earlier one if it starts before they all end,
+	//and a later one if it ends after the next one starts
+	qsort(ranges, nRanges, sizeof(TexarciRange), TexarciRangeComparator);
+	unsigned int maxEnd = 0;
+	for (int i = 0; i < nRanges; i++) {
+		if (ranges[i].start < maxEnd) shared[ranges[i].index] = 1;
+		if (i + 1 < nRanges && ranges[i].end > ranges[i + 1].start) shared[ranges[i].index] = 1;
+		if (ranges[i].end > maxEnd) maxEnd = ranges[i].end;
+	}
+}
+
+//
+// Keep a copy of an NNS archive image whose TEX0 section matches the archive.
+// Nothing is kept if any data lies outside of the image.
+//
+static void TexarciCacheImage(TexArc *nsbtx, const unsigned char *image, unsigned int size, unsigned int tex0Offset) {
+	TexarcWriteCache *cache = &nsbtx->writeCache;
+	TexarciFreeWriteCache(cache);
+
+	unsigned char *tex0 = (unsigned char *) image + tex0Offset;
+	uint32_t texBase = *(uint32_t *) (tex0 + 0x14);
+	uint32_t tex4x4Base = *(uint32_t *) (tex0 + 0x24);
+	uint32_t indexBase = *(uint32_t *) (tex0 + 0x28);
+	uint32_t plttDictOffset = *(uint32_t *) (tex0 + 0x34);
+	uint32_t plttBase = *(uint32_t *) (tex0 + 0x38);
+	if (!TexarciInImage(tex0Offset, texBase, size) || !TexarciInImage(tex0Offset, tex4x4Base, size)
+		|| !TexarciInImage(tex0Offset, indexBase, size) || !TexarciInImage(tex0Offset, plttBase, size)
+		|| !TexarciInImage(tex0Offset, plttDictOffset, size)) return;
+
+	DICTIONARY dictPltt;
+	readDictionary(&dictPltt, tex0 + plttDictOffset, sizeof(DICTPLTTDATA));
+	if (dictPltt.nEntries != nsbtx->nPalettes) return;
+	DICTPLTTDATA *plttData = (DICTPLTTDATA *) dictPltt.entry.data;
+
+	int nTextures = nsbtx->nTextures, nPalettes = nsbtx->nPalettes;
+	cache->textureOffsets = (unsigned int *) calloc(nTextures + 1, sizeof(unsigned int));
+	cache->indexOffsets = (unsigned int *) calloc(nTextures + 1, sizeof(unsigned int));
+	cache->paletteOffsets = (unsigned int *) calloc(nPalettes + 1, sizeof(unsigned int));
+	TexarciRange *ranges = (TexarciRange *) calloc(2 * nTextures + nPalettes + 1, sizeof(TexarciRange));
+	int nRanges = 0, inImage = 1;
+
+	for (int i = 0; i < nTextures; i++) {
+		TEXELS *texture = nsbtx->textures + i;
+		int texelSize = TexarciGetTexelSize(texture);
+		int offset = OFFSET(texture->texImageParam);
+
+		if (FORMAT(texture->texImageParam) == CT_4x4) {
+			cache->textureOffsets[i] = tex0Offset + tex4x4Base + offset;
+			cache->indexOffsets[i] = tex0Offset + indexBase + offset / 2;
+			inImage = inImage && TexarciInImage(cache->indexOffsets[i], texelSize / 2, size);
+			TexarciAddRange(ranges, &nRanges, cache->indexOffsets[i], texelSize / 2, i);
+		} else {
+			cache->textureOffsets[i] = tex0Offset + texBase + offset;
+		}
+		inImage = inImage && TexarciInImage(cache->textureOffsets[i], texelSize, size);
+		TexarciAddRange(ranges, &nRanges, cache->textureOffsets[i], texelSize, i);
+	}
+	for (int i = 0; i < nPalettes; i++) {
+		PALETTE *palette = nsbtx->palettes + i;
+		cache->paletteOffsets[i] = tex0Offset + plttBase + (plttData[i].offset << 3);
+		inImage = inImage && TexarciInImage(cache->paletteOffsets[i], palette->nColors * sizeof(COLOR), size);
+		TexarciAddRange(ranges, &nRanges, cache->paletteOffsets[i], palette->nColors * sizeof(COLOR), nTextures + i);
+	}
+	if (!inImage) {
+		free(ranges);
+		TexarciFreeWriteCache(cache);
+		return;
+	}
+
+	unsigned char *shared = (unsigned char *) calloc(nTextures + nPalettes + 1, 1);
+	TexarciMarkOverlaps(ranges, nRanges, shared);
+	cache->textureShared = (unsigned char *) calloc(nTextures + 1, 1);
+	cache->paletteShared = (unsigned char *) calloc(nPalettes + 1, 1);
+	memcpy(cache->textureShared, shared, nTextures);
+	memcpy(cache->paletteShared, shared + nTextures, nPalettes);
+	free(shared);
+	free(ranges);
+
+	//keep the entries without their data
+	cache->textures = (TEXELS *) calloc(nTextures + 1, sizeof(TEXELS));
+	cache->palettes = (PALETTE *) calloc(nPalettes + 1, sizeof(PALETTE));
+	memcpy(cache->textures, nsbtx->textures, nTextures * sizeof(TEXELS));
+	memcpy(cache->palettes, nsbtx->palettes, nPalettes * sizeof(PALETTE));
+	for (int i = 0; i < nTextures; i++) {
+		cache->textures[i].texel = NULL;
+		cache->textures[i].cmp = NULL;
+	}
+	for (int i = 0; i < nPalettes; i++) {
+		cache->palettes[i].pal = NULL;
+	}
+
+	cache->image = (unsigned char *) malloc(size);
+	memcpy(cache->image, image, size);
+	cache->size = size;
+	cache->hasModel = nsbtx->mdl0 != NULL;
+	cache->nTextures = nTextures;
+	cache->nPalettes = nPalettes;
+}
+
+static int TexarciPatchImage(TexarcWriteCache *cache, unsigned int offset, const void *data, unsigned int size, int shared) {
+	if (memcmp(cache->image + offset, data, size) == 0) return 1;
+	if (shared) return 0;
+
+	memcpy(cache->image + offset, data, size);
+	return 1;
+}
+
+//
+// Write an archive by patching its cached image. Returns 0 if the archive
+// must be rebuilt instead.
+//
+static int TexarciWriteCached(TexArc *nsbtx, BSTREAM *stream) {
+	TexarcWriteCache *cache = &nsbtx->writeCache;
+	if (cache->image == NULL) return 0;
+	if (cache->nTextures != nsbtx->nTextures || cache->nPalettes != nsbtx->nPalettes) return 0;
+
+	//the model is kept as it was read, between the file header and the MDL0 header
+	if (cache->hasModel != (nsbtx->mdl0 != NULL)) return 0;
+	if (nsbtx->mdl0 != NULL) {
+		if (*(uint32_t *) (cache->image + 0x1C) != (uint32_t) nsbtx->mdl0Size + 8) return 0;
+		if (memcmp(cache->image + 0x20, nsbtx->mdl0, nsbtx->mdl0Size) != 0) return 0;
+	}
+
+	//dictionaries must be unchanged
+	for (int i = 0; i < nsbtx->nTextures; i++) {
+		TEXELS *texture = nsbtx->textures + i, *cached = cache->textures + i;
+		if (texture->texImageParam != cached->texImageParam || texture->height != cached->height) return 0;
+		if (memcmp(texture->name, cached->name, sizeof(texture->name)) != 0) return 0;
+	}
+	for (int i = 0; i < nsbtx->nPalettes; i++) {
+		PALETTE *palette = nsbtx->palettes + i, *cached = cache->palettes + i;
+		if (palette->nColors != cached->nColors) return 0;
+		if (memcmp(palette->name, cached->name, sizeof(palette->name)) != 0) return 0;
+	}
+
+	//patch changed data. If shared data changed, the patches made are still correct for the image.
+	for (int i = 0; i < nsbtx->nTextures; i++) {
+		TEXELS *texture = nsbtx->textures + i;
+		int texelSize = TexarciGetTexelSize(texture);
+		int shared = cache->textureShared[i];
+
+		if (!TexarciPatchImage(cache, cache->textureOffsets[i], texture->texel, texelSize, shared)) return 0;
+		if (FORMAT(texture->texImageParam) == CT_4x4
+			&& !TexarciPatchImage(cache, cache->indexOffsets[i], texture->cmp, texelSize / 2, shared)) return 0;
+	}
+	for (int i = 0; i < nsbtx->nPalettes; i++) {
+		PALETTE *palette = nsbtx->palettes + i;
+		int shared = cache->paletteShared[i];
+		if (!TexarciPatchImage(cache, cache->paletteOffsets[i], palette->pal, palette->nColors * sizeof(COLOR), shared)) return 0;
+	}
+
+	bstreamWrite(stream, cache->image, cache->size);
+	return 1;
+}
+
 int TexarcIsValidNsbtx(char *buffer, int size) {
 	if (!NnsIsValid(buffer, size)) return 0;
 
@@ -284,6 +492,14 @@ int TexarcReadNsbtx(TexArc *nsbtx, char *buffer, int size) {
 	nsbtx->nPalettes = dictPal.nEntries;
 	nsbtx->textures = texels;
 	nsbtx->palettes = palettes;
+
+	//keep the file for writing it again if its sections are laid out as we would write them
+	int sectionsStart = nsbtx->mdl0 != NULL ? 0x18 : 0x14;
+	if (nSections == (nsbtx->mdl0 != NULL ? 2 : 1) && *(uint32_t *) (buffer + 0x8) == (uint32_t) size
+		&& sectionOffsets[0] == sectionsStart && sectionOffsets[nSections - 1] == tex0Offset
+		&& tex0Offset + blockSize == size) {
+		TexarciCacheImage(nsbtx, buffer, size, tex0Offset);
+	}
 	return 0;
 }
 
@@ -388,6 +604,211 @@ int TexarcReadFile(TexArc *nsbtx, LPCWSTR path) {
 	return ObjReadFile(path, (OBJECT_HEADER *) nsbtx, (OBJECT_READER) TexarcRead);
 }
 
+// ----- VRAM layout
+
+static int TexarciIsPrefixTexture(TEXELS *texture, TEXELS *owner) {
+	//the smaller texture's data must begin the larger's, palette indices included
+	int size = TexarciGetTexelSize(texture);
+	if (size > TexarciGetTexelSize(owner)) return 0;
+	if ((FORMAT(texture->texImageParam) == CT_4x4) != (FORMAT(owner->texImageParam) == CT_4x4)) return 0;
+
+	if (memcmp(texture->texel, owner->texel, size) != 0) return 0;
+	if (texture->cmp != NULL && memcmp(texture->cmp, owner->cmp, size / 2) != 0) return 0;
+	return 1;
+}
+
+static int TexarciIsSamePalette(PALETTE *palette, PALETTE *owner) {
+	if (palette->nColors != owner->nColors) return 0;
+	return memcmp(palette->pal, owner->pal, palette->nColors * sizeof(COLOR)) == 0;
+}
+
+typedef struct TexarciSizedEntry_ {
+	int size;
+	int index;
+} TexarciSizedEntry;
+
+static int TexarciSizedEntryComparator(const void *p1, const void *p2) {
+	//largest first, then in archive order
+	const TexarciSizedEntry *e1 = (const TexarciSizedEntry *) p1, *e2 = (const TexarciSizedEntry *) p2;
+	if (e1->size != e2->size) return e2->size - e1->size;
+	return e1->index - e2->index;
+}
+
+static uint32_t TexarciHashBytes(uint32_t hash, const void *data, int size) {
+	//FNV-1a, continuing a previous hash
+	const unsigned char *bytes = (const unsigned char *) data;
+	for (int i = 0; i < size; i++) hash = (hash ^ bytes[i]) * 0x01000193;
+	return hash;
+}
+
+typedef struct TexarciPrefixNode_ {
+	uint32_t hash;                     // hash of the prefix
+	int size;                          // size of the prefix
+	int index;                         // texture or palette the prefix begins
+	int next;                          // next node of the bucket
+} TexarciPrefixNode;
+
+//
+// Find the owner of each texture or palette: for a texture, a larger or earlier
+// one whose data it begins, and for a palette, an earlier one with identical
+// data. Owners own their own data. Candidates are visited largest first. Each
+// texture owner is hashed over its prefix of every size an entry has, so only
+// data that could match is compared.
+//
+static void TexarciFindOwners(TexArc *nsbtx, int isPalette, int *owners) {
+	int matchPrefixes = !isPalette;
+	int n = isPalette ? nsbtx->nPalettes : nsbtx->nTextures;
+	TexarciSizedEntry *order = (TexarciSizedEntry *) calloc(n + 1, sizeof(TexarciSizedEntry));
+	for (int i = 0; i < n; i++) {
+		order[i].size = isPalette ? nsbtx->palettes[i].nColors * (int) sizeof(COLOR) : TexarciGetTexelSize(nsbtx->textures + i);
+		order[i].index = i;
+	}
+	qsort(order, n, sizeof(TexarciSizedEntry), TexarciSizedEntryComparator);
+
+	//distinct sizes, smallest first
+	int *sizes = (int *) calloc(n + 1, sizeof(int));
+	uint32_t *hashes = (uint32_t *) calloc(n + 1, sizeof(uint32_t));
+	int nSizes = 0;
+	for (int k = n - 1; k >= 0; k--) {
+		if (order[k].size > 0 && (nSizes == 0 || sizes[nSizes - 1] != order[k].size)) sizes[nSizes++] = order[k].size;
+	}
+
+	int nBuckets = 16;
+	while (nBuckets < n * 2) nBuckets *= 2;
+	int *heads = (int *) malloc(nBuckets * sizeof(int));
+	for (int i = 0; i < nBuckets; i++) heads[i] = -1;
+	int nNodes = 0, nodeCapacity = n + 1;
+	TexarciPrefixNode *nodes = (TexarciPrefixNode *) malloc(nodeCapacity * sizeof(TexarciPrefixNode));
+
+	for (int k = 0; k < n; k++) {
+		int i = order[k].index, size = order[k].size;
+		owners[i] = i;
+		if (size == 0) continue;
+
+		//hash each prefix of a distinct size, up to the whole data. Only the whole data is
+		//needed without prefix matching.
+		int nHashes = 0;
+		if (isPalette) {
+			const COLOR *pal = nsbtx->palettes[i].pal;
+			uint32_t hash = 0x811C9DC5;
+			for (int j = 0, pos = 0; j < nSizes && sizes[j] <= size; j++) {
+				if (!matchPrefixes && sizes[j] != size) continue;
+				hash = TexarciHashBytes(hash, (const unsigned char *) pal + pos, sizes[j] - pos);
+				pos = sizes[j];
+				hashes[nHashes++] = hash;
+			}
+		} else {
+			//the 4x4 palette index data is hashed alongside the texels
+			TEXELS *texture = nsbtx->textures + i;
+			int is4x4 = FORMAT(texture->texImageParam) == CT_4x4;
+			uint32_t hash = 0x811C9DC5 ^ is4x4, hashIdx = 0x811C9DC5;
+			for (int j = 0, pos = 0; j < nSizes && sizes[j] <= size; j++) {
+				if (!matchPrefixes && sizes[j] != size) continue;
+				hash = TexarciHashBytes(hash, texture->texel + pos, sizes[j] - pos);
+				if (is4x4) hashIdx = TexarciHashBytes(hashIdx, (unsigned char *) texture->cmp + pos / 2, (sizes[j] - pos) / 2);
+				pos = sizes[j];
+				hashes[nHashes++] = hash ^ (hashIdx * 0x9E3779B1);
+			}
+		}
+
+		//the last hash covers the whole data
+		uint32_t hash = hashes[nHashes - 1];
+		for (int j = heads[(hash ^ size) & (nBuckets - 1)]; j != -1; j = nodes[j].next) {
+			TexarciPrefixNode *node = nodes + j;
+			if (node->size != size || node->hash != hash) continue;
+
+			int match = isPalette ? TexarciIsSamePalette(nsbtx->palettes + i, nsbtx->palettes + node->index)
+				: TexarciIsPrefixTexture(nsbtx->textures + i, nsbtx->textures + node->index);
+			if (match) {
+				owners[i] = node->index;
+				break;
+			}
+		}
+		if (owners[i] != i) continue;
+
+		//new data becomes a candidate owner of data of each hashed size
+		for (int j = 0, iHash = 0; j < nSizes && sizes[j] <= size; j++) {
+			if (!matchPrefixes && sizes[j] != size) continue;
+			if (nNodes == nodeCapacity) {
+				nodeCapacity *= 2;
+				nodes = (TexarciPrefixNode *) realloc(nodes, nodeCapacity * sizeof(TexarciPrefixNode));
+			}
+
+			int bucket = (hashes[iHash] ^ sizes[j]) & (nBuckets - 1);
+			nodes[nNodes].hash = hashes[iHash++];
+			nodes[nNodes].size = sizes[j];
+			nodes[nNodes].index = i;
+			nodes[nNodes].next = heads[bucket];
+			heads[bucket] = nNodes++;
+		}
+	}
+
+	free(order);
+	free(sizes);
+	free(hashes);
+	free(heads);
+	free(nodes);
+}
+
+void TexarcGetVramLayout(TexArc *nsbtx, int flags, TexarcVramLayout *layout) {
+	memset(layout, 0, sizeof(TexarcVramLayout));
+	layout->textureOffsets = (int *) calloc(nsbtx->nTextures + 1, sizeof(int));
+	layout->paletteOffsets = (int *) calloc(nsbtx->nPalettes + 1, sizeof(int));
+
+	int *textureOwners = layout->textureOwners = (int *) calloc(nsbtx->nTextures + 1, sizeof(int));
+	int *paletteOwners = layout->paletteOwners = (int *) calloc(nsbtx->nPalettes + 1, sizeof(int));
+	if (flags & TEXARC_VRAM_PACK) {
+		TexarciFindOwners(nsbtx, 0, textureOwners);
+		TexarciFindOwners(nsbtx, 1, paletteOwners);
+	} else {
+		for (int i = 0; i < nsbtx->nTextures; i++) textureOwners[i] = i;
+		for (int i = 0; i < nsbtx->nPalettes; i++) paletteOwners[i] = i;
+	}
+
+	//place owners in archive order, then the rest at their owner's offset
+	for (int i = 0; i < nsbtx->nTextures; i++) {
+		TEXELS *texture = nsbtx->textures + i;
+		int *pos = FORMAT(texture->texImageParam) == CT_4x4 ? &layout->texel4x4Size : &layout->texelSize;
+		if (textureOwners[i] != i) continue;
+
+		*pos = (*pos + 7) & ~7;
+		layout->textureOffsets[i] = *pos;
+		*pos += TexarciGetTexelSize(texture);
+	}
+	layout->texelSize = (layout->texelSize + 7) & ~7;
+	layout->texel4x4Size = (layout->texel4x4Size + 7) & ~7;
+	for (int i = 0; i < nsbtx->nTextures; i++) {
+		if (textureOwners[i] == i) continue;
+		layout->textureOffsets[i] = layout->textureOffsets[textureOwners[i]];
+		layout->nSharedTextures++;
+	}
+
+	for (int i = 0; i < nsbtx->nPalettes; i++) {
+		PALETTE *palette = nsbtx->palettes + i;
+		if (paletteOwners[i] != i) continue;
+
+		//4-color palettes are addressed in 8 byte units, others in 16
+		int align = palette->nColors > 4 ? 16 : 8;
+		layout->paletteSize = (layout->paletteSize + align - 1) & ~(align - 1);
+		layout->paletteOffsets[i] = layout->paletteSize;
+		layout->paletteSize += palette->nColors * sizeof(COLOR);
+	}
+	layout->paletteSize = (layout->paletteSize + 15) & ~15;
+	for (int i = 0; i < nsbtx->nPalettes; i++) {
+		if (paletteOwners[i] == i) continue;
+		layout->paletteOffsets[i] = layout->paletteOffsets[paletteOwners[i]];
+		layout->nSharedPalettes++;
+	}
+}
+
+void TexarcFreeVramLayout(TexarcVramLayout *layout) {
+	free(layout->textureOffsets);
+	free(layout->paletteOffsets);
+	free(layout->textureOwners);
+	free(layout->paletteOwners);
+	memset(layout, 0, sizeof(TexarcVramLayout));
+}
+
 static char *TexarciGetTextureNameCallback(void *texels) {
 	return ((TEXELS *) texels)->name;
 }
@@ -396,7 +817,19 @@ static char *TexarciGetPaletteNameCallback(void *palette) {
 	return ((PALETTE *) palette)->name;
 }
 
+static void TexarciWriteAt(BSTREAM *stream, int pos, const void *data, int size) {
+	//pad up to a position, data is written in increasing order
+	unsigned char padding[16] = { 0 };
+	while (stream->pos < pos) {
+		bstreamWrite(stream, padding, min(pos - stream->pos, (int) sizeof(padding)));
+	}
+	bstreamWrite(stream, (void *) data, size);
+}
+
 int TexarcWriteNsbtx(TexArc *nsbtx, BSTREAM *stream) {
+	//rewrite the last image if only texture and palette data changed
+	if (TexarciWriteCached(nsbtx, stream)) return 0;
+
 	if (nsbtx->mdl0 != NULL) {
 		BYTE fileHeader[] = { 'B', 'M', 'D', '0', 0xFF, 0xFE, 1, 0, 0, 0, 0, 0, 0x10, 0, 2, 0, 0x18, 0, 0, 0, 0, 0, 0, 0 };
 
@@ -419,72 +852,45 @@ int TexarcWriteNsbtx(TexArc *nsbtx, BSTREAM *stream) {
 	BYTE tex0Header[] = { 'T', 'E', 'X', '0', 0, 0, 0, 0 };
 	bstreamWrite(stream, tex0Header, sizeof(tex0Header));
 
-	BSTREAM texData, tex4x4Data, tex4x4PlttIdxData, paletteData;
-	bstreamCreate(&texData, NULL, 0);
-	bstreamCreate(&tex4x4Data, NULL, 0);
-	bstreamCreate(&tex4x4PlttIdxData, NULL, 0);
-	bstreamCreate(&paletteData, NULL, 0);
+	//lay out texture and palette data, sharing VRAM where data repeats
+	TexarcVramLayout layout;
+	TexarcGetVramLayout(nsbtx, nsbtx->vramFlags, &layout);
+	int has4Color = 0;
+
 	for (int i = 0; i < nsbtx->nTextures; i++) {
+		//write the offset in the texImageParams
 		TEXELS *texture = nsbtx->textures + i;
-		int width = TEXW(texture->texImageParam);
-		int height = texture->height;
-		int texelSize = TxGetTexelSize(width, height, texture->texImageParam);
-
-		if (FORMAT(texture->texImageParam) == CT_4x4) {
-			//write the offset in the texImageParams
-			int ofs = (tex4x4Data.pos >> 3) & 0xFFFF;
-			texture->texImageParam = (texture->texImageParam & 0xFFFF0000) | ofs;
-			bstreamWrite(&tex4x4Data, texture->texel, texelSize);
-			bstreamWrite(&tex4x4PlttIdxData, (BYTE *) texture->cmp, texelSize / 2);
-		} else {
-			int ofs = (texData.pos >> 3) & 0xFFFF;
-			texture->texImageParam = (texture->texImageParam & 0xFFFF0000) | ofs;
-			bstreamWrite(&texData, texture->texel, texelSize);
-		}
+		texture->texImageParam = (texture->texImageParam & 0xFFFF0000) | ((layout.textureOffsets[i] >> 3) & 0xFFFF);
 	}
 
-	int *paletteOffsets = (int *) calloc(nsbtx->nTextures, sizeof(int));
-	int has4Color = 0;
 	for (int i = 0; i < nsbtx->nPalettes; i++) {
-		int offs = paletteData.pos;
-		PALETTE *palette = nsbtx->palettes + i;
-
-		//if not a palette4 palette, ensure alignment
-		int nColors = palette->nColors;
-		if (nColors > 4) {
-			bstreamAlign(&paletteData, 16);
-		}
-		paletteOffsets[i] = paletteData.pos;
-
-		//palette
-		bstreamWrite(&paletteData, (BYTE *) palette->pal, nColors * 2);
-
 		//do we have 4 color?
-		if (nColors <= 4) has4Color = 1;
+		if (nsbtx->palettes[i].nColors <= 4) has4Color = 1;
 	}
 
-	//if palette section size unaligned, pad it
-	bstreamAlign(&paletteData, 16);
+	//reserve the rest of the archive: headers, dictionaries and data
+	int dataSize = layout.texelSize + layout.texel4x4Size + layout.texel4x4Size / 2 + layout.paletteSize;
+	bstreamReserve(stream, stream->pos + 0x100 + (nsbtx->nTextures + nsbtx->nPalettes) * 0x20 + dataSize);
 
 	uint8_t texInfo[] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
 	*(uint16_t *) (texInfo + 6) = 60;
-	*(uint16_t *) (texInfo + 4) = texData.pos >> 3;
+	*(uint16_t *) (texInfo + 4) = layout.texelSize >> 3;
 	*(uint32_t *) (texInfo + 12) = 92 + nsbtx->nTextures * 28 + nsbtx->nPalettes * 24;
 	bstreamWrite(stream, texInfo, sizeof(texInfo));
 
 	uint8_t tex4x4Info[] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
 	*(uint16_t *) (tex4x4Info + 6) = 60;
 	*(uint16_t *) (tex4x4Info + 8) = has4Color ? 0x8000 : 0; //to accommodate an NNS G3D bug
-	*(uint16_t *) (tex4x4Info + 4) = tex4x4Data.pos >> 3;
-	*(uint32_t *) (tex4x4Info + 12) = 92 + nsbtx->nTextures * 28 + nsbtx->nPalettes * 24 + texData.pos;
-	*(uint32_t *) (tex4x4Info + 16) = (*(uint32_t *) (tex4x4Info + 12)) + tex4x4Data.pos;
+	*(uint16_t *) (tex4x4Info + 4) = layout.texel4x4Size >> 3;
+	*(uint32_t *) (tex4x4Info + 12) = 92 + nsbtx->nTextures * 28 + nsbtx->nPalettes * 24 + layout.texelSize;
+	*(uint32_t *) (tex4x4Info + 16) = (*(uint32_t *) (tex4x4Info + 12)) + layout.texel4x4Size;
 	bstreamWrite(stream, tex4x4Info, sizeof(tex4x4Info));
 
 	uint8_t plttInfo[] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
 	*(uint16_t *) (plttInfo + 8) = 76 + nsbtx->nTextures * 28;
-	*(uint16_t *) (plttInfo + 4) = paletteData.pos >> 3;
+	*(uint16_t *) (plttInfo + 4) = layout.paletteSize >> 3;
 	*(uint16_t *) (plttInfo + 6) = has4Color ? 0x8000 : 0;
-	*(uint32_t *) (plttInfo + 12) = 92 + nsbtx->nTextures * 28 + nsbtx->nPalettes * 24 + texData.pos + tex4x4Data.pos + tex4x4PlttIdxData.pos;
+	*(uint32_t *) (plttInfo + 12) = 92 + nsbtx->nTextures * 28 + nsbtx->nPalettes * 24 + layout.texelSize + layout.texel4x4Size + layout.texel4x4Size / 2;
 	bstreamWrite(stream, plttInfo, sizeof(plttInfo));
 
 	{
@@ -518,22 +924,45 @@ int TexarcWriteNsbtx(TexArc *nsbtx, BSTREAM *stream) {
 		
 		//write data
 		bstreamSeek(stream, dictOfs, 0);
-		for (int i = 0; i < nsbtx->nTextures; i++) {
+		for (int i = 0; i < nsbtx->nPalettes; i++) {
 			PALETTE *palette = nsbtx->palettes + i;
 			uint16_t dictData[2];
-			dictData[0] = paletteOffsets[i] >> 3;
+			dictData[0] = layout.paletteOffsets[i] >> 3;
 			dictData[1] = palette->nColors <= 4;
 			bstreamWrite(stream, dictData, sizeof(dictData));
 		}
 		bstreamSeek(stream, dictEndOfs, 0);
 	}
-	free(paletteOffsets);
 
-	//write texData, tex4x4Data, tex4x4PlttIdxData, paletteData
-	bstreamWrite(stream, texData.buffer, texData.pos);
-	bstreamWrite(stream, tex4x4Data.buffer, tex4x4Data.pos);
-	bstreamWrite(stream, tex4x4PlttIdxData.buffer, tex4x4PlttIdxData.pos);
-	bstreamWrite(stream, paletteData.buffer, paletteData.pos);
+	//write texData, tex4x4Data, tex4x4PlttIdxData, paletteData from the entries owning their data
+	int texDataPos = stream->pos;
+	int tex4x4DataPos = texDataPos + layout.texelSize;
+	int tex4x4PlttIdxDataPos = tex4x4DataPos + layout.texel4x4Size;
+	int paletteDataPos = tex4x4PlttIdxDataPos + layout.texel4x4Size / 2;
+	for (int i = 0; i < nsbtx->nTextures; i++) {
+		TEXELS *texture = nsbtx->textures + i;
+		if (layout.textureOwners[i] != i || FORMAT(texture->texImageParam) == CT_4x4) continue;
+		TexarciWriteAt(stream, texDataPos + layout.textureOffsets[i], texture->texel, TexarciGetTexelSize(texture));
+	}
+	TexarciWriteAt(stream, tex4x4DataPos, NULL, 0);
+	for (int i = 0; i < nsbtx->nTextures; i++) {
+		TEXELS *texture = nsbtx->textures + i;
+		if (layout.textureOwners[i] != i || FORMAT(texture->texImageParam) != CT_4x4) continue;
+		TexarciWriteAt(stream, tex4x4DataPos + layout.textureOffsets[i], texture->texel, TexarciGetTexelSize(texture));
+	}
+	TexarciWriteAt(stream, tex4x4PlttIdxDataPos, NULL, 0);
+	for (int i = 0; i < nsbtx->nTextures; i++) {
+		TEXELS *texture = nsbtx->textures + i;
+		if (layout.textureOwners[i] != i || FORMAT(texture->texImageParam) != CT_4x4) continue;
+		TexarciWriteAt(stream, tex4x4PlttIdxDataPos + layout.textureOffsets[i] / 2, texture->cmp, TexarciGetTexelSize(texture) / 2);
+	}
+	TexarciWriteAt(stream, paletteDataPos, NULL, 0);
+	for (int i = 0; i < nsbtx->nPalettes; i++) {
+		PALETTE *palette = nsbtx->palettes + i;
+		if (layout.paletteOwners[i] != i) continue;
+		TexarciWriteAt(stream, paletteDataPos + layout.paletteOffsets[i], palette->pal, palette->nColors * sizeof(COLOR));
+	}
+	TexarciWriteAt(stream, paletteDataPos + layout.paletteSize, NULL, 0);
 
 	//write back the proper sizes
 	DWORD endPos = stream->pos;
@@ -554,11 +983,10 @@ int TexarcWriteNsbtx(TexArc *nsbtx, BSTREAM *stream) {
 		bstreamWrite(stream, &tex0Offset, 4);
 	}
 
+	TexarciCacheImage(nsbtx, stream->buffer, endPos, tex0Offset);
+
 	//free resources
-	bstreamFree(&texData);
-	bstreamFree(&tex4x4Data);
-	bstreamFree(&tex4x4PlttIdxData);
-	bstreamFree(&paletteData);
+	TexarcFreeVramLayout(&layout);
 
 	return 0;
 }
@@ -713,24 +1141,92 @@ int TexarcWriteFile(TexArc *nsbtx, LPWSTR name) {
 	return ObjWriteFile(name, (OBJECT_HEADER *) nsbtx, (OBJECT_WRITER) TexarcWrite);
 }
 
-int TexarcGetTextureIndexByName(TexArc *nsbtx, const char *name) {
-	for (int i = 0; i < nsbtx->nTextures; i++) {
-		if (strncmp(nsbtx->textures[i].name, name, 16) == 0) {
-			return i;
-		}
+// ----- name index. Names are found at a stride from the first entry's name, so one index serves textures and palettes.
+
+static uint32_t TexarciHashName(const char *name) {
+	uint32_t hash = 0x811C9DC5;
+	for (int i = 0; i < 16 && name[i] != '\0'; i++) {
+		hash = (hash ^ (unsigned char) name[i]) * 0x01000193;
 	}
-	return -1;
+	return hash;
 }
 
-int TexarcGetPaletteIndexByName(TexArc *nsbtx, const char *name) {
-	for (int i = 0; i < nsbtx->nPalettes; i++) {
-		if (strncmp(nsbtx->palettes[i].name, name, 16) == 0) {
-			return i;
-		}
+static const char *TexarciGetName(const char *names, size_t stride, int i) {
+	return names + i * stride;
+}
+
+static const char *TexarciTextureNames(TexArc *nsbtx) {
+	return (const char *) nsbtx->textures + offsetof(TEXELS, name);
+}
+
+static const char *TexarciPaletteNames(TexArc *nsbtx) {
+	return (const char *) nsbtx->palettes + offsetof(PALETTE, name);
+}
+
+static void TexarciIndexInsert(TexarcNameIndex *index, const char *names, size_t stride, int i) {
+	int mask = index->nSlots - 1;
+	int slot = TexarciHashName(TexarciGetName(names, stride, i)) & mask;
+	while (index->slots[slot]) slot = (slot + 1) & mask;
+	index->slots[slot] = i + 1;
+	index->nEntries++;
+}
+
+static void TexarciIndexRebuild(TexarcNameIndex *index, const char *names, size_t stride, int nEntries) {
+	//keep the table at most half full
+	int nSlots = 16;
+	while (nSlots < nEntries * 2) nSlots *= 2;
+	if (nSlots != index->nSlots) {
+		if (index->slots != NULL) free(index->slots);
+		index->slots = (int *) malloc(nSlots * sizeof(int));
+		index->nSlots = nSlots;
+	}
+	memset(index->slots, 0, nSlots * sizeof(int));
+
+	//insert in order so that the first of duplicate names is found first
+	index->nEntries = 0;
+	for (int i = 0; i < nEntries; i++) TexarciIndexInsert(index, names, stride, i);
+}
+
+static void TexarciIndexAppend(TexarcNameIndex *index, const char *names, size_t stride, int nEntries) {
+	//the last entry was just added
+	if (index->nEntries != nEntries - 1 || nEntries * 2 > index->nSlots) {
+		TexarciIndexRebuild(index, names, stride, nEntries);
+	} else {
+		TexarciIndexInsert(index, names, stride, nEntries - 1);
+	}
+}
+
+static int TexarciIndexFind(TexarcNameIndex *index, const char *names, size_t stride, int nEntries, const char *name) {
+	if (nEntries == 0) return -1;
+	if (index->nEntries != nEntries) TexarciIndexRebuild(index, names, stride, nEntries);
+
+	int mask = index->nSlots - 1;
+	int slot = TexarciHashName(name) & mask;
+	while (index->slots[slot]) {
+		int i = index->slots[slot] - 1;
+		if (strncmp(TexarciGetName(names, stride, i), name, 16) == 0) return i;
+		slot = (slot + 1) & mask;
 	}
 	return -1;
 }
 
+static void *TexarciReserve(void *entries, int nEntries, int *capacity, size_t size) {
+	//grow geometrically, so that adding entries one at a time takes linear time
+	if (*capacity < nEntries) *capacity = nEntries;
+	if (nEntries + 1 <= *capacity) return entries;
+
+	*capacity = *capacity < 8 ? 8 : *capacity * 2;
+	return realloc(entries, *capacity * size);
+}
+
+int TexarcGetTextureIndexByName(TexArc *nsbtx, const char *name) {
+	return TexarciIndexFind(&nsbtx->textureNames, TexarciTextureNames(nsbtx), sizeof(TEXELS), nsbtx->nTextures, name);
+}
+
+int TexarcGetPaletteIndexByName(TexArc *nsbtx, const char *name) {
+	return TexarciIndexFind(&nsbtx->paletteNames, TexarciPaletteNames(nsbtx), sizeof(PALETTE), nsbtx->nPalettes, name);
+}
+
 TEXELS *TexarcGetTextureByName(TexArc *nsbtx, const char *name) {
 	int index = TexarcGetTextureIndexByName(nsbtx, name);
 	if (index == -1) return NULL;
@@ -750,9 +1246,10 @@ int TexarcAddTexture(TexArc *nsbtx, TEXELS *texture) {
 	if (TexarcGetTextureByName(nsbtx, texture->name) != NULL) return -1;
 
 	//add texture
-	nsbtx->textures = realloc(nsbtx->textures, (nsbtx->nTextures + 1) * sizeof(TEXELS));
+	nsbtx->textures = (TEXELS *) TexarciReserve(nsbtx->textures, nsbtx->nTextures, &nsbtx->textureCapacity, sizeof(TEXELS));
 	memcpy(nsbtx->textures + nsbtx->nTextures, texture, sizeof(TEXELS));
 	nsbtx->nTextures++;
+	TexarciIndexAppend(&nsbtx->textureNames, TexarciTextureNames(nsbtx), sizeof(TEXELS), nsbtx->nTextures);
 	return nsbtx->nTextures - 1;
 }
 
@@ -786,9 +1283,47 @@ int TexarcAddPalette(TexArc *nsbtx, PALETTE *palette) {
 	}
 
 	//add palette
-	nsbtx->palettes = realloc(nsbtx->palettes, (nsbtx->nPalettes + 1) * sizeof(PALETTE));
+	nsbtx->palettes = (PALETTE *) TexarciReserve(nsbtx->palettes, nsbtx->nPalettes, &nsbtx->paletteCapacity, sizeof(PALETTE));
 	memcpy(nsbtx->palettes + nsbtx->nPalettes, palette, sizeof(PALETTE));
 	nsbtx->nPalettes++;
+	TexarciIndexAppend(&nsbtx->paletteNames, TexarciPaletteNames(nsbtx), sizeof(PALETTE), nsbtx->nPalettes);
 	return nsbtx->nPalettes - 1;
 }
 
+void TexarcRemoveTexture(TexArc *nsbtx, int index) {
+	TEXELS *texture = nsbtx->textures + index;
+	if (texture->texel != NULL) free(texture->texel);
+	if (texture->cmp != NULL) free(texture->cmp);
+
+	//the array keeps its allocation
+	if (nsbtx->textureCapacity < nsbtx->nTextures) nsbtx->textureCapacity = nsbtx->nTextures;
+	memmove(texture, texture + 1, (nsbtx->nTextures - index - 1) * sizeof(TEXELS));
+	nsbtx->nTextures--;
+	TexarciIndexRebuild(&nsbtx->textureNames, TexarciTextureNames(nsbtx), sizeof(TEXELS), nsbtx->nTextures);
+}
+
+void TexarcRemovePalette(TexArc *nsbtx, int index) {
+	PALETTE *palette = nsbtx->palettes + index;
+	if (palette->pal != NULL) free(palette->pal);
+
+	//the array keeps its allocation
+	if (nsbtx->paletteCapacity < nsbtx->nPalettes) nsbtx->paletteCapacity = nsbtx->nPalettes;
+	memmove(palette, palette + 1, (nsbtx->nPalettes - index - 1) * sizeof(PALETTE));
+	nsbtx->nPalettes--;
+	TexarciIndexRebuild(&nsbtx->paletteNames, TexarciPaletteNames(nsbtx), sizeof(PALETTE), nsbtx->nPalettes);
+}
+
+void TexarcSetTextureName(TexArc *nsbtx, int index, const char *name) {
+	char *dest = nsbtx->textures[index].name;
+	memset(dest, 0, 16);
+	memcpy(dest, name, min(strlen(name), 16));
+	TexarciIndexRebuild(&nsbtx->textureNames, TexarciTextureNames(nsbtx), sizeof(TEXELS), nsbtx->nTextures);
+}
+
+void TexarcSetPaletteName(TexArc *nsbtx, int index, const char *name) {
+	char *dest = nsbtx->palettes[index].name;
+	memset(dest, 0, 16);
+	memcpy(dest, name, min(strlen(name), 16));
+	TexarciIndexRebuild(&nsbtx->paletteNames, TexarciPaletteNames(nsbtx), sizeof(PALETTE), nsbtx->nPalettes);
+}
+
@@ -27,12 +27,52 @@ typedef struct BMD_DATA_ {
 } BMD_DATA;
 
 
+//
+// Hash index of the 16-character names of a texture archive's textures or
+// palettes. It is kept up to date by the TexArc functions that add, remove and
+// rename entries, and is rebuilt by a lookup if the number of entries changed
+// without them.
+//
+typedef struct TexarcNameIndex_ {
+	int *slots;                        // entry index + 1 of each slot, 0 when empty
+	int nSlots;                        // power of 2
+	int nEntries;                      // number of entries indexed
+} TexarcNameIndex;
+
+//
+// Image of an NNS archive as it was last read or written. Writing the archive
+// again compares each texture and palette against its data in the image and
+// patches only those that changed, as long as the names, formats and sizes of
+// all of them are unchanged and the changed data is not shared with another
+// texture or palette. Otherwise the archive is rebuilt and the image replaced.
+//
+typedef struct TexarcWriteCache_ {
+	unsigned char *image;              // file as last read or written, NULL if there is none
+	unsigned int size;
+	int hasModel;                      // the image has a MDL0 section before its TEX0 section
+	int nTextures;
+	int nPalettes;
+	TEXELS *textures;                  // textures as in the image, without their data
+	PALETTE *palettes;                 // palettes as in the image, without their data
+	unsigned int *textureOffsets;      // image offset of each texture's texels
+	unsigned int *indexOffsets;        // image offset of each 4x4 texture's palette index data
+	unsigned int *paletteOffsets;      // image offset of each palette's colors
+	unsigned char *textureShared;      // texture data overlaps other data in the image
+	unsigned char *paletteShared;      // palette data overlaps other data in the image
+} TexarcWriteCache;
+
 typedef struct TexArc_ { //these should not be converted to other formats
 	OBJECT_HEADER header;
 	int nTextures;
 	int nPalettes;
 	TEXELS *textures;
 	PALETTE *palettes;
+	int textureCapacity;               // allocated textures, less than nTextures if allocated exactly
+	int paletteCapacity;               // allocated palettes, less than nPalettes if allocated exactly
+	TexarcNameIndex textureNames;
+	TexarcNameIndex paletteNames;
+	TexarcWriteCache writeCache;
+	int vramFlags;                     // TEXARC_VRAM_* flags of the layout the archive is written with
 
 	void *mdl0;			//for handling NSBMD files as well
 	int mdl0Size;
@@ -51,6 +91,38 @@ int TexarcWriteFile(TexArc *nsbtx, LPWSTR filename);
 
 int TexarcWrite(TexArc *nsbtx, BSTREAM *stream);
 
+#define TEXARC_VRAM_PACK                 1   // share VRAM between textures or palettes holding the same data
+
+//
+// Placement of an archive's textures and palettes in its texel and palette
+// data. A packed layout places each texture whose data is identical to, or a
+// prefix of, another's at that one's offset, so that they share VRAM. Textures
+// compare their 4x4 palette index data too, since its offset follows from the
+// texel offset. Palettes share only identical data: palette lengths are not
+// stored, so a palette placed at a longer one's offset would be read back with
+// the longer length.
+//
+typedef struct TexarcVramLayout_ {
+	int *textureOffsets;               // byte offset of each texture in the texel data of its kind
+	int *paletteOffsets;               // byte offset of each palette in the palette data
+	int *textureOwners;                // texture whose data is stored at each texture's offset
+	int *paletteOwners;                // palette whose data is stored at each palette's offset
+	int texelSize;                     // bytes of non-4x4 texel data
+	int texel4x4Size;                  // bytes of 4x4 texel data, the palette index data is half as large
+	int paletteSize;                   // bytes of palette data, padded to 16 bytes
+	int nSharedTextures;               // textures placed at another texture's offset
+	int nSharedPalettes;               // palettes placed at another palette's offset
+} TexarcVramLayout;
+
+//
+// Compute the VRAM layout of an archive from TEXARC_VRAM_* flags, in order
+// when none are set. The archive is written with the layout of its vramFlags,
+// TEXARC_VRAM_PACK unless changed.
+//
+void TexarcGetVramLayout(TexArc *nsbtx, int flags, TexarcVramLayout *layout);
+
+void TexarcFreeVramLayout(TexarcVramLayout *layout);
+
 int TexarcGetTextureIndexByName(TexArc *nsbtx, const char *name);
 
 int TexarcGetPaletteIndexByName(TexArc *nsbtx, const char *name);
@@ -62,3 +134,18 @@ PALETTE *TexarcGetPaletteByName(TexArc *nsbtx, const char *name);
 int TexarcAddTexture(TexArc *nsbtx, TEXELS *texture);
 
 int TexarcAddPalette(TexArc *nsbtx, PALETTE *palette);
+
+//
+// Remove a texture or palette from an archive, freeing its data.
+//
+void TexarcRemoveTexture(TexArc *nsbtx, int index);
+
+void TexarcRemovePalette(TexArc *nsbtx, int index);
+
+//
+// Rename a texture or palette of an archive. Names longer than 16 characters
+// are truncated.
+//
+void TexarcSetTextureName(TexArc *nsbtx, int index, const char *name);
+
+void TexarcSetPaletteName(TexArc *nsbtx, int index, const char *name);
@@ -57,28 +57,24 @@ HBITMAP renderTexture(TEXELS *texture, PALETTE *palette, int zoom) {
 	return hBitmap;
 }
 
-int levenshtein(const char *str1, int l1, const char *str2, int l2, int dst, int maxDst) {
-	if (dst >= maxDst) return maxDst;
-	while (1) {
-		if (l1 == 0) return l2;
-		if (l2 == 0) return l1;
-
-		char c1 = *str1, c2 = *str2;
-		if (c1 >= 'a' && c1 <= 'z') c1 = c1 + 'A' - 'a';
-		if (c2 >= 'a' && c2 <= 'z') c2 = c2 + 'A' - 'a';
-
-		if (c1 != c2) {
-			int m1 = levenshtein(str1 + 1, l1 - 1, str2, l2, dst + 1, maxDst);
-			int m2 = levenshtein(str1, l1, str2 + 1, l2 - 1, dst + 1, min(maxDst, m1));
-			int m3 = levenshtein(str1 + 1, l1 - 1, str2 + 1, l2 - 1, dst + 1, min(maxDst, m2));
-			return min(min(m1, m2), m3) + 1;
+static int TexarcViewerNameDistance(const char *str1, int l1, const char *str2, int l2) {
+	//Levenshtein distance, one row at a time. Names are at most 16 characters.
+	int row[17];
+	for (int j = 0; j <= l2; j++) row[j] = j;
+
+	for (int i = 1; i <= l1; i++) {
+		int diag = row[0];
+		row[0] = i;
+		for (int j = 1; j <= l2; j++) {
+			int above = row[j];
+			int cost = diag + (str1[i - 1] != str2[j - 1]);
+			if (above + 1 < cost) cost = above + 1;
+			if (row[j - 1] + 1 < cost) cost = row[j - 1] + 1;
+			row[j] = cost;
+			diag = above;
 		}
-
-		str1++;
-		str2++;
-		l1--;
-		l2--;
 	}
+	return row[l2];
 }
 
 int calculateHighestPaletteIndex(TEXELS *texture) {
@@ -137,14 +133,183 @@ int calculateHighestPaletteIndex(TEXELS *texture) {
 	return nHighest;
 }
 
-int guessTexPlttByName(char *textureName, char **paletteNames, int nPalettes, TEXELS *texture, PALETTE *palettes) {
+#define PLTT_GUESS_BUCKETS         4096                     // trigram hash buckets of palette names
+
+//
+// Index of an archive's palette names for guessing the palette of each of its
+// textures. Names are compared case-insensitively, so they are kept upper-case.
+// Exact names are found by hash, and otherwise palettes are ranked by the
+// trigrams their names share with the texture's.
+//
+typedef struct PlttGuessIndex_ {
+	char (*names)[17];                 // upper-case palette names
+	int *lengths;
+	int nPalettes;
+	int *slots;                        // hash of names, palette index + 1, 0 when empty
+	int nSlots;
+	int *bucketStart;                  // first posting of each trigram bucket, with one past the end
+	int *postings;                     // palettes having a trigram in each bucket, ascending
+	int *shared;                       // per palette, trigram buckets shared with the texture
+	int *touched;                      // palettes sharing any trigram bucket with the texture
+} PlttGuessIndex;
+
+static uint32_t PlttGuessHashName(const char *name) {
+	uint32_t hash = 0x811C9DC5;
+	while (*name) hash = (hash ^ (unsigned char) *(name++)) * 0x01000193;
+	return hash;
+}
+
+static int PlttGuessTrigramBucket(const char *str) {
+	return (((unsigned char) str[0] * 31 + (unsigned char) str[1]) * 31 + (unsigned char) str[2]) & (PLTT_GUESS_BUCKETS - 1);
+}
+
+static void PlttGuessUpperName(char *dest, const char *name) {
+	int i;
+	for (i = 0; i < 16 && name[i] != '\0'; i++) {
+		char c = name[i];
+		if (c >= 'a' && c <= 'z') c = c + 'A' - 'a';
+		dest[i] = c;
+	}
+	dest[i] = '\0';
+}
+
+//get the distinct trigram buckets of an upper-case name, returning their count
+static int PlttGuessGetTrigrams(const char *name, int len, int *buckets) {
+	int nBuckets = 0;
+	for (int i = 0; i + 3 <= len; i++) {
+		int bucket = PlttGuessTrigramBucket(name + i);
+
+		int j;
+		for (j = 0; j < nBuckets; j++) if (buckets[j] == bucket) break;
+		if (j == nBuckets) buckets[nBuckets++] = bucket;
+	}
+	return nBuckets;
+}
+
+static void PlttGuessInit(PlttGuessIndex *index, PALETTE *palettes, int nPalettes) {
+	index->nPalettes = nPalettes;
+	index->names = (char (*)[17]) calloc(nPalettes + 1, sizeof(*index->names));
+	index->lengths = (int *) calloc(nPalettes + 1, sizeof(int));
+	index->shared = (int *) calloc(nPalettes + 1, sizeof(int));
+	index->touched = (int *) calloc(nPalettes + 1, sizeof(int));
+	index->bucketStart = (int *) calloc(PLTT_GUESS_BUCKETS + 1, sizeof(int));
+	index->postings = (int *) calloc(nPalettes * 14 + 1, sizeof(int));
+
+	index->nSlots = 16;
+	while (index->nSlots < nPalettes * 2) index->nSlots *= 2;
+	index->slots = (int *) calloc(index->nSlots, sizeof(int));
+
+	//hash names, in order so the first of equal names is found first
+	for (int i = 0; i < nPalettes; i++) {
+		PlttGuessUpperName(index->names[i], palettes[i].name);
+		index->lengths[i] = strlen(index->names[i]);
+
+		int slot = PlttGuessHashName(index->names[i]) & (index->nSlots - 1);
+		while (index->slots[slot]) slot = (slot + 1) & (index->nSlots - 1);
+		index->slots[slot] = i + 1;
+	}
+
+	//count, then fill trigram postings
+	int buckets[14];
+	for (int i = 0; i < nPalettes; i++) {
+		int nBuckets = PlttGuessGetTrigrams(index->names[i], index->lengths[i], buckets);
+		for (int j = 0; j < nBuckets; j++) index->bucketStart[buckets[j] + 1]++;
+	}
+	for (int i = 0; i < PLTT_GUESS_BUCKETS; i++) index->bucketStart[i + 1] += index->bucketStart[i];
+
+	int *fill = (int *) calloc(PLTT_GUESS_BUCKETS, sizeof(int));
+	memcpy(fill, index->bucketStart, PLTT_GUESS_BUCKETS * sizeof(int));
+	for (int i = 0; i < nPalettes; i++) {
+		int nBuckets = PlttGuessGetTrigrams(index->names[i], index->lengths[i], buckets);
+		for (int j = 0; j < nBuckets; j++) index->postings[fill[buckets[j]]++] = i;
+	}
+	free(fill);
+}
+
+static void PlttGuessFree(PlttGuessIndex *index) {
+	free(index->names);
+	free(index->lengths);
+	free(index->shared);
+	free(index->touched);
+	free(index->bucketStart);
+	free(index->postings);
+	free(index->slots);
+}
+
+static int PlttGuessFindName(PlttGuessIndex *index, const char *name) {
+	char upper[17];
+	PlttGuessUpperName(upper, name);
+
+	int slot = PlttGuessHashName(upper) & (index->nSlots - 1);
+	while (index->slots[slot]) {
+		int i = index->slots[slot] - 1;
+		if (strcmp(index->names[i], upper) == 0) return i;
+		slot = (slot + 1) & (index->nSlots - 1);
+	}
+	return -1;
+}
+
+static int PlttGuessClosestName(PlttGuessIndex *index, const char *textureName, const unsigned char *valids) {
+	char name[17];
+	PlttGuessUpperName(name, textureName);
+	int len = strlen(name);
+
+	//count the trigram buckets each palette shares with the texture
+	int buckets[14];
+	int nBuckets = PlttGuessGetTrigrams(name, len, buckets);
+	int nTouched = 0, maxShared = 0;
+	for (int i = 0; i < nBuckets; i++) {
+		for (int j = index->bucketStart[buckets[i]]; j < index->bucketStart[buckets[i] + 1]; j++) {
+			int p = index->postings[j];
+			if (index->shared[p]++ == 0) index->touched[nTouched++] = p;
+			if (index->shared[p] > maxShared) maxShared = index->shared[p];
+		}
+	}
+
+	//Visit palettes by decreasing shared trigrams. Each edit removes at most 3 of the texture's
+	//trigrams, so a palette sharing s of its n distinct trigram buckets is at least (n - s) / 3
+	//edits away. Stop once no remaining palette can beat the best, ties going to the first.
+	int bestDistance = 0x7FFFFFFF, bestIndex = -1;
+	for (int s = maxShared; s >= 0; s--) {
+		int lowerBound = (nBuckets - s + 2) / 3;
+		if (lowerBound > bestDistance) break;
+
+		if (s > 0) {
+			for (int i = 0; i < nTouched; i++) {
+				int p = index->touched[i];
+				if (index->shared[p] != s || !valids[p]) continue;
+
+				int dst = TexarcViewerNameDistance(name, len, index->names[p], index->lengths[p]);
+				if (dst < bestDistance || (dst == bestDistance && p < bestIndex)) {
+					bestDistance = dst;
+					bestIndex = p;
+				}
+			}
+		} else {
+			for (int p = 0; p < index->nPalettes; p++) {
+				if (index->shared[p] != 0 || !valids[p]) continue;
+
+				int dst = TexarcViewerNameDistance(name, len, index->names[p], index->lengths[p]);
+				if (dst < bestDistance || (dst == bestDistance && p < bestIndex)) {
+					bestDistance = dst;
+					bestIndex = p;
+				}
+			}
+		}
+	}
+
+	for (int i = 0; i < nTouched; i++) index->shared[index->touched[i]] = 0;
+	return bestIndex;
+}
+
+int guessTexPlttByName(PlttGuessIndex *index, char *textureName, TEXELS *texture, PALETTE *palettes) {
 	int format = FORMAT(texture->texImageParam);
 	if (format == CT_DIRECT) return -1;
+	int nPalettes = index->nPalettes;
 
 	//first gueses: Same name (case insensitive)?
-	for (int i = 0; i < nPalettes; i++) {
-		if (_stricmp(textureName, paletteNames[i]) == 0) return i;
-	}
+	int found = PlttGuessFindName(index, textureName);
+	if (found != -1) return found;
 
 	//second guess: add "_pl" to texture name (and truncate to 16)
 	char nameBuffer[20];
@@ -152,35 +317,32 @@ int guessTexPlttByName(char *textureName, char **paletteNames, int nPalettes, TE
 	memcpy(nameBuffer + strlen(nameBuffer), "_pl", 4);
 	nameBuffer[16] = '\0';
 
-	for (int i = 0; i < nPalettes; i++) {
-		if (_stricmp(nameBuffer, paletteNames[i]) == 0) return i;
-	}
+	found = PlttGuessFindName(index, nameBuffer);
+	if (found != -1) return found;
 
 	//third guess: same as last but truncate to 15 (sometimes names are only 15 characters?)
 	nameBuffer[15] = '\0';
-	for (int i = 0; i < nPalettes; i++) {
-		if (_stricmp(nameBuffer, paletteNames[i]) == 0) return i;
-	}
+	found = PlttGuessFindName(index, nameBuffer);
+	if (found != -1) return found;
 
 	//fourth guess: add "_pl" after truncating texture name length to 13
 	memcpy(nameBuffer, textureName, strlen(textureName) + 1);
 	nameBuffer[13] = '\0';
 	memcpy(nameBuffer + strlen(nameBuffer), "_pl", 4);
-	for (int i = 0; i < nPalettes; i++) {
-		if (_stricmp(nameBuffer, paletteNames[i]) == 0) return i;
-	}
+	found = PlttGuessFindName(index, nameBuffer);
+	if (found != -1) return found;
 
 	//fifth guess: same thing but truncate texture name length to 12
 	memcpy(nameBuffer, textureName, strlen(textureName) + 1);
 	nameBuffer[12] = '\0';
 	memcpy(nameBuffer + strlen(nameBuffer), "_pl", 4);
-	for (int i = 0; i < nPalettes; i++) {
-		if (_stricmp(nameBuffer, paletteNames[i]) == 0) return i;
-	}
+	found = PlttGuessFindName(index, nameBuffer);
+	if (found != -1) return found;
 	
 	//do a search for the "best-conforming" palette. Palette must use at least the number of colors the texture references.
 	//For paletted textures (not 4x4 and not direct), do not allow for more colors than is standard for the format. 
-	unsigned char *valids = (unsigned char *) calloc(nPalettes, 1);
+	int nHighest = calculateHighestPaletteIndex(texture);
+	unsigned char *valids = (unsigned char *) calloc(nPalettes + 1, 1);
 	for (int i = 0; i < nPalettes; i++) {
 		int nColors = palettes[i].nColors;
 
@@ -191,7 +353,6 @@ int guessTexPlttByName(char *textureName, char **paletteNames, int nPalettes, TE
 		else if (nColors > 256 && (format == CT_A3I5 || format == CT_A5I3)) continue; //OPTPiX quirk
 
 		//test for not enough colors
-		int nHighest = calculateHighestPaletteIndex(texture);
 		if (nHighest >= nColors) continue;
 
 		//if it's a 4x4 texture, allow some wiggle room.
@@ -214,16 +375,7 @@ int guessTexPlttByName(char *textureName, char **paletteNames, int nPalettes, TE
 	}
 
 	//well, nothing's worked so far. Let's try using Levenshtein distance to be our best guess.
-	int bestDistance = 0x7FFFFFFF, bestIndex = -1;
-	for (int i = 0; i < nPalettes; i++) {
-		if (!valids[i]) continue;
-
-		int dst = levenshtein(textureName, strlen(textureName), paletteNames[i], strlen(paletteNames[i]), 0, bestDistance);
-		if (dst < bestDistance) {
-			bestDistance = dst;
-			bestIndex = i;
-		}
-	}
+	int bestIndex = PlttGuessClosestName(index, textureName, valids);
 
 	free(valids);
 	if (bestIndex != -1) {
@@ -481,25 +633,13 @@ LRESULT WINAPI NsbtxViewerWndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lPa
 			int sel = wParam;
 			if (hWndControl == data->hWndTextureSelect) {
 				//delete the sel-th texture
-				TEXELS *textures = data->nsbtx.textures;
-				void *texel = textures[sel].texel, *index = textures[sel].cmp;
-				memmove(textures + sel, textures + sel + 1, (data->nsbtx.nTextures - sel - 1) * sizeof(TEXELS));
-				data->nsbtx.nTextures--;
-				data->nsbtx.textures = (TEXELS *) realloc(data->nsbtx.textures, data->nsbtx.nTextures * sizeof(TEXELS));
-				//don't forget to free!
-				free(texel);
-				if (index) free(index);
+				TexarcRemoveTexture(&data->nsbtx, sel);
 
 				//update index if it would be out of bounds
 				if (sel >= data->nsbtx.nTextures) sel = data->nsbtx.nTextures - 1;
 			} else if (hWndControl == data->hWndPaletteSelect) {
 				//delete the sel-th palette
-				PALETTE *palettes = data->nsbtx.palettes;
-				void *cols = palettes[sel].pal;
-				memmove(palettes + sel, palettes + sel + 1, (data->nsbtx.nPalettes - sel - 1) * sizeof(PALETTE));
-				data->nsbtx.nPalettes--;
-				data->nsbtx.palettes = (PALETTE *) realloc(data->nsbtx.palettes, data->nsbtx.nPalettes * sizeof(PALETTE));
-				free(cols);
+				TexarcRemovePalette(&data->nsbtx, sel);
 				if (sel >= data->nsbtx.nPalettes) sel = data->nsbtx.nPalettes - 1;
 			}
 			SetListBoxSelection(hWndControl, sel);
@@ -595,20 +735,16 @@ LRESULT WINAPI NsbtxViewerWndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lPa
 							pathLen++;
 						}
 
-						//iterate over textures. First, create an array of palette names.
-						char **palNames = (char **) calloc(data->nsbtx.nPalettes, sizeof(char *));
-						for (int i = 0; i < data->nsbtx.nPalettes; i++) {
-							char *nameBuffer = (char *) calloc(17, 1); //null terminator for convenience
-							memcpy(nameBuffer, data->nsbtx.palettes[i].name, 16);
-							palNames[i] = nameBuffer;
-						}
+						//iterate over textures. First, index the palette names.
+						PlttGuessIndex plttIndex;
+						PlttGuessInit(&plttIndex, data->nsbtx.palettes, data->nsbtx.nPalettes);
 
 						//next, associate each texture with a palette. Write out Nitro TGA files.
 						for (int i = 0; i < data->nsbtx.nTextures; i++) {
 							char name[17];
 							memcpy(name, data->nsbtx.textures[i].name, 16);
 							name[16] = '\0';
-							int pltt = guessTexPlttByName(name, palNames, data->nsbtx.nPalettes, &data->nsbtx.textures[i], data->nsbtx.palettes);
+							int pltt = guessTexPlttByName(&plttIndex, name, &data->nsbtx.textures[i], data->nsbtx.palettes);
 
 							//copy texture name to the end of `path`
 							for (unsigned int j = 0; j < strlen(name) + 1; j++) {
@@ -620,11 +756,7 @@ LRESULT WINAPI NsbtxViewerWndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lPa
 							TxWriteFileDirect(&data->nsbtx.textures[i], &data->nsbtx.palettes[pltt], TEXTURE_TYPE_NNSTGA, path);
 						}
 
-						//free palette name array
-						for (int i = 0; i < data->nsbtx.nPalettes; i++) {
-							free(palNames[i]);
-						}
-						free(palNames);
+						PlttGuessFree(&plttIndex);
 						free(path);
 					} else if (hWndControl == data->hWndResourceButton) {
 						HWND hWndMain = getMainWindow(hWnd);
@@ -704,15 +836,14 @@ LRESULT WINAPI NsbtxViewerWndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lPa
 							SetFocus(hWndControl);
 
 							//update TexArc
-							char *destName = NULL;
+							char name[17] = { 0 };
+							for (unsigned int i = 0; i < wcslen(textBuffer) && i < 16; i++) {
+								name[i] = (char) textBuffer[i];
+							}
 							if (hWndControl == data->hWndTextureSelect) {
-								destName = data->nsbtx.textures[sel].name;
+								TexarcSetTextureName(&data->nsbtx, sel, name);
 							} else {
-								destName = data->nsbtx.palettes[sel].name;
-							}
-							memset(destName, 0, 16);
-							for (unsigned int i = 0; i < wcslen(textBuffer); i++) {
-								destName[i] = (char) textBuffer[i];
+								TexarcSetPaletteName(&data->nsbtx, sel, name);
 							}
 						}
 					}
@@ -869,6 +1000,17 @@ LRESULT CALLBACK VramUseWndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lPara
 			SetWindowLong(hWnd, 5 * sizeof(void *), (LONG) normalTexelSize);
 			SetWindowLong(hWnd, 6 * sizeof(void *), (LONG) compressedTexelSize);
 			SetWindowLong(hWnd, 7 * sizeof(void *), (LONG) totalIndexSize);
+
+			//usage once packed as the archive is written
+			TexarcVramLayout layout;
+			TexarcGetVramLayout(nsbtx, nsbtx->vramFlags, &layout);
+			SetWindowLong(hWnd, 8 * sizeof(void *), (LONG) totalPaletteSize);
+			SetWindowLong(hWnd, 9 * sizeof(void *), (LONG) layout.texelSize);
+			SetWindowLong(hWnd, 10 * sizeof(void *), (LONG) layout.texel4x4Size);
+			SetWindowLong(hWnd, 11 * sizeof(void *), (LONG) layout.paletteSize);
+			SetWindowLong(hWnd, 12 * sizeof(void *), (LONG) layout.nSharedTextures);
+			SetWindowLong(hWnd, 13 * sizeof(void *), (LONG) layout.nSharedPalettes);
+			TexarcFreeVramLayout(&layout);
 			break;
 		}
 		case WM_COMMAND:
@@ -876,14 +1018,28 @@ LRESULT CALLBACK VramUseWndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lPara
 			HWND hWndControl = (HWND) lParam;
 			if (hWndControl != NULL) {
 				if (hWndControl == hWndInfoButton && HIWORD(wParam) == BN_CLICKED) {
-					WCHAR buffer[128];
+					WCHAR buffer[512];
 					int normalTexelSize = GetWindowLong(hWnd, 5 * sizeof(void *));
 					int compressedTexelSize = GetWindowLong(hWnd, 6 * sizeof(void *));
 					int totalIndexSize = GetWindowLong(hWnd, 7 * sizeof(void *));
-					wsprintfW(buffer, L"Texture Summary:\nNormal Texel:\t\t%d.%03dKB\nCompressed Texel:\t\t%d.%03dKB\nIndex Data:\t\t%d.%03dKB",
+					int paletteSize = GetWindowLong(hWnd, 8 * sizeof(void *));
+					int packedTexelSize = GetWindowLong(hWnd, 9 * sizeof(void *));
+					int packedCompressedSize = GetWindowLong(hWnd, 10 * sizeof(void *));
+					int packedPaletteSize = GetWindowLong(hWnd, 11 * sizeof(void *));
+					int nSharedTextures = GetWindowLong(hWnd, 12 * sizeof(void *));
+					int nSharedPalettes = GetWindowLong(hWnd, 13 * sizeof(void *));
+					int packedIndexSize = packedCompressedSize / 2;
+					wsprintfW(buffer, L"Texture Summary:\nNormal Texel:\t\t%d.%03dKB\nCompressed Texel:\t\t%d.%03dKB\nIndex Data:\t\t%d.%03dKB\nPalette:\t\t\t%d.%03dKB\n\n"
+						L"Packed (%d textures, %d palettes shared):\nNormal Texel:\t\t%d.%03dKB\nCompressed Texel:\t\t%d.%03dKB\nIndex Data:\t\t%d.%03dKB\nPalette:\t\t\t%d.%03dKB",
 						normalTexelSize / 1024, (normalTexelSize % 1024) * 1000 / 1024,
 						compressedTexelSize / 1024, (compressedTexelSize % 1024) * 1000 / 1024,
-						totalIndexSize / 1024, (totalIndexSize % 1024) * 1000 / 1024);
+						totalIndexSize / 1024, (totalIndexSize % 1024) * 1000 / 1024,
+						paletteSize / 1024, (paletteSize % 1024) * 1000 / 1024,
+						nSharedTextures, nSharedPalettes,
+						packedTexelSize / 1024, (packedTexelSize % 1024) * 1000 / 1024,
+						packedCompressedSize / 1024, (packedCompressedSize % 1024) * 1000 / 1024,
+						packedIndexSize / 1024, (packedIndexSize % 1024) * 1000 / 1024,
+						packedPaletteSize / 1024, (packedPaletteSize % 1024) * 1000 / 1024);
 					MessageBox(hWnd, buffer, L"Texture VRAM Usage", MB_ICONINFORMATION);
 				}
 			}
@@ -909,7 +1065,7 @@ LRESULT CALLBACK VramUseWndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lPara
 VOID RegisterNsbtxViewerClass(VOID) {
 	int features = EDITOR_FEATURE_ZOOM;
 	EditorRegister(L"NsbtxViewerClass", NsbtxViewerWndProc, L"NSBTX Editor", sizeof(NSBTXVIEWERDATA), features);
-	RegisterGenericClass(L"VramUseClass", VramUseWndProc, 8 * sizeof(void *));
+	RegisterGenericClass(L"VramUseClass", VramUseWndProc, 14 * sizeof(void *));
 }
 
 HWND CreateNsbtxViewer(int x, int y, int width, int height, HWND hWndParent, LPCWSTR path) {
@@ -580,7 +580,7 @@ int nscrGetTileEx(NSCR *nscr, NCGR *ncgr, NCLR *nclr, int charBase, int x, int y
 	}
 
 	COLOR32 charbuf[64];
-	uint8_t *ncgrTile = ncgr->tiles[tileNumber];
+	uint8_t *ncgrTile = NCGR_CHAR(ncgr, tileNumber);
 	for (int i = 0; i < 64; i++) {
 		if (ncgrTile[i] || !transparent) {
 			int colIndex = ncgrTile[i];
@@ -625,6 +625,7 @@ int ScrWriteNscr(NSCR *nscr, BSTREAM *stream) {
 	NnsStream nnsStream;
 	NnsStreamCreate(&nnsStream, "NSCR", 1, 0, NNS_TYPE_G2D, NNS_SIG_LE);
 	NnsStreamStartBlock(&nnsStream, "SCRN");
+	bstreamReserve(NnsStreamGetBlockStream(&nnsStream), 8 + sizeof(scrnHeader) + ScriGetDataSize(nscr));
 	NnsStreamWrite(&nnsStream, scrnHeader, sizeof(scrnHeader));
 	ScriWriteScreenData(nscr, NnsStreamGetBlockStream(&nnsStream));
 	NnsStreamEndBlock(&nnsStream);
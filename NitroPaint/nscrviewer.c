@@ -21,10 +21,79 @@ extern HICON g_appIcon;
 static void ScrViewerRender(HWND hWnd, FrameBuffer *fb, int scrollX, int scrollY, int renderWidth, int renderHeight);
 
 static void ScrViewerGraphicsChanged(NSCRVIEWERDATA *data) {
+	ObjMarkModified(&data->nscr.header);
 	InvalidateRect(data->ted.hWndViewer, NULL, FALSE);
 	PreviewLoadBgScreen(&data->nscr);
 }
 
+static void ScrViewerTilesChanged(NSCRVIEWERDATA *data, int tileX, int tileY, int tilesX, int tilesY) {
+	ObjMarkModified(&data->nscr.header);
+	TedInvalidateTiles((EDITOR_DATA *) data, &data->ted, tileX, tileY, tilesX, tilesY);
+	PreviewLoadBgScreen(&data->nscr);
+}
+
+ScrUsage *ScrViewerGetUsage(HWND hWnd) {
+	NSCRVIEWERDATA *data = (NSCRVIEWERDATA *) EditorGetData(hWnd);
+	ScrUsageUpdate(&data->usage, &data->nscr);
+	return &data->usage;
+}
+
+static void ScrViewerInvalidateMatchingTiles(NSCRVIEWERDATA *data, int chrStart, int chrEnd, int paltFirst, int paltLast) {
+	int tilesX = data->nscr.tilesX, tilesY = data->nscr.tilesY;
+	if (chrEnd - chrStart < SCRUSAGE_MAX_CHARS && tilesX > 0) {
+		//few characters: invalidate only the tiles listed in the usage index
+		ScrUsageUpdate(&data->usage, &data->nscr);
+		for (int chrno = chrStart; chrno < chrEnd; chrno++) {
+			int cell = ScrUsageGetFirstCell(&data->usage, chrno + data->tileBase);
+			for (; cell != -1; cell = ScrUsageGetNextCell(&data->usage, cell)) {
+				int palno = data->nscr.data[cell] >> 12;
+				if (palno < paltFirst || palno > paltLast) continue;
+
+				TedInvalidateTiles((EDITOR_DATA *) data, &data->ted, cell % tilesX, cell / tilesX, 1, 1);
+			}
+		}
+		return;
+	}
+
+	//invalidate runs of tiles that use a character in [chrStart, chrEnd) and a palette in [paltFirst, paltLast]
+	for (int y = 0; y < tilesY; y++) {
+		int runStart = -1;
+		for (int x = 0; x <= tilesX; x++) {
+			int inRange = 0;
+			if (x < tilesX) {
+				uint16_t scrdat = data->nscr.data[x + y * tilesX];
+				int chrno = (scrdat & 0x3FF) - data->tileBase;
+				int palno = scrdat >> 12;
+				inRange = chrno >= chrStart && chrno < chrEnd && palno >= paltFirst && palno <= paltLast;
+			}
+
+			if (inRange && runStart == -1) runStart = x;
+			if (!inRange && runStart != -1) {
+				TedInvalidateTiles((EDITOR_DATA *) data, &data->ted, runStart, y, x - runStart, 1);
+				runStart = -1;
+			}
+		}
+	}
+}
+
+static LRESULT ScrViewerOnInvalidateChars(NSCRVIEWERDATA *data, int start, int count) {
+	ScrViewerInvalidateMatchingTiles(data, start, start + count, 0, 15);
+	return 1;
+}
+
+static LRESULT ScrViewerOnInvalidateColors(NSCRVIEWERDATA *data, int start, int count) {
+	//palette size follows the bit depth of the character editor
+	int nBits = 4;
+	NITROPAINTSTRUCT *nitroPaintStruct = NpGetData(getMainWindow(data->hWnd));
+	if (nitroPaintStruct->hWndNcgrViewer != NULL) {
+		nBits = ((NCGR *) EditorGetObject(nitroPaintStruct->hWndNcgrViewer))->nBits;
+	}
+
+	//out of range characters are drawn without color
+	ScrViewerInvalidateMatchingTiles(data, 0, 0x400, start >> nBits, (start + count - 1) >> nBits);
+	return 1;
+}
+
 static int ScrViewerGetFormat_NP_SCRN(void) {
 	static int fmt = 0;
 	if (!fmt) {
@@ -105,7 +174,7 @@ unsigned char *ScrViewerRenderIndexed(NSCR *nscr, NCGR *ncgr, int tileBase, int
 			int pal = scr >> 12;
 
 			if (chr >= 0 && chr < ncgr->nTiles) {
-				unsigned char *chrData = ncgr->tiles[chr];
+				unsigned char *chrData = NCGR_CHAR(ncgr, chr);
 				for (int i = 0; i < 64; i++) {
 					int tileX = i % 8;
 					int tileY = i / 8;
@@ -127,6 +196,18 @@ unsigned char *ScrViewerRenderIndexed(NSCR *nscr, NCGR *ncgr, int tileBase, int
 	return bits;
 }
 
+static const COLOR32 *ScrViewerGetRenderTile(void *param, int tileX, int tileY) {
+	NSCRVIEWERDATA *data = (NSCRVIEWERDATA *) param;
+
+	//get BG tile properties
+	uint16_t scrdat = data->nscr.data[tileX + tileY * data->nscr.tilesX];
+	int chrno = (scrdat >>  0) & 0x03FF;
+	int flip  = (scrdat >> 10) & 0x0003;
+	int palno = (scrdat >> 12) & 0x000F;
+
+	return ChrCacheGetTile(&data->chrCache, chrno - data->tileBase, palno, flip);
+}
+
 static void ScrViewerRender(HWND hWnd, FrameBuffer *fb, int scrollX, int scrollY, int renderWidth, int renderHeight) {
 	//get data pointer
 	NSCRVIEWERDATA *data = (NSCRVIEWERDATA *) EditorGetData(hWnd);
@@ -155,93 +236,42 @@ static void ScrViewerRender(HWND hWnd, FrameBuffer *fb, int scrollX, int scrollY
 	int hlMode = data->hlMode;
 	if ((data->verifyFrames & 1) == 0) hlStart = hlEnd = -1;
 
-	//get character hover params
-	if (chrHover != -1) {
-		chrHover += data->tileBase;
-	}
-
-	int tilesX = nscr->tilesX;
-	int tilesY = nscr->tilesY;
-
-
-	for (int y = 0; y < renderHeight; y++) {
-		for (int x = 0; x < renderWidth; x++) {
-			int srcX = (x + scrollX) / data->scale;
-			int srcY = (y + scrollY) / data->scale;
-			int srcTileX = srcX / 8;
-			int srcTileY = srcY / 8;
-
-			//get BG tile properties
-			uint16_t scrdat = nscr->data[srcTileX + srcTileY * tilesX];
-			int chrno = (scrdat >>  0) & 0x03FF;
-			int flip  = (scrdat >> 10) & 0x0003;
-			int palno = (scrdat >> 12) & 0x000F;
-
-			//get graphics tile
-			unsigned char *chr = NULL;
-			chrno -= data->tileBase;
-			if (ncgr != NULL && chrno >= 0 && chrno < ncgr->nTiles) {
-				chr = ncgr->tiles[chrno];
-			}
-
-			//get source pixel in tile
-			int inX = srcX % 8;
-			int inY = srcY % 8;
-			if (flip & TILE_FLIPX) inX ^= 7;
-			if (flip & TILE_FLIPY) inY ^= 7;
-
-			//sample color
-			COLOR32 c = 0;
-			int cidx = -1;
-			if (chr != NULL) {
-				cidx = chr[inX + inY * 8] + (palno << ncgr->nBits);
-				if (nclr != NULL && cidx < nclr->nColors) {
-					//sample color from palette
-					c = ColorConvertFromDS(nclr->colors[cidx]);
-				} else {
-					//black
-					c = 0;
+	//render from cached tiles
+	ChrCacheSetSource(&data->chrCache, ncgr, nclr, data->transparent, hlStart, hlEnd, hlMode == PALVIEWER_SELMODE_2D);
+	ChrCacheRender(fb, scrollX, scrollY, renderWidth, renderHeight, data->scale, ScrViewerGetRenderTile, data);
+
+	//handle hover indication in character editor
+	if (chrHover == -1 || renderWidth <= 0 || renderHeight <= 0) return;
+
+	int tileSize = 8 * data->scale;
+	int tileX0 = scrollX / tileSize, tileX1 = (scrollX + renderWidth - 1) / tileSize;
+	int tileY0 = scrollY / tileSize, tileY1 = (scrollY + renderHeight - 1) / tileSize;
+	for (int tileY = tileY0; tileY <= tileY1; tileY++) {
+		for (int tileX = tileX0; tileX <= tileX1; tileX++) {
+			int chrno = (nscr->data[tileX + tileY * nscr->tilesX] & 0x3FF) - data->tileBase;
+			if (chrno != chrHover) continue;
+
+			//tile bounds in the framebuffer
+			int x0 = tileX * tileSize - scrollX, x1 = x0 + tileSize;
+			int y0 = tileY * tileSize - scrollY, y1 = y0 + tileSize;
+			if (x0 < 0) x0 = 0;
+			if (y0 < 0) y0 = 0;
+			if (x1 > renderWidth) x1 = renderWidth;
+			if (y1 > renderHeight) y1 = renderHeight;
+
+			for (int y = y0; y < y1; y++) {
+				for (int x = x0; x < x1; x++) {
+					COLOR32 c = fb->px[x + y * fb->width];
+					unsigned int b = (c >> 0) & 0xFF;
+					unsigned int g = (c >> 8) & 0xFF;
+					unsigned int r = (c >> 16) & 0xFF;
+
+					r = (r + 0x00 + 1) / 2;
+					g = (g + 0xFF + 1) / 2;
+					b = (b + 0xFF + 1) / 2;
+					fb->px[x + y * fb->width] = b | (g << 8) | (r << 16) | 0xFF000000;
 				}
-
-				//color 0 within palette?
-				if ((cidx & ((1 << ncgr->nBits) - 1)) == 0) {
-					//alpha = 0
-				} else {
-					//alpha = 255
-					c |= 0xFF000000;
-				}
-			}
-
-			//handle alpha
-			if (data->transparent && (c >> 24) == 0) {
-				//render transparent
-				COLOR32 checker[] = { 0xFFFFFF, 0xC0C0C0 };
-				c = checker[((x ^ y) >> 2) & 1];
 			}
-
-			//handle verify color
-			if (hlStart != -1 && hlEnd != -1) {
-				if (PalViewerIndexInRange(cidx, hlStart, hlEnd, hlMode == PALVIEWER_SELMODE_2D)) {
-					int lightness = (c & 0xFF) + ((c >> 8) & 0xFF) + ((c >> 16) & 0xFF);
-					if (lightness < 383) c = 0xFFFFFFFF;
-					else c = 0xFF000000;
-				}
-			}
-
-			//handle hover indication in character editor
-			if (chrHover != -1 && chrHover == chrno) {
-				unsigned int r = (c >> 0) & 0xFF;
-				unsigned int g = (c >> 8) & 0xFF;
-				unsigned int b = (c >> 16) & 0xFF;
-
-				r = (r + 0x00 + 1) / 2;
-				g = (g + 0xFF + 1) / 2;
-				b = (b + 0xFF + 1) / 2;
-				c = r | (g << 8) | (b << 16) | 0xFF000000;
-			}
-
-			//put pixel
-			fb->px[x + y * fb->width] = REVERSE(c);
 		}
 	}
 }
@@ -448,6 +478,39 @@ static void ScrViewerSetPreferredSize(NSCRVIEWERDATA *data) {
 	SetWindowPos(data->hWnd, HWND_TOP, 0, 0, width, height, SWP_NOMOVE);
 }
 
+static void ScrViewerSaveState(HWND hWnd, BSTREAM *stream) {
+	NSCRVIEWERDATA *data = (NSCRVIEWERDATA *) EditorGetData(hWnd);
+
+	unsigned int header[3] = { data->nscr.tilesX, data->nscr.tilesY, data->nscr.dataSize };
+	bstreamWrite(stream, header, sizeof(header));
+	bstreamWrite(stream, data->nscr.data, data->nscr.dataSize);
+}
+
+static void ScrViewerRestoreState(HWND hWnd, const unsigned char *state, unsigned int size) {
+	NSCRVIEWERDATA *data = (NSCRVIEWERDATA *) EditorGetData(hWnd);
+	NSCR *nscr = &data->nscr;
+
+	unsigned int header[3];
+	memcpy(header, state, sizeof(header));
+
+	//the screen may have been resized
+	int resized = header[0] != nscr->tilesX || header[1] != nscr->tilesY;
+	if (header[2] != nscr->dataSize) {
+		free(nscr->data);
+		nscr->data = (uint16_t *) malloc(header[2] + sizeof(uint16_t));
+	}
+	nscr->tilesX = header[0];
+	nscr->tilesY = header[1];
+	nscr->dataSize = header[2];
+	memcpy(nscr->data, state + sizeof(header), header[2]);
+
+	if (resized) {
+		TedUpdateSize((EDITOR_DATA *) data, &data->ted, nscr->tilesX, nscr->tilesY);
+		ScrViewerUpdateContentSize(data);
+	}
+	ScrViewerGraphicsChanged(data);
+}
+
 static LRESULT WINAPI ScrViewerWndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 	NSCRVIEWERDATA *data = (NSCRVIEWERDATA *) EditorGetData(hWnd);
 	float dpiScale = GetDpiScale();
@@ -458,7 +521,8 @@ static LRESULT WINAPI ScrViewerWndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARA
 			data->showBorders = 0;
 			data->scale = 2;
 			data->transparent = g_configuration.renderTransparent;
-
+			ChrCacheInit(&data->chrCache);
+			ScrUsageInit(&data->usage);
 
 			HWND hWndViewer = CreateWindow(L"NscrPreviewClass", L"", WS_VISIBLE | WS_CHILD | WS_HSCROLL | WS_VSCROLL, 0, 0, 300, 300, hWnd, NULL, NULL, NULL);
 			TedInit(&data->ted, hWnd, hWndViewer, 8, 8);
@@ -577,8 +641,14 @@ static LRESULT WINAPI ScrViewerWndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARA
 			return 1;
 		}
 		case NV_UPDATEPREVIEW:
+			//also sent by other editors after editing the screen
+			ObjMarkModified(&data->nscr.header);
 			PreviewLoadBgScreen(&data->nscr);
 			break;
+		case NV_INVALIDATECHARS:
+			return ScrViewerOnInvalidateChars(data, (int) wParam, (int) lParam);
+		case NV_INVALIDATECOLORS:
+			return ScrViewerOnInvalidateColors(data, (int) wParam, (int) lParam);
 		case WM_KEYDOWN:
 		{
 			TedViewerOnKeyDown((EDITOR_DATA *) data, &data->ted, wParam, lParam);
@@ -695,8 +765,8 @@ static LRESULT WINAPI ScrViewerWndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARA
 									if(x != selWidth) data->nscr.data[t2 + y * (data->nscr.tilesX * 8 >> 3)] = d1;
 								}
 							}
+							ScrViewerTilesChanged(data, selStartX, selStartY, selWidth, selHeight);
 						}
-						ScrViewerGraphicsChanged(data);
 						break;
 					}
 					case ID_NSCRMENU_FLIPVERTICALLY:
@@ -716,8 +786,8 @@ static LRESULT WINAPI ScrViewerWndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARA
 									if(y != selHeight) data->nscr.data[x + t2 * (data->nscr.tilesX * 8 >> 3)] = d1;
 								}
 							}
+							ScrViewerTilesChanged(data, selStartX, selStartY, selWidth, selHeight);
 						}
-						ScrViewerGraphicsChanged(data);
 						break;
 					}
 					case ID_NSCRMENU_MAKEIDENTITY:
@@ -735,7 +805,7 @@ static LRESULT WINAPI ScrViewerWndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARA
 								index++;
 							}
 						}
-						ScrViewerGraphicsChanged(data);
+						ScrViewerTilesChanged(data, selStartX, selStartY, selWidth, selHeight);
 						break;
 					}
 					case ID_FILE_SAVEAS:
@@ -766,10 +836,15 @@ static LRESULT WINAPI ScrViewerWndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARA
 						ScrViewerUpdateSelLabel(data);
 						break;
 					case ID_NSCRMENU_CUT:
+					{
+						int selX, selY, selW, selH;
+						TedGetSelectionBounds(&data->ted, &selX, &selY, &selW, &selH);
+
 						ScrViewerCopy(data);
 						ScrViewerErase(data);
-						ScrViewerGraphicsChanged(data);
+						ScrViewerTilesChanged(data, selX, selY, selW, selH);
 						break;
+					}
 					case ID_VIEW_GRIDLINES:
 					case ID_ZOOM_100:
 					case ID_ZOOM_200:
@@ -827,7 +902,7 @@ static LRESULT WINAPI ScrViewerWndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARA
 							data->nscr.data[i] = value;
 						}
 					}
-					ScrViewerGraphicsChanged(data);
+					ScrViewerTilesChanged(data, selX, selY, selW, selH);
 				} else if (hWndControl == data->hWndTileBase) {
 					WORD command = HIWORD(wParam);
 					if (command == EN_CHANGE) {
@@ -861,6 +936,8 @@ static LRESULT WINAPI ScrViewerWndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARA
 			break;
 		case WM_DESTROY:
 			TedDestroy(&data->ted);
+			ChrCacheFree(&data->chrCache);
+			ScrUsageFree(&data->usage);
 			break;
 	}
 	return DefChildProc(hWnd, msg, wParam, lParam);
@@ -1347,8 +1424,9 @@ static void ScrViewerRegisterPreviewClass(void) {
 }
 
 void RegisterNscrViewerClass(void) {
-	int features = EDITOR_FEATURE_ZOOM | EDITOR_FEATURE_GRIDLINES;
+	int features = EDITOR_FEATURE_ZOOM | EDITOR_FEATURE_GRIDLINES | EDITOR_FEATURE_UNDO;
 	EDITOR_CLASS *cls = EditorRegister(L"NscrViewerClass", ScrViewerWndProc, L"Screen Editor", sizeof(NSCRVIEWERDATA), features);
+	EditorSetUndoProcs(cls, ScrViewerSaveState, ScrViewerRestoreState);
 	EditorAddFilter(cls, NSCR_TYPE_NSCR, L"nscr", L"NSCR Files (*.nscr)\0*.nscr\0");
 	EditorAddFilter(cls, NSCR_TYPE_NC, L"nsc", L"NSC Files (*.nsc)\0*.nsc\0");
 	EditorAddFilter(cls, NSCR_TYPE_IC, L"isc", L"ISC Files (*.isc)\0*.isc\0");
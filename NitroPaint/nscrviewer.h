@@ -5,6 +5,8 @@
 #include "nscr.h"
 #include "framebuffer.h"
 #include "tilededitor.h"
+#include "chrcache.h"
+#include "scrusage.h"
 
 typedef struct {
 	EDITOR_BASIC_MEMBERS;
@@ -12,6 +14,8 @@ typedef struct {
 	int transparent;
 
 	TedData ted;
+	ChrCache chrCache;
+	ScrUsage usage;
 
 	HWND hWndCharacterLabel;
 	HWND hWndCharacterNumber;
@@ -34,6 +38,12 @@ typedef struct {
 
 void NscrViewerSetTileBase(HWND hWnd, int tileBase);
 
+//
+// Get the character usage index of a screen editor, brought up to date with
+// its screen data.
+//
+ScrUsage *ScrViewerGetUsage(HWND hWnd);
+
 VOID RegisterNscrViewerClass(VOID);
 
 HWND CreateNscrViewer(int x, int y, int width, int height, HWND hWndParent, LPCWSTR path);
@@ -0,0 +1,100 @@
+#include "parallel.h"
+
+typedef struct ParJob_ {
+	ParWorkCallback callback;
+	void *context;
+	int nItems;
+	volatile LONG nextItem;
+	volatile LONG nCompleted;
+	volatile LONG *progress;
+	int progressBase;
+	int progressRange;
+} ParJob;
+
+typedef struct ParWorker_ {
+	ParJob *job;
+	int thread;
+} ParWorker;
+
+static int sParThreadCount = 0;
+
+int ParGetThreadCount(void) {
+	if (sParThreadCount == 0) {
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+
+		int nThreads = (int) info.dwNumberOfProcessors;
+		if (nThreads < 1) nThreads = 1;
+		if (nThreads > MAXIMUM_WAIT_OBJECTS) nThreads = MAXIMUM_WAIT_OBJECTS;
+		sParThreadCount = nThreads;
+	}
+	return sParThreadCount;
+}
+
+static void PariUpdateProgress(ParJob *job, LONG nCompleted) {
+	LONG value = job->progressBase + (LONG) ((LONGLONG) nCompleted * job->progressRange / job->nItems);
+
+	//only ever move progress forward, workers may finish out of order
+	LONG current = *job->progress;
+	while (current < value) {
+		LONG last = InterlockedCompareExchange(job->progress, value, current);
+		if (last == current) break;
+		current = last;
+	}
+}
+
+static void PariWork(ParJob *job, int thread) {
+	while (1) {
+		LONG item = InterlockedIncrement(&job->nextItem) - 1;
+		if (item >= job->nItems) break;
+
+		job->callback(job->context, thread, item);
+
+		LONG nCompleted = InterlockedIncrement(&job->nCompleted);
+		if (job->progress != NULL) PariUpdateProgress(job, nCompleted);
+	}
+}
+
+static DWORD CALLBACK PariWorkerProc(LPVOID param) {
+	ParWorker *worker = (ParWorker *) param;
+	PariWork(worker->job, worker->thread);
+	return 0;
+}
+
+void ParRun(int nItems, ParWorkCallback callback, void *context, int *progress, int progressBase, int progressRange) {
+	if (nItems <= 0) return;
+
+	ParJob job;
+	job.callback = callback;
+	job.context = context;
+	job.nItems = nItems;
+	job.nextItem = 0;
+	job.nCompleted = 0;
+	job.progress = (volatile LONG *) progress;
+	job.progressBase = progressBase;
+	job.progressRange = progressRange;
+
+	int nThreads = ParGetThreadCount();
+	if (nThreads > nItems) nThreads = nItems;
+
+	//the calling thread works as thread 0. If a thread can't be created, the rest still get done.
+	HANDLE hThreads[MAXIMUM_WAIT_OBJECTS];
+	ParWorker workers[MAXIMUM_WAIT_OBJECTS];
+	int nCreated = 0;
+	for (int i = 1; i < nThreads; i++) {
+		workers[nCreated].job = &job;
+		workers[nCreated].thread = nCreated + 1;
+		hThreads[nCreated] = CreateThread(NULL, 0, PariWorkerProc, &workers[nCreated], 0, NULL);
+		if (hThreads[nCreated] == NULL) break;
+		nCreated++;
+	}
+
+	PariWork(&job, 0);
+
+	if (nCreated > 0) {
+		WaitForMultipleObjects(nCreated, hThreads, TRUE, INFINITE);
+		for (int i = 0; i < nCreated; i++) {
+			CloseHandle(hThreads[i]);
+		}
+	}
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <Windows.h>
+
+//
+// Callback run for each work item. thread is the index of the worker running
+// the item, from 0 to ParGetThreadCount()-1, and may be used to select
+// per-thread scratch data.
+//
+typedef void (*ParWorkCallback) (void *context, int thread, int item);
+
+//
+// Get the number of worker threads used to run parallel work.
+//
+int ParGetThreadCount(void);
+
+//
+// Run a callback for each of nItems work items across worker threads and wait
+// for them all to finish. Items are handed out in increasing order. If
+// progress is not NULL, it is advanced from progressBase up to
+// progressBase + progressRange as items complete.
+//
+void ParRun(int nItems, ParWorkCallback callback, void *context, int *progress, int progressBase, int progressRange);
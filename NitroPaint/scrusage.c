@@ -0,0 +1,80 @@
+#include "scrusage.h"
+
+void ScrUsageInit(ScrUsage *usage) {
+	memset(usage, 0, sizeof(ScrUsage));
+	usage->heads = (int *) malloc(SCRUSAGE_MAX_CHARS * sizeof(int));
+	usage->paletteCounts = (unsigned int *) calloc(SCRUSAGE_MAX_CHARS * 16, sizeof(unsigned int));
+	usage->flipCounts = (unsigned int *) calloc(SCRUSAGE_MAX_CHARS * 4, sizeof(unsigned int));
+	for (int i = 0; i < SCRUSAGE_MAX_CHARS; i++) usage->heads[i] = -1;
+}
+
+void ScrUsageFree(ScrUsage *usage) {
+	if (usage->next != NULL) free(usage->next);
+	if (usage->heads != NULL) free(usage->heads);
+	if (usage->paletteCounts != NULL) free(usage->paletteCounts);
+	if (usage->flipCounts != NULL) free(usage->flipCounts);
+	memset(usage, 0, sizeof(ScrUsage));
+}
+
+static void ScrUsageLink(ScrUsage *usage, int cell, uint16_t d) {
+	int chrno = d & 0x3FF;
+
+	usage->next[cell] = usage->heads[chrno];
+	usage->heads[chrno] = cell;
+
+	usage->paletteCounts[chrno * 16 + (d >> 12)]++;
+	usage->flipCounts[chrno * 4 + ((d >> 10) & 3)]++;
+}
+
+void ScrUsageUpdate(ScrUsage *usage, const NSCR *nscr) {
+	//screen unchanged since it was last indexed
+	if (usage->next != NULL && usage->generation == nscr->header.generation) return;
+
+	int nCells = nscr->dataSize / 2;
+	usage->next = (int *) realloc(usage->next, (nCells + 1) * sizeof(int));
+	usage->nCells = nCells;
+	usage->generation = nscr->header.generation;
+
+	for (int i = 0; i < SCRUSAGE_MAX_CHARS; i++) usage->heads[i] = -1;
+	memset(usage->paletteCounts, 0, SCRUSAGE_MAX_CHARS * 16 * sizeof(unsigned int));
+	memset(usage->flipCounts, 0, SCRUSAGE_MAX_CHARS * 4 * sizeof(unsigned int));
+
+	//link in reverse so that each list is in cell order
+	for (int i = nCells - 1; i >= 0; i--) {
+		ScrUsageLink(usage, i, nscr->data[i]);
+	}
+}
+
+int ScrUsageGetFirstCell(const ScrUsage *usage, int chrno) {
+	if (chrno < 0 || chrno >= SCRUSAGE_MAX_CHARS) return -1;
+	return usage->heads[chrno];
+}
+
+int ScrUsageGetNextCell(const ScrUsage *usage, int cell) {
+	return usage->next[cell];
+}
+
+unsigned int ScrUsageGetPaletteCount(const ScrUsage *usage, int chrno, int palno) {
+	if (chrno < 0 || chrno >= SCRUSAGE_MAX_CHARS) return 0;
+	return usage->paletteCounts[chrno * 16 + palno];
+}
+
+unsigned int ScrUsageGetFlipCount(const ScrUsage *usage, int chrno, int flip) {
+	if (chrno < 0 || chrno >= SCRUSAGE_MAX_CHARS) return 0;
+	return usage->flipCounts[chrno * 4 + flip];
+}
+
+int ScrUsageGetPalette(const ScrUsage *usage, int chrno) {
+	if (chrno < 0 || chrno >= SCRUSAGE_MAX_CHARS) return -1;
+
+	int palno = -1;
+	unsigned int best = 0;
+	const unsigned int *counts = usage->paletteCounts + chrno * 16;
+	for (int i = 0; i < 16; i++) {
+		if (counts[i] > best) {
+			best = counts[i];
+			palno = i;
+		}
+	}
+	return palno;
+}
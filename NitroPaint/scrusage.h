@@ -0,0 +1,57 @@
+#pragma once
+#include <Windows.h>
+
+#include "nscr.h"
+
+#define SCRUSAGE_MAX_CHARS         1024                     // number of character names a screen can refer to
+
+//
+// Reverse index of a screen, from each character name to the screen cells
+// using it, along with the palettes and flips it is used with. Character names
+// are the raw names stored in the screen, without the character base.
+//
+// Screen data may be edited from any editor, so the index remembers the edit
+// generation of the screen it was built from, and updating it rebuilds the
+// index only once the screen has been marked modified since.
+//
+typedef struct ScrUsage_ {
+	unsigned int generation;           // edit generation of the screen the index was built from
+	int *next;                         // next cell using the same character, -1 at the end
+	int nCells;
+	int *heads;                        // first cell using each character, -1 if unused
+	unsigned int *paletteCounts;       // cells using each character with each palette, 16 per character
+	unsigned int *flipCounts;          // cells using each character with each flip, 4 per character
+} ScrUsage;
+
+void ScrUsageInit(ScrUsage *usage);
+
+void ScrUsageFree(ScrUsage *usage);
+
+//
+// Bring the index up to date with the screen data.
+//
+void ScrUsageUpdate(ScrUsage *usage, const NSCR *nscr);
+
+//
+// Get the first cell using a character, or -1 if it is unused. Following cells
+// are found with ScrUsageGetNextCell.
+//
+int ScrUsageGetFirstCell(const ScrUsage *usage, int chrno);
+
+int ScrUsageGetNextCell(const ScrUsage *usage, int cell);
+
+//
+// Get the number of cells using a character with a palette.
+//
+unsigned int ScrUsageGetPaletteCount(const ScrUsage *usage, int chrno, int palno);
+
+//
+// Get the number of cells using a character with a flip.
+//
+unsigned int ScrUsageGetFlipCount(const ScrUsage *usage, int chrno, int flip);
+
+//
+// Get the palette a character is used with by the most cells, or -1 if it is
+// unused. Ties go to the lowest palette number.
+//
+int ScrUsageGetPalette(const ScrUsage *usage, int chrno);
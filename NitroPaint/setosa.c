@@ -2,10 +2,14 @@
 
 #include "setosa.h"
 
+//room kept in front of the first block for the header
+#define SET_STREAM_HEADROOM 0x40
+
 void SetStreamCreate(SetStream *stream) {
 	stream->nBlocks = 0;
 	bstreamCreate(&stream->headerStream, NULL, 0);
 	bstreamCreate(&stream->blockStream, NULL, 0);
+	bstreamCreate(&stream->currentStream, NULL, 0);
 
 	//prepare header
 	unsigned char header[8] = { 'R', 'S', 'R', 'C', 0, 0, 0, 0 };
@@ -17,7 +21,7 @@ void SetStreamStartBlock(SetStream *stream, const char *sig) {
 	uint32_t pos = stream->blockStream.size;
 	bstreamWrite(&stream->headerStream, &pos, sizeof(pos));
 
-	bstreamCreate(&stream->currentStream, NULL, 0);
+	if (stream->blockStream.size == 0) bstreamReserveFront(&stream->currentStream, SET_STREAM_HEADROOM);
 	bstreamWrite(&stream->currentStream, sig, 4);
 	stream->nBlocks++;
 }
@@ -28,8 +32,7 @@ void SetStreamWrite(SetStream *stream, const void *data, unsigned int size) {
 
 void SetStreamEndBlock(SetStream *stream) {
 	bstreamAlign(&stream->currentStream, 4);
-	bstreamWrite(&stream->blockStream, stream->currentStream.buffer, stream->currentStream.size);
-	bstreamFree(&stream->currentStream);
+	bstreamSplice(&stream->blockStream, &stream->currentStream);
 }
 
 void SetStreamFinalize(SetStream *stream) {
@@ -41,13 +44,21 @@ void SetStreamFinalize(SetStream *stream) {
 }
 
 void SetStreamFlushOut(SetStream *stream, BSTREAM *out) {
+	//an empty stream takes over the blocks with the header put in front of them
+	if (out->size == 0) {
+		bstreamPrepend(&stream->blockStream, stream->headerStream.buffer, stream->headerStream.size);
+		bstreamSplice(out, &stream->blockStream);
+		return;
+	}
+
 	bstreamWrite(out, stream->headerStream.buffer, stream->headerStream.size);
-	bstreamWrite(out, stream->blockStream.buffer, stream->blockStream.size);
+	bstreamSplice(out, &stream->blockStream);
 }
 
 void SetStreamFree(SetStream *stream) {
 	bstreamFree(&stream->headerStream);
 	bstreamFree(&stream->blockStream);
+	bstreamFree(&stream->currentStream);
 }
 
 
@@ -148,7 +159,9 @@ void SetResDirFlushOut(SetResDirectory *dir, SetStream *out) {
 	header[0] = dir->nObjects;
 	header[1] = dir->hasNames ? 0 : 1;
 
-	//write entries
+	//write entries, reserving room for the whole directory
+	int dirSize = dir->dirStream.size + dir->objStream.size + dir->nameStream.size;
+	bstreamReserve(&out->currentStream, out->currentStream.size + dirSize + 4);
 	bstreamWrite(&out->currentStream, dir->dirStream.buffer, dir->dirStream.size);
 
 	//write data
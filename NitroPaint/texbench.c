@@ -0,0 +1,278 @@
+#include <Windows.h>
+#include <Psapi.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "texbench.h"
+#include "texconv.h"
+#include "palette.h"
+
+typedef struct TxBenchImage_ {
+	const char *name;
+	int width;
+	int height;
+	void (*generate) (COLOR32 *px, int width, int height);
+} TxBenchImage;
+
+typedef struct TxBenchMemory_ {
+	SIZE_T commit;
+	SIZE_T peakCommit;
+} TxBenchMemory;
+
+static unsigned int sBenchSeed = 0;
+
+static unsigned int TxBenchRandom(void) {
+	//deterministic LCG so that every run converts the same images
+	sBenchSeed = sBenchSeed * 1103515245 + 12345;
+	return (sBenchSeed >> 16) & 0x7FFF;
+}
+
+static COLOR32 TxBenchPack(int r, int g, int b, int a) {
+	if (r < 0) r = 0;
+	if (g < 0) g = 0;
+	if (b < 0) b = 0;
+	if (a < 0) a = 0;
+	if (r > 255) r = 255;
+	if (g > 255) g = 255;
+	if (b > 255) b = 255;
+	if (a > 255) a = 255;
+	return r | (g << 8) | (b << 16) | (a << 24);
+}
+
+static void TxBenchGenerateGradient(COLOR32 *px, int width, int height) {
+	//smooth opaque gradient, the worst case for banding
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			int r = x * 255 / (width - 1);
+			int g = y * 255 / (height - 1);
+			int b = 255 - (x + y) * 255 / (width + height - 2);
+			px[x + y * width] = TxBenchPack(r, g, b, 255);
+		}
+	}
+}
+
+static void TxBenchGenerateNoise(COLOR32 *px, int width, int height) {
+	//uncorrelated opaque noise, the worst case for palette generation
+	for (int i = 0; i < width * height; i++) {
+		px[i] = TxBenchPack(TxBenchRandom() & 0xFF, TxBenchRandom() & 0xFF, TxBenchRandom() & 0xFF, 255);
+	}
+}
+
+static void TxBenchGeneratePhoto(COLOR32 *px, int width, int height) {
+	//low frequency content with some grain, resembling painted or photographic art
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			float fx = (float) x / width, fy = (float) y / height;
+			int grain = (int) (TxBenchRandom() % 17) - 8;
+			int r = (int) (128.0f + 100.0f * sinf(fx * 7.0f + fy * 3.0f)) + grain;
+			int g = (int) (128.0f + 90.0f * sinf(fy * 5.0f - fx * 2.0f + 1.0f)) + grain;
+			int b = (int) (110.0f + 80.0f * cosf((fx + fy) * 6.0f)) + grain;
+			px[x + y * width] = TxBenchPack(r, g, b, 255);
+		}
+	}
+}
+
+static void TxBenchGenerateSprite(COLOR32 *px, int width, int height) {
+	//few flat colors with hard edges on a transparent background
+	static const COLOR32 colors[] = { 0xFF2040C0, 0xFFF0E0D0, 0xFF101010, 0xFF30A0F0, 0xFF40C040 };
+	memset(px, 0, width * height * sizeof(COLOR32));
+
+	int nShapes = 24;
+	for (int i = 0; i < nShapes; i++) {
+		int cx = TxBenchRandom() % width, cy = TxBenchRandom() % height;
+		int radius = 4 + TxBenchRandom() % (width / 6);
+		COLOR32 c = colors[i % (sizeof(colors) / sizeof(colors[0]))];
+
+		for (int y = cy - radius; y <= cy + radius; y++) {
+			if (y < 0 || y >= height) continue;
+			for (int x = cx - radius; x <= cx + radius; x++) {
+				if (x < 0 || x >= width) continue;
+				int dx = x - cx, dy = y - cy;
+				if (dx * dx + dy * dy <= radius * radius) px[x + y * width] = c;
+			}
+		}
+	}
+}
+
+static void TxBenchGenerateTranslucent(COLOR32 *px, int width, int height) {
+	//soft radial alpha falloff over a two-tone color ramp, like a particle or glow
+	float cx = width / 2.0f, cy = height / 2.0f;
+	float maxDist = sqrtf(cx * cx + cy * cy);
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			float dx = x - cx, dy = y - cy;
+			float d = sqrtf(dx * dx + dy * dy) / maxDist;
+			int a = (int) (255.0f * (1.0f - d * 1.4f));
+			int r = 255, g = (int) (240.0f - 180.0f * d), b = (int) (120.0f - 120.0f * d);
+			px[x + y * width] = TxBenchPack(r, g, b, a);
+		}
+	}
+}
+
+static const TxBenchImage sBenchImages[] = {
+	{ "gradient",    256, 256, TxBenchGenerateGradient    },
+	{ "noise",       128, 128, TxBenchGenerateNoise       },
+	{ "photo",       256, 256, TxBenchGeneratePhoto       },
+	{ "photo-large", 512, 512, TxBenchGeneratePhoto       },
+	{ "sprite",      128, 128, TxBenchGenerateSprite      },
+	{ "translucent", 128, 128, TxBenchGenerateTranslucent }
+};
+
+static void TxBenchGetMemory(TxBenchMemory *mem) {
+	//K32GetProcessMemoryInfo is exported by kernel32 from Windows 7 onward; fall back to psapi.
+	static BOOL (WINAPI *GetProcessMemoryInfoFunc) (HANDLE, PPROCESS_MEMORY_COUNTERS, DWORD) = NULL;
+	if (GetProcessMemoryInfoFunc == NULL) {
+		HMODULE hKernel32 = GetModuleHandle(L"KERNEL32.DLL");
+		GetProcessMemoryInfoFunc = (BOOL (WINAPI *) (HANDLE, PPROCESS_MEMORY_COUNTERS, DWORD))
+			GetProcAddress(hKernel32, "K32GetProcessMemoryInfo");
+	}
+	if (GetProcessMemoryInfoFunc == NULL) {
+		HMODULE hPsapi = LoadLibrary(L"PSAPI.DLL");
+		if (hPsapi != NULL) {
+			GetProcessMemoryInfoFunc = (BOOL (WINAPI *) (HANDLE, PPROCESS_MEMORY_COUNTERS, DWORD))
+				GetProcAddress(hPsapi, "GetProcessMemoryInfo");
+		}
+	}
+
+	PROCESS_MEMORY_COUNTERS counters = { 0 };
+	counters.cb = sizeof(counters);
+	if (GetProcessMemoryInfoFunc == NULL || !GetProcessMemoryInfoFunc(GetCurrentProcess(), &counters, sizeof(counters))) {
+		mem->commit = 0;
+		mem->peakCommit = 0;
+		return;
+	}
+	mem->commit = counters.PagefileUsage;
+	mem->peakCommit = counters.PeakPagefileUsage;
+}
+
+static double TxBenchComputePsnr(const COLOR32 *src, const COLOR32 *dst, int nPx) {
+	//color error is only counted where either pixel is visible; alpha error always counts.
+	double total = 0.0;
+	for (int i = 0; i < nPx; i++) {
+		COLOR32 c1 = src[i], c2 = dst[i];
+		int a1 = c1 >> 24, a2 = c2 >> 24;
+		int da = a1 - a2;
+		total += da * da;
+		if (a1 == 0 && a2 == 0) continue;
+
+		int dr = (int) (c1 & 0xFF) - (int) (c2 & 0xFF);
+		int dg = (int) ((c1 >> 8) & 0xFF) - (int) ((c2 >> 8) & 0xFF);
+		int db = (int) ((c1 >> 16) & 0xFF) - (int) ((c2 >> 16) & 0xFF);
+		total += dr * dr + dg * dg + db * db;
+	}
+
+	double mse = total / (4.0 * nPx);
+	if (mse == 0.0) return 99.99; //lossless
+	return 10.0 * log10(255.0 * 255.0 / mse);
+}
+
+static int TxBenchGetColorEntries(int fmt) {
+	switch (fmt) {
+		case CT_4COLOR:
+			return 4;
+		case CT_16COLOR:
+			return 16;
+		case CT_256COLOR:
+			return 256;
+		case CT_A3I5:
+			return 32;
+		case CT_A5I3:
+			return 8;
+		case CT_4x4:
+			return 256;
+	}
+	return 0;
+}
+
+static double TxBenchGetTime(LARGE_INTEGER *start) {
+	LARGE_INTEGER now, freq;
+	QueryPerformanceCounter(&now);
+	QueryPerformanceFrequency(&freq);
+	return (double) (now.QuadPart - start->QuadPart) / (double) freq.QuadPart;
+}
+
+static int TxBenchWrite(HANDLE hFile, const char *str) {
+	DWORD dwWritten;
+	return WriteFile(hFile, str, strlen(str), &dwWritten, NULL);
+}
+
+int TxBenchRun(LPCWSTR reportPath) {
+	HANDLE hFile = CreateFile(reportPath, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE) return 0;
+
+	char line[512];
+	TxBenchWrite(hFile, "image        size     format      tiles(ms) palette(ms) index(ms) refine(ms) total(ms) render(ms)"
+		"  commit(KB) peak+(KB) texel(B) pltt(B)  PSNR(dB)\r\n");
+
+	int nImages = sizeof(sBenchImages) / sizeof(sBenchImages[0]);
+	for (int i = 0; i < nImages; i++) {
+		const TxBenchImage *image = &sBenchImages[i];
+		int width = image->width, height = image->height, nPx = width * height;
+
+		COLOR32 *source = (COLOR32 *) calloc(nPx, sizeof(COLOR32));
+		COLOR32 *work = (COLOR32 *) calloc(nPx, sizeof(COLOR32));
+		COLOR32 *render = (COLOR32 *) calloc(nPx, sizeof(COLOR32));
+		sBenchSeed = i + 1;
+		image->generate(source, width, height);
+
+		for (int fmt = CT_A3I5; fmt <= CT_DIRECT; fmt++) {
+			//TxConvert renders the result back over its input, so convert from a copy
+			memcpy(work, source, nPx * sizeof(COLOR32));
+
+			TEXTURE texture = { 0 };
+			TxConversionStats stats = { 0 };
+			TxConversionParameters *params = (TxConversionParameters *) calloc(1, sizeof(TxConversionParameters));
+			params->px = work;
+			params->width = width;
+			params->height = height;
+			params->fmt = fmt;
+			params->colorEntries = TxBenchGetColorEntries(fmt);
+			params->balance = BALANCE_DEFAULT;
+			params->colorBalance = BALANCE_DEFAULT;
+			params->dest = &texture;
+			params->stats = &stats;
+			memcpy(params->pnam, "bench_pl", 9);
+
+			TxBenchMemory memBefore, memAfter;
+			TxBenchGetMemory(&memBefore);
+			TxConvert(params);
+			TxBenchGetMemory(&memAfter);
+			free(params);
+
+			LARGE_INTEGER renderStart;
+			memset(render, 0, nPx * sizeof(COLOR32));
+			QueryPerformanceCounter(&renderStart);
+			TxRender(render, width, height, &texture.texels, &texture.palette, 0);
+			double renderTime = TxBenchGetTime(&renderStart);
+
+			int texelVram = TxGetTextureVramSize(&texture.texels);
+			int plttVram = TxGetTexPlttVramSize(&texture.palette);
+			double psnr = TxBenchComputePsnr(source, render, nPx);
+
+			//the process peak only ever grows, so report how much this conversion raised it
+			sprintf(line, "%-12s %4dx%-4d %-11s %9.2f %11.2f %9.2f %10.2f %9.2f %10.2f  %10u %9u %8d %7d  %8.2f\r\n",
+				image->name, width, height, TxNameFromTexFormat(fmt),
+				stats.tileData * 1000.0, stats.palette * 1000.0, stats.indexing * 1000.0, stats.refinement * 1000.0,
+				stats.total * 1000.0, renderTime * 1000.0,
+				(unsigned int) (memBefore.commit / 1024), (unsigned int) ((memAfter.peakCommit - memBefore.peakCommit) / 1024),
+				texelVram, plttVram, psnr);
+			TxBenchWrite(hFile, line);
+
+			if (texture.texels.texel != NULL) free(texture.texels.texel);
+			if (texture.texels.cmp != NULL) free(texture.texels.cmp);
+			if (texture.palette.pal != NULL) free(texture.palette.pal);
+		}
+
+		free(source);
+		free(work);
+		free(render);
+	}
+
+	TxBenchMemory memEnd;
+	TxBenchGetMemory(&memEnd);
+	sprintf(line, "\r\nprocess lifetime peak commit: %u KB\r\n", (unsigned int) (memEnd.peakCommit / 1024));
+	TxBenchWrite(hFile, line);
+
+	CloseHandle(hFile);
+	return 1;
+}
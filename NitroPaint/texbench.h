@@ -0,0 +1,12 @@
+#pragma once
+#include <Windows.h>
+
+//
+// Runs the texture conversion benchmark: a set of procedurally generated images
+// is converted through every texture format, and per-stage timings, memory use,
+// VRAM size and PSNR of the rendered result are written to a text report.
+// Memory use is the commit charge before each conversion and how much the
+// conversion raised the process peak commit, which is only reset by restarting.
+// Returns 1 on success, 0 if the report could not be written.
+//
+int TxBenchRun(LPCWSTR reportPath);
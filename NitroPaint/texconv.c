@@ -1,6 +1,7 @@
 #include "palette.h"
 #include "color.h"
 #include "texconv.h"
+#include "gdip.h"
 
 #include <math.h>
 
@@ -54,10 +55,25 @@ static COLOR32 *TxiPadTextureImage(COLOR32 *px, int width, int height, int *outW
 	return out;
 }
 
+static double TxiTimerLap(LARGE_INTEGER *mark) {
+	//return seconds elapsed since the mark, and move the mark to now
+	LARGE_INTEGER now, freq;
+	QueryPerformanceCounter(&now);
+	QueryPerformanceFrequency(&freq);
+	double elapsed = (double) (now.QuadPart - mark->QuadPart) / (double) freq.QuadPart;
+	*mark = now;
+	return elapsed;
+}
+
+//accumulate the time since the last mark into a stage of the conversion statistics
+#define TxiStatsLap(params,stage,mark) do { if ((params)->stats != NULL) (params)->stats->stage += TxiTimerLap(mark); } while (0)
+
 int TxConvertDirect(TxConversionParameters *params) {
 	//convert to direct color.
 	int width = params->width, height = params->height;
 	COLOR32 *px = params->px;
+	LARGE_INTEGER mark;
+	QueryPerformanceCounter(&mark);
 
 	COLOR *txel = (COLOR *) calloc(width * height, 2);
 	params->dest->texels.texImageParam = (ilog2(width >> 3) << 20) | (ilog2(height >> 3) << 23) | (params->fmt << 26);
@@ -79,13 +95,26 @@ int TxConvertDirect(TxConversionParameters *params) {
 		}
 		txel[i] = c;
 	}
+	TxiStatsLap(params, indexing, &mark);
 	return 0;
 }
 
+static int TxiUseImagePalette(TxConversionParameters *params, COLOR32 *palette, int nColors, int alphaThreshold) {
+	//an image with no more colors than the palette holds needs no palette generation. Pixels below
+	//alphaThreshold are those the conversion makes transparent.
+	int nUsed = ImgCountOpaqueColors(params->px, params->width * params->height, alphaThreshold, nColors, palette, NULL);
+	if (nUsed > nColors) return 0;
+
+	qsort(palette, nUsed, sizeof(COLOR32), RxColorLightnessComparator);
+	return 1;
+}
+
 int TxConvertIndexedOpaque(TxConversionParameters *params) {
 	//convert to translucent. First, generate a palette of colors.
 	int nColors = 0, bitsPerPixel = 0;
 	int width = params->width, height = params->height;
+	LARGE_INTEGER mark;
+	QueryPerformanceCounter(&mark);
 	switch (params->fmt) {
 		case CT_4COLOR:
 			nColors = 4;
@@ -116,8 +145,10 @@ int TxConvertIndexedOpaque(TxConversionParameters *params) {
 
 	if (!params->useFixedPalette) {
 		//generate a palette, making sure to leave a transparent color, if applicable.
-		RxCreatePaletteEx(params->px, width, height, palette + hasTransparent, nColors - hasTransparent,
-			params->balance, params->colorBalance, params->enhanceColors, TRUE);
+		if (!TxiUseImagePalette(params, palette + hasTransparent, nColors - hasTransparent, 0x80)) {
+			RxCreatePaletteEx(params->px, width, height, palette + hasTransparent, nColors - hasTransparent,
+				params->balance, params->colorBalance, params->enhanceColors, TRUE);
+		}
 
 		//reduce palette color depth
 		for (int i = 0; i < nColors; i++) {
@@ -128,6 +159,7 @@ int TxConvertIndexedOpaque(TxConversionParameters *params) {
 			palette[i] = ColorConvertFromDS(params->fixedPalette[i]);
 		}
 	}
+	TxiStatsLap(params, palette, &mark);
 
 	//allocate texel space.
 	int nBytes = width * height * bitsPerPixel / 8;
@@ -143,6 +175,7 @@ int TxConvertIndexedOpaque(TxConversionParameters *params) {
 		if ((p >> 24) >= 0x80) index = RxPaletteFindClosestColorSimple(p, palette + hasTransparent, nColors - hasTransparent) + hasTransparent;
 		txel[i / pixelsPerByte] |= index << (bitsPerPixel * (i & (pixelsPerByte - 1)));
 	}
+	TxiStatsLap(params, indexing, &mark);
 
 	//update texture info
 	unsigned int param = (params->fmt << 26) | (ilog2(width >> 3) << 20) | (ilog2(height >> 3) << 23);
@@ -164,6 +197,8 @@ int TxConvertIndexedTranslucent(TxConversionParameters *params) {
 	//convert to translucent. First, generate a palette of colors.
 	int nColors = 0, alphaShift = 0, alphaMax = 0;
 	int width = params->width, height = params->height;
+	LARGE_INTEGER mark;
+	QueryPerformanceCounter(&mark);
 	switch (params->fmt) {
 		case CT_A3I5:
 			nColors = 32;
@@ -182,8 +217,10 @@ int TxConvertIndexedTranslucent(TxConversionParameters *params) {
 
 	if (!params->useFixedPalette) {
 		//generate a palette, making sure to leave a transparent color, if applicable.
-		RxCreatePaletteEx(params->px, width, height, palette, nColors,
-			params->balance, params->colorBalance, params->enhanceColors, TRUE);
+		if (!TxiUseImagePalette(params, palette, nColors, 1)) {
+			RxCreatePaletteEx(params->px, width, height, palette, nColors,
+				params->balance, params->colorBalance, params->enhanceColors, TRUE);
+		}
 
 		//reduce palette color depth
 		for (int i = 0; i < nColors; i++) {
@@ -194,6 +231,7 @@ int TxConvertIndexedTranslucent(TxConversionParameters *params) {
 			palette[i] = ColorConvertFromDS(params->fixedPalette[i]);
 		}
 	}
+	TxiStatsLap(params, palette, &mark);
 
 	//allocate texel space.
 	int nBytes = width * height;
@@ -214,6 +252,7 @@ int TxConvertIndexedTranslucent(TxConversionParameters *params) {
 			doDiffuse(i, width, height, params->px, 0, 0, 0, -errorAlpha, params->diffuseAmount);
 		}
 	}
+	TxiStatsLap(params, indexing, &mark);
 
 	//update texture info
 	if (params->dest->palette.pal) free(params->dest->palette.pal);
@@ -1185,11 +1224,14 @@ int TxConvert4x4(TxConversionParameters *params) {
 	int tilesX = width / 4, tilesY = height / 4;
 	g_texCompressionProgressMax = tilesX * tilesY * 3;
 	g_texCompressionProgress = 0;
+	LARGE_INTEGER mark;
+	QueryPerformanceCounter(&mark);
 
 	//create tile data
 	RxReduction *reduction = (RxReduction *) calloc(1, sizeof(RxReduction));
 	RxInit(reduction, params->balance, params->colorBalance, 15, params->enhanceColors, 4);
 	TxTileData *tileData = TxiCreateTileData(reduction, params->px, tilesX, tilesY);
+	TxiStatsLap(params, tileData, &mark);
 
 	//build the palettes.
 	COLOR *nnsPal = (COLOR *) calloc(params->colorEntries, sizeof(COLOR));
@@ -1203,6 +1245,7 @@ int TxConvert4x4(TxConversionParameters *params) {
 	}
 	if (nUsedColors & 7) nUsedColors += 8 - (nUsedColors & 7);
 	if (nUsedColors < 16) nUsedColors = 16;
+	TxiStatsLap(params, palette, &mark);
 
 	//for end indexing, a map of which palette colors were used
 	//(interpolated tiles: non-endpoints use both endpoints)
@@ -1240,6 +1283,7 @@ int TxConvert4x4(TxConversionParameters *params) {
 		TxiIndexTile(tileData + i, txel + i, palette, paletteSize, 0, diffuse);
 		g_texCompressionProgress++;
 	}
+	TxiStatsLap(params, indexing, &mark);
 
 	if (params->fixedPalette == NULL) {
 		unsigned char *useMap = (unsigned char *) calloc(nUsedColors, 1);
@@ -1257,6 +1301,7 @@ int TxConvert4x4(TxConversionParameters *params) {
 
 		free(useMap);
 	}
+	TxiStatsLap(params, refinement, &mark);
 
 	RxDestroy(reduction);
 	free(reduction);
@@ -1274,6 +1319,10 @@ int TxConvert4x4(TxConversionParameters *params) {
 }
 
 int TxConvert(TxConversionParameters *params) {
+	LARGE_INTEGER start;
+	QueryPerformanceCounter(&start);
+	if (params->stats != NULL) memset(params->stats, 0, sizeof(TxConversionStats));
+
 	//pad texture if needed
 	int padWidth, padHeight, sourceWidth = params->width, sourceHeight = params->height;
 	COLOR32 *srcPx = params->px;
@@ -1319,6 +1368,7 @@ int TxConvert(TxConversionParameters *params) {
 	}
 
 	TxRender(params->px, sourceWidth, sourceHeight, &params->dest->texels, &params->dest->palette, 0);
+	TxiStatsLap(params, total, &start);
 	
 	g_texCompressionFinished = 1;
 	if (params->callback) params->callback(params->callbackParam);
@@ -2,6 +2,24 @@
 #include <Windows.h>
 #include "texture.h"
 
+//
+// Version of the texture converter. Increment this when a change to conversion
+// alters its output, so that cached batch conversions are redone.
+//
+#define TX_CONVERTER_VERSION 1
+
+//
+// Per-stage timings (in seconds) recorded by a texture conversion. Stages that
+// a format does not have are left at 0.
+//
+typedef struct TxConversionStats_ {
+	double tileData;    //building 4x4 tile data
+	double palette;     //palette generation
+	double indexing;    //texel indexing (including dithering)
+	double refinement;  //4x4 palette refinement
+	double total;       //whole conversion, including padding and final render
+} TxConversionStats;
+
 //
 // Structure used by texture conversion functions.
 //
@@ -24,6 +42,7 @@ typedef struct TxConversionParameters_ {
 	TEXTURE *dest;
 	void (*callback) (void *);
 	void *callbackParam;
+	TxConversionStats *stats; //optional, receives stage timings
 	char pnam[17];
 } TxConversionParameters;
 
@@ -70,190 +70,194 @@ static COLOR32 TxiBlend(COLOR32 c1, COLOR32 c2, int factor) {
 	return ColorRoundToDS18(r | (g << 8) | (b << 16));
 }
 
-void TxRender(COLOR32 *px, int dstWidth, int dstHeight, TEXELS *texels, PALETTE *palette, int flip) {
-	int format = FORMAT(texels->texImageParam);
-	int c0xp = COL0TRANS(texels->texImageParam);
-	int width = TEXW(texels->texImageParam);
-	int height = TEXH(texels->texImageParam);
-	int nPixels = width * height;
-	int txelSize = TxGetTexelSize(width, height, texels->texImageParam);
-	switch (format) {
-		case CT_DIRECT:
-		{
-			for (int i = 0; i < nPixels; i++) {
-				int curX = i % width, curY = i / width;
-				COLOR pVal = ((COLOR *) texels->texel)[i];
-				if (curX < dstWidth && curY < dstHeight) {
-					px[curX + curY * dstWidth] = ColorConvertFromDS(pVal) | (GetA(pVal) ? 0xFF000000 : 0);
-				}
-			}
-			break;
+//15-bit to 24-bit color expansion for every DS color, built on first use
+static COLOR32 sTxColorLookup[0x8000];
+static volatile int sTxColorLookupInitialized = 0;
+
+static const COLOR32 *TxiGetColorLookup(void) {
+	//a racing initialization writes the same values, so this needs no lock
+	if (!sTxColorLookupInitialized) {
+		for (int i = 0; i < 0x8000; i++) {
+			sTxColorLookup[i] = ColorConvertFromDS((COLOR) i);
 		}
-		case CT_4COLOR:
-		{
-			int offs = 0;
-			for (int i = 0; i < txelSize >> 2; i++) {
-				uint32_t d = ((uint32_t *) texels->texel)[i];
-				for (int j = 0; j < 16; j++) {
-					int curX = offs % width, curY = offs / width;
-					int pVal = d & 0x3;
-					d >>= 2;
-					if (curX < dstWidth && curY < dstHeight && pVal < palette->nColors) {
-						if (!pVal && c0xp) {
-							px[offs] = 0;
-						} else {
-							COLOR col = palette->pal[pVal];
-							px[curX + curY * dstWidth] = ColorConvertFromDS(col) | 0xFF000000;
-						}
-					}
-					offs++;
-				}
-			}
-			break;
+		sTxColorLookupInitialized = 1;
+	}
+	return sTxColorLookup;
+}
+
+static void TxiBuildTexelLookup(COLOR32 *table, int format, int c0xp, PALETTE *palette, const COLOR32 *lookup) {
+	//every texel byte of an a3i5/a5i3 texture, or every palette index otherwise, maps to one output color.
+	//indices past the end of the palette decode as transparent.
+	int indexBits = 8, alphaMax = 0;
+	if (format == CT_A3I5) {
+		indexBits = 5;
+		alphaMax = 7;
+	} else if (format == CT_A5I3) {
+		indexBits = 3;
+		alphaMax = 31;
+	}
+
+	int indexMask = (1 << indexBits) - 1;
+	for (int i = 0; i < 256; i++) {
+		int index = i & indexMask;
+		COLOR32 c = 0;
+		if (index < palette->nColors) {
+			c = lookup[palette->pal[index] & 0x7FFF];
+			if (alphaMax) c |= ((i >> indexBits) * 255 / alphaMax) << 24;
+			else c |= 0xFF000000;
 		}
-		case CT_16COLOR:
-		{
-			for (int i = 0; i < txelSize; i++) {
-				uint8_t pVal = texels->texel[i];
-				COLOR32 col0 = 0;
-				COLOR32 col1 = 0;
-
-				if ((pVal & 0xF) < palette->nColors) {
-					col0 = ColorConvertFromDS(palette->pal[pVal & 0xF]) | 0xFF000000;
-				}
-				if ((pVal >> 4) < palette->nColors) {
-					col1 = ColorConvertFromDS(palette->pal[pVal >> 4]) | 0xFF000000;
-				}
+		table[i] = c;
+	}
 
-				if (c0xp) {
-					if (!(pVal & 0xF)) col0 = 0;
-					if (!(pVal >> 4)) col1 = 0;
-				}
+	//color 0 transparent
+	if (c0xp && format != CT_A3I5 && format != CT_A5I3) table[0] = 0;
+}
 
-				int offs = i * 2;
-				int curX = offs % width, curY = offs / width;
-				if ((curX + 0) < dstWidth && curY < dstHeight) px[offs + 0] = col0;
-				if ((curX + 1) < dstWidth && curY < dstHeight) px[offs + 1] = col1;
-			}
+static void TxiExpand4x4Palette(COLOR32 *colors, uint16_t index, PALETTE *palette, const COLOR32 *lookup) {
+	int address = COMP_INDEX(index);
+	int mode = index & COMP_MODE_MASK;
+	COLOR *base = palette->pal + address;
+
+	colors[0] = colors[1] = colors[2] = colors[3] = 0;
+	if (address + 2 <= palette->nColors) {
+		colors[0] = lookup[base[0] & 0x7FFF] | 0xFF000000;
+		colors[1] = lookup[base[1] & 0x7FFF] | 0xFF000000;
+	}
+
+	switch (mode) {
+		case COMP_TRANSPARENT | COMP_FULL:
+			//require 3 colors
+			if (address + 3 <= palette->nColors) colors[2] = lookup[base[2] & 0x7FFF] | 0xFF000000;
 			break;
-		}
-		case CT_256COLOR:
-		{
-			for (int i = 0; i < txelSize; i++) {
-				uint8_t pVal = texels->texel[i];
-				int destX = i % width, destY = i / width;
-				if (destX < dstWidth && destY < dstHeight && pVal < palette->nColors) {
-					if (!pVal && c0xp) {
-						px[i] = 0;
-					} else {
-						COLOR col = palette->pal[pVal];
-						px[destX + destY * dstWidth] = ColorConvertFromDS(col) | 0xFF000000;
-					}
-				}
-			}
+		case COMP_TRANSPARENT | COMP_INTERPOLATE:
+			//require 2 colors
+			colors[2] = TxiBlend(colors[0], colors[1], 4) | 0xFF000000;
 			break;
-		}
-		case CT_A3I5:
-		{
-			for (int i = 0; i < txelSize; i++) {
-				uint8_t d = texels->texel[i];
-				int alpha = ((d & 0xE0) >> 5) * 255 / 7;
-				int index = d & 0x1F;
-				if (index < palette->nColors) {
-					COLOR32 atIndex = ColorConvertFromDS(palette->pal[index]);
-					int destX = i % width, destY = i / width;
-					if (destX < dstWidth && destY < dstHeight) {
-						px[destX + destY * dstWidth] = atIndex | (alpha << 24);
-					}
-				}
+		case COMP_OPAQUE | COMP_FULL:
+			//require 4 colors
+			if (address + 4 <= palette->nColors) {
+				colors[2] = lookup[base[2] & 0x7FFF] | 0xFF000000;
+				colors[3] = lookup[base[3] & 0x7FFF] | 0xFF000000;
 			}
 			break;
-		}
-		case CT_A5I3:
-		{
-			for (int i = 0; i < txelSize; i++) {
-				uint8_t d = texels->texel[i];
-				int alpha = ((d & 0xF8) >> 3) * 255 / 31;
-				int index = d & 0x7;
-				if (index < palette->nColors) {
-					COLOR32 atIndex = ColorConvertFromDS(palette->pal[index]);
-					int destX = i % width, destY = i / width;
-					if (destX < dstWidth && destY < dstHeight) {
-						px[destX + destY * dstWidth] = atIndex | (alpha << 24);
-					}
+		case COMP_OPAQUE | COMP_INTERPOLATE:
+			//require 2 colors
+			colors[2] = TxiBlend(colors[0], colors[1], 3) | 0xFF000000;
+			colors[3] = TxiBlend(colors[0], colors[1], 5) | 0xFF000000;
+			break;
+	}
+}
+
+//small direct-mapped cache of expanded 4x4 palettes, since neighboring blocks tend to share one
+#define TX_4x4_CACHE_SIZE 256
+
+typedef struct TxiPaletteCacheEntry_ {
+	int index;
+	COLOR32 colors[4];
+} TxiPaletteCacheEntry;
+
+static void TxiRender4x4(COLOR32 *px, int dstWidth, TEXELS *texels, PALETTE *palette, const COLOR32 *lookup, int x0, int y0, int x1, int y1) {
+	int tilesX = TEXW(texels->texImageParam) / 4;
+	TxiPaletteCacheEntry cache[TX_4x4_CACHE_SIZE];
+	for (int i = 0; i < TX_4x4_CACHE_SIZE; i++) cache[i].index = -1;
+
+	const uint32_t *txel = (const uint32_t *) texels->texel;
+	for (int tileY = y0 >> 2; tileY <= (y1 - 1) >> 2; tileY++) {
+		//rows of this block row within the rectangle
+		int rowStart = max(y0 - tileY * 4, 0);
+		int rowEnd = min(y1 - tileY * 4, 4);
+
+		for (int tileX = x0 >> 2; tileX <= (x1 - 1) >> 2; tileX++) {
+			int colStart = max(x0 - tileX * 4, 0);
+			int colEnd = min(x1 - tileX * 4, 4);
+
+			int tileIndex = tileX + tileY * tilesX;
+			uint16_t index = texels->cmp[tileIndex];
+			TxiPaletteCacheEntry *entry = &cache[(index ^ (index >> 8)) & (TX_4x4_CACHE_SIZE - 1)];
+			if (entry->index != index) {
+				entry->index = index;
+				TxiExpand4x4Palette(entry->colors, index, palette, lookup);
+			}
+
+			uint32_t texel = txel[tileIndex];
+			COLOR32 *dest = px + tileX * 4 + tileY * 4 * dstWidth;
+			for (int y = rowStart; y < rowEnd; y++) {
+				unsigned int row = (texel >> (y * 8)) & 0xFF;
+				COLOR32 *destRow = dest + y * dstWidth;
+				for (int x = colStart; x < colEnd; x++) {
+					destRow[x] = entry->colors[(row >> (x * 2)) & 3];
 				}
 			}
-			break;
 		}
-		case CT_4x4:
-		{
-			int tilesX = width / 4;
-			int tilesY = height / 4;
-			int nTiles = tilesX * tilesY;
-			for (int i = 0; i < nTiles; i++) {
-				int tileX = i % tilesX;
-				int tileY = i / tilesX;
-
-				COLOR32 colors[4] = { 0 };
-				uint32_t texel = *(uint32_t *) (texels->texel + (i << 2));
-				uint16_t index = texels->cmp[i];
-
-				int address = COMP_INDEX(index);
-				int mode = index & COMP_MODE_MASK;
-				COLOR *base = palette->pal + address;
-				if (address + 2 <= palette->nColors) {
-					colors[0] = ColorConvertFromDS(base[0]) | 0xFF000000;
-					colors[1] = ColorConvertFromDS(base[1]) | 0xFF000000;
-				}
+	}
+}
 
-				if (mode == (COMP_TRANSPARENT | COMP_FULL)) {
-					//require 3 colors
-					if (address + 3 <= palette->nColors) {
-						colors[2] = ColorConvertFromDS(base[2]) | 0xFF000000;
-					}
-					colors[3] = 0;
-				} else if (mode == (COMP_TRANSPARENT | COMP_INTERPOLATE)) {
-					//require 2 colors
-					COLOR32 col0 = 0, col1 = 0;
-					if (address + 2 <= palette->nColors) {
-						col0 = colors[0];
-						col1 = colors[1];
-					}
-					colors[2] = TxiBlend(col0, col1, 4) | 0xFF000000;
-					colors[3] = 0;
-				} else if (mode == (COMP_OPAQUE | COMP_FULL)) {
-					//require 4 colors
-					if (address + 4 <= palette->nColors) {
-						colors[2] = ColorConvertFromDS(base[2]) | 0xFF000000;
-						colors[3] = ColorConvertFromDS(base[3]) | 0xFF000000;
-					}
-				} else {
-					//require 2 colors
-					COLOR32 col0 = 0, col1 = 0;
-					if (address + 2 <= palette->nColors) {
-						col0 = colors[0];
-						col1 = colors[1];
-					}
-					
-					colors[2] = TxiBlend(col0, col1, 3) | 0xFF000000;
-					colors[3] = TxiBlend(col0, col1, 5) | 0xFF000000;
-				}
+void TxRenderRect(COLOR32 *px, int dstWidth, int dstHeight, TEXELS *texels, PALETTE *palette, int x, int y, int width, int height) {
+	int format = FORMAT(texels->texImageParam);
+	int c0xp = COL0TRANS(texels->texImageParam);
+	int texWidth = TEXW(texels->texImageParam);
+	int texHeight = TEXH(texels->texImageParam);
+	if (format == 0) return;
 
-				for (int j = 0; j < 16; j++) {
-					int pVal = texel & 0x3;
-					texel >>= 2;
+	//clip rectangle to both the texture and the destination
+	int x0 = max(x, 0), y0 = max(y, 0);
+	int x1 = min(min(x + width, texWidth), dstWidth);
+	int y1 = min(min(y + height, texHeight), dstHeight);
+	if (x0 >= x1 || y0 >= y1) return;
 
-					int destX = (j % 4) + tileX * 4;
-					int destY = (j / 4) + tileY * 4;
-					if (destX < dstWidth && destY < dstHeight) {
-						px[destX + destY * dstWidth] = colors[pVal];
-					}
-				}
+	const COLOR32 *lookup = TxiGetColorLookup();
+	if (format == CT_4x4) {
+		TxiRender4x4(px, dstWidth, texels, palette, lookup, x0, y0, x1, y1);
+		return;
+	}
+
+	if (format == CT_DIRECT) {
+		const COLOR *src = (const COLOR *) texels->texel;
+		for (int curY = y0; curY < y1; curY++) {
+			const COLOR *srcRow = src + curY * texWidth;
+			COLOR32 *destRow = px + curY * dstWidth;
+			for (int curX = x0; curX < x1; curX++) {
+				COLOR c = srcRow[curX];
+				destRow[curX] = lookup[c & 0x7FFF] | ((c & 0x8000) ? 0xFF000000 : 0);
 			}
-			break;
 		}
+		return;
 	}
 
+	//paletted formats decode through a table of every texel value
+	COLOR32 table[256];
+	TxiBuildTexelLookup(table, format, c0xp, palette, lookup);
+
+	int depths[] = { 0, 8, 2, 4, 8, 0, 8, 16 };
+	int depth = depths[format];
+	int strideBytes = texWidth * depth / 8;
+	for (int curY = y0; curY < y1; curY++) {
+		const unsigned char *srcRow = texels->texel + curY * strideBytes;
+		COLOR32 *destRow = px + curY * dstWidth;
+
+		switch (depth) {
+			case 8:
+				for (int curX = x0; curX < x1; curX++) {
+					destRow[curX] = table[srcRow[curX]];
+				}
+				break;
+			case 4:
+				for (int curX = x0; curX < x1; curX++) {
+					destRow[curX] = table[(srcRow[curX >> 1] >> ((curX & 1) << 2)) & 0xF];
+				}
+				break;
+			case 2:
+				for (int curX = x0; curX < x1; curX++) {
+					destRow[curX] = table[(srcRow[curX >> 2] >> ((curX & 3) << 1)) & 0x3];
+				}
+				break;
+		}
+	}
+}
+
+void TxRender(COLOR32 *px, int dstWidth, int dstHeight, TEXELS *texels, PALETTE *palette, int flip) {
+	TxRenderRect(px, dstWidth, dstHeight, texels, palette, 0, 0, dstWidth, dstHeight);
+
 	//flip upside down
 	if (flip) {
 		COLOR32 *tmp = calloc(dstWidth, 4);
@@ -516,16 +520,11 @@ int TxIdentify(const unsigned char *buffer, unsigned int size) {
 }
 
 int TxIdentifyFile(LPCWSTR path) {
-	HANDLE hFile = CreateFile(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-	DWORD dwSizeHigh;
-	DWORD dwSize = GetFileSize(hFile, &dwSizeHigh);
-	LPBYTE lpBuffer = (LPBYTE) malloc(dwSize);
-	DWORD dwRead;
-	ReadFile(hFile, lpBuffer, dwSize, &dwRead, NULL);
-	CloseHandle(hFile);
-
-	int type = TxIdentify(lpBuffer, dwRead);
-	free(lpBuffer);
+	OBJ_FILE_MAPPING mapping;
+	if (!OBJ_SUCCEEDED(ObjMapFile(path, &mapping))) return TEXTURE_TYPE_INVALID;
+
+	int type = TxIdentify(mapping.buffer, mapping.size);
+	ObjUnmapFile(&mapping);
 	return type;
 }
 
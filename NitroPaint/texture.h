@@ -62,6 +62,12 @@ const char *TxNameFromTexFormat(int fmt);
 
 void TxRender(COLOR32 *px, int dstWidth, int dstHeight, TEXELS *texels, PALETTE *palette, int flip);
 
+//
+// Render a rectangle of a texture to the same position in the destination, leaving
+// the rest of the destination untouched.
+//
+void TxRenderRect(COLOR32 *px, int dstWidth, int dstHeight, TEXELS *texels, PALETTE *palette, int x, int y, int width, int height);
+
 int TxGetTexelSize(int width, int height, int texImageParam);
 
 int TxGetTextureVramSize(TEXELS *texels);
@@ -9,6 +9,7 @@
 #include "gdip.h"
 #include "texconv.h"
 #include "nclr.h"
+#include "parallel.h"
 
 #include <Shlwapi.h>
 #include <ShlObj.h>
@@ -443,13 +444,14 @@ static LRESULT CALLBACK TextureEditorWndProc(HWND hWnd, UINT msg, WPARAM wParam,
 				data->isNitro = 1;
 				TxRender(data->px, data->width, data->height, &data->texture.texture.texels, &data->texture.texture.palette, 0);
 				TexViewerUpdatePaletteLabel(hWnd);
+			} else {
+				//the palette label counts the colors of a Nitro TGA
+				WCHAR buffer[16];
+				int nColors = ImgCountColors(data->px, data->width * data->height);
+				int len = wsprintfW(buffer, L"Colors: %d", nColors);
+				SendMessage(data->hWndUniqueColors, WM_SETTEXT, len, (LPARAM) buffer);
 			}
 
-			WCHAR buffer[16];
-			int nColors = ImgCountColors(data->px, data->width * data->height);
-			int len = wsprintfW(buffer, L"Colors: %d", nColors);
-			SendMessage(data->hWndUniqueColors, WM_SETTEXT, len, (LPARAM) buffer);
-
 			SendMessage(data->ted.hWndViewer, NV_RECALCULATE, 0, 0);
 			RedrawWindow(data->ted.hWndViewer, NULL, NULL, RDW_FRAME | RDW_INVALIDATE);
 			break;
@@ -474,11 +476,6 @@ static LRESULT CALLBACK TextureEditorWndProc(HWND hWnd, UINT msg, WPARAM wParam,
 			TxRender(data->px, data->width, data->height, &texture->texture.texels, &texture->texture.palette, 0);
 
 			//update UI
-			WCHAR buffer[16];
-			int nColors = ImgCountColors(data->px, data->width * data->height);
-			int len = wsprintfW(buffer, L"Colors: %d", nColors);
-			SendMessage(data->hWndUniqueColors, WM_SETTEXT, len, (LPARAM) buffer);
-
 			SendMessage(data->ted.hWndViewer, NV_RECALCULATE, 0, 0);
 			RedrawWindow(data->ted.hWndViewer, NULL, NULL, RDW_FRAME | RDW_INVALIDATE);
 			TexViewerUpdatePaletteLabel(hWnd);
@@ -780,18 +777,18 @@ static LRESULT CALLBACK TextureTileEditorWndProc(HWND hWnd, UINT msg, WPARAM wPa
 				if (notification == BN_CLICKED && hWndControl == data->hWndTransparent) {
 					int state = GetCheckboxChecked(hWndControl);
 					*pIdx = ((*pIdx) & 0x7FFF) | ((!state) << 15);
-					TxRender(data->px, data->width, data->height, texels, &data->texture.texture.palette, 0);
+					TxRenderRect(data->px, data->width, data->height, texels, &data->texture.texture.palette, tileX * 4, tileY * 4, 4, 4);
 					InvalidateRect(data->hWnd, NULL, FALSE);
 					InvalidateRect(hWnd, NULL, FALSE);
 				} else if (notification == BN_CLICKED && hWndControl == data->hWndInterpolate) {
 					int state = GetCheckboxChecked(hWndControl);
 					*pIdx = ((*pIdx) & 0xBFFF) | (state << 14);
-					TxRender(data->px, data->width, data->height, texels, &data->texture.texture.palette, 0);
+					TxRenderRect(data->px, data->width, data->height, texels, &data->texture.texture.palette, tileX * 4, tileY * 4, 4, 4);
 					InvalidateRect(data->hWnd, NULL, FALSE);
 					InvalidateRect(hWnd, NULL, FALSE);
 				} else if (notification == EN_CHANGE && hWndControl == data->hWndPaletteBase) {
 					*pIdx = ((*pIdx) & 0xC000) | (GetEditNumber(hWndControl) & 0x3FFF);
-					TxRender(data->px, data->width, data->height, texels, &data->texture.texture.palette, 0);
+					TxRenderRect(data->px, data->width, data->height, texels, &data->texture.texture.palette, tileX * 4, tileY * 4, 4, 4);
 					InvalidateRect(data->hWnd, NULL, FALSE);
 					InvalidateRect(hWnd, NULL, FALSE);
 				}
@@ -870,7 +867,7 @@ static LRESULT CALLBACK TextureTileEditorWndProc(HWND hWnd, UINT msg, WPARAM wPa
 						}
 					}
 				}
-				TxRender(data->px, data->width, data->height, texels, &data->texture.texture.palette, 0);
+				TxRenderRect(data->px, data->width, data->height, texels, &data->texture.texture.palette, tileX * 4, tileY * 4, 4, 4);
 				InvalidateRect(data->hWnd, NULL, FALSE);
 				InvalidateRect(hWnd, NULL, FALSE);
 			} else if (pt.x >= 138 && pt.y >= 0) { //select palette/alpha
@@ -1029,7 +1026,8 @@ static int TexViewerJudgeFormat(COLOR32 *px, int nWidth, int nHeight) {
 	//is there translucency?
 	if (TexViewerImageHasTranslucentPixels(px, nWidth, nHeight)) {
 		//then choose a3i5 or a5i3. Do this by using color count.
-		int colorCount = ImgCountColors(px, nWidth * nHeight);
+		int hasTransparent;
+		int colorCount = ImgCountOpaqueColors(px, nWidth * nHeight, 1, 16, NULL, &hasTransparent) + hasTransparent;
 		if (colorCount < 16) {
 			//colors < 16, choose a5i3.
 			fmt = CT_A5I3;
@@ -1409,7 +1407,13 @@ LRESULT CALLBACK CompressionProgressProc(HWND hWnd, UINT msg, WPARAM wParam, LPA
 		}
 		case WM_TIMER:
 		{
-			if (g_texCompressionProgressMax) {
+			//batch conversion tracks its own progress out of 1000
+			volatile int *batchProgress = (volatile int *) GetWindowLongPtr(hWnd, GWLP_USERDATA);
+			if (batchProgress != NULL) {
+				HWND hWndProgress = (HWND) GetWindowLongPtr(hWnd, 0);
+				SendMessage(hWndProgress, PBM_SETRANGE, 0, 1000 << 16);
+				SendMessage(hWndProgress, PBM_SETPOS, *batchProgress, 0);
+			} else if (g_texCompressionProgressMax) {
 				HWND hWndProgress = (HWND) GetWindowLongPtr(hWnd, 0);
 				SendMessage(hWndProgress, PBM_SETRANGE, 0, g_texCompressionProgressMax << 16);
 				SendMessage(hWndProgress, PBM_SETPOS, g_texCompressionProgress, 0);
@@ -1794,9 +1798,53 @@ int BatchTexDelete(LPCWSTR path) {
 	return EnumAllFiles(path, DeleteFileCallback, RemoveDirectoryCallback, NULL, NULL);
 }
 
-//some global state for the current batch operation
-int g_batchTexConvertedTex = 0; //number of textures converted
-LPCWSTR g_batchTexOut = NULL;
+#define BATCHTEX_CACHE_NAME      L"batchtex.cache"  // name of the conversion cache in the output directory
+
+#define BATCHTEX_JOB_SKIPPED     0   // not an image
+#define BATCHTEX_JOB_CURRENT     1   // output is up to date
+#define BATCHTEX_JOB_CONVERTED   2   // output was converted
+#define BATCHTEX_JOB_FAILED      3   // image has invalid texture dimensions
+
+typedef struct BatchTexJob_ {
+	WCHAR path[MAX_PATH];
+	WCHAR outPath[MAX_PATH];
+	WCHAR configPath[MAX_PATH];
+	int fmt;                       // -1 to judge from the image
+	int colorEntries;              // -1 to judge from the image
+	int dither;
+	int ditherAlpha;
+	float diffuse;
+	int balance;
+	int colorBalance;
+	int enhanceColors;
+	char pnam[17];
+	BOOL hasMissing;               // options missing from the configuration file
+	uint64_t key;                  // hash of the output file name
+	uint64_t hash;                 // hash of the image pixels, options and converter version
+	int status;
+} BatchTexJob;
+
+//
+// Content hashes of converted textures, keyed by the hash of their output file
+// name. Sorted by key.
+//
+typedef struct BatchTexCache_ {
+	int nEntries;
+	uint64_t *keys;
+	uint64_t *hashes;
+} BatchTexCache;
+
+typedef struct BatchTexContext_ {
+	LPCWSTR srcDir;
+	LPCWSTR outDir;
+	BatchTexJob *jobs;
+	int nJobs;
+	int jobsCapacity;
+	BatchTexCache cache;
+	volatile int progress;         // 0-1000
+	int status;
+} BatchTexContext;
+
 HWND g_hWndBatchTexWindow;
 
 BOOL BatchTexReadOptions(LPCWSTR path, int *fmt, int *dither, int *ditherAlpha, float *diffuse, int *paletteSize, char *pnam,
@@ -1892,47 +1940,86 @@ void BatchTexWriteOptions(LPCWSTR path, int fmt, int dither, int ditherAlpha, fl
 	WritePrivateProfileString(L"Texture", L"EnhanceColors", buffer, path);
 }
 
-BOOL BatchTexShouldConvert(LPCWSTR path, LPCWSTR configPath, LPCWSTR outPath) {
-	HANDLE hTextureFile = CreateFile(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-	HANDLE hConfigFile = CreateFile(configPath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-	HANDLE hOutFile = CreateFile(outPath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-	
-	//if input doesn't exist, we can't possibly 
-	BOOL shouldWrite = FALSE;
-	FILETIME srcTime = { 0 }, configTime = { 0 }, destTime = { 0 };
-	if (hTextureFile == INVALID_HANDLE_VALUE) {
-		shouldWrite = FALSE;
-		goto cleanup;
+static uint64_t BatchTexHash(uint64_t hash, const void *data, int size) {
+	//FNV-1a
+	const unsigned char *bytes = (const unsigned char *) data;
+	for (int i = 0; i < size; i++) {
+		hash = (hash ^ bytes[i]) * 0x00000100000001B3ull;
 	}
+	return hash;
+}
 
-	//if output doesn't exist or config doesn't exist, do output
-	if (hOutFile == INVALID_HANDLE_VALUE || hConfigFile == INVALID_HANDLE_VALUE) {
-		shouldWrite = TRUE;
-		goto cleanup;
+static uint64_t BatchTexHashName(LPCWSTR path) {
+	//output names are compared case insensitively
+	uint64_t hash = 0xCBF29CE484222325ull;
+	for (LPCWSTR name = GetFileName(path); *name; name++) {
+		WCHAR c = towupper(*name);
+		hash = BatchTexHash(hash, &c, sizeof(c));
 	}
+	return hash;
+}
 
-	//if either of srcTime or configTime are greater than or equal to destTime, do write
-	LARGE_INTEGER srcInt, configInt, destInt;
-	GetFileTime(hTextureFile, NULL, NULL, &srcTime);
-	GetFileTime(hConfigFile, NULL, NULL, &configTime);
-	GetFileTime(hOutFile, NULL, NULL, &destTime);
-	srcInt.LowPart = srcTime.dwLowDateTime;
-	srcInt.HighPart = srcTime.dwHighDateTime;
-	configInt.LowPart = configTime.dwLowDateTime;
-	configInt.HighPart = configTime.dwHighDateTime;
-	destInt.LowPart = destTime.dwLowDateTime;
-	destInt.HighPart = destTime.dwHighDateTime;
-	if (destInt.QuadPart <= srcInt.QuadPart || destInt.QuadPart <= configInt.QuadPart) {
-		shouldWrite = TRUE;
-		goto cleanup;
+static int BatchTexCompareKeys(const void *p1, const void *p2) {
+	uint64_t k1 = *(const uint64_t *) p1, k2 = *(const uint64_t *) p2;
+	return (k1 > k2) - (k1 < k2);
+}
+
+static void BatchTexReadCache(BatchTexCache *cache, LPCWSTR path) {
+	memset(cache, 0, sizeof(BatchTexCache));
+
+	OBJ_FILE_MAPPING mapping;
+	if (!OBJ_SUCCEEDED(ObjMapFile(path, &mapping))) return;
+
+	//one line per texture: key and hash in hex
+	int nLines = mapping.size / 35;
+	uint64_t *entries = (uint64_t *) calloc(nLines + 1, 2 * sizeof(uint64_t));
+	for (int i = 0; i < nLines; i++) {
+		char line[36] = { 0 };
+		memcpy(line, mapping.buffer + i * 35, 35);
+		if (sscanf(line, "%16llx %16llx", &entries[i * 2], &entries[i * 2 + 1]) != 2) break;
+		cache->nEntries++;
 	}
-	
+	ObjUnmapFile(&mapping);
+
+	qsort(entries, cache->nEntries, 2 * sizeof(uint64_t), BatchTexCompareKeys);
+	cache->keys = (uint64_t *) calloc(cache->nEntries + 1, sizeof(uint64_t));
+	cache->hashes = (uint64_t *) calloc(cache->nEntries + 1, sizeof(uint64_t));
+	for (int i = 0; i < cache->nEntries; i++) {
+		cache->keys[i] = entries[i * 2];
+		cache->hashes[i] = entries[i * 2 + 1];
+	}
+	free(entries);
+}
 
-cleanup:
-	if (hTextureFile != INVALID_HANDLE_VALUE) CloseHandle(hTextureFile);
-	if (hConfigFile != INVALID_HANDLE_VALUE) CloseHandle(hConfigFile);
-	if (hOutFile != INVALID_HANDLE_VALUE) CloseHandle(hOutFile);
-	return shouldWrite;
+static int BatchTexLookupCache(BatchTexCache *cache, uint64_t key, uint64_t *hash) {
+	uint64_t *found = (uint64_t *) bsearch(&key, cache->keys, cache->nEntries, sizeof(uint64_t), BatchTexCompareKeys);
+	if (found == NULL) return 0;
+
+	*hash = cache->hashes[found - cache->keys];
+	return 1;
+}
+
+static void BatchTexFreeCache(BatchTexCache *cache) {
+	if (cache->keys != NULL) free(cache->keys);
+	if (cache->hashes != NULL) free(cache->hashes);
+	memset(cache, 0, sizeof(BatchTexCache));
+}
+
+static void BatchTexWriteCache(BatchTexContext *ctx, LPCWSTR path) {
+	HANDLE hFile = CreateFile(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE) return;
+
+	//only textures present in the output are recorded
+	for (int i = 0; i < ctx->nJobs; i++) {
+		BatchTexJob *job = ctx->jobs + i;
+		if (job->status != BATCHTEX_JOB_CURRENT && job->status != BATCHTEX_JOB_CONVERTED) continue;
+
+		char line[36];
+		DWORD dwWritten;
+		sprintf(line, "%016llx %016llx\r\n", job->key, job->hash);
+		WriteFile(hFile, line, 35, &dwWritten, NULL);
+	}
+	CloseHandle(hFile);
 }
 
 void BatchTexCheckFormatDir(LPCWSTR path, int *fmt) {
@@ -1966,27 +2053,38 @@ void BatchTexCheckFormatDir(LPCWSTR path, int *fmt) {
 	}
 }
 
-BOOL CALLBACK BatchTexConvertFileCallback(LPCWSTR path, void *param) {
-	//read image
-	int width, height;
-	COLOR32 *px = ImgRead(path, &width, &height);
-
-	//invalid image?
-	if (px == NULL) {
-		return TRUE; //just skip the file by reporting a success
+static int BatchTexDefaultColorEntries(int fmt, int width, int height) {
+	//max color entries for the selected format
+	switch (fmt) {
+		case CT_4COLOR:
+			return 4;
+		case CT_16COLOR:
+			return 16;
+		case CT_256COLOR:
+			return 256;
+		case CT_A3I5:
+			return 32;
+		case CT_A5I3:
+			return 8;
 	}
+	return TexViewerJudgeColorCount(width, height);
+}
 
-	//invalid texture size?
-	if (!TxDimensionIsValid(width) || !TxDimensionIsValid(height)) {
-		if (px) free(px);
-		return FALSE; //report actual error
+BOOL CALLBACK BatchTexCollectFileCallback(LPCWSTR path, void *param) {
+	BatchTexContext *ctx = (BatchTexContext *) param;
+	if (ctx->nJobs == ctx->jobsCapacity) {
+		ctx->jobsCapacity = ctx->jobsCapacity ? ctx->jobsCapacity * 2 : 64;
+		ctx->jobs = (BatchTexJob *) realloc(ctx->jobs, ctx->jobsCapacity * sizeof(BatchTexJob));
 	}
+	BatchTexJob *job = ctx->jobs + ctx->nJobs++;
+	memset(job, 0, sizeof(BatchTexJob));
+	memcpy(job->path, path, 2 * (wcslen(path) + 1));
 
 	//construct output path (ensure .TGA extension)
-	WCHAR outPath[MAX_PATH] = { 0 };
+	WCHAR *outPath = job->outPath;
 	LPCWSTR filename = GetFileName(path);
-	int outPathLen = wcslen(g_batchTexOut);
-	memcpy(outPath, g_batchTexOut, 2 * (outPathLen + 1));
+	int outPathLen = wcslen(ctx->outDir);
+	memcpy(outPath, ctx->outDir, 2 * (outPathLen + 1));
 	outPath[outPathLen++] = L'\\';
 	memcpy(outPath + outPathLen, filename, 2 * wcslen(filename) + 2);
 
@@ -1996,9 +2094,10 @@ BOOL CALLBACK BatchTexConvertFileCallback(LPCWSTR path, void *param) {
 		if (outPath[i] == L'.') extensionIndex = i;
 	}
 	memcpy(outPath + extensionIndex, L".TGA", 5 * sizeof(WCHAR));
+	job->key = BatchTexHashName(outPath);
 
 	//construct congfiguration path; used to read/write for this texture
-	WCHAR configPath[MAX_PATH] = { 0 };
+	WCHAR *configPath = job->configPath;
 	memcpy(configPath, path, 2 * (wcslen(path) + 1));
 	extensionIndex = 0;
 	for (unsigned int i = 0; i < wcslen(configPath); i++) {
@@ -2006,89 +2105,113 @@ BOOL CALLBACK BatchTexConvertFileCallback(LPCWSTR path, void *param) {
 	}
 	memcpy(configPath + extensionIndex, L".INI", 5 * sizeof(WCHAR));
 
-	//check: should we re-convert?
-	BOOL doConvert = BatchTexShouldConvert(path, configPath, outPath);
-	if (!doConvert) return TRUE; //skip
-
 	int i;
-	char pnam[17] = { 0 };
 	for (i = 0; i < 12; i++) { //add _pl, max 15 chars
 		if (filename[i] == L'\0') break;
 		if (filename[i] == L'.') break;
-		pnam[i] = (char) filename[i];
+		job->pnam[i] = (char) filename[i];
 	}
-	memcpy(pnam + i, "_pl", 4);
+	memcpy(job->pnam + i, "_pl", 4);
+
+	//format and color count are judged from the image unless set by the
+	//directory or configuration. The last directory name after base may be
+	//the name of a format.
+	job->fmt = -1;
+	job->colorEntries = -1;
+	BatchTexCheckFormatDir(path, &job->fmt);
+	if (job->fmt != -1) job->colorEntries = BatchTexDefaultColorEntries(job->fmt, 0, 0);
+	job->balance = BALANCE_DEFAULT;
+	job->colorBalance = BALANCE_DEFAULT;
 
-	//setup texture params
-	int dither = 0, ditherAlpha = 0;
-	float diffuse = 0.0f;
+	//read overrides from file.
+	job->hasMissing = BatchTexReadOptions(configPath, &job->fmt, &job->dither, &job->ditherAlpha, &job->diffuse,
+		&job->colorEntries, job->pnam, &job->balance, &job->colorBalance, &job->enhanceColors);
+	return TRUE;
+}
 
-	//palette settings
-	int useFixedPalette = 0;
-	COLOR *fixedPalette = NULL;
+static uint64_t BatchTexHashJob(BatchTexJob *job, const COLOR32 *px, int width, int height) {
+	int version = TX_CONVERTER_VERSION;
+	int diffuse = (int) (job->diffuse * 100.0f + 0.5f);
+
+	uint64_t hash = 0xCBF29CE484222325ull;
+	hash = BatchTexHash(hash, &version, sizeof(version));
+	hash = BatchTexHash(hash, &width, sizeof(width));
+	hash = BatchTexHash(hash, &height, sizeof(height));
+	hash = BatchTexHash(hash, px, width * height * sizeof(COLOR32));
+	hash = BatchTexHash(hash, &job->fmt, sizeof(job->fmt));
+	hash = BatchTexHash(hash, &job->colorEntries, sizeof(job->colorEntries));
+	hash = BatchTexHash(hash, &job->dither, sizeof(job->dither));
+	hash = BatchTexHash(hash, &job->ditherAlpha, sizeof(job->ditherAlpha));
+	hash = BatchTexHash(hash, &diffuse, sizeof(diffuse));
+	hash = BatchTexHash(hash, &job->balance, sizeof(job->balance));
+	hash = BatchTexHash(hash, &job->colorBalance, sizeof(job->colorBalance));
+	hash = BatchTexHash(hash, &job->enhanceColors, sizeof(job->enhanceColors));
+	hash = BatchTexHash(hash, job->pnam, sizeof(job->pnam));
+	return hash;
+}
 
-	//4x4 settings
-	int fmt = TexViewerJudgeFormat(px, width, height);
-	int colorEntries = TexViewerJudgeColorCount(width, height);
-	int threshold4x4 = 0;
+static void BatchTexConvertProc(void *context, int thread, int item) {
+	BatchTexContext *ctx = (BatchTexContext *) context;
+	BatchTexJob *job = ctx->jobs + item;
 
-	//check the directory. Last directory name after base should be the name
-	//of a format.
-	BatchTexCheckFormatDir(path, &fmt);
+	//image decoding uses COM, which each worker thread must initialize
+	HRESULT hrCom = CoInitializeEx(NULL, COINIT_MULTITHREADED);
 
-	//max color entries for the selected format
-	switch (fmt) {
-		case CT_4COLOR:
-			colorEntries = 4;
-			break;
-		case CT_16COLOR:
-			colorEntries = 16;
-			break;
-		case CT_256COLOR:
-			colorEntries = 256;
-			break;
-		case CT_A3I5:
-			colorEntries = 32;
-			break;
-		case CT_A5I3:
-			colorEntries = 8;
-			break;
+	//read image
+	int width, height;
+	COLOR32 *px = ImgRead(job->path, &width, &height);
+
+	//invalid image?
+	if (px == NULL) {
+		job->status = BATCHTEX_JOB_SKIPPED; //just skip the file
+		goto cleanup;
 	}
 
-	//balance settings
-	int balance = BALANCE_DEFAULT, colorBalance = BALANCE_DEFAULT;
-	int enhanceColors = 0;
+	//invalid texture size?
+	if (!TxDimensionIsValid(width) || !TxDimensionIsValid(height)) {
+		job->status = BATCHTEX_JOB_FAILED; //report actual error
+		goto cleanup;
+	}
 
-	//read overrides from file.
-	BOOL hasMissing = BatchTexReadOptions(configPath, &fmt, &dither, &ditherAlpha, &diffuse, &colorEntries, pnam,
-		&balance, &colorBalance, &enhanceColors);
+	if (job->fmt == -1) job->fmt = TexViewerJudgeFormat(px, width, height);
+	if (job->colorEntries == -1) job->colorEntries = BatchTexDefaultColorEntries(job->fmt, width, height);
 
-	//write back options to file (if there were any missing entries)
-	if (hasMissing) {
-		BatchTexWriteOptions(configPath, fmt, dither, ditherAlpha, diffuse, colorEntries, pnam, balance, colorBalance, enhanceColors);
+	//check: should we re-convert? Only if the image or its options changed since the last conversion.
+	uint64_t cachedHash;
+	job->hash = BatchTexHashJob(job, px, width, height);
+	if (BatchTexLookupCache(&ctx->cache, job->key, &cachedHash) && cachedHash == job->hash
+		&& GetFileAttributes(job->outPath) != INVALID_FILE_ATTRIBUTES) {
+		job->status = BATCHTEX_JOB_CURRENT;
+		goto cleanup;
 	}
 
-	HWND hWndMain = g_hWndBatchTexWindow;
-	HWND hWndProgress = CreateWindow(L"CompressionProgress", L"Compressing", WS_OVERLAPPEDWINDOW & ~(WS_THICKFRAME | WS_MAXIMIZEBOX | WS_MINIMIZEBOX),
-		CW_USEDEFAULT, CW_USEDEFAULT, 500, 150, hWndMain, NULL, NULL, NULL);
-	ShowWindow(hWndProgress, SW_SHOW);
-
 	TEXTURE texture = { 0 };
-	HANDLE hThread = textureConvertThreaded(px, width, height, fmt, dither, diffuse, ditherAlpha, colorEntries,
-		useFixedPalette, fixedPalette, threshold4x4, balance, colorBalance, enhanceColors, pnam, &texture,
-		NULL, NULL);
-	DoModalWait(hWndProgress, hThread); //modal wait progress window
-	
-	//contain texture
+	TxConversionParameters params = { 0 };
+	params.px = px;
+	params.width = width;
+	params.height = height;
+	params.fmt = job->fmt;
+	params.dither = job->dither;
+	params.diffuseAmount = job->diffuse;
+	params.ditherAlpha = job->ditherAlpha;
+	params.colorEntries = job->colorEntries;
+	params.balance = job->balance;
+	params.colorBalance = job->colorBalance;
+	params.enhanceColors = job->enhanceColors;
+	params.dest = &texture;
+	memcpy(params.pnam, job->pnam, sizeof(params.pnam));
+	TxConvert(&params);
+
+	//contain texture and write file out
 	TextureObject textureObj;
 	TxContain(&textureObj, TEXTURE_TYPE_NNSTGA, &texture);
-
-	//write file out
-	TxWriteFile(&textureObj, outPath);
-
-	//free texture memory
+	TxWriteFile(&textureObj, job->outPath);
 	ObjFree(&textureObj.header);
-	return TRUE;
+	job->status = BATCHTEX_JOB_CONVERTED;
+
+cleanup:
+	if (px != NULL) free(px);
+	if (SUCCEEDED(hrCom)) CoUninitialize();
 }
 
 BOOL CALLBACK BatchTexConvertDirectoryCallback(LPCWSTR path, void *param) {
@@ -2106,26 +2229,68 @@ BOOL CALLBACK BatchTexConvertDirectoryExclusion(LPCWSTR path, void *param) {
 	return TRUE;
 }
 
+static int BatchTexRun(BatchTexContext *ctx, LPCWSTR path) {
+	//collect all the textures in this directory along with their options
+	ctx->status = EnumAllFiles(path, BatchTexCollectFileCallback, BatchTexConvertDirectoryCallback, BatchTexConvertDirectoryExclusion, ctx);
+
+	WCHAR cachePath[MAX_PATH];
+	wsprintfW(cachePath, L"%s\\%s", ctx->outDir, BATCHTEX_CACHE_NAME);
+	BatchTexReadCache(&ctx->cache, cachePath);
+
+	//convert the textures that changed in parallel
+	ParRun(ctx->nJobs, BatchTexConvertProc, ctx, (int *) &ctx->progress, 0, 1000);
+
+	//write back options to file (if there were any missing entries)
+	for (int i = 0; i < ctx->nJobs; i++) {
+		BatchTexJob *job = ctx->jobs + i;
+		if (job->status == BATCHTEX_JOB_FAILED) ctx->status = 0;
+		if (job->status == BATCHTEX_JOB_SKIPPED || job->status == BATCHTEX_JOB_FAILED || !job->hasMissing) continue;
+
+		BatchTexWriteOptions(job->configPath, job->fmt, job->dither, job->ditherAlpha, job->diffuse, job->colorEntries,
+			job->pnam, job->balance, job->colorBalance, job->enhanceColors);
+	}
+
+	BatchTexWriteCache(ctx, cachePath);
+	BatchTexFreeCache(&ctx->cache);
+	return ctx->status;
+}
+
+static DWORD CALLBACK BatchTexConvertThreadEntry(LPVOID lpParam) {
+	BatchTexContext *ctx = (BatchTexContext *) lpParam;
+	return BatchTexRun(ctx, ctx->srcDir);
+}
+
 int BatchTexConvert(LPCWSTR path, LPCWSTR convertedDir) {
 	//ensure output directory exists
 	BOOL b = CreateDirectory(convertedDir, NULL);
 	if (!b && GetLastError() != ERROR_ALREADY_EXISTS) return 0; //failure
 
-	//recursively process all the textures in this directory. Ugh ummm
-	g_batchTexOut = convertedDir;
-	int status = EnumAllFiles(path, BatchTexConvertFileCallback, BatchTexConvertDirectoryCallback, BatchTexConvertDirectoryExclusion, NULL);
-	g_batchTexOut = NULL;
-	return status;
+	//recursively process all the textures in this directory on a worker thread
+	BatchTexContext ctx = { 0 };
+	ctx.srcDir = path;
+	ctx.outDir = convertedDir;
+
+	HWND hWndProgress = CreateWindow(L"CompressionProgress", L"Compressing", WS_OVERLAPPEDWINDOW & ~(WS_THICKFRAME | WS_MAXIMIZEBOX | WS_MINIMIZEBOX),
+		CW_USEDEFAULT, CW_USEDEFAULT, 500, 150, g_hWndBatchTexWindow, NULL, NULL, NULL);
+	SetWindowLongPtr(hWndProgress, GWLP_USERDATA, (LONG_PTR) &ctx.progress);
+	ShowWindow(hWndProgress, SW_SHOW);
+
+	HANDLE hThread = CreateThread(NULL, 0, BatchTexConvertThreadEntry, &ctx, 0, NULL);
+	DoModalWait(hWndProgress, hThread); //modal wait progress window
+	CloseHandle(hThread);
+
+	if (ctx.jobs != NULL) free(ctx.jobs);
+	return ctx.status;
 }
 
 BOOL CALLBACK BatchTexAddTexture(LPCWSTR path, void *param) {
 	TexArc *nsbtx = (TexArc *) param;
 
 	//read file and determine if valid
-	int size;
-	void *pf = ObjReadWholeFile(path, &size);
-	int valid = TxIsValidNnsTga(pf, size);
-	free(pf);
+	OBJ_FILE_MAPPING mapping;
+	ObjMapFile(path, &mapping);
+	int valid = mapping.buffer != NULL && TxIsValidNnsTga(mapping.buffer, mapping.size);
+	ObjUnmapFile(&mapping);
 	if (!valid) return TRUE;
 
 	//read texture
@@ -2135,15 +2300,14 @@ BOOL CALLBACK BatchTexAddTexture(LPCWSTR path, void *param) {
 	//split from object
 	TEXTURE *texture = TxUncontain(&textureObj);
 
-	//add to TexArc
+	//add to TexArc, as it would be packed: conflicting names are dropped and palettes sharing a name are merged
 	int fmt = FORMAT(texture->texels.texImageParam);
-	nsbtx->nTextures++;
-	nsbtx->textures = (TEXELS *) realloc(nsbtx->textures, nsbtx->nTextures * sizeof(TEXELS));
-	memcpy(nsbtx->textures + nsbtx->nTextures - 1, &texture->texels, sizeof(TEXELS));
+	if (TexarcAddTexture(nsbtx, &texture->texels) == -1) {
+		if (texture->texels.texel != NULL) free(texture->texels.texel);
+		if (texture->texels.cmp != NULL) free(texture->texels.cmp);
+	}
 	if (fmt != CT_DIRECT) {
-		nsbtx->nPalettes++;
-		nsbtx->palettes = (PALETTE *) realloc(nsbtx->palettes, nsbtx->nPalettes * sizeof(PALETTE));
-		memcpy(nsbtx->palettes + nsbtx->nPalettes - 1, &texture->palette, sizeof(PALETTE));
+		if (TexarcAddPalette(nsbtx, &texture->palette) == -1) free(texture->palette.pal);
 	}
 	return TRUE;
 }
@@ -2299,16 +2463,17 @@ HWND CreateTexturePaletteEditor(int x, int y, int width, int height, HWND hWndPa
 }
 
 HWND CreateTextureEditor(int x, int y, int width, int height, HWND hWndParent, LPCWSTR path) {
-	unsigned int fileSize;
-	unsigned char *bytes = ObjReadWholeFile(path, &fileSize);
+	OBJ_FILE_MAPPING mapping;
+	ObjMapFile(path, &mapping);
+	unsigned int fileSize = mapping.size;
+	unsigned char *bytes = mapping.buffer;
 	int compression = CxGetCompressionType(bytes, fileSize);
 	if (compression != COMPRESSION_NONE) {
-		unsigned char *dec = CxDecompress(bytes, fileSize, &fileSize);
-		free(bytes);
-		bytes = dec;
+		bytes = CxDecompress(bytes, fileSize, &fileSize);
 	}
 	int textureType = TxIdentify(bytes, fileSize);
-	free(bytes);
+	if (bytes != mapping.buffer) free(bytes);
+	ObjUnmapFile(&mapping);
 
 	int bWidth, bHeight;
 	COLOR32 *bits = ImgRead(path, &bWidth, &bHeight);
@@ -60,7 +60,7 @@ static void TedDrawLine(FrameBuffer *fb, COLOR32 col, int x1, int y1, int x2, in
 
 // ----- margin functions
 
-void TedMarginPaint(HWND hWnd, EDITOR_DATA *data, TedData *ted) {
+static void TedMarginRender(HWND hWnd, HDC hDC, EDITOR_DATA *data, TedData *ted) {
 	//margin dimensions
 	int marginSize = MARGIN_SIZE;
 	int marginBorderSize = MARGIN_BORDER_SIZE;
@@ -70,9 +70,6 @@ void TedMarginPaint(HWND hWnd, EDITOR_DATA *data, TedData *ted) {
 	RECT rcClient;
 	GetClientRect(hWnd, &rcClient);
 
-	PAINTSTRUCT ps;
-	HDC hDC = BeginPaint(hWnd, &ps);
-
 	//exclude clip rect
 	ExcludeClipRect(hDC, MARGIN_TOTAL_SIZE, MARGIN_TOTAL_SIZE, rcClient.right, rcClient.bottom);
 
@@ -220,9 +217,29 @@ void TedMarginPaint(HWND hWnd, EDITOR_DATA *data, TedData *ted) {
 	//blit
 	FbDraw(&ted->fbMargin, hDC, 0, 0, renderWidth, MARGIN_TOTAL_SIZE, 0, 0);
 	FbDraw(&ted->fbMargin, hDC, 0, MARGIN_TOTAL_SIZE, MARGIN_TOTAL_SIZE, renderHeight - MARGIN_TOTAL_SIZE, 0, MARGIN_TOTAL_SIZE);
+}
+
+void TedMarginPaint(HWND hWnd, EDITOR_DATA *data, TedData *ted) {
+	PAINTSTRUCT ps;
+	HDC hDC = BeginPaint(hWnd, &ps);
+	TedMarginRender(hWnd, hDC, data, ted);
 	EndPaint(hWnd, &ps);
 }
 
+static void TedRedrawMargins(TedData *ted) {
+	//draw the margins immediately. Invalidating them would send the owner a WM_PAINT, which
+	//repaints the whole viewer, so this is used for updates in response to mouse movement.
+	EDITOR_DATA *data = (EDITOR_DATA *) EditorGetData(ted->hWnd);
+	if (data == NULL || data->scale == 0 || !IsWindowVisible(ted->hWnd)) {
+		TedUpdateMargins(ted);
+		return;
+	}
+
+	HDC hDC = GetDC(ted->hWnd);
+	TedMarginRender(ted->hWnd, hDC, data, ted);
+	ReleaseDC(ted->hWnd, hDC);
+}
+
 void TedUpdateMargins(TedData *data) {
 	HWND hWnd = data->hWnd;
 
@@ -243,6 +260,100 @@ void TedUpdateMargins(TedData *data) {
 
 // ----- viewer functions
 
+static void TedGetOverlay(EDITOR_DATA *data, TedData *ted, TedOverlay *overlay) {
+	int hit = ted->mouseDown ? ted->mouseDownHit : TedHitTest(data, ted, ted->mouseX, ted->mouseY);
+	int hitType = hit & HIT_TYPE_MASK;
+
+	TedGetScroll(ted, &overlay->scrollX, &overlay->scrollY);
+	overlay->scale = data->scale;
+	overlay->showBorders = data->showBorders;
+
+	//hovered tile or row/column
+	overlay->hoverMode = TED_HOVER_NONE;
+	overlay->hoverX = ted->hoverX;
+	overlay->hoverY = ted->hoverY;
+	if (ted->hoverX != -1 && ted->hoverY != -1 && ted->mouseOver) {
+		int highlightTile = 1;
+		if (ted->suppressHighlightCallback != NULL) {
+			highlightTile = !ted->suppressHighlightCallback(ted->hWnd);
+		}
+		if (highlightTile && hitType != HIT_SEL) overlay->hoverMode = TED_HOVER_TILE;
+	} else if (ted->hoverX != -1 || ted->hoverY != -1) {
+		overlay->hoverMode = TED_HOVER_ROWCOL;
+	}
+	if (overlay->hoverMode == TED_HOVER_NONE) overlay->hoverX = overlay->hoverY = -1;
+
+	//selection
+	overlay->selX1 = min(ted->selStartX, ted->selEndX);
+	overlay->selX2 = max(ted->selStartX, ted->selEndX);
+	overlay->selY1 = min(ted->selStartY, ted->selEndY);
+	overlay->selY2 = max(ted->selStartY, ted->selEndY);
+	overlay->selHit = hitType == HIT_SEL;
+}
+
+static void TedInvalidateTilesEx(EDITOR_DATA *data, TedData *ted, int tileX, int tileY, int tilesX, int tilesY, int inflate) {
+	int tileW = ted->tileWidth * data->scale;
+	int tileH = ted->tileHeight * data->scale;
+
+	int scrollX, scrollY;
+	TedGetScroll(ted, &scrollX, &scrollY);
+
+	RECT rc;
+	rc.left = tileX * tileW - scrollX - inflate;
+	rc.top = tileY * tileH - scrollY - inflate;
+	rc.right = (tileX + tilesX) * tileW - scrollX + inflate;
+	rc.bottom = (tileY + tilesY) * tileH - scrollY + inflate;
+	InvalidateRect(ted->hWndViewer, &rc, FALSE);
+}
+
+void TedInvalidateTiles(EDITOR_DATA *data, TedData *ted, int tileX, int tileY, int tilesX, int tilesY) {
+	TedInvalidateTilesEx(data, ted, tileX, tileY, tilesX, tilesY, 0);
+}
+
+static void TedInvalidateHover(EDITOR_DATA *data, TedData *ted, const TedOverlay *overlay) {
+	switch (overlay->hoverMode) {
+		case TED_HOVER_TILE:
+			TedInvalidateTiles(data, ted, overlay->hoverX, overlay->hoverY, 1, 1);
+			break;
+		case TED_HOVER_ROWCOL:
+			if (overlay->hoverX != -1) TedInvalidateTiles(data, ted, overlay->hoverX, 0, 1, ted->tilesY);
+			if (overlay->hoverY != -1) TedInvalidateTiles(data, ted, 0, overlay->hoverY, ted->tilesX, 1);
+			break;
+	}
+}
+
+static void TedInvalidateSelection(EDITOR_DATA *data, TedData *ted, const TedOverlay *overlay) {
+	if (overlay->selX1 == -1 || overlay->selY1 == -1) return;
+
+	//the selection border may be drawn 1 pixel outside of the selected tiles
+	TedInvalidateTilesEx(data, ted, overlay->selX1, overlay->selY1, overlay->selX2 + 1 - overlay->selX1,
+		overlay->selY2 + 1 - overlay->selY1, 1);
+}
+
+static void TedInvalidateOverlay(EDITOR_DATA *data, TedData *ted) {
+	TedOverlay overlay;
+	TedGetOverlay(data, ted, &overlay);
+
+	TedOverlay *last = &ted->overlay;
+	if (overlay.scrollX != last->scrollX || overlay.scrollY != last->scrollY || overlay.scale != last->scale
+		|| overlay.showBorders != last->showBorders) {
+		//view moved: repaint all
+		InvalidateRect(ted->hWndViewer, NULL, FALSE);
+	} else {
+		//repaint regions of overlays that changed
+		if (overlay.hoverMode != last->hoverMode || overlay.hoverX != last->hoverX || overlay.hoverY != last->hoverY) {
+			TedInvalidateHover(data, ted, last);
+			TedInvalidateHover(data, ted, &overlay);
+		}
+		if (overlay.selX1 != last->selX1 || overlay.selX2 != last->selX2 || overlay.selY1 != last->selY1
+			|| overlay.selY2 != last->selY2 || overlay.selHit != last->selHit) {
+			TedInvalidateSelection(data, ted, last);
+			TedInvalidateSelection(data, ted, &overlay);
+		}
+	}
+	memcpy(last, &overlay, sizeof(overlay));
+}
+
 void TedOnViewerPaint(EDITOR_DATA *data, TedData *ted) {
 	HWND hWnd = ted->hWndViewer;
 
@@ -262,6 +373,18 @@ void TedOnViewerPaint(EDITOR_DATA *data, TedData *ted) {
 	int viewHeight = rcClient.bottom;
 	FbSetSize(&ted->fb, viewWidth, viewHeight);
 
+	//get the region to repaint. Its origin is aligned to 8 pixels so that patterns drawn relative to
+	//the rendered region line up with the rest of the view.
+	int clipX1 = ps.rcPaint.left & ~7, clipY1 = ps.rcPaint.top & ~7;
+	int clipX2 = min(ps.rcPaint.right, viewWidth), clipY2 = min(ps.rcPaint.bottom, viewHeight);
+	if (clipX1 < 0) clipX1 = 0;
+	if (clipY1 < 0) clipY1 = 0;
+	if (clipX2 <= clipX1 || clipY2 <= clipY1) {
+		EndPaint(hWnd, &ps);
+		return;
+	}
+	BOOL fullPaint = clipX1 == 0 && clipY1 == 0 && clipX2 == viewWidth && clipY2 == viewHeight;
+
 	//get mouse coord
 	POINT mouse;
 	mouse.x = ted->mouseX;
@@ -286,12 +409,19 @@ void TedOnViewerPaint(EDITOR_DATA *data, TedData *ted) {
 	if (renderWidth < 0) renderWidth = 0;
 	if (renderHeight < 0) renderHeight = 0;
 
+	//bounds of graphics within the repainted region
+	int drawX1 = clipX1, drawX2 = min(clipX2, renderWidth);
+	int drawY1 = clipY1, drawY2 = min(clipY2, renderHeight);
+
 	//get hovered row/column
 	int hovRow = ted->hoverY, hovCol = ted->hoverX;
 
-	//render character graphics
-	if (ted->renderCallback != NULL) {
-		ted->renderCallback(ted->hWnd, &ted->fb, scrollX, scrollY, renderWidth, renderHeight);
+	//render character graphics in the repainted region
+	if (ted->renderCallback != NULL && drawX2 > drawX1 && drawY2 > drawY1) {
+		FrameBuffer fbRegion = ted->fb;
+		fbRegion.px = ted->fb.px + drawX1 + drawY1 * viewWidth;
+		fbRegion.height = drawY2 - drawY1;
+		ted->renderCallback(ted->hWnd, &fbRegion, scrollX + drawX1, scrollY + drawY1, drawX2 - drawX1, drawY2 - drawY1);
 	}
 
 	//mark highlighted tiles
@@ -307,8 +437,8 @@ void TedOnViewerPaint(EDITOR_DATA *data, TedData *ted) {
 			blendW = 2;
 		}
 
-		for (int y = 0; y < renderHeight; y++) {
-			for (int x = 0; x < renderWidth; x++) {
+		for (int y = drawY1; y < drawY2; y++) {
+			for (int x = drawX1; x < drawX2; x++) {
 				int curRow = (y + scrollY) / tileH;
 				int curCol = (x + scrollX) / tileW;
 
@@ -344,7 +474,7 @@ void TedOnViewerPaint(EDITOR_DATA *data, TedData *ted) {
 						int pxX = x - scrollX + hovCol * tileW;
 						int pxY = y - scrollY + hovRow * tileH;
 
-						if (pxX >= 0 && pxY >= 0 && pxX < renderWidth && pxY < renderHeight) {
+						if (pxX >= drawX1 && pxY >= drawY1 && pxX < drawX2 && pxY < drawY2) {
 							COLOR32 col = ted->fb.px[pxX + pxY * viewWidth];
 
 							//bit trick: average with white
@@ -357,8 +487,8 @@ void TedOnViewerPaint(EDITOR_DATA *data, TedData *ted) {
 		}
 	} else if (hovRow != -1 || hovCol != -1) {
 		//mark hovered row/column
-		for (int y = 0; y < renderHeight; y++) {
-			for (int x = 0; x < renderWidth; x++) {
+		for (int y = drawY1; y < drawY2; y++) {
+			for (int x = drawX1; x < drawX2; x++) {
 				int curRow = (y + scrollY) / tileH;
 				int curCol = (x + scrollX) / tileW;
 
@@ -376,24 +506,28 @@ void TedOnViewerPaint(EDITOR_DATA *data, TedData *ted) {
 	//render gridlines
 	if (data->showBorders) {
 		//mark tile boundaries (deliberately do not mark row/col 0)
-		for (int y = tileH - (scrollY % tileH); y < renderHeight; y += tileH) {
-			for (int x = 0; x < renderWidth; x++) {
+		int gridX1 = tileW - (scrollX % tileW), gridY1 = tileH - (scrollY % tileH);
+		while (gridX1 < drawX1) gridX1 += tileW;
+		while (gridY1 < drawY1) gridY1 += tileH;
+
+		for (int y = gridY1; y < drawY2; y += tileH) {
+			for (int x = drawX1; x < drawX2; x++) {
 				//invert the pixel if (x^y) is even
 				if (((x ^ y) & 1) == 0) {
 					ted->fb.px[x + y * viewWidth] ^= 0xFFFFFF;
 				}
 			}
 		}
-		for (int y = 0; y < renderHeight; y++) {
-			for (int x = tileW - (scrollX % tileW); x < renderWidth; x += tileW) {
+		for (int y = drawY1; y < drawY2; y++) {
+			for (int x = gridX1; x < drawX2; x += tileW) {
 				//invert the pixel if (x^y) is even
 				if (((x ^ y) & 1) == 0) {
 					ted->fb.px[x + y * viewWidth] ^= 0xFFFFFF;
 				}
 			}
 		}
-		for (int y = tileH - (scrollY % tileH); y < renderHeight; y += tileH) {
-			for (int x = tileW - (scrollX % tileW); x < renderWidth; x += tileW) {
+		for (int y = gridY1; y < drawY2; y += tileH) {
+			for (int x = gridX1; x < drawX2; x += tileW) {
 				//since we did the gridlines in two passes, pass over the intersections to flip them once more
 				if (((x ^ y) & 1) == 0) {
 					ted->fb.px[x + y * viewWidth] ^= 0xFFFFFF;
@@ -404,10 +538,14 @@ void TedOnViewerPaint(EDITOR_DATA *data, TedData *ted) {
 		//if scale is >= 16x, mark each pixel
 		if (data->scale >= 16) {
 			int pxSize = data->scale;
-			for (int y = pxSize - (scrollY % pxSize); y < renderHeight; y += pxSize) {
+			int pxX1 = pxSize - (scrollX % pxSize), pxY1 = pxSize - (scrollY % pxSize);
+			while (pxX1 < drawX1) pxX1 += pxSize;
+			while (pxY1 < drawY1) pxY1 += pxSize;
+
+			for (int y = pxY1; y < drawY2; y += pxSize) {
 				if ((y + scrollY) % tileH == 0) continue; //skip grid-marked rows
 
-				for (int x = pxSize - (scrollX % pxSize); x < renderWidth; x += pxSize) {
+				for (int x = pxX1; x < drawX2; x += pxSize) {
 					if ((x + scrollX) % tileW == 0) continue; //skip grid-marked columns
 
 					ted->fb.px[x + y * viewWidth] ^= 0xFFFFFF;
@@ -436,22 +574,21 @@ void TedOnViewerPaint(EDITOR_DATA *data, TedData *ted) {
 	}
 
 	//draw background color
-	if (renderHeight < viewHeight) {
-		for (int y = renderHeight; y < viewHeight; y++) {
-			for (int x = 0; x < viewWidth; x++) {
-				ted->fb.px[x + y * viewWidth] = 0xF0F0F0;
-			}
+	for (int y = max(renderHeight, clipY1); y < clipY2; y++) {
+		for (int x = clipX1; x < clipX2; x++) {
+			ted->fb.px[x + y * viewWidth] = 0xF0F0F0;
 		}
 	}
-	if (renderWidth < viewWidth) {
-		for (int y = 0; y < renderHeight; y++) {
-			for (int x = renderWidth; x < viewWidth; x++) {
-				ted->fb.px[x + y * viewWidth] = 0xF0F0F0;
-			}
+	for (int y = clipY1; y < drawY2; y++) {
+		for (int x = max(renderWidth, clipX1); x < clipX2; x++) {
+			ted->fb.px[x + y * viewWidth] = 0xF0F0F0;
 		}
 	}
 
-	FbDraw(&ted->fb, hDC, 0, 0, viewWidth, viewHeight, 0, 0);
+	//the whole view now shows the current overlays
+	if (fullPaint) TedGetOverlay(data, ted, &ted->overlay);
+
+	FbDraw(&ted->fb, hDC, clipX1, clipY1, clipX2 - clipX1, clipY2 - clipY1, clipX1, clipY1);
 	EndPaint(hWnd, &ps);
 }
 
@@ -653,9 +790,9 @@ void TedUpdateCursor(EDITOR_DATA *data, TedData *ted) {
 		}
 	}
 
-	//repaint viewer and update margin rendering
-	InvalidateRect(ted->hWndViewer, NULL, FALSE);
-	TedUpdateMargins(ted);
+	//repaint changed regions of viewer and update margin rendering
+	TedInvalidateOverlay(data, ted);
+	TedRedrawMargins(ted);
 }
 
 void TedReleaseCursor(EDITOR_DATA *data, TedData *ted) {
@@ -955,7 +1092,9 @@ void TedMainOnMouseMove(EDITOR_DATA *data, TedData *ted, UINT msg, WPARAM wParam
 		TrackMouseEvent(&tme);
 	}
 
-	TedUpdateMargins(ted);
+	//hovered rows, columns and selection may have changed
+	TedInvalidateOverlay(data, ted);
+	TedRedrawMargins(ted);
 }
 
 void TedOnLButtonDown(EDITOR_DATA *data, TedData *ted) {
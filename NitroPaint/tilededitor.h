@@ -43,6 +43,30 @@ typedef int     (*TedIsSelectionModeCallback)   (HWND hWnd);
 typedef void    (*TedUpdateCursorCallback)      (HWND hWnd, int pxX, int pxY);
 typedef HMENU   (*TedGetPopupMenuCallback)      (HWND hWnd);
 
+//hover highlight modes
+#define TED_HOVER_NONE          0
+#define TED_HOVER_TILE          1
+#define TED_HOVER_ROWCOL        2
+
+//
+// State of the overlays drawn over the rendered graphics. When it changes, only
+// the regions of the viewer covered by the old and new overlays are repainted.
+//
+typedef struct TedOverlay_ {
+	int scrollX;        // scroll X
+	int scrollY;        // scroll Y
+	int scale;          // view scale
+	int showBorders;    // gridlines shown
+	int hoverMode;      // hover highlight mode
+	int hoverX;         // hovered char X
+	int hoverY;         // hovered char Y
+	int selX1;          // selection left char X
+	int selY1;          // selection top char Y
+	int selX2;          // selection right char X
+	int selY2;          // selection bottom char Y
+	int selHit;         // selection under cursor
+} TedOverlay;
+
 typedef struct TedData_ {
 	FrameBuffer fb;
 	FrameBuffer fbMargin;
@@ -50,7 +74,7 @@ typedef struct TedData_ {
 	//callback routines for interaction with the owner
 	TedGetCursorProc getCursorProc;                         // callback to get cursor
 	TedTileHoverCallback tileHoverCallback;                 // callback to indicate change in hovered tile
-	TedRenderCallback renderCallback;                       // callback to render graphics
+	TedRenderCallback renderCallback;                       // callback to render graphics (may render a region of the view)
 	TedSuppressHighlightCallback suppressHighlightCallback; // callback to suppress tile highlight
 	TedIsSelectionModeCallback isSelectionModeCallback;     // callback to determine selection mode
 	TedUpdateCursorCallback updateCursorCallback;           // callback to update cursor
@@ -88,6 +112,8 @@ typedef struct TedData_ {
 	int tileWidth;      // width of tile
 	int tileHeight;     // height of tile
 
+	TedOverlay overlay; // overlay state currently shown
+
 	HWND hWnd;
 	HWND hWndViewer;
 } TedData;
@@ -104,6 +130,7 @@ void TedUpdateMargins(TedData *data);
 
 void TedOnViewerPaint(EDITOR_DATA *data, TedData *ted);
 void TedGetScroll(TedData *data, int *scrollX, int *scrollY);
+void TedInvalidateTiles(EDITOR_DATA *data, TedData *ted, int tileX, int tileY, int tilesX, int tilesY);
 
 
 // ----- general functions
@@ -3,73 +3,203 @@
 #include <stdio.h>
 #include <string.h>
 
-void undoInitialize(UNDO *undoStack, int elementSize) {
-	undoStack->elementSize = elementSize;
-	undoStack->stackPosition = -1;
-	undoStack->freeFunction = NULL;
-	undoStack->stackSize = 0;
-	undoStack->elements = calloc(1, elementSize);
-	InitializeCriticalSection(&undoStack->criticalSection);
+#define UNDO_RANGE_GAP    16       // unchanged bytes that may be absorbed into a range rather than starting a new one
+
+void UndoInit(UNDO *undo, int maxEntries, size_t memoryLimit) {
+	memset(undo, 0, sizeof(UNDO));
+	undo->maxEntries = maxEntries;
+	undo->memoryLimit = memoryLimit;
+	undo->entries = (UNDO_ENTRY *) calloc(maxEntries, sizeof(UNDO_ENTRY));
 }
 
-void *undoGetElement(UNDO *undoStack, int index) {
-	return (void *) (((uintptr_t) undoStack->elements) + (index * undoStack->elementSize));
+static UNDO_ENTRY *UndoGetEntry(UNDO *undo, int index) {
+	return undo->entries + (undo->first + index) % undo->maxEntries;
 }
 
-void *undoGetStackPosition(UNDO *undoStack) {
-	return undoGetElement(undoStack, undoStack->stackPosition);
+static void UndoFreeEntry(UNDO *undo, UNDO_ENTRY *entry) {
+	undo->memory -= entry->dataSize + sizeof(UNDO_ENTRY);
+	if (entry->data != NULL) free(entry->data);
+	memset(entry, 0, sizeof(UNDO_ENTRY));
 }
 
-void *undo(UNDO *undoStack) {
-	EnterCriticalSection(&undoStack->criticalSection);
-	if (undoStack->stackPosition > 0) {
-		undoStack->stackPosition--;
+void UndoFree(UNDO *undo) {
+	for (int i = 0; i < undo->nEntries; i++) {
+		UndoFreeEntry(undo, UndoGetEntry(undo, i));
 	}
-	void *position = undoGetStackPosition(undoStack);
-	LeaveCriticalSection(&undoStack->criticalSection);
-	return position;
+	if (undo->entries != NULL) free(undo->entries);
+	if (undo->state != NULL) free(undo->state);
+	memset(undo, 0, sizeof(UNDO));
 }
 
-void *redo(UNDO *undoStack) {
-	EnterCriticalSection(&undoStack->criticalSection);
-	if (undoStack->stackPosition < undoStack->stackSize - 1) {
-		undoStack->stackPosition++;
+static void UndoWriteRange(UNDO_ENTRY *entry, unsigned int *capacity, unsigned int offset, const unsigned char *oldBytes,
+	unsigned int oldLen, const unsigned char *newBytes, unsigned int newLen) {
+	unsigned int size = 3 * sizeof(uint32_t) + oldLen + newLen;
+	if (entry->dataSize + size > *capacity) {
+		*capacity = (entry->dataSize + size) * 2;
+		entry->data = (unsigned char *) realloc(entry->data, *capacity);
 	}
-	void *position = undoGetStackPosition(undoStack);
-	LeaveCriticalSection(&undoStack->criticalSection);
-	return position;
+
+	uint32_t header[3] = { offset, oldLen, newLen };
+	unsigned char *out = entry->data + entry->dataSize;
+	memcpy(out, header, sizeof(header));
+	memcpy(out + sizeof(header), oldBytes, oldLen);
+	memcpy(out + sizeof(header) + oldLen, newBytes, newLen);
+	entry->dataSize += size;
 }
 
-void undoAdd(UNDO *undoStack, void *elem) {
-	EnterCriticalSection(&undoStack->criticalSection);
-	if (undoStack->stackPosition != undoStack->stackSize - 1) {
-		for (int i = undoStack->stackPosition + 1; i < undoStack->stackSize; i++) {
-			if (undoStack->freeFunction != NULL) {
-				undoStack->freeFunction(undoGetElement(undoStack, i));
-			}
+static int UndoDiff(UNDO_ENTRY *entry, const unsigned char *oldState, unsigned int oldSize, const unsigned char *newState, unsigned int newSize) {
+	unsigned int capacity = 0;
+	unsigned int common = oldSize < newSize ? oldSize : newSize;
+	entry->oldSize = oldSize;
+	entry->newSize = newSize;
+	entry->dataSize = 0;
+	entry->data = NULL;
+
+	unsigned int i = 0;
+	while (i < common) {
+		//skip unchanged bytes, 8 at a time where possible
+		while (i + 8 <= common) {
+			uint64_t o, n;
+			memcpy(&o, oldState + i, 8);
+			memcpy(&n, newState + i, 8);
+			if (o != n) break;
+			i += 8;
 		}
+		while (i < common && oldState[i] == newState[i]) i++;
+		if (i >= common) break;
+
+		//extend the range over short runs of unchanged bytes
+		unsigned int start = i, end = i + 1;
+		for (unsigned int j = end; j < common && j - end < UNDO_RANGE_GAP; j++) {
+			if (oldState[j] != newState[j]) end = j + 1;
+		}
+		UndoWriteRange(entry, &capacity, start, oldState + start, end - start, newState + start, end - start);
+		i = end;
 	}
-	int newPosition = undoStack->stackPosition + 1;
-	undoStack->stackPosition = newPosition;
-	undoStack->stackSize = newPosition + 1;
-	undoStack->elements = realloc(undoStack->elements, undoStack->stackSize * undoStack->elementSize);
-	memcpy(undoGetElement(undoStack, newPosition), elem, undoStack->elementSize);
-	LeaveCriticalSection(&undoStack->criticalSection);
+
+	//state grew or shrank
+	if (oldSize != newSize) {
+		UndoWriteRange(entry, &capacity, common, oldState + common, oldSize - common, newState + common, newSize - common);
+	}
+
+	if (entry->dataSize == 0) return 0;
+	entry->data = (unsigned char *) realloc(entry->data, entry->dataSize);
+	return 1;
 }
 
-void undoDestroy(UNDO *undo) {
-	EnterCriticalSection(&undo->criticalSection);
-	for (int i = 0; i < undo->stackSize; i++) {
-		if (undo->freeFunction != NULL) {
-			undo->freeFunction(undoGetElement(undo, i));
-		}
+static void UndoApply(unsigned char **pState, unsigned int *pSize, const UNDO_ENTRY *entry, int forward) {
+	unsigned int targetSize = forward ? entry->newSize : entry->oldSize;
+	if (targetSize > *pSize) *pState = (unsigned char *) realloc(*pState, targetSize);
+
+	unsigned int pos = 0;
+	while (pos < entry->dataSize) {
+		uint32_t header[3];
+		memcpy(header, entry->data + pos, sizeof(header));
+		const unsigned char *oldBytes = entry->data + pos + sizeof(header);
+		const unsigned char *newBytes = oldBytes + header[1];
+
+		if (forward) memcpy(*pState + header[0], newBytes, header[2]);
+		else memcpy(*pState + header[0], oldBytes, header[1]);
+		pos += sizeof(header) + header[1] + header[2];
 	}
-	undo->elementSize = 0;
-	undo->stackSize = 0;
-	undo->stackPosition = -1;
-	free(undo->elements);
-	undo->elements = NULL;
-	undo->freeFunction = NULL;
-	LeaveCriticalSection(&undo->criticalSection);
-	DeleteCriticalSection(&undo->criticalSection);
-}
\ No newline at end of file
+	*pSize = targetSize;
+}
+
+static void UndoSetState(UNDO *undo, const void *state, unsigned int size) {
+	undo->state = (unsigned char *) realloc(undo->state, size + 1);
+	memcpy(undo->state, state, size);
+	undo->stateSize = size;
+	undo->hasState = 1;
+}
+
+static void UndoDropOldest(UNDO *undo) {
+	UndoFreeEntry(undo, UndoGetEntry(undo, 0));
+	undo->first = (undo->first + 1) % undo->maxEntries;
+	undo->nEntries--;
+	undo->position--;
+}
+
+static int UndoMergeCheckpoint(UNDO *undo, const void *state, unsigned int size) {
+	//diff against the state before the last step, reverting the last step in place since
+	//the state is replaced by the new one afterwards anyway
+	UNDO_ENTRY *top = UndoGetEntry(undo, undo->nEntries - 1);
+	UndoApply(&undo->state, &undo->stateSize, top, 0);
+
+	UNDO_ENTRY merged = { 0 };
+	int changed = UndoDiff(&merged, undo->state, undo->stateSize, (const unsigned char *) state, size);
+
+	merged.group = top->group;
+	UndoFreeEntry(undo, top);
+	if (changed) {
+		*top = merged;
+		undo->memory += merged.dataSize + sizeof(UNDO_ENTRY);
+	} else {
+		//the action returned to where it started
+		undo->nEntries--;
+		undo->position--;
+	}
+	UndoSetState(undo, state, size);
+
+	//keep within the memory limit, always keeping the newest step
+	while (undo->memory > undo->memoryLimit && undo->nEntries > 1) UndoDropOldest(undo);
+	return 1;
+}
+
+int UndoCheckpoint(UNDO *undo, const void *state, unsigned int size, unsigned int group) {
+	if (!undo->hasState) {
+		UndoSetState(undo, state, size);
+		return 0;
+	}
+	if (size == undo->stateSize && memcmp(state, undo->state, size) == 0) return 0;
+
+	//continuing the last step
+	if (group != 0 && undo->position == undo->nEntries && undo->nEntries > 0
+		&& UndoGetEntry(undo, undo->nEntries - 1)->group == group) {
+		return UndoMergeCheckpoint(undo, state, size);
+	}
+
+	//discard steps that were undone
+	while (undo->nEntries > undo->position) {
+		UndoFreeEntry(undo, UndoGetEntry(undo, undo->nEntries - 1));
+		undo->nEntries--;
+	}
+	if (undo->nEntries == undo->maxEntries) UndoDropOldest(undo);
+
+	UNDO_ENTRY *entry = UndoGetEntry(undo, undo->nEntries);
+	UndoDiff(entry, undo->state, undo->stateSize, (const unsigned char *) state, size);
+	entry->group = group;
+	undo->memory += entry->dataSize + sizeof(UNDO_ENTRY);
+	undo->nEntries++;
+	undo->position++;
+	UndoSetState(undo, state, size);
+
+	//keep within the memory limit, always keeping the newest step
+	while (undo->memory > undo->memoryLimit && undo->nEntries > 1) UndoDropOldest(undo);
+	return 1;
+}
+
+const unsigned char *UndoStepBack(UNDO *undo, unsigned int *pSize) {
+	if (!UndoCanStepBack(undo)) return NULL;
+
+	undo->position--;
+	UndoApply(&undo->state, &undo->stateSize, UndoGetEntry(undo, undo->position), 0);
+	*pSize = undo->stateSize;
+	return undo->state;
+}
+
+const unsigned char *UndoStepForward(UNDO *undo, unsigned int *pSize) {
+	if (!UndoCanStepForward(undo)) return NULL;
+
+	UndoApply(&undo->state, &undo->stateSize, UndoGetEntry(undo, undo->position), 1);
+	undo->position++;
+	*pSize = undo->stateSize;
+	return undo->state;
+}
+
+int UndoCanStepBack(const UNDO *undo) {
+	return undo->position > 0;
+}
+
+int UndoCanStepForward(const UNDO *undo) {
+	return undo->position < undo->nEntries;
+}
@@ -1,25 +1,67 @@
 #pragma once
 #include <Windows.h>
 
+#define UNDO_DEFAULT_MAX_ENTRIES   4096                     // default number of undo steps kept
+#define UNDO_DEFAULT_MEMORY_LIMIT  (16 * 1024 * 1024)       // default bytes of deltas kept
+
+//
+// One undo step: the byte ranges of the state that changed, with their
+// contents before and after the step. Only the last range may change length,
+// when the state grows or shrinks.
+//
+typedef struct UNDO_ENTRY_ {
+	unsigned int group;            // nonzero when later checkpoints of the same group may merge into it
+	unsigned int oldSize;          // state size before the step
+	unsigned int newSize;          // state size after the step
+	unsigned int dataSize;
+	unsigned char *data;           // ranges: offset, old length, new length, old bytes, new bytes
+} UNDO_ENTRY;
+
+//
+// Undo journal of a flat byte image of an editor's state. The journal keeps a
+// copy of the state at its current position, and records each checkpoint as a
+// delta against that copy. Steps are kept in a ring bounded by a number of
+// steps and the memory held by their deltas; the oldest steps are discarded
+// first.
+//
 typedef struct UNDO_ {
-	int elementSize;
-	void (*freeFunction) (void *);
-	int stackPosition;
-	int stackSize;
-	void *elements;
-	CRITICAL_SECTION criticalSection;
+	unsigned char *state;          // state at the current position
+	unsigned int stateSize;
+	int hasState;                  // the first checkpoint only sets the state
+	UNDO_ENTRY *entries;           // ring of steps
+	int maxEntries;
+	int first;                     // ring index of the oldest step
+	int nEntries;                  // number of steps in the ring
+	int position;                  // number of steps applied to the state
+	size_t memory;                 // bytes held by step deltas
+	size_t memoryLimit;
 } UNDO;
 
-void undoInitialize(UNDO *undoStack, int elementSize);
+void UndoInit(UNDO *undo, int maxEntries, size_t memoryLimit);
 
-void *undoGetElement(UNDO *undoStack, int index);
+void UndoFree(UNDO *undo);
 
-void *undoGetStackPosition(UNDO *undoStack);
+//
+// Record the changes from the current position to a new state as a step,
+// discarding the steps that were undone. Nothing is recorded if the state is
+// unchanged. A nonzero group merges the changes into the last step if it was
+// recorded with the same group and has not been undone, so that a continuous
+// action is undone at once. Returns 1 if a step was recorded or extended.
+//
+int UndoCheckpoint(UNDO *undo, const void *state, unsigned int size, unsigned int group);
 
-void *undo(UNDO *undoStack);
+//
+// Undo one step. Returns the state before the step, or NULL if there is no step
+// to undo. The returned state is owned by the journal.
+//
+const unsigned char *UndoStepBack(UNDO *undo, unsigned int *pSize);
 
-void *redo(UNDO *undoStack);
+//
+// Redo one step. Returns the state after the step, or NULL if there is no step
+// to redo. The returned state is owned by the journal.
+//
+const unsigned char *UndoStepForward(UNDO *undo, unsigned int *pSize);
 
-void undoAdd(UNDO *undoStack, void *elem);
+int UndoCanStepBack(const UNDO *undo);
 
-void undoDestroy(UNDO *undo);
\ No newline at end of file
+int UndoCanStepForward(const UNDO *undo);